@@ -0,0 +1,329 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include "CommandLineArgs.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "TreeDeleter.h"
+#include "TreeWalker.h"
+
+using namespace std;
+using namespace w32;
+
+//Benchmarks for the registry and string code in Shared.
+//Everything runs against a generated in-memory hive, so the results do not depend on
+//the contents of the registry of the machine, and nothing on the machine is changed.
+
+struct CBenchResult
+{
+    string Name;
+    size_t Ops;                 //operations per repetition
+    double MinNs;               //per operation, fastest repetition
+    double MedianNs;            //per operation, median repetition
+};
+
+class CBenchRunner
+{
+    size_t m_repetitions;
+    wstring m_filter;
+    vector<CBenchResult> m_results;
+
+public:
+    CBenchRunner(size_t repetitions, const wstring& filter) :
+        m_repetitions(repetitions), m_filter(filter)
+    {
+    }
+
+    //Time body once per repetition, after one untimed warm up run.
+    //setup runs before every run of body and is not timed.
+    void Run(const string& name, size_t ops, function<void()> body,
+        function<void()> setup = function<void()>())
+    {
+        if (!m_filter.empty() && StringToWString(name).find(m_filter.c_str()) == wstring::npos)
+            return;
+
+        vector<double> times;
+        for (size_t rep = 0; rep <= m_repetitions; rep++) {
+            if (setup)
+                setup();
+            auto start = chrono::steady_clock::now();
+            body();
+            auto elapsed = chrono::steady_clock::now() - start;
+            if (rep > 0)
+                times.push_back((double)chrono::duration_cast<chrono::nanoseconds>(elapsed).count());
+        }
+
+        sort(times.begin(), times.end());
+        CBenchResult result;
+        result.Name = name;
+        result.Ops = ops;
+        result.MinNs = times.front() / ops;
+        result.MedianNs = times[times.size() / 2] / ops;
+        m_results.push_back(result);
+
+        wcerr << left << setw(24) << StringToWString(name).c_str() << right <<
+            fixed << setprecision(1) << setw(12) << result.MedianNs << L" ns/op" << endl;
+    }
+
+    //One object with the settings and a list of results
+    void WriteJson(ostream& out, size_t libraries)
+    {
+        out << "{\n";
+        out << "  \"tool\": \"RegBench\",\n";
+        out << "  \"schema\": 1,\n";
+#ifdef NDEBUG
+        out << "  \"build\": \"release\",\n";
+#else
+        out << "  \"build\": \"debug\",\n";
+#endif
+        out << "  \"libraries\": " << libraries << ",\n";
+        out << "  \"repetitions\": " << m_repetitions << ",\n";
+        out << "  \"results\": [";
+        for (size_t i = 0; i < m_results.size(); i++) {
+            const CBenchResult& result = m_results[i];
+            out << (i ? ",\n" : "\n");
+            out << "    { \"name\": \"" << result.Name << "\", \"ops\": " << result.Ops <<
+                fixed << setprecision(2) <<
+                ", \"min_ns_per_op\": " << result.MinNs <<
+                ", \"median_ns_per_op\": " << result.MedianNs <<
+                ", \"ops_per_sec\": " << (result.MedianNs > 0 ? 1e9 / result.MedianNs : 0) << " }";
+        }
+        out << "\n  ]\n}\n";
+    }
+};
+
+//GUIDs that are different for every index and the same on every run
+static GUID BenchGuid(size_t index)
+{
+    GUID guid = {};
+    guid.Data1 = (unsigned long)(0x5EED0000 + index);
+    guid.Data2 = (unsigned short)(index * 7);
+    guid.Data3 = 0x4000;
+    for (int i = 0; i < 8; i++)
+        guid.Data4[i] = (unsigned char)(index >> (i % 4 * 8)) ^ (unsigned char)(0xA0 + i);
+    return guid;
+}
+
+//A TypeLib tree the way RegisterTypeLib leaves it:
+//{guid}\1.0 (name), 1.0\0\win32 (path), 1.0\FLAGS and 1.0\HELPDIR. 6 keys per library.
+static void GenerateTypeLibs(IRegBackend* backend, const wstring& path, size_t libraries)
+{
+    CHKey root = CHKey::Create(HKEY_LOCAL_MACHINE, path,
+        GENERIC_READ | GENERIC_WRITE, INVALID_HANDLE_VALUE, backend);
+    for (size_t i = 0; i < libraries; i++) {
+        wstring number = to_wstring(i);
+        CHKey version = root.CreateSubKey(WStringFromGUID(BenchGuid(i)) + L"\\1.0",
+            GENERIC_READ | GENERIC_WRITE);
+        version.SetValue(L"", L"Benchmark Type Library " + number);
+        version.CreateSubKey(L"0\\win32", GENERIC_READ | GENERIC_WRITE).SetValue(L"",
+            L"C:\\Program Files\\Benchmark\\Library" + number + L".tlb");
+        version.CreateSubKey(L"FLAGS", GENERIC_READ | GENERIC_WRITE).SetValue(L"", L"0");
+        version.CreateSubKey(L"HELPDIR", GENERIC_READ | GENERIC_WRITE).SetValue(L"",
+            L"C:\\Program Files\\Benchmark");
+    }
+}
+
+class CCountingVisitor : public IKeyVisitor
+{
+public:
+    size_t Keys = 0;
+    void Visit(CHKey&, const CKeySnapshot&, size_t) override { Keys++; }
+};
+
+int wmain(int argc, wchar_t* argv[])
+{
+    try
+    {
+        int libraries = 2000;
+        int repetitions = 5;
+        wstring jsonPath;
+        wstring filter;
+
+        CCommandLineArgs args(argc, argv);
+        wstring program;
+        args.GetNext(program);
+        while (args.GetNext()) {
+            if (args.TryParseArg(L"/libraries", libraries) ||
+                args.TryParseArg(L"/reps", repetitions) ||
+                args.TryParseArg(L"/json", jsonPath) ||
+                args.TryParseArg(L"/filter", filter)) {
+                continue;
+            }
+            wcout << L"USAGE:" << endl;
+            wcout << L"RegBench [/libraries <n>] [/reps <n>] [/filter <name part>] [/json <file>]" << endl;
+            wcout << L"/libraries <n>\t\tNumber of type libraries in the generated hive, 6 keys each. Default 2000." << endl;
+            wcout << L"/reps <n>\t\tNumber of timed repetitions of every benchmark. Default 5." << endl;
+            wcout << L"/filter <name part>\tOnly run the benchmarks whose name contains this." << endl;
+            wcout << L"/json <file>\t\tWrite the results to a file instead of to the console." << endl;
+            return 1;
+        }
+        if (libraries < 1 || repetitions < 1) {
+            wcout << L"/libraries and /reps must be at least 1" << endl;
+            return 1;
+        }
+
+        CBenchRunner runner(repetitions, filter);
+        size_t count = libraries;
+        size_t keys = count * 6;
+
+        CMemRegBackend hive;
+        GenerateTypeLibs(&hive, L"Bench\\TypeLib", count);
+        CHKey typeLibs = CHKey::Open(HKEY_LOCAL_MACHINE, L"Bench\\TypeLib",
+            GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+
+        vector<wstring> names = typeLibs.GetSubKeys();
+        vector<CHKey> versions;
+        for (const wstring& name : names)
+            versions.push_back(typeLibs.OpenSubKey(name + L"\\1.0"));
+
+        //CHKey enumeration and lookups
+        runner.Run("enum_subkeys", count, [&]() {
+            size_t found = 0;
+            for (wstring_view name : typeLibs.SubKeys())
+                found += name.size();
+            if (found == 0)
+                throw AppException(L"No subkeys enumerated");
+        });
+        runner.Run("get_subkeys", count, [&]() {
+            if (typeLibs.GetSubKeys().size() != count)
+                throw AppException(L"Wrong number of subkeys");
+        });
+        runner.Run("open_subkey", count, [&]() {
+            for (const wstring& name : names)
+                typeLibs.OpenSubKey(name);
+        });
+        runner.Run("subkey_exists", count, [&]() {
+            for (const wstring& name : names)
+                typeLibs.SubKeyExists(name);
+        });
+
+        //value reads
+        runner.Run("get_ws_value", count, [&]() {
+            for (CHKey& version : versions)
+                version.GetWSValue(L"");
+        });
+        vector<BYTE> buffer;
+        runner.Run("get_value_buffer", count, [&]() {
+            for (CHKey& version : versions)
+                version.GetValue(L"", buffer);
+        });
+        CKeySnapshot snapshot;
+        runner.Run("snapshot_reuse", count, [&]() {
+            for (CHKey& version : versions)
+                version.Snapshot(snapshot);
+        });
+
+        //subtree walks
+        CThreadPool pool;
+        runner.Run("walk_tree", keys + 1, [&]() {
+            CCountingVisitor visitor;
+            CTreeWalker walker(pool);
+            walker.Walk(typeLibs, visitor);
+        });
+        runner.Run("walk_tree_structure", keys + 1, [&]() {
+            CCountingVisitor visitor;
+            CTreeWalker walker(pool, false);
+            walker.Walk(typeLibs, visitor);
+        });
+
+        //deletes, each on a fresh copy of the tree that is generated without timing
+        runner.Run("delete_tree", keys, [&]() {
+            CHKey::DeleteTree(HKEY_LOCAL_MACHINE, L"Bench\\Delete", true,
+                INVALID_HANDLE_VALUE, &hive);
+        }, [&]() {
+            GenerateTypeLibs(&hive, L"Bench\\Delete", count);
+        });
+        runner.Run("tree_deleter", keys, [&]() {
+            CTreeDeleter deleter(&hive, pool);
+            deleter.DeleteTree(HKEY_LOCAL_MACHINE, L"Bench\\Delete", true);
+        }, [&]() {
+            GenerateTypeLibs(&hive, L"Bench\\Delete", count);
+        });
+
+        //StringHelper
+        const size_t strings = 100000;
+        wstring wide = L"Software\\Classes\\TypeLib\\{00020430-0000-0000-C000-000000000046}";
+        string narrow = WStringToString(wide);
+        runner.Run("wstring_to_string", strings, [&]() {
+            for (size_t i = 0; i < strings; i++)
+                WStringToString(wide);
+        });
+        runner.Run("string_to_wstring", strings, [&]() {
+            for (size_t i = 0; i < strings; i++)
+                StringToWString(narrow);
+        });
+        runner.Run("compare_no_case", strings, [&]() {
+            int sum = 0;
+            for (size_t i = 0; i < strings; i++)
+                sum += CompareNoCase(names[i % count], names[(i + 1) % count]);
+            if (sum == INT_MAX)
+                throw AppException(L"Unexpected comparison result");
+        });
+
+        //GUID parse and format
+        vector<wstring> guidStrings;
+        for (size_t i = 0; i < 1000; i++)
+            guidStrings.push_back(WStringFromGUID(BenchGuid(i)));
+        runner.Run("guid_format", strings, [&]() {
+            for (size_t i = 0; i < strings; i++)
+                WStringFromGUID(BenchGuid(i % 1000));
+        });
+        runner.Run("guid_parse", strings, [&]() {
+            GUID guid;
+            for (size_t i = 0; i < strings; i++)
+                GUIDFromWString(guidStrings[i % 1000], guid);
+        });
+
+        if (jsonPath.empty()) {
+            runner.WriteJson(cout, count);
+        }
+        else {
+            ofstream file(filesystem::path(jsonPath), ios::trunc);
+            runner.WriteJson(file, count);
+            if (!file.good())
+                throw AppException(L"Cannot write " + jsonPath);
+        }
+    }
+    catch (const AppException& ex) {
+        cout << ex.what() << endl;
+        return 1;
+    }
+    return 0;
+}
+
+#ifndef _WIN32
+//Outside Windows the arguments are narrow UTF-8 strings
+int main(int argc, char* argv[])
+{
+    vector<wstring> wideArgs;
+    vector<wchar_t*> wideArgv;
+    for (int i = 0; i < argc; i++)
+        wideArgs.push_back(StringToWString(argv[i]));
+    for (wstring& arg : wideArgs)
+        wideArgv.push_back(arg.data());
+    return wmain(argc, wideArgv.data());
+}
+#endif
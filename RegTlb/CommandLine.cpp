@@ -53,6 +53,11 @@ CCommandLine::CCommandLine(int argc, wchar_t* argv[]) :
 	CCommandLineArgs(argc, argv)
 {
 	m_argsValid = true;
+	m_stats = false;
+	m_native = false;
+	m_whatIf = false;
+	m_fullScan = false;
+	m_fix = false;
 	m_command = ECommand::NONE;
 	m_guid = L"";
 	m_major = 0;
@@ -62,12 +67,22 @@ CCommandLine::CCommandLine(int argc, wchar_t* argv[]) :
 
 	std::wstring temp;
 	int tempint;
+	bool verify = false;
+	bool rebuild = false;
+	bool orphans = false;
+	bool check = false;
 	GetNext(m_path);
 	while (m_argsValid && GetNext())
 	{
 		if (ParseCommand(GetCurrent(), m_command)) {
 			continue;
 		}
+		else if (TryParseFlag(L"/stats", m_stats) || TryParseFlag(L"/native", m_native) ||
+			TryParseFlag(L"/whatif", m_whatIf) || TryParseFlag(L"/verify", verify) ||
+			TryParseFlag(L"/rebuild", rebuild) || TryParseFlag(L"/orphans", orphans) ||
+			TryParseFlag(L"/fix", m_fix) || TryParseFlag(L"/check", check)) {
+			continue;
+		}
 		else if (
 			TryParseArg(L"/guid", m_guid) ||
 			TryParseArg(L"/major", m_major) ||
@@ -85,6 +100,29 @@ CCommandLine::CCommandLine(int argc, wchar_t* argv[]) :
 			else
 				m_argsValid = false;
 		}
+		else if (TryParseArg(L"/hive", m_hivePath)) {
+			if (PathFileExistsW(m_hivePath.c_str())) {
+				continue;
+			}
+			else
+				m_argsValid = false;
+		}
+		else if (TryParseArg(L"/cache", m_cachePath) || TryParseArg(L"/index", m_indexPath) ||
+			TryParseArg(L"/file", m_filePath) || TryParseArg(L"/progid", m_progId)) {
+			continue;
+		}
+		else if (TryParseArg(L"/snapshot", m_snapshotPath)) {
+			m_command = ECommand::SNAPSHOT;
+			continue;
+		}
+		else if (TryParseArg(L"/diff", m_snapshotPath) && GetNext(m_diffPath)) {
+			if (PathFileExistsW(m_snapshotPath.c_str()) && PathFileExistsW(m_diffPath.c_str())) {
+				m_command = ECommand::DIFF;
+				continue;
+			}
+			else
+				m_argsValid = false;
+		}
 		else if (TryParseArg(L"/syskind", temp)) {
 			if (temp == L"win64") {
 				m_syskind = SYS_WIN64;
@@ -109,6 +147,35 @@ CCommandLine::CCommandLine(int argc, wchar_t* argv[]) :
 	if (!m_argsValid)
 		return;
 
+	//looking for orphans and checking are commands of their own
+	if (orphans || check) {
+		if (m_command != ECommand::NONE || (orphans && check)) {
+			m_argsValid = false;
+			return;
+		}
+		m_command = orphans ? ECommand::ORPHANS : ECommand::CHECK;
+	}
+	if (m_fix && m_command != ECommand::ORPHANS) {
+		m_argsValid = false;
+		return;
+	}
+
+	//an index file without another command is built, or refreshed
+	if (!m_indexPath.empty() && m_command == ECommand::NONE && !verify) {
+		m_command = ECommand::INDEX;
+		m_fullScan = rebuild;
+		rebuild = false;
+	}
+
+	//verifying or rebuilding is the whole command, and needs nothing but the cache file
+	if (verify || rebuild) {
+		if (verify == rebuild || m_command != ECommand::NONE || m_cachePath.empty()) {
+			m_argsValid = false;
+			return;
+		}
+		m_command = verify ? ECommand::CACHE_VERIFY : ECommand::CACHE_REBUILD;
+	}
+
 	//bail if the application is not running for install or uninstall
 	if (m_command == ECommand::NONE) {
 		m_argsValid = false;
@@ -139,6 +206,40 @@ CCommandLine::CCommandLine(int argc, wchar_t* argv[]) :
 
 	}
 
+	//only registration has a native implementation, which is also what /whatif plans
+	if ((m_native || m_whatIf) && m_command != ECommand::INSTALL && m_command != ECommand::INSTALL_PER_USER) {
+		m_argsValid = false;
+		return;
+	}
+
+	//the cache is used where a library is read: /q /tlb, /whatif, /native and /check
+	if (!m_cachePath.empty() && m_command != ECommand::CACHE_VERIFY && m_command != ECommand::CACHE_REBUILD) {
+		bool query = m_command == ECommand::QUERY && !m_tlbPath.empty();
+		if (!query && !m_native && !m_whatIf && m_command != ECommand::CHECK) {
+			m_argsValid = false;
+			return;
+		}
+	}
+
+	//the index answers queries for one GUID, file or ProgID
+	if (m_command == ECommand::QUERY && !m_indexPath.empty()) {
+		int keys = (m_guid.empty() ? 0 : 1) + (m_filePath.empty() ? 0 : 1) + (m_progId.empty() ? 0 : 1);
+		if (keys != 1 || !m_tlbPath.empty() || !m_hivePath.empty()) {
+			m_argsValid = false;
+			return;
+		}
+	}
+	else if (!m_filePath.empty() || !m_progId.empty()) {
+		m_argsValid = false;
+		return;
+	}
+
+	//an offline hive can only be queried
+	if (!m_hivePath.empty() && m_command != ECommand::QUERY) {
+		m_argsValid = false;
+		return;
+	}
+
 	//if the purpose is to query, we need a GUID
 }
 
@@ -147,10 +248,15 @@ void CCommandLine::PrintUsage(void)
 	wcout << L"This program can register or unregister type libraries." << endl;
 	//wcout << L"It also has the ability to add or remove the type library references for applicable COM classes and interfaces." << endl;
 	wcout << L"USAGE:" << endl;
-	wcout << L"RegTlb [/i | /i_user] /tlb <library path>" << endl;
+	wcout << L"RegTlb [/i | /i_user] /tlb <library path> [/native | /whatif]" << endl;
 	wcout << L"/i\t\t\tRegister the type library" << endl;
 	wcout << L"/i_user\t\t\tRegister the type library for the current user" << endl;
 	wcout << L"/tlb <path>\t\tthe full path of the tlb file. Use double quotes if the path has spaces." << endl;
+	wcout << L"/native\t\t\tWrite the registry entries directly, in one transaction, instead of calling RegisterTypeLib." << endl;
+	wcout << L"\t\t\tValues that are already registered are not written again." << endl;
+	wcout << L"/whatif\t\t\tShow what /native would create, update and delete, without changing anything." << endl;
+	wcout << L"/cache <file>\t\tWith /native or /whatif, take the library information from a cache file, if the" << endl;
+	wcout << L"\t\t\tlibrary did not change since it was cached, instead of reading the library." << endl;
 	wcout << L"Relative paths are allowed for the tlb file. The relative path will be converted." << endl;
 	wcout << L"to absolute paths when registering the tlb file in the registry." << endl << endl << endl;
 
@@ -160,10 +266,43 @@ void CCommandLine::PrintUsage(void)
 	wcout << L"/u_user\t\t\tUnregister the type library for the current user." << endl;
 	wcout << L"/tlb <path>\t\tthe full path of the tlb file. Use double quotes if the path has spaces." << endl << endl << endl;
 
-	wcout << L"RegTlb /q [/tlb <library path> | /guid <guid>]" << endl;
+	wcout << L"RegTlb /q [/tlb <library path> | /guid <guid> [/hive <hive path>]]" << endl;
 	wcout << L"/q\t\t\tQuery type library information" << endl;
 	wcout << L"/tlb <library path>\t\tQuery type library information that is contained in the library (identifiers)" << endl;
-	wcout << L"/guid <guid>\t\tQuery type library information that is contained in the registry for the specified GUID" << endl << endl << endl;
+	wcout << L"/guid <guid>\t\tQuery type library information that is contained in the registry for the specified GUID" << endl;
+	wcout << L"/hive <hive path>\tQuery an offline registry hive file (e.g. SOFTWARE or NTUSER.DAT) instead of the registry." << endl;
+	wcout << L"/cache <file>\t\tWith /tlb, take the library information from a cache file if the library did not change." << endl << endl << endl;
+
+	wcout << L"RegTlb /q /index <file> [/guid <guid> | /file <path> | /progid <progid>]" << endl;
+	wcout << L"Answer from a COM index file instead of searching the registry." << endl;
+	wcout << L"/guid <guid>\t\tThe files of a type library, the type library of an interface or class, the ProgIDs of a class." << endl;
+	wcout << L"/file <path>\t\tThe type libraries and classes that are registered with a file." << endl;
+	wcout << L"/progid <progid>\tThe CLSID of a ProgID." << endl << endl << endl;
+
+	wcout << L"RegTlb /index <file> [/rebuild]" << endl;
+	wcout << L"Index the TypeLib, Interface, CLSID and ProgID keys of the machine and the current user." << endl;
+	wcout << L"An existing index is refreshed: only the keys that changed since it was saved are read." << endl;
+	wcout << L"/rebuild\t\tRead all keys, also when the index exists." << endl << endl << endl;
+
+	wcout << L"RegTlb /orphans [/fix]" << endl;
+	wcout << L"List the type library registrations of the machine and the current user whose file does not exist." << endl;
+	wcout << L"/fix\t\t\tDelete them, in transactions of a limited size." << endl << endl << endl;
+
+	wcout << L"RegTlb /check [/tlb <library path>] [/cache <file>]" << endl;
+	wcout << L"Check that the Interface and CLSID keys of the machine and the current user point at the type libraries" << endl;
+	wcout << L"that have those interfaces and classes. Without /tlb, every registered library whose file exists is checked." << endl;
+	wcout << L"Reports keys that are missing, that point at another version or a type the library no longer has (stale)," << endl;
+	wcout << L"and that point at another library (conflicting)." << endl << endl << endl;
+
+	wcout << L"RegTlb /cache <file> [/verify | /rebuild]" << endl;
+	wcout << L"/verify\t\t\tCompare every library in the cache with its file, including the contents, and list" << endl;
+	wcout << L"\t\t\tthe ones that changed or are gone." << endl;
+	wcout << L"/rebuild\t\tRead every library in the cache again, and drop the ones that are gone." << endl << endl << endl;
+
+	wcout << L"RegTlb /snapshot <file>" << endl;
+	wcout << L"Save the TypeLib, CLSID and Interface keys of the machine and the current user to a snapshot file." << endl;
+	wcout << L"RegTlb /diff <before file> <after file>" << endl;
+	wcout << L"Show the keys and values that differ between two snapshot files, e.g. taken before and after /i." << endl << endl << endl;
 
 	wcout << L"RegTlb /u /guid <guid> /major <version> /minor <version> [/locale <lcid>] /syskind <kind> " << endl;
 	wcout << L"/u\t\t\tUnregister the type library" << endl;
@@ -174,6 +313,9 @@ void CCommandLine::PrintUsage(void)
 	wcout << L"/syskind <kind>\t\tString value. The system kind. WIN32 or WIN64 are supported." << endl;
 	wcout << L"In case of doubt, use RegTlb /q /guid <guid> first to find the appropriate values." << endl << endl << endl;
 
+	wcout << L"/stats\t\t\tCan be added to any command. Print the number of registry and type library calls," << endl;
+	wcout << L"\t\t\tthe bytes read and written, errors and latencies when the command is done." << endl << endl << endl;
+
 	
 
 	//wcout << L"Optional arguments" << endl;
@@ -192,11 +334,71 @@ std::wstring CCommandLine::GetPath(void)
 	return m_tlbPath;
 }
 
+std::wstring CCommandLine::GetHivePath(void)
+{
+	return m_hivePath;
+}
+
+std::wstring CCommandLine::GetSnapshotPath(void)
+{
+	return m_snapshotPath;
+}
+
+std::wstring CCommandLine::GetDiffPath(void)
+{
+	return m_diffPath;
+}
+
+std::wstring CCommandLine::GetCachePath(void)
+{
+	return m_cachePath;
+}
+
+std::wstring CCommandLine::GetIndexPath(void)
+{
+	return m_indexPath;
+}
+
+std::wstring CCommandLine::GetFilePath(void)
+{
+	return m_filePath;
+}
+
+std::wstring CCommandLine::GetProgId(void)
+{
+	return m_progId;
+}
+
 ECommand CCommandLine::GetCommand(void)
 {
 	return m_command;
 }
 
+bool CCommandLine::GetStats(void)
+{
+	return m_stats;
+}
+
+bool CCommandLine::GetNative(void)
+{
+	return m_native;
+}
+
+bool CCommandLine::GetWhatIf(void)
+{
+	return m_whatIf;
+}
+
+bool CCommandLine::GetFullScan(void)
+{
+	return m_fullScan;
+}
+
+bool CCommandLine::GetFix(void)
+{
+	return m_fix;
+}
+
 GUID CCommandLine::GetGuid(void)
 {
 	GUID guid;
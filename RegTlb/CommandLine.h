@@ -24,7 +24,14 @@ enum class ECommand {
 	INSTALL_PER_USER,
 	UNINSTALL,
 	UNINSTALL_PER_USER,
-	QUERY
+	QUERY,
+	SNAPSHOT,
+	DIFF,
+	CACHE_VERIFY,
+	CACHE_REBUILD,
+	INDEX,
+	ORPHANS,
+	CHECK
 };
 
 class CCommandLine : private CCommandLineArgs
@@ -32,9 +39,21 @@ class CCommandLine : private CCommandLineArgs
 private:
 	std::wstring m_path;
 	std::wstring m_tlbPath;
+	std::wstring m_hivePath;
+	std::wstring m_snapshotPath;
+	std::wstring m_diffPath;
+	std::wstring m_cachePath;
+	std::wstring m_indexPath;
+	std::wstring m_filePath;
+	std::wstring m_progId;
 	std::wstring m_guid;
 	ECommand m_command;
 	bool m_argsValid;
+	bool m_stats;
+	bool m_native;
+	bool m_whatIf;
+	bool m_fullScan;
+	bool m_fix;
 	WORD m_major;
 	WORD m_minor;
 	LCID m_locale;
@@ -48,7 +67,19 @@ public:
 	void PrintUsage(void);
 	bool ArgsValid(void);
 	std::wstring GetPath(void);
+	std::wstring GetHivePath(void);
+	std::wstring GetSnapshotPath(void);
+	std::wstring GetDiffPath(void);
+	std::wstring GetCachePath(void);
+	std::wstring GetIndexPath(void);
+	std::wstring GetFilePath(void);
+	std::wstring GetProgId(void);
 	ECommand GetCommand(void);
+	bool GetStats(void);
+	bool GetNative(void);
+	bool GetWhatIf(void);
+	bool GetFullScan(void);
+	bool GetFix(void);
 	GUID GetGuid(void);
 	WORD GetMajor(void);
 	WORD GetMinor(void);
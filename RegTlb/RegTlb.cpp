@@ -19,14 +19,60 @@
 #include "TypeLibrary.h"
 #include "CommandLine.h"
 #include "CommandLineArgs.h"
+#include "ComIndex.h"
 #include "ConsoleHelper.h"
 #include "HKey.h"
+#include "InstrumentedBackend.h"
+#include "RegfBackend.h"
+#include "RegSnapshotFile.h"
+#include "TlbCache.h"
+#include "TlbChecker.h"
+#include "TlbOrphanScanner.h"
+#include "TlbRegPlan.h"
+#include <memory>
+#include <optional>
+#include <set>
 
 using namespace std;
 using namespace w32;
 
+//The information of a library, from the cache file if one was given and it has the
+//library as it is now. Otherwise the library is read, and added to the cache file.
+static CTlbMetadata ReadLibrary(const std::wstring& path, const std::wstring& cachePath)
+{
+    if (cachePath.empty()) {
+        return CTypeLibrary(path).Metadata();
+    }
+
+    CTlbCache cache(cachePath);
+    CTlbMetadata metadata = cache.Get(path);
+    if (cache.Modified() && !cache.Save()) {
+        wcout << L"The cache file " << cachePath << L" is in use and was not updated." << endl;
+    }
+    return metadata;
+}
+
+//Print the entries of the index of one kind with a key, under a title if there are any
+static size_t PrintIndexEntries(const CComIndex& index, EComIndexKind kind, const std::wstring& key,
+    const wchar_t* title)
+{
+    std::vector<CComIndexEntry> entries = index.Find(kind, key);
+    if (!entries.empty()) {
+        wcout << title << endl;
+    }
+    for (const CComIndexEntry& entry : entries) {
+        wcout << L"    " << (entry.PerUser ? L"user    " : L"machine ") << entry.Value;
+        if (!entry.Detail.empty()) {
+            wcout << L" (" << entry.Detail << L")";
+        }
+        wcout << endl;
+    }
+    return entries.size();
+}
+
 int wmain(int argc, wchar_t* argv[])
 {
+    bool printStats = false;
     try
     {
         CCommandLine cmdLine(argc, argv);
@@ -36,10 +82,75 @@ int wmain(int argc, wchar_t* argv[])
             return 0;
         }
 
+        //count every registry call that the command makes
+        printStats = cmdLine.GetStats();
+        CInstrumentedBackend countedRegistry(GetDefaultRegBackend());
+        optional<CDefaultRegBackendScope> countedScope;
+        if (printStats) {
+            countedScope.emplace(&countedRegistry);
+        }
+
         switch (cmdLine.GetCommand())
         {
         case ECommand::QUERY:
-            if (cmdLine.GetPath().empty()) {
+            if (!cmdLine.GetIndexPath().empty()) {
+                CComIndex index(cmdLine.GetIndexPath());
+                if (!index.Exists()) {
+                    throw AppException(L"There is no COM index " + cmdLine.GetIndexPath() + L". Create it with /index.");
+                }
+
+                size_t found = 0;
+                if (!cmdLine.GetFilePath().empty()) {
+                    wstring file = cmdLine.GetFilePath();
+                    wcout << L"Querying the COM index for " << file << endl;
+                    found += PrintIndexEntries(index, EComIndexKind::FILE_GUID, file, L"Registered with:");
+                }
+                else if (!cmdLine.GetProgId().empty()) {
+                    wstring progId = cmdLine.GetProgId();
+                    wcout << L"Querying the COM index for " << progId << endl;
+                    found += PrintIndexEntries(index, EComIndexKind::PROGID_CLASS, progId, L"CLSID:");
+                }
+                else {
+                    wstring guidStr = WStringFromGUID(cmdLine.GetGuid());
+                    wcout << L"Querying the COM index for " << guidStr << endl;
+                    found += PrintIndexEntries(index, EComIndexKind::TYPELIB_FILE, guidStr, L"Type library files:");
+                    found += PrintIndexEntries(index, EComIndexKind::INTERFACE_TYPELIB, guidStr, L"Type library of the interface:");
+                    found += PrintIndexEntries(index, EComIndexKind::CLASS_TYPELIB, guidStr, L"Type library of the class:");
+                    found += PrintIndexEntries(index, EComIndexKind::CLASS_PROGID, guidStr, L"ProgIDs of the class:");
+                }
+                if (found == 0) {
+                    wcout << L"The COM index has no entries for it." << endl;
+                }
+            }
+            else if (cmdLine.GetPath().empty() && !cmdLine.GetHivePath().empty()) {
+                GUID guid = cmdLine.GetGuid();
+                std::wstring guidStr = WStringFromGUID(guid);
+                wcout << L"Querying for type library " << guidStr <<
+                    L" in hive file " << cmdLine.GetHivePath() << endl;
+
+                //The TypeLib key lives at a different depth depending on which hive
+                //was exported: SOFTWARE, NTUSER.DAT or UsrClass.dat
+                CRegfBackend hive(cmdLine.GetHivePath());
+                CInstrumentedBackend countedHive(&hive);
+                CKeyCache cache(16, printStats ? (IRegBackend*)&countedHive : &hive);
+                const wchar_t* locations[] = {
+                    L"Classes\\TypeLib\\",
+                    L"Software\\Classes\\TypeLib\\",
+                    L"TypeLib\\" };
+
+                bool found = false;
+                for (const wchar_t* location : locations) {
+                    std::wstring regPath = location + guidStr;
+                    if (cache.Exists(HKEY_LOCAL_MACHINE, regPath)) {
+                        PrintRegKeyContents(*cache.Open(HKEY_LOCAL_MACHINE, regPath));
+                        found = true;
+                    }
+                }
+                if (!found) {
+                    std::wcout << L"GUID " << guidStr << L" does not exist in the hive file." << std::endl;
+                }
+            }
+            else if (cmdLine.GetPath().empty()) {
                 GUID guid = cmdLine.GetGuid();
                 wcout << L"Querying for type library " <<
                     WStringFromGUID(guid) <<
@@ -49,18 +160,18 @@ int wmain(int argc, wchar_t* argv[])
                 std::wstring regPath = L"Software\\Classes\\TypeLib\\";
                 regPath += guidStr;
 
-                if (CTypeLibrary::Exists(guid, true)) {
+                //the key that Exists opens is reused for printing
+                CKeyCache cache;
+                if (CTypeLibrary::Exists(guid, true, cache)) {
                     std::wcout << L"GUID " << guidStr << L" exists in the user hive." << std::endl;
-                    CHKey key = CHKey::Open(HKEY_CURRENT_USER, regPath);
-                    PrintRegKeyContents(key);
+                    PrintRegKeyContents(*cache.Open(HKEY_CURRENT_USER, regPath));
                 }
                 else {
                     std::wcout << L"GUID " << guidStr << L" does not exist in the user hive." << std::endl;
                 }
-                if (CTypeLibrary::Exists(guid, false)) {
+                if (CTypeLibrary::Exists(guid, false, cache)) {
                     std::wcout << L"GUID" << guidStr << L" exists in the machine hive." << std::endl;
-                    CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, regPath);
-                    PrintRegKeyContents(key);
+                    PrintRegKeyContents(*cache.Open(HKEY_LOCAL_MACHINE, regPath));
                 }
                 else {
                     std::wcout << L"GUID " << guidStr << L" does not exist in the machine hive." << std::endl;
@@ -71,14 +182,176 @@ int wmain(int argc, wchar_t* argv[])
                 wstring path = cmdLine.GetPath();
                 wcout << L"Querying type library " << path <<
                     L" for embedded information." << endl;
-                CTypeLibrary tlb(path);
+                CTlbMetadata tlb = ReadLibrary(path, cmdLine.GetCachePath());
+                wcout << L"Library: " << tlb.Name << L" " << WStringFromGUID(tlb.Guid) <<
+                    L" version " << tlb.MajorVersion << L"." << tlb.MinorVersion << endl;
+                if (!tlb.DocString.empty()) {
+                    wcout << L"Description: " << tlb.DocString << endl;
+                }
                 tlb.PrintTlbInfo();
             }
             break;
+        case ECommand::SNAPSHOT: {
+            //everything that type library registration touches, for both hives
+            CRegSnapshotWriter writer(cmdLine.GetSnapshotPath());
+            HKEY roots[] = { HKEY_LOCAL_MACHINE, HKEY_CURRENT_USER };
+            const wchar_t* trees[] = {
+                L"Software\\Classes\\TypeLib",
+                L"Software\\Classes\\CLSID",
+                L"Software\\Classes\\Interface" };
+            for (HKEY root : roots) {
+                for (const wchar_t* tree : trees) {
+                    if (CHKey::Exists(root, tree)) {
+                        CHKey key = CHKey::Open(root, tree);
+                        writer.Add(key);
+                    }
+                }
+            }
+            writer.Save();
+            wcout << L"Saved " << writer.KeyCount() << L" keys to " <<
+                cmdLine.GetSnapshotPath() << endl;
+            break;
+        }
+        case ECommand::DIFF: {
+            CRegSnapshotFile before(cmdLine.GetSnapshotPath());
+            CRegSnapshotFile after(cmdLine.GetDiffPath());
+            size_t differences = PrintSnapshotDiff(before, after);
+            wcout << differences << L" differences" << endl;
+            break;
+        }
+        case ECommand::INDEX: {
+            //the old index has to be let go of before it can be overwritten
+            CComIndexBuilder builder;
+            {
+                CComIndex previous(cmdLine.GetIndexPath());
+                if (cmdLine.GetFullScan()) {
+                    builder.Scan();
+                }
+                else {
+                    builder.Refresh(previous);
+                }
+            }
+            builder.Save(cmdLine.GetIndexPath());
+            wcout << L"Saved " << builder.Count() << L" entries to " << cmdLine.GetIndexPath() << L". Read " <<
+                builder.ScannedGroups() << L" keys, " << builder.ReusedGroups() << L" did not change." << endl;
+            break;
+        }
+        case ECommand::ORPHANS: {
+            CTlbOrphanScanner scanner;
+            scanner.Scan();
+            std::vector<size_t> orphans = scanner.Orphans();
+            for (size_t i : orphans) {
+                const CTlbRegistration& registration = scanner.Registrations()[i];
+                wcout << (registration.PerUser ? L"user    " : L"machine ") << registration.LibId << L" " <<
+                    registration.Version << L"\\" << registration.Locale << L"\\" << registration.Platform <<
+                    L" " << registration.Path << endl;
+            }
+            wcout << scanner.Registrations().size() << L" registrations of " << scanner.FileCount() <<
+                L" files, " << orphans.size() << L" of them are orphaned." << endl;
+            if (cmdLine.GetFix() && !orphans.empty()) {
+                size_t deleted = scanner.Fix();
+                wcout << L"Deleted " << deleted << L" keys." << endl;
+            }
+            break;
+        }
+        case ECommand::CHECK: {
+            std::vector<std::wstring> paths;
+            if (!cmdLine.GetPath().empty()) {
+                paths.push_back(cmdLine.GetPath());
+            }
+            else {
+                //every registered library whose file exists, each file once
+                CTlbOrphanScanner scanner;
+                scanner.Scan();
+                std::set<std::wstring> files;
+                for (size_t i = 0; i < scanner.Registrations().size(); i++) {
+                    std::wstring file = CTlbOrphanScanner::FileOf(scanner.Registrations()[i].Path);
+                    if (scanner.States()[i] == ETlbFileState::PRESENT && files.insert(ToWUpperName(file)).second) {
+                        paths.push_back(file);
+                    }
+                }
+            }
+
+            std::unique_ptr<CTlbCache> cache;
+            if (!cmdLine.GetCachePath().empty()) {
+                cache = std::make_unique<CTlbCache>(cmdLine.GetCachePath());
+            }
+            CTlbChecker checker;
+            for (const std::wstring& path : paths) {
+                try {
+                    checker.Add(cache ? cache->Get(path) : CTypeLibrary(path).Metadata());
+                }
+                catch (const AppException&) {
+                    wcout << L"Skipped " << path << L", it cannot be read as a type library." << endl;
+                }
+            }
+            if (cache && cache->Modified() && !cache->Save()) {
+                wcout << L"The cache file " << cmdLine.GetCachePath() << L" is in use and was not updated." << endl;
+            }
+
+            checker.Check();
+            size_t counts[3] = {};
+            const wchar_t* names[3] = { L"missing    ", L"stale      ", L"conflicting" };
+            for (const CTlbCheckIssue& issue : checker.Issues()) {
+                counts[(int)issue.Issue]++;
+                wcout << names[(int)issue.Issue] << L" ";
+                if (issue.Issue != ETlbCheckIssue::MISSING) {
+                    wcout << (issue.PerUser ? L"user    " : L"machine ");
+                }
+                wcout << issue.Key;
+                if (!issue.Found.empty()) {
+                    wcout << L" is " << issue.Found;
+                }
+                if (!issue.Expected.empty()) {
+                    wcout << L", expected " << issue.Expected;
+                }
+                wcout << endl;
+            }
+            wcout << L"Checked " << checker.LibraryCount() << L" libraries with " << checker.GuidCount() <<
+                L" interfaces and classes: " << counts[0] << L" missing, " << counts[1] << L" stale and " <<
+                counts[2] << L" conflicting keys." << endl;
+            break;
+        }
+        case ECommand::CACHE_VERIFY: {
+            CTlbCache cache(cmdLine.GetCachePath());
+            std::vector<std::wstring> stale;
+            CTlbCache::CVerifyResult result = cache.Verify(&stale);
+            for (const std::wstring& path : stale) {
+                wcout << L"Not current: " << path << endl;
+            }
+            wcout << result.Current << L" libraries are current, " << result.Changed <<
+                L" changed and " << result.Missing << L" are missing." << endl;
+            break;
+        }
+        case ECommand::CACHE_REBUILD: {
+            CTlbCache cache(cmdLine.GetCachePath());
+            size_t before = cache.Count();
+            size_t read = cache.Rebuild();
+            if (!cache.Save()) {
+                throw ExWin32Error(ERROR_SHARING_VIOLATION, L"Cannot replace " + cmdLine.GetCachePath());
+            }
+            wcout << L"Read " << read << L" libraries, dropped " << before - read << L"." << endl;
+            break;
+        }
         case ECommand::INSTALL:
         case ECommand::INSTALL_PER_USER: {
-            CTypeLibrary typelib(cmdLine.GetPath());
-            typelib.Register(cmdLine.GetCommand() == ECommand::INSTALL_PER_USER);
+            bool perUser = cmdLine.GetCommand() == ECommand::INSTALL_PER_USER;
+            if (cmdLine.GetWhatIf()) {
+                CTlbRegPlan plan(perUser);
+                plan.Add(ReadLibrary(cmdLine.GetPath(), cmdLine.GetCachePath()));
+                plan.Print();
+            }
+            else if (cmdLine.GetNative()) {
+                CTlbRegPlan plan(perUser);
+                plan.Add(ReadLibrary(cmdLine.GetPath(), cmdLine.GetCachePath()));
+                plan.Apply();
+                wcout << L"Made " << plan.Changes().size() << L" changes, " <<
+                    plan.UnchangedCount() << L" values were already registered." << endl;
+            }
+            else {
+                CTypeLibrary typelib(cmdLine.GetPath());
+                typelib.Register(perUser);
+            }
             break;
         }
         case ECommand::UNINSTALL:
@@ -104,4 +377,14 @@ int wmain(int argc, wchar_t* argv[])
 
         cout << ex.what() << endl;
     }
+
+    if (printStats) {
+        if (CStats::Enabled) {
+            wcout << endl;
+            PrintStats(CStats::Collect());
+        }
+        else {
+            wcout << L"This build of RegTlb does not collect statistics." << endl;
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,597 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "ComIndex.h"
+#include "HKey.h"
+#include "TreeWalker.h"
+#include "Task.h"
+#include "RecordStream.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <tuple>
+
+namespace w32
+{
+    /////////////////////////////////////////////////////////////
+    //File layout, see CRecordWriter for how fields are stored
+    //  header:  "RGCI", version (4 bytes), number of entries (8 bytes), number of groups
+    //           (8 bytes), offset of the first group (8 bytes)
+    //  index:   offset of every entry in the file (8 bytes each), in the order of the entries
+    //  entry:   kind (2), per user (2), group (4), sort key, key, value, detail
+    //  group:   per user (2), tree (2), stamp (8), name
+    //Entries are sorted by kind and sort key, groups are only read by a refresh.
+    /////////////////////////////////////////////////////////////
+
+    static const char IndexMagic[4] = { 'R', 'G', 'C', 'I' };
+    static const uint32_t IndexVersion = 1;
+    static const size_t HeaderSize = 32;
+    static const char* IndexDamaged = "The COM index is damaged; build it again";
+
+    static const wchar_t* const ClassesPath = L"Software\\Classes\\";
+
+    //The trees that are walked, CComIndexBuilder::CGroup::Tree is an index in this list
+    static const wchar_t* const Trees[] = { L"TypeLib", L"Interface", L"CLSID" };
+    static const WORD TypeLibTree = 0;
+    static const WORD InterfaceTree = 1;
+    static const WORD ClsidTree = 2;
+
+    //Number of ProgIDs that one task of the pool reads
+    static const size_t ProgIdBatch = 256;
+
+    static uint64_t FileTimeValue(const FILETIME& time)
+    {
+        return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+    }
+
+    static HKEY RootOf(bool perUser)
+    {
+        return perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
+    }
+
+    //The default value of a key, if it is a string
+    static bool DefaultValue(const CKeySnapshot& values, std::wstring_view& value)
+    {
+        size_t index = values.Find(L"");
+        if (index == CKeySnapshot::npos)
+            return false;
+        DWORD type = values.Type(index);
+        if (type != REG_SZ && type != REG_EXPAND_SZ)
+            return false;
+        value = values.WSValue(index);
+        return !value.empty();
+    }
+
+    static void ReadEntry(CRecordReader& reader, CComIndexBuilder::CEntry& entry)
+    {
+        uint64_t kind = reader.Number(2);
+        if (kind < (WORD)EComIndexKind::TYPELIB_FILE || kind > (WORD)EComIndexKind::PROGID_CLASS)
+            throw AppException(std::string(IndexDamaged));
+        entry.Entry.Kind = (EComIndexKind)kind;
+        entry.Entry.PerUser = reader.Number(2) != 0;
+        entry.Group = (uint32_t)reader.Number(4);
+        entry.SortKey = reader.String();
+        entry.Entry.Key = reader.String();
+        entry.Entry.Value = reader.String();
+        entry.Entry.Detail = reader.String();
+    }
+
+    static void WriteEntry(CRecordWriter& writer, const CComIndexBuilder::CEntry& entry)
+    {
+        writer.Number((WORD)entry.Entry.Kind, 2);
+        writer.Number(entry.Entry.PerUser ? 1 : 0, 2);
+        writer.Number(entry.Group, 4);
+        writer.String(entry.SortKey);
+        writer.String(entry.Entry.Key);
+        writer.String(entry.Entry.Value);
+        writer.String(entry.Entry.Detail);
+    }
+
+    static CComIndexBuilder::CEntry MakeEntry(EComIndexKind kind, bool perUser, uint32_t group,
+        std::wstring_view key, std::wstring_view value, std::wstring_view detail)
+    {
+        CComIndexBuilder::CEntry entry;
+        entry.Entry.Kind = kind;
+        entry.Entry.PerUser = perUser;
+        entry.Entry.Key = key;
+        entry.Entry.Value = value;
+        entry.Entry.Detail = detail;
+        entry.SortKey = kind == EComIndexKind::FILE_GUID ?
+            CComIndex::NormalizeFile(key) : CComIndex::NormalizeName(key);
+        entry.Group = group;
+        return entry;
+    }
+
+    /////////////////////////////////////////////////////////////
+    //CComIndex
+    /////////////////////////////////////////////////////////////
+
+    CComIndex::CComIndex(const std::wstring& fileName)
+    {
+        std::error_code error;
+        if (!std::filesystem::exists(std::filesystem::path(fileName), error))
+            return;
+
+        auto file = std::make_unique<CMappedFile>(fileName);
+        const BYTE* data = file->Data();
+        size_t size = file->Size();
+        if (size < HeaderSize || memcmp(data, IndexMagic, 4) != 0)
+            return;
+        CRecordReader header(data + 4, data + HeaderSize, IndexDamaged);
+        if (header.Number(4) != IndexVersion)
+            return;
+        uint64_t count = header.Number(8);
+        uint64_t groupCount = header.Number(8);
+        uint64_t groupsOffset = header.Number(8);
+        if (groupsOffset > size || count > (groupsOffset - HeaderSize) / sizeof(uint64_t))
+            return;
+
+        //offsets have to be in order and before the groups, then every entry has an end
+        CRecordReader index(data + HeaderSize, data + size, IndexDamaged);
+        uint64_t previous = HeaderSize + count * sizeof(uint64_t);
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t offset = index.Number(8);
+            if (offset < previous || offset >= groupsOffset)
+                return;
+            previous = offset;
+        }
+        m_file = std::move(file);
+        m_count = (size_t)count;
+        m_groupCount = (size_t)groupCount;
+        m_groupsOffset = groupsOffset;
+    }
+
+    const BYTE* CComIndex::Record(size_t index, const BYTE** end) const
+    {
+        const BYTE* data = m_file->Data();
+        CRecordReader offsets(data + HeaderSize + index * sizeof(uint64_t), data + m_file->Size(), IndexDamaged);
+        uint64_t offset = offsets.Number(8);
+        *end = data + (index + 1 < m_count ? offsets.Number(8) : m_groupsOffset);
+        return data + offset;
+    }
+
+    int CComIndex::CompareRecord(size_t index, EComIndexKind kind, const std::wstring& key) const
+    {
+        const BYTE* end;
+        const BYTE* record = Record(index, &end);
+        CRecordReader reader(record, end, IndexDamaged);
+        WORD recordKind = (WORD)reader.Number(2);
+        if (recordKind != (WORD)kind)
+            return recordKind < (WORD)kind ? -1 : 1;
+        reader.Number(2);
+        reader.Number(4);
+        return reader.String().compare(key);
+    }
+
+    bool CComIndex::Exists() const
+    {
+        return m_file != NULL;
+    }
+
+    size_t CComIndex::Count() const
+    {
+        return m_count;
+    }
+
+    std::vector<CComIndexEntry> CComIndex::Find(EComIndexKind kind, std::wstring_view key) const
+    {
+        std::vector<CComIndexEntry> found;
+        if (!m_file)
+            return found;
+        std::wstring sortKey = kind == EComIndexKind::FILE_GUID ? NormalizeFile(key) : NormalizeName(key);
+
+        //first entry that is not before the key
+        size_t low = 0;
+        size_t high = m_count;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            if (CompareRecord(middle, kind, sortKey) < 0)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        for (size_t i = low; i < m_count && CompareRecord(i, kind, sortKey) == 0; i++) {
+            const BYTE* end;
+            const BYTE* record = Record(i, &end);
+            CRecordReader reader(record, end, IndexDamaged);
+            CComIndexBuilder::CEntry entry;
+            ReadEntry(reader, entry);
+            found.push_back(std::move(entry.Entry));
+        }
+        return found;
+    }
+
+    std::vector<CComIndexEntry> CComIndex::Entries() const
+    {
+        std::vector<CComIndexEntry> entries;
+        entries.reserve(m_count);
+        CComIndexBuilder::CEntry previous;
+        for (size_t i = 0; i < m_count; i++) {
+            const BYTE* end;
+            const BYTE* record = Record(i, &end);
+            CRecordReader reader(record, end, IndexDamaged);
+            CComIndexBuilder::CEntry entry;
+            ReadEntry(reader, entry);
+            //Find relies on the order, and this is the one place that sees all of it
+            if (i > 0 && std::tie(entry.Entry.Kind, entry.SortKey) < std::tie(previous.Entry.Kind, previous.SortKey))
+                throw AppException(std::string(IndexDamaged));
+            entries.push_back(entry.Entry);
+            previous = std::move(entry);
+        }
+        return entries;
+    }
+
+    std::wstring CComIndex::NormalizeName(std::wstring_view name)
+    {
+        size_t first = name.find_first_not_of(L' ');
+        size_t last = name.find_last_not_of(L' ');
+        if (first == std::wstring_view::npos)
+            return std::wstring();
+        return ToWUpperName(name.substr(first, last - first + 1));
+    }
+
+    std::wstring CComIndex::NormalizeFile(std::wstring_view path)
+    {
+        std::wstring file = NormalizeName(path);
+
+        //an unquoted command line ends after the executable
+        if (file.empty() || file[0] != L'"') {
+            size_t exe = file.find(L".EXE ");
+            if (exe != std::wstring::npos)
+                file.resize(exe + 4);
+        }
+
+        //the same file as the orphan scanner checks, also for module\number
+        std::replace(file.begin(), file.end(), L'/', L'\\');
+        file = ToWUpperName(RegisteredFile(file));
+        return std::filesystem::path(file).lexically_normal().wstring();
+    }
+
+    /////////////////////////////////////////////////////////////
+    //CComIndexBuilder
+    /////////////////////////////////////////////////////////////
+
+    //Turns the keys of a walk over one of the trees into entries.
+    //A walk either starts at the tree, and every key directly below it starts a group, or
+    //at a key directly below it that is read again for a group that exists already.
+    class CComCollector : public IKeyVisitor
+    {
+        std::vector<CComIndexBuilder::CGroup>& m_groups;
+        std::vector<CComIndexBuilder::CEntry>* m_entries;   //NULL to only collect the groups
+        bool m_perUser;
+        WORD m_tree;
+        size_t m_offset;                    //depth of the start of the walk below the tree
+        uint32_t m_group = CComIndexBuilder::NoGroup;
+        std::vector<std::wstring> m_names;  //names of the keys below the tree
+
+        void Add(EComIndexKind kind, std::wstring_view key, std::wstring_view value, std::wstring_view detail)
+        {
+            m_entries->push_back(MakeEntry(kind, m_perUser, m_group, key, value, detail));
+        }
+
+        void Collect(const CKeySnapshot& values)
+        {
+            size_t depth = m_names.size();
+            const std::wstring& name = m_names.back();
+            std::wstring_view value;
+            if (!DefaultValue(values, value))
+                return;
+
+            if (m_tree == TypeLibTree) {
+                //TypeLib\{libid}\version\lcid\platform
+                if (depth == 4 && (CompareNoCase(name, L"win16") == 0 ||
+                    CompareNoCase(name, L"win32") == 0 || CompareNoCase(name, L"win64") == 0)) {
+                    Add(EComIndexKind::TYPELIB_FILE, m_names[0], value,
+                        m_names[1] + L"\\" + m_names[2] + L"\\" + name);
+                    Add(EComIndexKind::FILE_GUID, value, m_names[0], name);
+                }
+            }
+            else if (m_tree == InterfaceTree) {
+                if (depth == 2 && CompareNoCase(name, L"TypeLib") == 0) {
+                    size_t version = values.Find(L"Version");
+                    std::wstring_view versionValue;
+                    if (version != CKeySnapshot::npos && values.Type(version) == REG_SZ)
+                        versionValue = values.WSValue(version);
+                    Add(EComIndexKind::INTERFACE_TYPELIB, m_names[0], value, versionValue);
+                }
+            }
+            else if (depth == 2) {
+                if (CompareNoCase(name, L"TypeLib") == 0)
+                    Add(EComIndexKind::CLASS_TYPELIB, m_names[0], value, L"");
+                else if (CompareNoCase(name, L"ProgID") == 0 || CompareNoCase(name, L"VersionIndependentProgID") == 0)
+                    Add(EComIndexKind::CLASS_PROGID, m_names[0], value, name);
+                else if (CompareNoCase(name, L"InprocServer32") == 0 || CompareNoCase(name, L"LocalServer32") == 0 ||
+                    CompareNoCase(name, L"InprocHandler32") == 0)
+                    Add(EComIndexKind::FILE_GUID, value, m_names[0], name);
+            }
+        }
+
+    public:
+        CComCollector(std::vector<CComIndexBuilder::CGroup>& groups, std::vector<CComIndexBuilder::CEntry>* entries,
+            bool perUser, WORD tree) :
+            m_groups(groups), m_entries(entries), m_perUser(perUser), m_tree(tree), m_offset(0)
+        {
+        }
+
+        //Collect the entries of a group again, starting at its key
+        CComCollector(std::vector<CComIndexBuilder::CGroup>& groups, std::vector<CComIndexBuilder::CEntry>* entries,
+            uint32_t group) :
+            m_groups(groups), m_entries(entries), m_perUser(groups[group].PerUser), m_tree(groups[group].Tree),
+            m_offset(1), m_group(group)
+        {
+        }
+
+        void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+        {
+            depth += m_offset;
+            if (depth == 0)
+                return;
+            m_names.resize(depth - 1);
+            m_names.push_back(key.Name());
+
+            if (depth == 1) {
+                if (m_offset == 0) {
+                    m_group = (uint32_t)m_groups.size();
+                    m_groups.push_back({ m_perUser, m_tree, m_names[0], 0 });
+                }
+                else {
+                    m_groups[m_group].Stamp = 0;
+                }
+            }
+            CComIndexBuilder::CGroup& group = m_groups[m_group];
+            group.Stamp = std::max(group.Stamp, FileTimeValue(values.LastWriteTime()));
+            if (m_entries)
+                Collect(values);
+        }
+    };
+
+    //Read the CLSID of a range of ProgIDs, on a thread of the pool
+    static CTask<std::vector<CComIndexBuilder::CEntry>> ReadProgIds(bool perUser,
+        const std::vector<std::wstring>& names, size_t begin, size_t end, IRegBackend* backend, CThreadPool* pool)
+    {
+        co_await ResumeOn(pool);
+        std::vector<CComIndexBuilder::CEntry> entries;
+        CHKey classes = CHKey::Open(RootOf(perUser), ClassesPath, GENERIC_READ, INVALID_HANDLE_VALUE, backend);
+        CKeySnapshot values;
+        for (size_t i = begin; i < end; i++) {
+            std::wstring subKey = names[i] + L"\\CLSID";
+            if (!classes.SubKeyExists(subKey))
+                continue;
+            CHKey key = classes.OpenSubKey(subKey);
+            key.Snapshot(values);
+            std::wstring_view clsid;
+            if (DefaultValue(values, clsid))
+                entries.push_back(MakeEntry(EComIndexKind::PROGID_CLASS, perUser, CComIndexBuilder::NoGroup,
+                    names[i], clsid, L""));
+        }
+        co_return entries;
+    }
+
+    CComIndexBuilder::CComIndexBuilder(IRegBackend* backend, CThreadPool& pool) :
+        m_backend(backend ? backend : GetDefaultRegBackend()),
+        m_pool(pool)
+    {
+    }
+
+    void CComIndexBuilder::ScanTree(bool perUser, WORD tree, const std::wstring& subKey)
+    {
+        if (!CHKey::Exists(RootOf(perUser), subKey, INVALID_HANDLE_VALUE, m_backend))
+            return;
+        CHKey key = CHKey::Open(RootOf(perUser), subKey, GENERIC_READ, INVALID_HANDLE_VALUE, m_backend);
+        size_t groups = m_groups.size();
+        CComCollector collector(m_groups, &m_entries, perUser, tree);
+        CTreeWalker walker(m_pool);
+        walker.Walk(key, collector);
+        m_scannedGroups += m_groups.size() - groups;
+    }
+
+    void CComIndexBuilder::ScanProgIds(bool perUser)
+    {
+        std::wstring classesPath(ClassesPath);
+        classesPath.pop_back();
+        if (!CHKey::Exists(RootOf(perUser), classesPath, INVALID_HANDLE_VALUE, m_backend))
+            return;
+
+        //ProgIDs are mixed with file extensions, GUIDs and the trees directly under Classes.
+        //Only the names that can be a ProgID are tried.
+        std::vector<std::wstring> names;
+        {
+            CHKey classes = CHKey::Open(RootOf(perUser), classesPath, GENERIC_READ, INVALID_HANDLE_VALUE, m_backend);
+            for (std::wstring_view name : classes.SubKeys()) {
+                if (!name.empty() && name[0] != L'.' && name[0] != L'{' && name[0] != L'*')
+                    names.push_back(std::wstring(name));
+            }
+        }
+
+        std::vector<CTask<std::vector<CEntry>>> tasks;
+        for (size_t begin = 0; begin < names.size(); begin += ProgIdBatch)
+            tasks.push_back(ReadProgIds(perUser, names, begin, std::min(begin + ProgIdBatch, names.size()),
+                m_backend, &m_pool));
+        for (std::vector<CEntry>& entries : SyncWait(WhenAll(std::move(tasks)))) {
+            for (CEntry& entry : entries)
+                m_entries.push_back(std::move(entry));
+        }
+    }
+
+    void CComIndexBuilder::Scan()
+    {
+        m_groups.clear();
+        m_entries.clear();
+        m_scannedGroups = 0;
+        m_reusedGroups = 0;
+        for (bool perUser : { false, true }) {
+            for (WORD tree = 0; tree < std::size(Trees); tree++)
+                ScanTree(perUser, tree, ClassesPath + std::wstring(Trees[tree]));
+            ScanProgIds(perUser);
+        }
+    }
+
+    void CComIndexBuilder::Refresh(const CComIndex& previous)
+    {
+        if (!previous.Exists()) {
+            Scan();
+            return;
+        }
+        m_groups.clear();
+        m_entries.clear();
+        m_scannedGroups = 0;
+        m_reusedGroups = 0;
+
+        //the groups of the old index, by where they are in the registry
+        typedef std::tuple<bool, WORD, std::wstring> CGroupKey;
+        std::map<CGroupKey, uint32_t> oldGroups;
+        std::vector<uint64_t> oldStamps;
+        const BYTE* data = previous.m_file->Data();
+        CRecordReader groupReader(data + previous.m_groupsOffset, data + previous.m_file->Size(), IndexDamaged);
+        for (size_t i = 0; i < previous.m_groupCount; i++) {
+            bool perUser = groupReader.Number(2) != 0;
+            WORD tree = (WORD)groupReader.Number(2);
+            oldStamps.push_back(groupReader.Number(8));
+            oldGroups[CGroupKey(perUser, tree, ToWUpperName(groupReader.String()))] = (uint32_t)i;
+        }
+
+        //the groups as they are now, only with their stamps
+        std::vector<uint32_t> renumber(previous.m_groupCount, NoGroup);
+        std::vector<uint32_t> changed;
+        for (bool perUser : { false, true }) {
+            for (WORD tree = 0; tree < std::size(Trees); tree++) {
+                std::wstring subKey = ClassesPath + std::wstring(Trees[tree]);
+                if (!CHKey::Exists(RootOf(perUser), subKey, INVALID_HANDLE_VALUE, m_backend))
+                    continue;
+                CHKey key = CHKey::Open(RootOf(perUser), subKey, GENERIC_READ, INVALID_HANDLE_VALUE, m_backend);
+                size_t first = m_groups.size();
+                CComCollector collector(m_groups, NULL, perUser, tree);
+                CTreeWalker walker(m_pool, false, true);
+                walker.Walk(key, collector);
+
+                for (size_t i = first; i < m_groups.size(); i++) {
+                    auto old = oldGroups.find(CGroupKey(perUser, tree, ToWUpperName(m_groups[i].Name)));
+                    if (old != oldGroups.end() && oldStamps[old->second] == m_groups[i].Stamp)
+                        renumber[old->second] = (uint32_t)i;
+                    else
+                        changed.push_back((uint32_t)i);
+                }
+            }
+        }
+
+        //keep the entries of the groups that did not change
+        for (size_t i = 0; i < previous.m_count; i++) {
+            const BYTE* end;
+            const BYTE* record = previous.Record(i, &end);
+            CRecordReader reader(record, end, IndexDamaged);
+            CEntry entry;
+            ReadEntry(reader, entry);
+            if (entry.Group < renumber.size() && renumber[entry.Group] != NoGroup) {
+                entry.Group = renumber[entry.Group];
+                m_entries.push_back(std::move(entry));
+            }
+        }
+        m_reusedGroups = m_groups.size() - changed.size();
+
+        //and read the others again
+        for (uint32_t group : changed) {
+            std::wstring subKey = ClassesPath + std::wstring(Trees[m_groups[group].Tree]) + L"\\" + m_groups[group].Name;
+            HKEY root = RootOf(m_groups[group].PerUser);
+            if (!CHKey::Exists(root, subKey, INVALID_HANDLE_VALUE, m_backend))
+                continue;
+            CHKey key = CHKey::Open(root, subKey, GENERIC_READ, INVALID_HANDLE_VALUE, m_backend);
+            CComCollector collector(m_groups, &m_entries, group);
+            CTreeWalker walker(m_pool);
+            walker.Walk(key, collector);
+            m_scannedGroups++;
+        }
+
+        for (bool perUser : { false, true })
+            ScanProgIds(perUser);
+    }
+
+    size_t CComIndexBuilder::ScannedGroups() const
+    {
+        return m_scannedGroups;
+    }
+
+    size_t CComIndexBuilder::ReusedGroups() const
+    {
+        return m_reusedGroups;
+    }
+
+    size_t CComIndexBuilder::Count() const
+    {
+        return m_entries.size();
+    }
+
+    void CComIndexBuilder::Save(const std::wstring& fileName)
+    {
+        auto order = [](const CEntry& l, const CEntry& r) {
+            return std::tie(l.Entry.Kind, l.SortKey, l.Entry.PerUser, l.Entry.Value, l.Entry.Detail) <
+                std::tie(r.Entry.Kind, r.SortKey, r.Entry.PerUser, r.Entry.Value, r.Entry.Detail);
+        };
+        std::sort(m_entries.begin(), m_entries.end(), order);
+        m_entries.erase(std::unique(m_entries.begin(), m_entries.end(), [&](const CEntry& l, const CEntry& r) {
+            return !order(l, r) && !order(r, l);
+        }), m_entries.end());
+
+        std::vector<BYTE> entries;
+        std::vector<uint64_t> offsets;
+        CRecordWriter entryWriter(entries);
+        for (const CEntry& entry : m_entries) {
+            offsets.push_back(entries.size());
+            WriteEntry(entryWriter, entry);
+        }
+
+        std::vector<BYTE> buffer;
+        CRecordWriter writer(buffer);
+        uint64_t start = HeaderSize + offsets.size() * sizeof(uint64_t);
+        buffer.insert(buffer.end(), IndexMagic, IndexMagic + 4);
+        writer.Number(IndexVersion, 4);
+        writer.Number(offsets.size(), 8);
+        writer.Number(m_groups.size(), 8);
+        writer.Number(start + entries.size(), 8);
+        for (uint64_t offset : offsets)
+            writer.Number(start + offset, 8);
+        buffer.insert(buffer.end(), entries.begin(), entries.end());
+        for (const CGroup& group : m_groups) {
+            writer.Number(group.PerUser ? 1 : 0, 2);
+            writer.Number(group.Tree, 2);
+            writer.Number(group.Stamp, 8);
+            writer.String(group.Name);
+        }
+
+        //the old index stays as it is until the new one is complete
+        std::wstring tempName = fileName + L".new";
+        {
+            std::ofstream file(std::filesystem::path(tempName), std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw ExWin32Error(ERROR_OPEN_FAILED, L"Cannot create COM index " + tempName);
+            file.write((const char*)buffer.data(), buffer.size());
+            file.flush();
+            if (!file)
+                throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot write COM index " + tempName);
+        }
+
+        std::error_code error;
+        std::filesystem::rename(std::filesystem::path(tempName), std::filesystem::path(fileName), error);
+        if (error) {
+            std::filesystem::remove(std::filesystem::path(tempName), error);
+            throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot replace COM index " + fileName);
+        }
+    }
+}
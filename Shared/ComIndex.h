@@ -0,0 +1,165 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "MappedFile.h"
+#include "RegBackend.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+	//The relations that the COM index answers questions about
+	enum class EComIndexKind : WORD
+	{
+		TYPELIB_FILE = 1,       //libid -> file of the library, for a version, locale and platform
+		FILE_GUID,              //file -> libid of a library or CLSID of a server in that file
+		INTERFACE_TYPELIB,      //IID -> libid of the library that describes the interface
+		CLASS_TYPELIB,          //CLSID -> libid of the library that describes the class
+		CLASS_PROGID,           //CLSID -> ProgID, from the ProgID and VersionIndependentProgID keys
+		PROGID_CLASS            //ProgID -> CLSID, from the CLSID key of the ProgID
+	};
+
+	/// <summary>
+	/// One relation in the COM index
+	/// </summary>
+	struct CComIndexEntry
+	{
+		EComIndexKind Kind;
+		bool PerUser;           //found under HKEY_CURRENT_USER rather than HKEY_LOCAL_MACHINE
+		std::wstring Key;
+		std::wstring Value;
+		std::wstring Detail;    //TYPELIB_FILE: version\lcid\platform, INTERFACE_TYPELIB: version,
+		                        //FILE_GUID: the key that names the file (win32, InprocServer32, ...)
+	};
+
+	/// <summary>
+	/// Index of the TypeLib, Interface, CLSID and ProgID registrations of the machine and
+	/// the current user, saved by CComIndexBuilder.
+	///
+	/// The file is memory mapped. Entries are sorted by kind and by their key, normalized
+	/// and uppercased, so a lookup is a binary search over an index of offsets and only
+	/// the matching entries are decoded.
+	/// A file that is missing, has another version or is not an index is treated as an
+	/// empty index.
+	/// </summary>
+	class CComIndex
+	{
+		std::unique_ptr<CMappedFile> m_file;    //NULL if there is no usable file
+		size_t m_count = 0;
+		size_t m_groupCount = 0;
+		uint64_t m_groupsOffset = 0;
+
+		const BYTE* Record(size_t index, const BYTE** end) const;
+		int CompareRecord(size_t index, EComIndexKind kind, const std::wstring& key) const;
+
+		friend class CComIndexBuilder;
+
+	public:
+		CComIndex(const std::wstring& fileName);
+
+		//Is there an index file
+		bool Exists() const;
+
+		//Number of entries
+		size_t Count() const;
+
+		//The entries of a kind with a given key. The key is normalized like the index does,
+		//so GUIDs, ProgIDs and paths can be passed as they are typed.
+		std::vector<CComIndexEntry> Find(EComIndexKind kind, std::wstring_view key) const;
+
+		//Every entry, in the order of the file
+		std::vector<CComIndexEntry> Entries() const;
+
+		//Lookup key of a GUID or ProgID: uppercased
+		static std::wstring NormalizeName(std::wstring_view name);
+
+		//Lookup key of a file: the RegisteredFile of the path, without the arguments of a
+		//LocalServer32 command line, normalized and uppercased
+		static std::wstring NormalizeFile(std::wstring_view path);
+	};
+
+	/// <summary>
+	/// Scans the registry into a COM index file.
+	///
+	/// The TypeLib, Interface and CLSID trees of both hives are walked with CTreeWalker,
+	/// and the ProgIDs directly under Classes are read in batches on the thread pool.
+	/// The entries are remembered per group: a key directly below one of the trees, such
+	/// as CLSID\{...}, with the last write time of the newest key in it.
+	///
+	/// Refresh starts from an existing index. It walks the trees without reading values,
+	/// only the last write times, keeps the entries of the groups whose time did not
+	/// change, and reads the values of the new and changed groups. Groups that are gone
+	/// are dropped. ProgIDs have no group and are always read again.
+	/// </summary>
+	class CComIndexBuilder
+	{
+	public:
+		struct CGroup
+		{
+			bool PerUser;
+			WORD Tree;              //index in the list of trees
+			std::wstring Name;
+			uint64_t Stamp;         //newest last write time in the group
+		};
+
+		struct CEntry
+		{
+			CComIndexEntry Entry;
+			std::wstring SortKey;
+			uint32_t Group;         //NoGroup for ProgIDs
+		};
+
+		static constexpr uint32_t NoGroup = 0xFFFFFFFF;
+
+	private:
+		IRegBackend* m_backend;
+		CThreadPool& m_pool;
+		std::vector<CGroup> m_groups;
+		std::vector<CEntry> m_entries;
+		size_t m_scannedGroups = 0;
+		size_t m_reusedGroups = 0;
+
+		void ScanTree(bool perUser, WORD tree, const std::wstring& subKey);
+		void ScanProgIds(bool perUser);
+
+	public:
+		CComIndexBuilder(IRegBackend* backend = NULL, CThreadPool& pool = CThreadPool::Default());
+
+		//Read everything
+		void Scan();
+
+		//Read what changed since the index was saved, and take the rest from it
+		void Refresh(const CComIndex& previous);
+
+		//Number of groups that were read from the registry, and taken from the old index
+		size_t ScannedGroups() const;
+		size_t ReusedGroups() const;
+
+		//Number of entries
+		size_t Count() const;
+
+		//Write the index to a file, replacing it if it exists. The index is written to
+		//<file>.new first and renamed, so a failure leaves the old index intact. The old
+		//file must not be mapped at that point.
+		void Save(const std::wstring& fileName);
+	};
+}
@@ -16,6 +16,9 @@
 
 #include "pch.h"
 #include "ConsoleHelper.h"
+#include "TreeWalker.h"
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 
 using namespace std;
@@ -23,42 +26,189 @@ using namespace std;
 namespace w32
 {
 
+	//Prints one line per value, in a form that fits its type
+	class CPrintValueVisitor : public IValueVisitor
+	{
+		const std::wstring& m_offset;
+
+		void PrintName(std::wstring_view name)
+		{
+			wcout << m_offset << L"  " << (name.empty() ? L"(Default)" : name) << L":  ";
+		}
+
+	public:
+		CPrintValueVisitor(const std::wstring& offset) : m_offset(offset) {}
+
+		void OnString(std::wstring_view name, std::wstring_view value, bool expand) override
+		{
+			PrintName(name);
+			wcout << value << endl;
+		}
+
+		void OnDWord(std::wstring_view name, DWORD value) override
+		{
+			PrintName(name);
+			wcout << value << endl;
+		}
+
+		void OnQWord(std::wstring_view name, ULONGLONG value) override
+		{
+			PrintName(name);
+			wcout << value << endl;
+		}
+
+		void OnMultiString(std::wstring_view name, const CMultiString& value) override
+		{
+			PrintName(name);
+			const wchar_t* separator = L"";
+			for (std::wstring_view str : value) {
+				wcout << separator << str;
+				separator = L" | ";
+			}
+			wcout << endl;
+		}
+
+		void OnBinary(std::wstring_view name, DWORD type, std::span<const BYTE> value) override
+		{
+			//long data is cut off, this is for reading, not for copying
+			static const wchar_t* digits = L"0123456789abcdef";
+			PrintName(name);
+			for (size_t i = 0; i < value.size() && i < 32; i++)
+				wcout << (i ? L" " : L"") << digits[value[i] >> 4] << digits[value[i] & 0xF];
+			if (value.size() > 32)
+				wcout << L" ... (" << value.size() << L" bytes)";
+			wcout << endl;
+		}
+	};
+
+	//Print the values in a snapshot of a key
+	static void PrintValues(const CKeySnapshot& values, const std::wstring& offset)
+	{
+		CPrintValueVisitor visitor(offset);
+		values.Visit(visitor);
+	}
+
 	//Print the values under a specific key
     void PrintRegKeyValues(CHKey& key, std::wstring offset)
     {
-		for (wstring valueName : key.GetValues())
+		PrintValues(key.Snapshot(), offset);
+    }
+
+	//Prints every key of a tree walk, indented according to its depth
+	class CPrintVisitor : public IKeyVisitor
+	{
+		std::wstring m_offset;
+
+	public:
+		CPrintVisitor(const std::wstring& offset) : m_offset(offset) {}
+
+		void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
 		{
+			wstring offset = m_offset + wstring(depth * 2, L' ');
+			if (offset == L"")
+				wcout << offset << key.Path() << endl;
+			else
+				wcout << offset << L"> " << key.RelPath() << endl;
 
-			wcout << offset << L"  " << ((valueName == L"") ? L"(Default)" : valueName) << L":  ";
-			switch (key.GetValueType(valueName))
-			{
-			case REG_DWORD:
-				wcout << key.GetDWValue(valueName);
-				break;
-			case REG_SZ:
-				wcout << key.GetWSValue(valueName);
-				break;
-			}
-			wcout << L"" << valueName << endl;
+			PrintValues(values, offset);
 		}
-    }
+	};
 
 	//Print the entire contents (values and subkeys) under a specified key.
-	//an offset is built during recursion to make the printout hierarchical
+	//The subkeys are read in parallel, but printed in the same order as a
+	//recursive walk, each level indented by 2 more than its parent.
 	void PrintRegKeyContents(CHKey& key, std::wstring offset)
 	{
-		if(offset == L"")
-			wcout << offset << key.Path() << endl;
-		else
-			wcout << offset << L"> " << key.RelPath() << endl;
+		CPrintVisitor visitor(offset);
+		CTreeWalker walker;
+		walker.Walk(key, visitor);
+	}
 
-		PrintRegKeyValues(key, offset);
+	//Print the data of a value from a snapshot file
+	static void PrintSnapshotValue(const CSnapshotValue& value)
+	{
+		switch (value.Type)
+		{
+		case REG_DWORD:
+			if (value.Size == sizeof(DWORD)) {
+				DWORD number;
+				memcpy(&number, value.Data, sizeof(number));
+				wcout << number;
+				return;
+			}
+			break;
+		case REG_SZ:
+		case REG_EXPAND_SZ: {
+			//the data in the file is not aligned, so it is copied out first
+			wstring text(value.Size / sizeof(wchar_t), L'\0');
+			memcpy(text.data(), value.Data, text.length() * sizeof(wchar_t));
+			text.resize(wcsnlen(text.c_str(), text.length()));
+			wcout << L"\"" << text << L"\"";
+			return;
+		}
+		}
+		wcout << L"(" << value.Size << L" bytes of type " << value.Type << L")";
+	}
 
-		wstring subOffset = offset + L"  ";
-		for (wstring keyName : key.GetSubKeys())
+	//Prints every difference between two snapshots, one line each
+	class CPrintDiff : public ISnapshotDiff
+	{
+	public:
+		void OnKeyAdded(std::wstring_view path) override
 		{
-			CHKey subkey = key.OpenSubKey(keyName);
-			PrintRegKeyContents(subkey, subOffset);
+			wcout << L"+ " << path << endl;
+		}
+
+		void OnKeyRemoved(std::wstring_view path) override
+		{
+			wcout << L"- " << path << endl;
+		}
+
+		void OnValueChanged(std::wstring_view path,
+			const CSnapshotValue* before, const CSnapshotValue* after) override
+		{
+			const CSnapshotValue* value = after ? after : before;
+			wcout << (!before ? L"+ " : !after ? L"- " : L"* ") << path << L"  " <<
+				(value->Name.empty() ? L"(Default)" : value->Name) << L":  ";
+			if (before) {
+				PrintSnapshotValue(*before);
+				if (after)
+					wcout << L" -> ";
+			}
+			if (after)
+				PrintSnapshotValue(*after);
+			wcout << endl;
+		}
+	};
+
+	//Print what changed between two snapshots. Returns the number of differences.
+	size_t PrintSnapshotDiff(const CRegSnapshotFile& before, const CRegSnapshotFile& after)
+	{
+		CPrintDiff printer;
+		return DiffSnapshots(before, after, printer);
+	}
+
+	//One line per operation that was called, latencies in microseconds
+	void PrintStats(const CStatsReport& report)
+	{
+		wcout << left << setw(20) << L"Operation" << right <<
+			setw(10) << L"Calls" << setw(8) << L"Errors" <<
+			setw(12) << L"Read" << setw(12) << L"Written" <<
+			setw(10) << L"Avg us" << setw(10) << L"p50 us" << setw(10) << L"p99 us" << endl;
+
+		wcout << fixed << setprecision(1);
+		for (size_t op = 0; op < (size_t)EStatOp::Count; op++) {
+			const COpStats& stats = report.Ops[op];
+			if (stats.Calls == 0)
+				continue;
+
+			wcout << left << setw(20) << StatOpName((EStatOp)op) << right <<
+				setw(10) << stats.Calls << setw(8) << stats.Errors <<
+				setw(12) << stats.BytesRead << setw(12) << stats.BytesWritten <<
+				setw(10) << stats.TotalNanoseconds / 1000.0 / stats.Calls <<
+				setw(10) << stats.Latency.Percentile(0.5) / 1000.0 <<
+				setw(10) << stats.Latency.Percentile(0.99) / 1000.0 << endl;
 		}
+		wcout << defaultfloat;
 	}
-}
\ No newline at end of file
+}
@@ -18,6 +18,8 @@
 #include <string>
 #include <WinBase.h>
 #include "HKey.h"
+#include "RegSnapshotFile.h"
+#include "Stats.h"
 
 /// <summary>
 /// Various helper routines for console applications
@@ -28,5 +30,7 @@ namespace w32
 
     void PrintRegKeyValues(CHKey& key, std::wstring offset = L"");
     void PrintRegKeyContents(CHKey& key, std::wstring offset = L"");
+    size_t PrintSnapshotDiff(const CRegSnapshotFile& before, const CRegSnapshotFile& after);
+    void PrintStats(const CStatsReport& report);
 
 }
\ No newline at end of file
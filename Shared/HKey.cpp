@@ -27,20 +27,24 @@ using namespace std;
 namespace w32
 {
 	//create a new key. Only called in the static methods
-	CHKey::CHKey() : m_transaction(), m_handle(NULL){}
+	CHKey::CHKey() : m_transaction(), m_handle(NULL), m_backend(NULL){}
 
 	//move constructor for use in the static methods
 	CHKey::CHKey(CHKey&& key) noexcept {
 		m_handle = key.m_handle;
-		m_path = key.m_path;
+		m_path = std::move(key.m_path);
+		m_relDepth = key.m_relDepth;
+		m_subKeyIndex = std::move(key.m_subKeyIndex);
+		m_valueIndex = std::move(key.m_valueIndex);
 		m_transaction = key.m_transaction;
+		m_backend = key.m_backend;
 		key.m_handle = NULL;
 		key.m_transaction = NULL;
 	}
 
 	CHKey::~CHKey() {
 		if (m_handle) {
-			RegCloseKey(m_handle);
+			m_backend->CloseKey(m_handle);
 			m_handle = NULL;
 		}
 	}
@@ -55,31 +59,85 @@ namespace w32
 		return IsWellKnownKey(m_handle);
 	}
 
+	//Get the backend this key lives in
+	IRegBackend* CHKey::Backend()
+	{
+		return m_backend;
+	}
+
 	//Get the full path of the key, inasmuch as we've been able to build it from the start
 	std::wstring CHKey::Path()
 	{
-		return m_path;
+		if (m_path.IsEmpty())
+			return L"<unknown>";
+		return m_path.ToString();
 	}
 
 	//Get the path of this key, relative to the key from which it was opened.
 	std::wstring CHKey::RelPath()
 	{
-		return m_relPath;
+		if (m_path.IsEmpty())
+			return L"<unknown>";
+		return m_path.ToString(m_relDepth);
 	}
 
 	//Get the name of the key
 	std::wstring CHKey::Name()
 	{
-		size_t index = m_path.find_last_of(L'\\');
-		if (index >= 0)
-			return m_path.substr(index + 1);
-		return m_path; //no separator
+		if (m_path.IsEmpty())
+			return L"<unknown>";
+		return std::wstring(m_path.Name());
 	}
 
 	//Does a specific subkey exist
 	bool CHKey::SubKeyExists(std::wstring subKey)
 	{
-		return Exists(m_handle, subKey, m_transaction);
+		return Exists(m_handle, subKey, m_transaction, m_backend);
+	}
+
+	//Get the index of subkey names, enumerating them the first time
+	const CNameIndex& CHKey::SubKeyIndex()
+	{
+		if (!m_subKeyIndex) {
+			DWORD numSubKeys = 0;
+			LSTATUS retVal = m_backend->QueryInfoKey(m_handle, &numSubKeys, NULL,
+				NULL, NULL, NULL, NULL);
+			if (retVal != ERROR_SUCCESS)
+				throw ExWin32Error(retVal);
+
+			std::unique_ptr<CNameIndex> index = std::make_unique<CNameIndex>();
+			index->Reserve(numSubKeys);
+			for (std::wstring_view name : SubKeys())
+				index->Add(name);
+			m_subKeyIndex = std::move(index);
+		}
+		return *m_subKeyIndex;
+	}
+
+	//Get the index of value names, enumerating them the first time
+	const CNameIndex& CHKey::ValueIndex()
+	{
+		if (!m_valueIndex) {
+			DWORD numValues = 0;
+			LSTATUS retVal = m_backend->QueryInfoKey(m_handle, NULL, NULL,
+				&numValues, NULL, NULL, NULL);
+			if (retVal != ERROR_SUCCESS)
+				throw ExWin32Error(retVal);
+
+			std::unique_ptr<CNameIndex> index = std::make_unique<CNameIndex>();
+			index->Reserve(numValues);
+			for (std::wstring_view name : Values())
+				index->Add(name);
+			m_valueIndex = std::move(index);
+		}
+		return *m_valueIndex;
+	}
+
+	//Forget the indexes, so that they are rebuilt when they are needed again
+	void CHKey::ResetIndexes()
+	{
+		m_subKeyIndex.reset();
+		m_valueIndex.reset();
 	}
 
 	//Open a new subkey relative to this one
@@ -87,17 +145,21 @@ namespace w32
 	CHKey CHKey::OpenSubKey(
 		std::wstring regkey,      //keyname
 		REGSAM samDesired) {
-		CHKey key = CHKey::Open(m_handle, regkey, samDesired, m_transaction);
-		key.m_path = m_path + L"\\" + regkey;
-		return key;
+		return OpenOrCreate(false, m_handle, m_path, regkey, samDesired, m_transaction, m_backend);
 	}
 
 	//Create or open a subkey
 	CHKey CHKey::CreateSubKey(
 		std::wstring regkey,      //keyname
 		REGSAM samDesired) {
-		CHKey key = CHKey::Create(m_handle, regkey, samDesired, m_transaction);
-		key.m_path = m_path + L"\\" + regkey;
+		CHKey key = OpenOrCreate(true, m_handle, m_path, regkey, samDesired, m_transaction, m_backend);
+		//the first level of the new key is a direct subkey of ours
+		size_t start = regkey.find_first_not_of(L'\\');
+		if (m_subKeyIndex && start != std::wstring::npos) {
+			size_t end = regkey.find(L'\\', start);
+			m_subKeyIndex->Add(std::wstring_view(regkey).substr(start,
+				end == std::wstring::npos ? std::wstring::npos : end - start));
+		}
 		return key;
 	}
 
@@ -105,21 +167,50 @@ namespace w32
 	void CHKey::DeleteSubKey(
 		std::wstring regkey,
 		HANDLE transaction) {
-		LSTATUS retVal = RegDeleteTreeW(m_handle, regkey.c_str());
+		LSTATUS retVal = m_backend->DeleteTree(m_handle, regkey.c_str());
 		if (retVal)
 			throw ExWin32Error(retVal);
+		//names cannot be taken out of the index
+		m_subKeyIndex.reset();
 	}
 
 	//Set a value under this key
 	void CHKey::SetValue(
 		std::wstring valueName,   //value name (NULL is default value)
 		std::wstring value) {
-		LSTATUS retVal;
-		if (!(retVal = RegSetValueExW(
-			m_handle, valueName.c_str(), 0, REG_SZ,
-			(const BYTE*)value.c_str(), (DWORD)((value.length() + 1) * sizeof(wchar_t)))))
+		SetValue(valueName, REG_SZ,
+			(const BYTE*)value.c_str(), (DWORD)((value.length() + 1) * sizeof(wchar_t)));
+	}
+
+	//Set a DWORD value under this key
+	void CHKey::SetValue(
+		std::wstring valueName,   //value name (NULL is default value)
+		DWORD value) {
+		SetValue(valueName, REG_DWORD, (const BYTE*)&value, sizeof(DWORD));
+	}
+
+	//Set a value of any type under this key
+	void CHKey::SetValue(
+		std::wstring valueName,   //value name (NULL is default value)
+		DWORD type,
+		const BYTE* data,
+		DWORD dataLength) {
+		LSTATUS retVal = m_backend->SetValue(
+			m_handle, valueName.c_str(), type, data, dataLength);
+		if (retVal != ERROR_SUCCESS)
 			throw ExWin32Error(retVal);
+		if (m_valueIndex)
+			m_valueIndex->Add(valueName);
+	}
 
+	//Delete a value under this key
+	void CHKey::DeleteValue(
+		std::wstring valueName) {
+		LSTATUS retVal = m_backend->DeleteValue(m_handle, valueName.c_str());
+		if (retVal != ERROR_SUCCESS)
+			throw ExWin32Error(retVal);
+		//names cannot be taken out of the index
+		m_valueIndex.reset();
 	}
 
 	//Get a string value 
@@ -129,27 +220,27 @@ namespace w32
 		LSTATUS retVal;
 		DWORD type = 0; //REG_SZ
 		DWORD dwSize = 0;
-		retVal = RegGetValueW(
-			m_handle, NULL, valueName.c_str(), RRF_RT_REG_SZ, &type,
-			NULL, &dwSize);
+		retVal = m_backend->QueryValue(
+			m_handle, valueName.c_str(), &type, NULL, &dwSize);
 		if (retVal != ERROR_SUCCESS)
 			throw ExWin32Error(retVal);
+		if (type != REG_SZ && type != REG_EXPAND_SZ)
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
 
 		//REG_SZ may or may not be stored with a 0 termination.
 		//safest is to assume there isn't one, and oversize by 1 character.
-		dwSize += sizeof(wchar_t);
-		//wchar_t* buffer = new wchar_t[dwSize / sizeof(wchar_t)];
-		//memset(buffer, 0, dwSize);
+		//The buffer is zeroed, so whatever we read is terminated.
+		CArray<wchar_t> buffer(dwSize / sizeof(wchar_t) + 1);
 
-		CArray<wchar_t> buffer(dwSize);
-
-		retVal = RegGetValue(
-			m_handle, NULL, valueName.c_str(), RRF_RT_REG_SZ, &type,
-			buffer, &dwSize);
+		retVal = m_backend->QueryValue(
+			m_handle, valueName.c_str(), &type, (LPBYTE)(wchar_t*)buffer, &dwSize);
 		if (retVal != ERROR_SUCCESS) {
 			throw ExWin32Error(retVal);
 		}
 
+		//like RegGetValue with RRF_RT_REG_SZ, REG_EXPAND_SZ is returned expanded
+		if (type == REG_EXPAND_SZ)
+			return ExpandEnvironment(std::wstring(buffer));
 		return std::wstring(buffer);
 	}
 
@@ -158,82 +249,97 @@ namespace w32
 		std::wstring valueName)
 	{
 		LSTATUS retVal;
-		DWORD type = 0; //RRF_RT_REG_DWORD
+		DWORD type = 0; //REG_DWORD
 
 		DWORD buffer = 0;
 		DWORD dwSize = sizeof(DWORD);
 
-		retVal = RegGetValue(
-			m_handle, NULL, valueName.c_str(), RRF_RT_REG_DWORD, &type,
-			&buffer, &dwSize);
+		retVal = m_backend->QueryValue(
+			m_handle, valueName.c_str(), &type, (LPBYTE)&buffer, &dwSize);
 		if (retVal != ERROR_SUCCESS) {
 			throw ExWin32Error(retVal);
 		}
+		if (type != REG_DWORD || dwSize != sizeof(DWORD))
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
 
 		return buffer;
 
 	}
 
-	//Get the subkeys under this key
-	std::vector<std::wstring> CHKey::GetSubKeys()
+	//Get a QWORD value
+	ULONGLONG CHKey::GetQWValue(
+		std::wstring valueName)
 	{
-		DWORD numsubkeys;
-		DWORD maxSubkeyLength;
+		LSTATUS retVal;
+		DWORD type = 0; //REG_QWORD
 
-		//Get the number and the length of the longest name
-		LSTATUS retVal = RegQueryInfoKeyW(m_handle, NULL, NULL, NULL, &numsubkeys, &maxSubkeyLength,
-			NULL, NULL, NULL, NULL, NULL, NULL);
+		ULONGLONG buffer = 0;
+		DWORD dwSize = sizeof(ULONGLONG);
+
+		retVal = m_backend->QueryValue(
+			m_handle, valueName.c_str(), &type, (LPBYTE)&buffer, &dwSize);
 		if (retVal != ERROR_SUCCESS) {
 			throw ExWin32Error(retVal);
 		}
+		if (type != REG_QWORD || dwSize != sizeof(ULONGLONG))
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
 
-		std::vector<std::wstring> subKeys;
-		CArray<wchar_t> buffer(maxSubkeyLength + 1);
+		return buffer;
+	}
 
-		//Get the name of each key, using the longest length as buffer size
-		for (DWORD i = 0; i < numsubkeys; i++)
-		{
-			DWORD subkeyLength = maxSubkeyLength + 1;
-			buffer.Zero();
-			retVal = RegEnumKeyExW(m_handle, i, buffer, &subkeyLength, NULL, NULL, NULL, NULL);
-			if (retVal != ERROR_SUCCESS) {
-				throw ExWin32Error(retVal);
+	//Get a value of any type, in a buffer that is reused
+	CRegValue CHKey::GetValue(
+		const std::wstring& valueName,
+		std::vector<BYTE>& buffer)
+	{
+		//all of the capacity is available without allocating
+		if (buffer.size() < buffer.capacity())
+			buffer.resize(buffer.capacity());
+
+		for (;;) {
+			DWORD type = REG_NONE;
+			DWORD dwSize = (DWORD)buffer.size();
+			LSTATUS retVal = m_backend->QueryValue(m_handle, valueName.c_str(), &type,
+				buffer.empty() ? NULL : buffer.data(), &dwSize);
+
+			//without a buffer, only the size is returned
+			if (retVal == ERROR_MORE_DATA || (retVal == ERROR_SUCCESS && buffer.empty() && dwSize > 0)) {
+				buffer.resize(dwSize);
+				continue;
 			}
-			subKeys.push_back(std::wstring(buffer));
+			if (retVal != ERROR_SUCCESS)
+				throw ExWin32Error(retVal);
+			return CRegValue(type, buffer.data(), dwSize);
 		}
+	}
+
+	//Enumerate the subkeys under this key
+	CKeyNameRange CHKey::SubKeys()
+	{
+		return CKeyNameRange(m_backend, m_handle, CKeyNameRange::EKind::SUBKEYS);
+	}
 
+	//Enumerate the values under this key
+	CKeyNameRange CHKey::Values()
+	{
+		return CKeyNameRange(m_backend, m_handle, CKeyNameRange::EKind::VALUES);
+	}
+
+	//Get the subkeys under this key
+	std::vector<std::wstring> CHKey::GetSubKeys()
+	{
+		std::vector<std::wstring> subKeys;
+		for (std::wstring_view name : SubKeys())
+			subKeys.emplace_back(name);
 		return subKeys;
 	}
 
 	//Get the names of the values under this key
 	std::vector<std::wstring> CHKey::GetValues()
 	{
-		DWORD numValues;
-		DWORD maxValueNameLength;
-		DWORD maxValueLength;
-
-		//Get the number and the length of the longest name
-		LSTATUS retVal = RegQueryInfoKeyW(m_handle, NULL, NULL, NULL, NULL, NULL,
-			NULL, &numValues, &maxValueNameLength, &maxValueLength, NULL, NULL);
-		if (retVal != ERROR_SUCCESS) {
-			throw ExWin32Error(retVal);
-		}
-
 		std::vector<std::wstring> values;
-		CArray<wchar_t> buffer(maxValueNameLength + 1);
-
-		//Get the name of each key, using the longest length as buffer size
-		for (DWORD i = 0; i < numValues; i++)
-		{
-			DWORD valueLength = maxValueNameLength + 1;
-			buffer.Zero();
-			retVal = RegEnumValueW(m_handle, i, buffer, &valueLength, NULL, NULL, NULL, NULL);
-			if (retVal != ERROR_SUCCESS) {
-				throw ExWin32Error(retVal);
-			}
-			values.push_back(std::wstring(buffer));
-		}
-
+		for (std::wstring_view name : Values())
+			values.emplace_back(name);
 		return values;
 	}
 
@@ -243,14 +349,32 @@ namespace w32
 		LSTATUS retVal;
 		DWORD type = 0;
 		DWORD dwSize = 0;
-		retVal = RegGetValueW(
-			m_handle, NULL, valueName.c_str(), RRF_RT_ANY, &type,
-			NULL, &dwSize);
+		retVal = m_backend->QueryValue(
+			m_handle, valueName.c_str(), &type, NULL, &dwSize);
 		if (retVal != ERROR_SUCCESS)
 			throw ExWin32Error(retVal);
 		return type;
 	}
 
+	//Get all values under this key
+	CKeySnapshot CHKey::Snapshot()
+	{
+		return CKeySnapshot::Capture(m_backend, m_handle);
+	}
+
+	//Get all values under this key, reusing a snapshot
+	void CHKey::Snapshot(CKeySnapshot& snapshot)
+	{
+		snapshot.Recapture(m_backend, m_handle);
+	}
+
+	//Get all values under this key on a thread of the pool
+	CTask<CKeySnapshot> CHKey::SnapshotAsync(CThreadPool* pool)
+	{
+		co_await ResumeOn(pool);
+		co_return CKeySnapshot::Capture(m_backend, m_handle);
+	}
+
 
 	////////////////////////////////////////////////////////////////////////////////////
 	//static methods
@@ -260,71 +384,53 @@ namespace w32
 		HKEY parentKey,             //location where we want to open a new key
 		std::wstring regkey,      //keyname
 		REGSAM samDesired,          //requested rights
-		HANDLE transaction) {  //transaction under which the key is opened.
-
-		CHKey key;
-		LSTATUS retVal = NO_ERROR;
-		if (transaction != INVALID_HANDLE_VALUE && transaction != NULL) {
-			retVal = RegOpenKeyTransacted(
-				parentKey, regkey.c_str(), 0, samDesired,
-				&key.m_handle,
-				transaction, NULL);
-		}
-		else {
-			retVal = RegOpenKeyEx(
-				parentKey, regkey.c_str(), 0, samDesired,
-				&key.m_handle);
-		}
-
-		if (retVal)
-			throw ExWin32Error(retVal);
-
-		//even though the HKEY itself has no need for the transaction anymore
-		//we need to pair it with the CHKey because otherwise it cannot open or
-		//create transacted subkeys
-		key.m_transaction = transaction;
+		HANDLE transaction,         //transaction under which the key is opened.
+		IRegBackend* backend) {     //backend in which the key lives
+		return OpenOrCreate(false, parentKey, RootPath(parentKey), regkey,
+			samDesired, transaction, backend);
+	}
 
-		if (IsWellKnownKey(parentKey)) {
-			key.m_path = GetWellKnownKeyName(parentKey) + L"\\" + regkey;
-		}
-		else {
-			key.m_path = std::wstring(L"<Unknown>\\") + regkey;
-		}
-		key.m_relPath = regkey;
-		return key;
+	CTask<CHKey> CHKey::OpenAsync(
+		HKEY parentKey,
+		std::wstring regkey,
+		REGSAM samDesired,
+		HANDLE transaction,
+		IRegBackend* backend,
+		CThreadPool* pool) {
+		co_await ResumeOn(pool);
+		co_return Open(parentKey, regkey, samDesired, transaction, backend);
 	}
 
 	CHKey CHKey::Create(
 		HKEY parentKey,             //location where we want to open a new key
 		std::wstring regkey,      //keyname
 		REGSAM samDesired,          //requested rights
-		HANDLE transaction) {  //transaction under which the key is opened.
+		HANDLE transaction,         //transaction under which the key is opened.
+		IRegBackend* backend) {     //backend in which the key lives
+		return OpenOrCreate(true, parentKey, RootPath(parentKey), regkey,
+			samDesired, transaction, backend);
+	}
+
+	//Open or create a key below a parent of which we know the path
+	CHKey CHKey::OpenOrCreate(
+		bool create,                //create the key if it does not exist
+		HKEY parentKey,             //location where we want to open a new key
+		const CKeyPath& parentPath, //path of the parent key
+		const std::wstring& regkey, //keyname
+		REGSAM samDesired,          //requested rights
+		HANDLE transaction,         //transaction under which the key is opened.
+		IRegBackend* backend) {     //backend in which the key lives
 
 		CHKey key;
-		LSTATUS retVal = NO_ERROR;
-		if (transaction != INVALID_HANDLE_VALUE && transaction != NULL) {
-			retVal = RegCreateKeyTransacted(
-				parentKey, regkey.c_str(), 0,
-				NULL,                   //user class. can be ignored
-				REG_OPTION_NON_VOLATILE,//the change is to be permanent
-				samDesired,
-				NULL,                   //security attributes. NULL -> default security inherited
-				&key.m_handle,
-				NULL,                   //disposition feedback -> was it created or opened? don't care.
-				transaction,
-				NULL);					//reserved
+		key.m_backend = backend ? backend : GetDefaultRegBackend();
+		LSTATUS retVal;
+		if (create) {
+			retVal = key.m_backend->CreateKey(
+				parentKey, regkey.c_str(), samDesired, transaction, &key.m_handle);
 		}
 		else {
-			retVal = RegCreateKeyEx(
-				parentKey,
-				regkey.c_str(),
-				0,                      //reserved
-				NULL,                   //user class. can be ignored
-				REG_OPTION_NON_VOLATILE,//the change is to be permanent
-				samDesired,
-				NULL,                   //security attributes. NULL -> default security inherited
-				&key.m_handle,
-				NULL);                 //disposition feedback -> was it created or opened? don't care.
+			retVal = key.m_backend->OpenKey(
+				parentKey, regkey.c_str(), samDesired, transaction, &key.m_handle);
 		}
 		if (retVal)
 			throw ExWin32Error(retVal);
@@ -334,17 +440,20 @@ namespace w32
 		//create transacted subkeys
 		key.m_transaction = transaction;
 
-		if (IsWellKnownKey(parentKey)) {
-			key.m_path = GetWellKnownKeyName(parentKey) + L"\\" + regkey;
-		}
-		else {
-			key.m_path = std::wstring(L"<Unknown>\\") + regkey;
-		}
-		key.m_relPath = regkey;
-
+		//the path shares everything up to the parent with the parent's path
+		key.m_path = parentPath.Append(regkey);
+		key.m_relDepth = key.m_path.Depth() - parentPath.Depth();
 		return key;
 	}
 
+	//The path from which the paths of keys below a parent key are built
+	CKeyPath CHKey::RootPath(HKEY parentKey)
+	{
+		if (IsWellKnownKey(parentKey))
+			return CKeyPath::Root(GetWellKnownKeyName(parentKey));
+		return CKeyPath::Root(L"<Unknown>");
+	}
+
 	//Delete all values and keys underneath a given key and - optionally- the subkey
 	//itself. This is performed in a transacted way. Either an overall transaction is
 	//supplied, or a local one is created and transacted locally.
@@ -354,7 +463,8 @@ namespace w32
 		HKEY hKeyRoot,              //root of the tree to be delete
 		LPCTSTR subKey,             //subkey that is to be deleted
 		bool deleteSubKey,          //do we delete the subkey itself or only what's underneath?
-		HANDLE transaction)         //transaction
+		HANDLE transaction,         //transaction
+		IRegBackend* backend)       //backend in which the tree lives
 	{
 		//The root cannot be NULL
 		if (hKeyRoot == NULL)
@@ -372,26 +482,29 @@ namespace w32
 		if (deleteSubKey && subKey == NULL)
 			throw ExWin32Error(ERROR_INVALID_PARAMETER);
 
+		if (backend == NULL)
+			backend = GetDefaultRegBackend();
+
 		//If an overall transaction was supplied, we use that.
 		//If not, we use a local one.
-		CTransaction localTransaction;
+		CRegTransaction localTransaction(backend);
 		if (transaction == INVALID_HANDLE_VALUE) {
 			localTransaction.Create();
+			transaction = localTransaction;
 		}
 
 		try
 		{
 			//Open a transacted handle and delete everything underneath the specified key / subkey
-			DWORD retVal = ERROR_SUCCESS;
+			LSTATUS retVal = ERROR_SUCCESS;
 
-			CHKey key = CHKey::Open(hKeyRoot, subKey, KEY_WRITE | KEY_READ, localTransaction);
+			CHKey key = CHKey::Open(hKeyRoot, subKey, KEY_WRITE | KEY_READ, transaction, backend);
 
-			if (!(retVal = RegDeleteTree(key, NULL)))
+			if ((retVal = backend->DeleteTree(key, NULL)) != ERROR_SUCCESS)
 				throw ExWin32Error(retVal);
 
 			if (deleteSubKey) {
-				if (!(retVal = RegDeleteKeyTransacted(
-					hKeyRoot, subKey, KEY_WRITE | KEY_READ, 0, localTransaction, NULL)))
+				if ((retVal = backend->DeleteKey(hKeyRoot, subKey, transaction)) != ERROR_SUCCESS)
 					throw ExWin32Error(retVal);
 			}
 
@@ -424,18 +537,15 @@ namespace w32
 	}
 
 	//Check if a key exists
-	bool CHKey::Exists(HKEY root, std::wstring subKeyName, HANDLE transaction)
+	bool CHKey::Exists(HKEY root, std::wstring subKeyName, HANDLE transaction, IRegBackend* backend)
 	{
+		if (backend == NULL)
+			backend = GetDefaultRegBackend();
+
 		HKEY subKey = NULL;
-		LSTATUS result = NO_ERROR;
-		if (transaction != INVALID_HANDLE_VALUE) {
-			result = RegOpenKeyTransactedW(root, subKeyName.c_str(), 0, KEY_READ, &subKey, transaction, NULL);
-		}
-		else {
-			result = RegOpenKeyExW(root, subKeyName.c_str(), 0, KEY_READ, &subKey);
-		}
+		LSTATUS result = backend->OpenKey(root, subKeyName.c_str(), KEY_READ, transaction, &subKey);
 		if (result == ERROR_SUCCESS) {
-			::CloseHandle(subKey);
+			backend->CloseKey(subKey);
 			return true;
 		}
 		else if (result != ERROR_FILE_NOT_FOUND) {
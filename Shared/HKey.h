@@ -20,6 +20,13 @@
 #include <vector>
 #include <string>
 #include "Transaction.h"
+#include "RegBackend.h"
+#include "KeySnapshot.h"
+#include "KeyNameRange.h"
+#include "PathTrie.h"
+#include "NameIndex.h"
+#include "Task.h"
+#include <memory>
 
 namespace w32
 {
@@ -38,13 +45,20 @@ namespace w32
 	/// The transaction is passed down through the root key because registry contents may be
 	/// subject to a current transaction and not yet exist in the committed state.
 	/// These keys support use with registry transaction based on whether you supply one.
+	///
+	/// All access goes through an IRegBackend. By default that is the live registry, but
+	/// the static methods accept a different backend (e.g. an in-memory hive), and every
+	/// key that is opened below an existing key uses the backend of its parent.
 	/// </summary>
 	class CHKey
 	{
-		std::wstring m_path = L"<unknown>";
-		std::wstring m_relPath = L"<unknown>";
+		CKeyPath m_path;                //shared with the parent key, see CKeyPath
+		size_t m_relDepth = 0;          //number of segments that were opened relative to the parent
 		HKEY m_handle;
 		HANDLE m_transaction;
+		IRegBackend* m_backend;
+		std::unique_ptr<CNameIndex> m_subKeyIndex;    //only built on request
+		std::unique_ptr<CNameIndex> m_valueIndex;     //only built on request
 
 		//creation only allowed in static methods
 		//because that is the only way to guarantee proper
@@ -52,6 +66,10 @@ namespace w32
 		//an open handle
 		CHKey();
 
+		static CHKey OpenOrCreate(bool create, HKEY parentKey, const CKeyPath& parentPath,
+			const std::wstring& regkey, REGSAM samDesired, HANDLE transaction, IRegBackend* backend);
+		static CKeyPath RootPath(HKEY parentKey);
+
 	public:
 		
 
@@ -64,14 +82,30 @@ namespace w32
 
 		bool IsWellKnownKey();
 
+		//The backend that this key lives in
+		IRegBackend* Backend();
+
 		std::wstring Path();
 
 		std::wstring RelPath();
 
 		std::wstring Name();
 
+		//Does a subkey exist. Always asks the registry; SubKeyIndex().Contains answers
+		//from the names that were there when the index was built.
 		bool SubKeyExists(std::wstring subKey);
 
+		//Index of the names of the subkeys, for fast case insensitive lookups.
+		//It is built the first time it is requested and then kept. Changes that are made
+		//through this CHKey object are reflected in it, other changes are not.
+		const CNameIndex& SubKeyIndex();
+
+		//Index of the names of the values, same as above
+		const CNameIndex& ValueIndex();
+
+		//Discard the indexes so they are rebuilt on the next request
+		void ResetIndexes();
+
 		//Open a key below this one
 		CHKey OpenSubKey(
 			std::wstring  regkey,
@@ -92,12 +126,45 @@ namespace w32
 			std::wstring valueName,   //value name (NULL is default value)
 			std::wstring value);      //value
 
+		//Set a DWORD value in the current key
+		void SetValue(
+			std::wstring valueName,   //value name (NULL is default value)
+			DWORD value);             //value
+
+		//Set a value of any type in the current key
+		void SetValue(
+			std::wstring valueName,   //value name (NULL is default value)
+			DWORD type,               //REG_SZ, REG_DWORD, ...
+			const BYTE* data,
+			DWORD dataLength);        //size of the data in bytes
+
+		//Delete a value from the current key
+		void DeleteValue(
+			std::wstring valueName);  //value name (NULL is default value)
+
 		std::wstring GetWSValue(
 			std::wstring valueName);  //value name (NULL is default value)
 
 		DWORD GetDWValue(
 			std::wstring valueName);  //value name (NULL is default value)
 
+		ULONGLONG GetQWValue(
+			std::wstring valueName);  //value name (NULL is default value)
+
+		//Read a value of any type into a buffer that the caller keeps and reuses.
+		//The buffer only grows when a value does not fit, so reading many values
+		//through one buffer does not allocate for each of them.
+		//The result refers to the buffer and is valid until it is modified.
+		CRegValue GetValue(
+			const std::wstring& valueName,  //value name (empty is default value)
+			std::vector<BYTE>& buffer);
+
+		//Enumerate the names of the subkeys under this key, one at a time
+		CKeyNameRange SubKeys();
+
+		//Enumerate the names of the values under this key, one at a time
+		CKeyNameRange Values();
+
 		//Get the names of the subkeys under this key
 		std::vector<std::wstring> GetSubKeys();
 
@@ -107,6 +174,17 @@ namespace w32
 		//Get the data type of a specific value
 		DWORD GetValueType(const std::wstring& valueName);
 
+		//Get the names, types and data of all values under this key in one sweep.
+		//Prefer this over GetValues + GetValueType + Get..Value when reading many values.
+		CKeySnapshot Snapshot();
+
+		//Same, but into an existing snapshot whose buffers are reused
+		void Snapshot(CKeySnapshot& snapshot);
+
+		//Take the snapshot on a thread of the pool. The key must stay alive until the
+		//task is done.
+		CTask<CKeySnapshot> SnapshotAsync(CThreadPool* pool = &CThreadPool::Default());
+
 		//Open a registry key. We cannot do that directly because a registry key
 		//is always opened or created below a parent key. A programmer can open
 		//a registry key by using this static function or by using the constructor
@@ -115,7 +193,18 @@ namespace w32
 			HKEY parentKey,             //location where we want to open a new key
 			std::wstring regkey,      //keyname
 			REGSAM samDesired = GENERIC_READ,          //requested rights
-			HANDLE transaction = INVALID_HANDLE_VALUE);  //transaction under which the key is opened.
+			HANDLE transaction = INVALID_HANDLE_VALUE,  //transaction under which the key is opened.
+			IRegBackend* backend = NULL);               //NULL means the default backend
+
+		//Same as Open, but on a thread of the pool so that several keys can be opened
+		//at the same time. A NULL pool opens the key on the thread that awaits it.
+		static CTask<CHKey> OpenAsync(
+			HKEY parentKey,
+			std::wstring regkey,
+			REGSAM samDesired = GENERIC_READ,
+			HANDLE transaction = INVALID_HANDLE_VALUE,
+			IRegBackend* backend = NULL,
+			CThreadPool* pool = &CThreadPool::Default());
 
 		//Open a registry key. We cannot do that directly because a registry key
 		//is always opened or created below a parent key. A programmer can open
@@ -125,7 +214,8 @@ namespace w32
 			HKEY parentKey,             //location where we want to open a new key
 			std::wstring regkey,      //keyname
 			REGSAM samDesired = GENERIC_READ | GENERIC_WRITE,          //requested rights
-			HANDLE transaction = INVALID_HANDLE_VALUE);  //transaction under which the key is opened.
+			HANDLE transaction = INVALID_HANDLE_VALUE,  //transaction under which the key is opened.
+			IRegBackend* backend = NULL);               //NULL means the default backend
 
 		//Delete all values and keys underneath a given key and - optionally- the subkey
 		//itself. This is performed in a transacted way. Either an overall transaction is
@@ -134,13 +224,15 @@ namespace w32
 			HKEY hKeyRoot,              //root of the tree to be delete
 			LPCTSTR subKey,             //subkey that is to be deleted
 			bool deleteSubKey,          //do we delete the subkey itself or only what's underneath?
-			HANDLE transaction = INVALID_HANDLE_VALUE); //transaction
+			HANDLE transaction = INVALID_HANDLE_VALUE, //transaction
+			IRegBackend* backend = NULL);              //NULL means the default backend
 
 		//Is the specified key one of the well known ones
 		static bool IsWellKnownKey(HKEY key);
 
 		//does a specific key exist?
-		static bool Exists(HKEY root, std::wstring subKey, HANDLE transaction = INVALID_HANDLE_VALUE);
+		static bool Exists(HKEY root, std::wstring subKey, HANDLE transaction = INVALID_HANDLE_VALUE,
+			IRegBackend* backend = NULL);
 
 		//get a readable name for a well known key 
 		static std::wstring GetWellKnownKeyName(HKEY key);
@@ -0,0 +1,143 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "InstrumentedBackend.h"
+
+namespace w32
+{
+	//Mark the call as failed if it was, and pass the status on
+	static LSTATUS Counted(CStatScope& scope, LSTATUS status)
+	{
+		if (status != ERROR_SUCCESS && status != ERROR_NO_MORE_ITEMS)
+			scope.Fail();
+		return status;
+	}
+
+	CInstrumentedBackend::CInstrumentedBackend(IRegBackend* inner) :
+		m_inner(inner ? inner : GetDefaultRegBackend())
+	{
+	}
+
+	LSTATUS CInstrumentedBackend::OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		CStatScope scope(EStatOp::OpenKey);
+		return Counted(scope, m_inner->OpenKey(parent, subKey, samDesired, transaction, result));
+	}
+
+	LSTATUS CInstrumentedBackend::CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		CStatScope scope(EStatOp::CreateKey);
+		return Counted(scope, m_inner->CreateKey(parent, subKey, samDesired, transaction, result));
+	}
+
+	LSTATUS CInstrumentedBackend::CloseKey(HKEY key)
+	{
+		CStatScope scope(EStatOp::CloseKey);
+		return Counted(scope, m_inner->CloseKey(key));
+	}
+
+	LSTATUS CInstrumentedBackend::QueryInfoKey(HKEY key,
+		DWORD* numSubKeys, DWORD* maxSubKeyLength,
+		DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+		FILETIME* lastWriteTime)
+	{
+		CStatScope scope(EStatOp::QueryInfoKey);
+		return Counted(scope, m_inner->QueryInfoKey(key, numSubKeys, maxSubKeyLength,
+			numValues, maxValueNameLength, maxValueLength, lastWriteTime));
+	}
+
+	LSTATUS CInstrumentedBackend::EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength)
+	{
+		CStatScope scope(EStatOp::EnumKey);
+		return Counted(scope, m_inner->EnumKey(key, index, name, nameLength));
+	}
+
+	LSTATUS CInstrumentedBackend::EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+		DWORD* type, LPBYTE data, DWORD* dataLength)
+	{
+		CStatScope scope(EStatOp::EnumValue);
+		LSTATUS status = m_inner->EnumValue(key, index, name, nameLength, type, data, dataLength);
+		if (status == ERROR_SUCCESS && data && dataLength)
+			scope.Read(*dataLength);
+		return Counted(scope, status);
+	}
+
+	LSTATUS CInstrumentedBackend::QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+		LPBYTE data, DWORD* dataLength)
+	{
+		CStatScope scope(EStatOp::QueryValue);
+		LSTATUS status = m_inner->QueryValue(key, valueName, type, data, dataLength);
+		if (status == ERROR_SUCCESS && data && dataLength)
+			scope.Read(*dataLength);
+		return Counted(scope, status);
+	}
+
+	LSTATUS CInstrumentedBackend::SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+		const BYTE* data, DWORD dataLength)
+	{
+		CStatScope scope(EStatOp::SetValue);
+		LSTATUS status = m_inner->SetValue(key, valueName, type, data, dataLength);
+		if (status == ERROR_SUCCESS)
+			scope.Written(dataLength);
+		return Counted(scope, status);
+	}
+
+	LSTATUS CInstrumentedBackend::DeleteValue(HKEY key, LPCWSTR valueName)
+	{
+		CStatScope scope(EStatOp::DeleteValue);
+		return Counted(scope, m_inner->DeleteValue(key, valueName));
+	}
+
+	LSTATUS CInstrumentedBackend::DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction)
+	{
+		CStatScope scope(EStatOp::DeleteKey);
+		return Counted(scope, m_inner->DeleteKey(parent, subKey, transaction));
+	}
+
+	LSTATUS CInstrumentedBackend::DeleteTree(HKEY key, LPCWSTR subKey)
+	{
+		CStatScope scope(EStatOp::DeleteTree);
+		return Counted(scope, m_inner->DeleteTree(key, subKey));
+	}
+
+	//all transaction calls are counted together
+	LSTATUS CInstrumentedBackend::CreateTransaction(HANDLE* transaction)
+	{
+		CStatScope scope(EStatOp::Transaction);
+		return Counted(scope, m_inner->CreateTransaction(transaction));
+	}
+
+	LSTATUS CInstrumentedBackend::CommitTransaction(HANDLE transaction)
+	{
+		CStatScope scope(EStatOp::Transaction);
+		return Counted(scope, m_inner->CommitTransaction(transaction));
+	}
+
+	LSTATUS CInstrumentedBackend::RollbackTransaction(HANDLE transaction)
+	{
+		CStatScope scope(EStatOp::Transaction);
+		return Counted(scope, m_inner->RollbackTransaction(transaction));
+	}
+
+	LSTATUS CInstrumentedBackend::CloseTransaction(HANDLE transaction)
+	{
+		CStatScope scope(EStatOp::Transaction);
+		return Counted(scope, m_inner->CloseTransaction(transaction));
+	}
+}
@@ -0,0 +1,64 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include "RegBackend.h"
+#include "Stats.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Backend that forwards every call to another backend and counts it in CStats:
+	/// calls, latency, bytes of value data read and written, and failures.
+	/// ERROR_NO_MORE_ITEMS is the normal end of an enumeration and is not counted as a
+	/// failure; anything else that is not ERROR_SUCCESS is.
+	///
+	/// To measure everything that goes through CHKey, wrap the default backend:
+	///     CInstrumentedBackend counted(GetDefaultRegBackend());
+	///     SetDefaultRegBackend(&counted);
+	/// </summary>
+	class CInstrumentedBackend : public IRegBackend
+	{
+		IRegBackend* m_inner;
+
+	public:
+		CInstrumentedBackend(IRegBackend* inner);
+
+		LSTATUS OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) override;
+		LSTATUS CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) override;
+		LSTATUS CloseKey(HKEY key) override;
+		LSTATUS QueryInfoKey(HKEY key,
+			DWORD* numSubKeys, DWORD* maxSubKeyLength,
+			DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+			FILETIME* lastWriteTime) override;
+		LSTATUS EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength) override;
+		LSTATUS EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+			DWORD* type, LPBYTE data, DWORD* dataLength) override;
+		LSTATUS QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+			LPBYTE data, DWORD* dataLength) override;
+		LSTATUS SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+			const BYTE* data, DWORD dataLength) override;
+		LSTATUS DeleteValue(HKEY key, LPCWSTR valueName) override;
+		LSTATUS DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction) override;
+		LSTATUS DeleteTree(HKEY key, LPCWSTR subKey) override;
+		LSTATUS CreateTransaction(HANDLE* transaction) override;
+		LSTATUS CommitTransaction(HANDLE transaction) override;
+		LSTATUS RollbackTransaction(HANDLE transaction) override;
+		LSTATUS CloseTransaction(HANDLE transaction) override;
+	};
+}
@@ -0,0 +1,184 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "KeyCache.h"
+#include "StringHelper.h"
+#include "Exception.h"
+
+namespace w32
+{
+	//Strip the separators at either end of a path
+	static std::wstring TrimPath(const std::wstring& path)
+	{
+		size_t start = path.find_first_not_of(L'\\');
+		if (start == std::wstring::npos)
+			return std::wstring();
+		size_t end = path.find_last_not_of(L'\\');
+		return path.substr(start, end - start + 1);
+	}
+
+	CKeyCache::CKeyCache(size_t capacity, IRegBackend* backend, REGSAM samDesired, HANDLE transaction) :
+		m_capacity(capacity ? capacity : 1),
+		m_backend(backend ? backend : GetDefaultRegBackend()),
+		m_samDesired(samDesired),
+		m_transaction(transaction)
+	{
+	}
+
+	//The cache id of a key is the root, followed by the uppercased path.
+	//Offsets in the path and in the id line up.
+	std::wstring CKeyCache::MakeId(HKEY root, const std::wstring& path)
+	{
+		std::wstring id = std::to_wstring((unsigned long long)(ULONG_PTR)root);
+		id += L':';
+		id += ToWUpperName(path);
+		return id;
+	}
+
+	//Find a key and mark it as most recently used. Must be called with the lock held.
+	std::shared_ptr<CHKey> CKeyCache::Lookup(const std::wstring& id)
+	{
+		auto it = m_index.find(id);
+		if (it == m_index.end())
+			return NULL;
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return it->second->key;
+	}
+
+	//Add a key, and close the least recently used one if needed.
+	//Must be called with the lock held.
+	void CKeyCache::Insert(const std::wstring& id, std::shared_ptr<CHKey> key)
+	{
+		m_entries.push_front(CEntry{ id, key });
+		m_index[id] = m_entries.begin();
+		while (m_entries.size() > m_capacity) {
+			m_index.erase(m_entries.back().id);
+			m_entries.pop_back();
+		}
+	}
+
+	std::shared_ptr<CHKey> CKeyCache::Open(HKEY root, const std::wstring& path)
+	{
+		std::shared_ptr<CHKey> key = TryOpen(root, path);
+		if (!key)
+			throw ExWin32Error(ERROR_FILE_NOT_FOUND);
+		return key;
+	}
+
+	std::shared_ptr<CHKey> CKeyCache::TryOpen(HKEY root, const std::wstring& path)
+	{
+		std::wstring trimmed = TrimPath(path);
+		std::wstring id = MakeId(root, trimmed);
+		size_t pathStart = id.length() - trimmed.length();
+
+		//Look for the key itself, then for the closest ancestor
+		std::shared_ptr<CHKey> ancestor;
+		size_t ancestorLength = 0;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			std::shared_ptr<CHKey> key = Lookup(id);
+			if (key) {
+				m_hits++;
+				return key;
+			}
+			m_misses++;
+
+			size_t pos = trimmed.length();
+			while (pos > 0 && (pos = trimmed.rfind(L'\\', pos - 1)) != std::wstring::npos) {
+				ancestor = Lookup(id.substr(0, pathStart + pos));
+				if (ancestor) {
+					ancestorLength = pos;
+					break;
+				}
+			}
+		}
+
+		//Open outside the lock, so that other threads can use the cache meanwhile
+		std::shared_ptr<CHKey> key;
+		try {
+			if (ancestor) {
+				key = std::make_shared<CHKey>(
+					ancestor->OpenSubKey(trimmed.substr(ancestorLength + 1), m_samDesired));
+			}
+			else {
+				key = std::make_shared<CHKey>(
+					CHKey::Open(root, trimmed, m_samDesired, m_transaction, m_backend));
+			}
+		}
+		catch (ExWin32Error& e) {
+			if (e.Value() == ERROR_FILE_NOT_FOUND)
+				return NULL;
+			throw;
+		}
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		//another thread may have opened it at the same time
+		std::shared_ptr<CHKey> existing = Lookup(id);
+		if (existing)
+			return existing;
+		Insert(id, key);
+		return key;
+	}
+
+	bool CKeyCache::Exists(HKEY root, const std::wstring& path)
+	{
+		return TryOpen(root, path) != NULL;
+	}
+
+	void CKeyCache::Invalidate(HKEY root, const std::wstring& path)
+	{
+		std::wstring trimmed = TrimPath(path);
+		std::wstring id = MakeId(root, trimmed);
+		std::wstring below = trimmed.empty() ? id : id + L"\\";
+
+		std::lock_guard<std::mutex> guard(m_lock);
+		for (auto it = m_entries.begin(); it != m_entries.end();) {
+			if (it->id == id || it->id.compare(0, below.length(), below) == 0) {
+				m_index.erase(it->id);
+				it = m_entries.erase(it);
+			}
+			else {
+				it++;
+			}
+		}
+	}
+
+	void CKeyCache::Clear()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		m_index.clear();
+		m_entries.clear();
+	}
+
+	size_t CKeyCache::Size()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		return m_entries.size();
+	}
+
+	size_t CKeyCache::Hits()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		return m_hits;
+	}
+
+	size_t CKeyCache::Misses()
+	{
+		std::lock_guard<std::mutex> guard(m_lock);
+		return m_misses;
+	}
+}
@@ -0,0 +1,99 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "HKey.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Bounded cache of open registry keys, so that code which keeps coming back to the
+	/// same keys (checking if a key exists and then opening it, or answering many queries
+	/// in one process) does not have to open them again every time.
+	///
+	/// Keys are identified by their root and their path, without regard to case and to
+	/// leading or trailing separators. When a key is not in the cache, it is opened
+	/// relative to the closest ancestor that is, which means the registry has fewer levels
+	/// to resolve. When the cache is full, the key that was used least recently is closed.
+	/// Keys that are handed out stay open for as long as the caller holds on to them.
+	///
+	/// All keys are opened with the same access rights, in the same backend and under the
+	/// same transaction. Keys that are not found are not remembered, because they could be
+	/// created at any time. After deleting keys, call Invalidate so the cache does not hand
+	/// out keys that no longer exist.
+	///
+	/// The cache can be used from multiple threads.
+	/// </summary>
+	class CKeyCache
+	{
+		struct CEntry
+		{
+			std::wstring id;
+			std::shared_ptr<CHKey> key;
+		};
+
+		size_t m_capacity;
+		IRegBackend* m_backend;
+		REGSAM m_samDesired;
+		HANDLE m_transaction;
+		std::mutex m_lock;
+		std::list<CEntry> m_entries;    //most recently used first
+		std::unordered_map<std::wstring, std::list<CEntry>::iterator> m_index;
+		size_t m_hits = 0;
+		size_t m_misses = 0;
+
+		static std::wstring MakeId(HKEY root, const std::wstring& path);
+		std::shared_ptr<CHKey> Lookup(const std::wstring& id);
+		void Insert(const std::wstring& id, std::shared_ptr<CHKey> key);
+
+	public:
+		CKeyCache(
+			size_t capacity = 64,                       //maximum number of open keys
+			IRegBackend* backend = NULL,                //NULL means the default backend
+			REGSAM samDesired = KEY_READ,
+			HANDLE transaction = INVALID_HANDLE_VALUE);
+
+		CKeyCache(const CKeyCache&) = delete;
+		CKeyCache& operator = (const CKeyCache&) = delete;
+
+		//Get an open key. Throws if it cannot be opened.
+		std::shared_ptr<CHKey> Open(HKEY root, const std::wstring& path);
+
+		//Get an open key, or NULL if it does not exist. Throws on other errors.
+		std::shared_ptr<CHKey> TryOpen(HKEY root, const std::wstring& path);
+
+		//Does a key exist? If it does, it stays in the cache for a subsequent Open.
+		bool Exists(HKEY root, const std::wstring& path);
+
+		//Forget a key and everything below it
+		void Invalidate(HKEY root, const std::wstring& path);
+
+		//Forget all keys
+		void Clear();
+
+		//Number of keys in the cache
+		size_t Size();
+
+		//Number of lookups that were and were not satisfied by the cache
+		size_t Hits();
+		size_t Misses();
+	};
+}
@@ -0,0 +1,111 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "KeyNameRange.h"
+#include "Exception.h"
+
+namespace w32
+{
+	CKeyNameRange::CKeyNameRange(IRegBackend* backend, HKEY key, EKind kind) :
+		m_backend(backend),
+		m_key(key),
+		m_kind(kind),
+		m_buffer(m_inline),
+		m_bufferLength(sizeof(m_inline) / sizeof(m_inline[0]))
+	{
+	}
+
+	bool CKeyNameRange::Fetch(DWORD index)
+	{
+		for (;;)
+		{
+			DWORD length = m_bufferLength;
+			LSTATUS retVal;
+			if (m_kind == EKind::SUBKEYS)
+				retVal = m_backend->EnumKey(m_key, index, m_buffer, &length);
+			else
+				retVal = m_backend->EnumValue(m_key, index, m_buffer, &length, NULL, NULL, NULL);
+
+			if (retVal == ERROR_SUCCESS) {
+				m_length = length;
+				return true;
+			}
+			else if (retVal == ERROR_NO_MORE_ITEMS) {
+				return false;
+			}
+			else if (retVal != ERROR_MORE_DATA) {
+				throw ExWin32Error(retVal);
+			}
+
+			//The name does not fit. Ask how long the longest one is and grow to that.
+			DWORD maxLength = 0;
+			if (m_kind == EKind::SUBKEYS)
+				retVal = m_backend->QueryInfoKey(m_key, NULL, &maxLength, NULL, NULL, NULL, NULL);
+			else
+				retVal = m_backend->QueryInfoKey(m_key, NULL, NULL, NULL, &maxLength, NULL, NULL);
+			if (retVal != ERROR_SUCCESS)
+				throw ExWin32Error(retVal);
+			if (maxLength + 1 <= m_bufferLength)
+				maxLength = m_bufferLength * 2;
+
+			m_overflow.resize(maxLength + 1);
+			m_buffer = m_overflow.data();
+			m_bufferLength = (DWORD)m_overflow.size();
+		}
+	}
+
+	CKeyNameRange::CIterator CKeyNameRange::begin()
+	{
+		return CIterator(this, 0);
+	}
+
+	CKeyNameRange::CIterator CKeyNameRange::end()
+	{
+		return CIterator();
+	}
+
+	CKeyNameRange::CIterator::CIterator(CKeyNameRange* range, DWORD index) :
+		m_range(range),
+		m_index(index)
+	{
+		if (!m_range->Fetch(m_index))
+			m_index = End;
+	}
+
+	std::wstring_view CKeyNameRange::CIterator::operator*() const
+	{
+		return std::wstring_view(m_range->m_buffer, m_range->m_length);
+	}
+
+	CKeyNameRange::CIterator& CKeyNameRange::CIterator::operator++()
+	{
+		m_index++;
+		if (!m_range->Fetch(m_index))
+			m_index = End;
+		return *this;
+	}
+
+	void CKeyNameRange::CIterator::operator++(int)
+	{
+		++*this;
+	}
+
+	bool CKeyNameRange::CIterator::operator==(const CIterator& other) const
+	{
+		return m_index == other.m_index;
+	}
+}
@@ -0,0 +1,94 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <vector>
+#include <string_view>
+#include <iterator>
+#include "RegBackend.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Lazy range over the subkey or value names of an open key, for use in range based
+	/// for loops. Each name is fetched from the backend only when the iterator gets to it,
+	/// so a caller that stops early does not pay for the rest of the key.
+	///
+	/// All names are read into one buffer that is owned by the range and reused for every
+	/// name. The string view that the iterator yields is only valid until the iterator is
+	/// advanced; copy it into a std::wstring to keep it.
+	///
+	/// Subkey names are limited to 255 characters, so they always fit the built-in buffer.
+	/// Only value names can be longer, in which case the buffer grows once.
+	/// The range refers to the key handle and must not outlive the key.
+	/// </summary>
+	class CKeyNameRange
+	{
+	public:
+		enum class EKind
+		{
+			SUBKEYS,
+			VALUES
+		};
+
+		class CIterator
+		{
+			CKeyNameRange* m_range = NULL;
+			DWORD m_index = End;
+
+		public:
+			static const DWORD End = (DWORD)-1;
+
+			using iterator_category = std::input_iterator_tag;
+			using value_type = std::wstring_view;
+			using difference_type = ptrdiff_t;
+			using pointer = const std::wstring_view*;
+			using reference = std::wstring_view;
+
+			CIterator() {}
+			CIterator(CKeyNameRange* range, DWORD index);
+
+			std::wstring_view operator*() const;
+			CIterator& operator++();
+			void operator++(int);
+			bool operator==(const CIterator& other) const;
+		};
+
+	private:
+		IRegBackend* m_backend;
+		HKEY m_key;
+		EKind m_kind;
+		wchar_t m_inline[256];
+		std::vector<wchar_t> m_overflow;    //only used for very long value names
+		wchar_t* m_buffer;
+		DWORD m_bufferLength;
+		DWORD m_length = 0;
+
+		//Read the name at a given index into the buffer. false if there is none.
+		bool Fetch(DWORD index);
+
+	public:
+		CKeyNameRange(IRegBackend* backend, HKEY key, EKind kind);
+
+		//the iterators point back into the range
+		CKeyNameRange(const CKeyNameRange&) = delete;
+		CKeyNameRange& operator = (const CKeyNameRange&) = delete;
+
+		CIterator begin();
+		CIterator end();
+	};
+}
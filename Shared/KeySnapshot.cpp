@@ -0,0 +1,205 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "KeySnapshot.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <cstring>
+
+namespace w32
+{
+	//Data entries are aligned so that string and integer data can be read in place
+	static const size_t DataAlignment = 8;
+
+	//Number of times a key that keeps changing while it is read is read again
+	static const int MaxRetries = 8;
+
+	static size_t AlignData(size_t offset)
+	{
+		return (offset + DataAlignment - 1) & ~(DataAlignment - 1);
+	}
+
+	CKeySnapshot CKeySnapshot::Capture(IRegBackend* backend, HKEY key)
+	{
+		CKeySnapshot snapshot;
+		snapshot.Recapture(backend, key);
+		return snapshot;
+	}
+
+	CKeySnapshot CKeySnapshot::CaptureInfo(IRegBackend* backend, HKEY key)
+	{
+		CKeySnapshot snapshot;
+		LSTATUS retVal = backend->QueryInfoKey(key,
+			&snapshot.m_numSubKeys, &snapshot.m_maxSubKeyLength,
+			NULL, NULL, NULL,
+			&snapshot.m_lastWriteTime);
+		if (retVal != ERROR_SUCCESS)
+			throw ExWin32Error(retVal);
+		return snapshot;
+	}
+
+	void CKeySnapshot::Recapture(IRegBackend* backend, HKEY key)
+	{
+		m_names.clear();
+		m_data.clear();
+		m_nameOffsets.clear();
+		m_nameLengths.clear();
+		m_types.clear();
+		m_dataOffsets.clear();
+		m_dataSizes.clear();
+
+		DWORD numValues = 0;
+		DWORD maxValueNameLength = 0;
+		DWORD maxValueLength = 0;
+
+		LSTATUS retVal = backend->QueryInfoKey(key,
+			&m_numSubKeys, &m_maxSubKeyLength,
+			&numValues, &maxValueNameLength, &maxValueLength,
+			&m_lastWriteTime);
+		if (retVal != ERROR_SUCCESS)
+			throw ExWin32Error(retVal);
+
+		m_nameOffsets.reserve(numValues);
+		m_nameLengths.reserve(numValues);
+		m_types.reserve(numValues);
+		m_dataOffsets.reserve(numValues);
+		m_dataSizes.reserve(numValues);
+
+		int retries = 0;
+		for (DWORD i = 0; i < numValues; i++)
+		{
+			//Read straight into the tail of the buffers, sized for the largest entry,
+			//and trim them back to what was actually returned.
+			size_t nameOffset = m_names.size();
+			size_t dataOffset = AlignData(m_data.size());
+			m_names.resize(nameOffset + maxValueNameLength + 1);
+			m_data.resize(dataOffset + maxValueLength);
+
+			DWORD nameLength = maxValueNameLength + 1;
+			DWORD dataSize = maxValueLength;
+			DWORD type = REG_NONE;
+			retVal = backend->EnumValue(key, i,
+				&m_names[nameOffset], &nameLength,
+				&type, m_data.data() + dataOffset, &dataSize);
+
+			if (retVal == ERROR_MORE_DATA) {
+				//a value was added or grew since we asked. Get the new maximums and retry.
+				m_names.resize(nameOffset);
+				m_data.resize(dataOffset);
+				if (++retries > MaxRetries)
+					throw ExWin32Error(retVal);
+				retVal = backend->QueryInfoKey(key, NULL, NULL,
+					&numValues, &maxValueNameLength, &maxValueLength, NULL);
+				if (retVal != ERROR_SUCCESS)
+					throw ExWin32Error(retVal);
+				i--;
+				continue;
+			}
+			else if (retVal == ERROR_NO_MORE_ITEMS) {
+				//values were deleted since we asked
+				m_names.resize(nameOffset);
+				m_data.resize(dataOffset);
+				break;
+			}
+			else if (retVal != ERROR_SUCCESS) {
+				throw ExWin32Error(retVal);
+			}
+
+			m_names.resize(nameOffset + nameLength + 1);
+			m_names[nameOffset + nameLength] = L'\0';
+			m_data.resize(dataOffset + dataSize);
+
+			m_nameOffsets.push_back((DWORD)nameOffset);
+			m_nameLengths.push_back(nameLength);
+			m_types.push_back(type);
+			m_dataOffsets.push_back((DWORD)dataOffset);
+			m_dataSizes.push_back(dataSize);
+		}
+	}
+
+	size_t CKeySnapshot::Count() const
+	{
+		return m_types.size();
+	}
+
+	std::wstring_view CKeySnapshot::Name(size_t index) const
+	{
+		return std::wstring_view(&m_names[m_nameOffsets[index]], m_nameLengths[index]);
+	}
+
+	DWORD CKeySnapshot::Type(size_t index) const
+	{
+		return m_types[index];
+	}
+
+	const BYTE* CKeySnapshot::Data(size_t index) const
+	{
+		return m_data.data() + m_dataOffsets[index];
+	}
+
+	DWORD CKeySnapshot::DataSize(size_t index) const
+	{
+		return m_dataSizes[index];
+	}
+
+	std::wstring_view CKeySnapshot::WSValue(size_t index) const
+	{
+		return Value(index).String();
+	}
+
+	DWORD CKeySnapshot::DWValue(size_t index) const
+	{
+		if (m_types[index] != REG_DWORD)
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
+		return Value(index).DWord();
+	}
+
+	CRegValue CKeySnapshot::Value(size_t index) const
+	{
+		return CRegValue(m_types[index], Data(index), m_dataSizes[index]);
+	}
+
+	void CKeySnapshot::Visit(IValueVisitor& visitor) const
+	{
+		for (size_t i = 0; i < Count(); i++)
+			VisitValue(Name(i), Value(i), visitor);
+	}
+
+	size_t CKeySnapshot::Find(std::wstring_view name) const
+	{
+		for (size_t i = 0; i < Count(); i++) {
+			if (CompareNoCase(Name(i), name) == 0)
+				return i;
+		}
+		return npos;
+	}
+
+	DWORD CKeySnapshot::NumSubKeys() const
+	{
+		return m_numSubKeys;
+	}
+
+	DWORD CKeySnapshot::MaxSubKeyLength() const
+	{
+		return m_maxSubKeyLength;
+	}
+
+	FILETIME CKeySnapshot::LastWriteTime() const
+	{
+		return m_lastWriteTime;
+	}
+}
@@ -0,0 +1,103 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <vector>
+#include <string>
+#include <string_view>
+#include "RegBackend.h"
+#include "RegValue.h"
+
+namespace w32
+{
+	/// <summary>
+	/// All values of a registry key (name, type and data), captured in a single sweep.
+	/// Reading a key value by value costs several round trips per value: one to list the
+	/// names, one to get the type and one or two to get the data. A snapshot costs one
+	/// QueryInfoKey for the whole key and one EnumValue per value.
+	///
+	/// The contents are stored as a struct of arrays: all names are packed in one
+	/// character buffer and all data in one byte buffer, with parallel arrays of offsets,
+	/// lengths and types. Names and string data are handed out as views into those
+	/// buffers, so they remain valid for as long as the snapshot exists.
+	///
+	/// The snapshot is a copy. Later changes to the key are not reflected in it.
+	/// </summary>
+	class CKeySnapshot
+	{
+		std::vector<wchar_t> m_names;       //all names, each 0 terminated
+		std::vector<BYTE> m_data;           //all data, each entry aligned
+		std::vector<DWORD> m_nameOffsets;
+		std::vector<DWORD> m_nameLengths;
+		std::vector<DWORD> m_types;
+		std::vector<DWORD> m_dataOffsets;
+		std::vector<DWORD> m_dataSizes;
+		DWORD m_numSubKeys = 0;
+		DWORD m_maxSubKeyLength = 0;
+		FILETIME m_lastWriteTime = {};
+
+	public:
+		static const size_t npos = (size_t)-1;
+
+		//Read all values of an open key. Throws on failure.
+		static CKeySnapshot Capture(IRegBackend* backend, HKEY key);
+
+		//Same, but into this snapshot, replacing what it held. The buffers are reused, so
+		//reading key after key into one snapshot stops allocating once they are big enough.
+		void Recapture(IRegBackend* backend, HKEY key);
+
+		//Only the subkey count and last write time of a key, without the values. That is a
+		//single QueryInfoKey, for when only the structure or the age of a tree matters.
+		static CKeySnapshot CaptureInfo(IRegBackend* backend, HKEY key);
+
+		//Number of values
+		size_t Count() const;
+
+		//Name of the value at a given index. The default value has an empty name.
+		std::wstring_view Name(size_t index) const;
+
+		//Registry data type (REG_SZ, REG_DWORD, ...) of the value at a given index
+		DWORD Type(size_t index) const;
+
+		//Raw data of the value at a given index
+		const BYTE* Data(size_t index) const;
+		DWORD DataSize(size_t index) const;
+
+		//Data of a REG_SZ or REG_EXPAND_SZ value, without terminator.
+		//Throws if the value has a different type.
+		std::wstring_view WSValue(size_t index) const;
+
+		//Data of a REG_DWORD value. Throws if the value has a different type.
+		DWORD DWValue(size_t index) const;
+
+		//Typed view of the value at a given index
+		CRegValue Value(size_t index) const;
+
+		//Hand every value to a visitor, in enumeration order
+		void Visit(IValueVisitor& visitor) const;
+
+		//Index of a value with a given name (case insensitive), or npos if there is none
+		size_t Find(std::wstring_view name) const;
+
+		//Number of subkeys and length of the longest subkey name at the time of capture
+		DWORD NumSubKeys() const;
+		DWORD MaxSubKeyLength() const;
+
+		//Last time the key was written to
+		FILETIME LastWriteTime() const;
+	};
+}
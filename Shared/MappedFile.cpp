@@ -0,0 +1,109 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "MappedFile.h"
+#include "Exception.h"
+#ifndef _WIN32
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace w32
+{
+#ifdef _WIN32
+
+    CMappedFile::CMappedFile(const std::wstring& path)
+    {
+        m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (!m_file.IsValid())
+            throw ExWin32Error(L"Cannot open " + path);
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(m_file, &size))
+            throw ExWin32Error(L"Cannot get the size of " + path);
+        m_size = (size_t)size.QuadPart;
+
+        //An empty file cannot be mapped, but it is not an error either
+        if (m_size == 0)
+            return;
+
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!m_mapping.IsValid())
+            throw ExWin32Error(L"Cannot map " + path);
+
+        m_data = static_cast<const BYTE*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_data == NULL)
+            throw ExWin32Error(L"Cannot map a view of " + path);
+    }
+
+    CMappedFile::~CMappedFile()
+    {
+        if (m_data)
+            UnmapViewOfFile(m_data);
+    }
+
+#else
+
+    CMappedFile::CMappedFile(const std::wstring& path)
+    {
+        std::string narrowPath = std::filesystem::path(path).string();
+        int file = open(narrowPath.c_str(), O_RDONLY);
+        if (file < 0)
+            throw AppException("Cannot open " + narrowPath);
+
+        struct stat info;
+        if (fstat(file, &info) != 0) {
+            close(file);
+            throw AppException("Cannot get the size of " + narrowPath);
+        }
+        m_size = (size_t)info.st_size;
+
+        if (m_size > 0) {
+            void* data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (data == MAP_FAILED) {
+                close(file);
+                throw AppException("Cannot map " + narrowPath);
+            }
+            m_data = static_cast<const BYTE*>(data);
+        }
+
+        //the mapping stays valid after the descriptor is closed
+        close(file);
+    }
+
+    CMappedFile::~CMappedFile()
+    {
+        if (m_data)
+            munmap(const_cast<BYTE*>(m_data), m_size);
+    }
+
+#endif
+
+    const BYTE* CMappedFile::Data() const
+    {
+        return m_data;
+    }
+
+    size_t CMappedFile::Size() const
+    {
+        return m_size;
+    }
+}
@@ -0,0 +1,55 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <WinBase.h>
+#include <string>
+#ifdef _WIN32
+#include "Handle.h"
+#endif
+
+namespace w32
+{
+    /// <summary>
+    /// Read-only view of an entire file, mapped into memory.
+    /// The contents can be accessed directly without copying for as long as
+    /// the object exists.
+    /// </summary>
+    class CMappedFile
+    {
+        const BYTE* m_data = NULL;
+        size_t m_size = 0;
+#ifdef _WIN32
+        CHandle m_file;
+        CHandle m_mapping;
+#endif
+
+    public:
+        //Map the file. Throws if the file cannot be opened or mapped.
+        CMappedFile(const std::wstring& path);
+        ~CMappedFile();
+
+        CMappedFile(const CMappedFile&) = delete;
+        CMappedFile& operator = (const CMappedFile&) = delete;
+
+        //Start of the file contents. NULL for an empty file.
+        const BYTE* Data() const;
+
+        //Size of the file in bytes
+        size_t Size() const;
+    };
+}
@@ -0,0 +1,745 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "MemRegBackend.h"
+#include "StringHelper.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace w32
+{
+	//A named value, stored in the arena together with its key
+	struct CMemRegBackend::CValue
+	{
+		pmr::wstring Name;
+		DWORD Type = REG_NONE;
+		pmr::vector<BYTE> Data;
+
+		CValue(pmr::memory_resource* arena) : Name(arena), Data(arena) {}
+	};
+
+	//A single key
+	struct CMemRegBackend::CNode
+	{
+		pmr::wstring Name;
+		CNode* Parent;
+		pmr::vector<CNode*> SubKeys;    //sorted without regard to case, like the real registry
+		pmr::vector<CValue> Values;     //in order of creation, like the real registry
+		unsigned long long LastWrite = 0;
+		bool Deleted = false;
+
+		CNode(pmr::memory_resource* arena, CNode* parent, wstring_view name) :
+			Name(name, arena), Parent(parent), SubKeys(arena), Values(arena) {}
+	};
+
+	//Everything that is needed to undo the changes made under a transaction.
+	//This lives on the regular heap because it is short lived.
+	struct CMemRegBackend::CTransactionLog
+	{
+		enum class EKind { CREATE_KEY, DELETE_KEY, VALUE };
+
+		struct CEntry
+		{
+			EKind Kind;
+			CNode* Node;
+			unsigned long long LastWrite;   //previous time of the key that changed: the parent
+			                                //for CREATE_KEY and DELETE_KEY, Node for VALUE
+			CNode* Parent = NULL;       //DELETE_KEY: where to reattach
+			wstring Name;               //VALUE: name of the value
+			bool Existed = false;       //VALUE: was there a previous value?
+			size_t Position = 0;        //VALUE: where the previous value was
+			DWORD Type = REG_NONE;      //VALUE: previous type
+			vector<BYTE> Data;          //VALUE: previous data
+		};
+
+		vector<CEntry> Entries;
+		bool Active = true;
+
+		//the transaction handle and every key handle opened under it hold a reference
+		atomic<int> References = 1;
+
+		void Release() {
+			if (--References == 0)
+				delete this;
+		}
+	};
+
+	//What a HKEY from this backend points to
+	struct CMemRegBackend::CKeyHandle
+	{
+		static const DWORD MAGIC = 0x4D454D4B; //'MEMK'
+		DWORD Magic = MAGIC;
+		CNode* Node;
+		CTransactionLog* Transaction;
+	};
+
+	namespace
+	{
+		//Split a registry path into its segments, ignoring empty ones
+		//so that leading, trailing and double separators are harmless
+		template<class TFunc>
+		bool ForEachSegment(LPCWSTR path, TFunc func)
+		{
+			if (path == NULL)
+				return true;
+			wstring_view remaining(path);
+			while (!remaining.empty()) {
+				size_t separator = remaining.find(L'\\');
+				wstring_view segment = remaining.substr(0, separator);
+				if (!segment.empty() && !func(segment))
+					return false;
+				if (separator == wstring_view::npos)
+					break;
+				remaining.remove_prefix(separator + 1);
+			}
+			return true;
+		}
+
+		FILETIME ToFileTime(unsigned long long value)
+		{
+			FILETIME time;
+			time.dwLowDateTime = (DWORD)(value & 0xFFFFFFFF);
+			time.dwHighDateTime = (DWORD)(value >> 32);
+			return time;
+		}
+
+		CMemRegBackend::CTransactionLog* ToLog(HANDLE transaction)
+		{
+			if (!IsTransaction(transaction))
+				return NULL;
+			return static_cast<CMemRegBackend::CTransactionLog*>(transaction);
+		}
+	}
+
+	CMemRegBackend::CMemRegBackend()
+	{
+		m_roots[0] = NewNode(NULL, L"HKLM");
+		m_roots[1] = NewNode(NULL, L"HKCU");
+		m_roots[2] = NewNode(NULL, L"HKU");
+		m_roots[3] = NewNode(NULL, L"HKCC");
+		m_roots[4] = NewNode(NULL, L"HKCULS");
+
+		//HKCR is a view on the machine wide class registrations
+		CNode* software = NewNode(m_roots[0], L"SOFTWARE");
+		AttachChild(m_roots[0], software);
+		m_roots[5] = NewNode(software, L"Classes");
+		AttachChild(software, m_roots[5]);
+	}
+
+	//All keys, names and values are released together with the arena.
+	CMemRegBackend::~CMemRegBackend() {}
+
+	CMemRegBackend::CNode* CMemRegBackend::NewNode(CNode* parent, wstring_view name)
+	{
+		void* memory = m_arena.allocate(sizeof(CNode), alignof(CNode));
+		CNode* node = new (memory) CNode(&m_arena, parent, name);
+		node->LastWrite = ++m_clock;
+		return node;
+	}
+
+	CMemRegBackend::CNode* CMemRegBackend::RootFor(HKEY key)
+	{
+		if (key == HKEY_LOCAL_MACHINE) return m_roots[0];
+		if (key == HKEY_CURRENT_USER) return m_roots[1];
+		if (key == HKEY_USERS) return m_roots[2];
+		if (key == HKEY_CURRENT_CONFIG) return m_roots[3];
+		if (key == HKEY_CURRENT_USER_LOCAL_SETTINGS) return m_roots[4];
+		if (key == HKEY_CLASSES_ROOT) return m_roots[5];
+		return NULL;
+	}
+
+	//Translate a HKEY into a key. Returns NULL for handles that are not ours.
+	CMemRegBackend::CNode* CMemRegBackend::Resolve(HKEY key, CTransactionLog** transaction)
+	{
+		if (transaction)
+			*transaction = NULL;
+		if (key == NULL)
+			return NULL;
+
+		CNode* root = RootFor(key);
+		if (root)
+			return root;
+
+		CKeyHandle* handle = reinterpret_cast<CKeyHandle*>(key);
+		if (handle->Magic != CKeyHandle::MAGIC)
+			return NULL;
+		if (transaction)
+			*transaction = handle->Transaction;
+		return handle->Node;
+	}
+
+	//Binary search for a child key. position receives the place where a key
+	//with that name belongs, whether it exists or not.
+	CMemRegBackend::CNode* CMemRegBackend::FindChild(CNode* parent, wstring_view name, size_t* position)
+	{
+		auto it = lower_bound(parent->SubKeys.begin(), parent->SubKeys.end(), name,
+			[](CNode* node, wstring_view value) {
+				return CompareNoCase(node->Name, value) < 0;
+			});
+		if (position)
+			*position = it - parent->SubKeys.begin();
+		if (it != parent->SubKeys.end() && CompareNoCase((*it)->Name, name) == 0)
+			return *it;
+		return NULL;
+	}
+
+	void CMemRegBackend::AttachChild(CNode* parent, CNode* child)
+	{
+		size_t position = 0;
+		FindChild(parent, child->Name, &position);
+		parent->SubKeys.insert(parent->SubKeys.begin() + position, child);
+		child->Parent = parent;
+		Touch(parent);
+	}
+
+	void CMemRegBackend::DetachChild(CNode* child)
+	{
+		CNode* parent = child->Parent;
+		auto& siblings = parent->SubKeys;
+		siblings.erase(remove(siblings.begin(), siblings.end(), child), siblings.end());
+		Touch(parent);
+	}
+
+	//Flag a key and everything below it. Handles to flagged keys stop working.
+	void CMemRegBackend::MarkDeleted(CNode* node, bool deleted)
+	{
+		vector<CNode*> pending{ node };
+		while (!pending.empty()) {
+			CNode* current = pending.back();
+			pending.pop_back();
+			current->Deleted = deleted;
+			pending.insert(pending.end(), current->SubKeys.begin(), current->SubKeys.end());
+		}
+	}
+
+	void CMemRegBackend::Touch(CNode* node)
+	{
+		node->LastWrite = ++m_clock;
+	}
+
+	//Revert everything in the log, newest change first. Each entry finds the hive as
+	//that change left it, so values go back to where they were, and last write times to
+	//what they were: a transaction that is rolled back does not look like a change.
+	void CMemRegBackend::Undo(CTransactionLog* log)
+	{
+		for (auto it = log->Entries.rbegin(); it != log->Entries.rend(); ++it) {
+			CTransactionLog::CEntry& entry = *it;
+			switch (entry.Kind)
+			{
+			case CTransactionLog::EKind::CREATE_KEY:
+				DetachChild(entry.Node);
+				MarkDeleted(entry.Node, true);
+				entry.Node->Parent->LastWrite = entry.LastWrite;
+				break;
+			case CTransactionLog::EKind::DELETE_KEY:
+				AttachChild(entry.Parent, entry.Node);
+				MarkDeleted(entry.Node, false);
+				entry.Parent->LastWrite = entry.LastWrite;
+				break;
+			case CTransactionLog::EKind::VALUE: {
+				auto& values = entry.Node->Values;
+				auto value = find_if(values.begin(), values.end(), [&](CValue& v) {
+					return CompareNoCase(v.Name, entry.Name) == 0;
+					});
+				if (entry.Existed) {
+					if (value == values.end()) {
+						value = values.emplace(values.begin() + min(entry.Position, values.size()), &m_arena);
+						value->Name = entry.Name;
+					}
+					value->Type = entry.Type;
+					value->Data.assign(entry.Data.begin(), entry.Data.end());
+				}
+				else if (value != values.end()) {
+					values.erase(value);
+				}
+				entry.Node->LastWrite = entry.LastWrite;
+				break;
+			}
+			}
+		}
+		log->Entries.clear();
+	}
+
+	HKEY CMemRegBackend::NewHandle(CNode* node, CTransactionLog* transaction)
+	{
+		CKeyHandle* handle = new CKeyHandle();
+		handle->Node = node;
+		handle->Transaction = transaction;
+		if (transaction)
+			transaction->References++;
+		return reinterpret_cast<HKEY>(handle);
+	}
+
+	size_t CMemRegBackend::KeyCount()
+	{
+		shared_lock<shared_mutex> lock(m_lock);
+		size_t count = 0;
+		vector<CNode*> pending(m_roots, m_roots + 5);
+		while (!pending.empty()) {
+			CNode* current = pending.back();
+			pending.pop_back();
+			count++;
+			pending.insert(pending.end(), current->SubKeys.begin(), current->SubKeys.end());
+		}
+		return count;
+	}
+
+	LSTATUS CMemRegBackend::OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		if (result == NULL)
+			return ERROR_INVALID_PARAMETER;
+
+		shared_lock<shared_mutex> lock(m_lock);
+		CTransactionLog* parentTransaction = NULL;
+		CNode* node = Resolve(parent, &parentTransaction);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+
+		bool found = ForEachSegment(subKey, [&](wstring_view segment) {
+			node = FindChild(node, segment, NULL);
+			return node != NULL;
+			});
+		if (!found)
+			return ERROR_FILE_NOT_FOUND;
+
+		CTransactionLog* log = ToLog(transaction);
+		*result = NewHandle(node, log ? log : parentTransaction);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		if (result == NULL)
+			return ERROR_INVALID_PARAMETER;
+
+		unique_lock<shared_mutex> lock(m_lock);
+		CTransactionLog* parentTransaction = NULL;
+		CNode* node = Resolve(parent, &parentTransaction);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+
+		CTransactionLog* log = ToLog(transaction);
+		if (log == NULL)
+			log = parentTransaction;
+		if (log && !log->Active)
+			return ERROR_TRANSACTION_NOT_ACTIVE;
+
+		ForEachSegment(subKey, [&](wstring_view segment) {
+			size_t position = 0;
+			CNode* child = FindChild(node, segment, &position);
+			if (child == NULL) {
+				child = NewNode(node, segment);
+				node->SubKeys.insert(node->SubKeys.begin() + position, child);
+				if (log)
+					log->Entries.push_back({ CTransactionLog::EKind::CREATE_KEY, child, node->LastWrite });
+				Touch(node);
+			}
+			node = child;
+			return true;
+			});
+
+		*result = NewHandle(node, log);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::CloseKey(HKEY key)
+	{
+		if (RootFor(key))
+			return ERROR_SUCCESS;
+		CKeyHandle* handle = reinterpret_cast<CKeyHandle*>(key);
+		if (handle == NULL || handle->Magic != CKeyHandle::MAGIC)
+			return ERROR_INVALID_HANDLE;
+		handle->Magic = 0;
+		if (handle->Transaction)
+			handle->Transaction->Release();
+		delete handle;
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::QueryInfoKey(HKEY key,
+		DWORD* numSubKeys, DWORD* maxSubKeyLength,
+		DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+		FILETIME* lastWriteTime)
+	{
+		shared_lock<shared_mutex> lock(m_lock);
+		CNode* node = Resolve(key, NULL);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+
+		if (numSubKeys)
+			*numSubKeys = (DWORD)node->SubKeys.size();
+		if (maxSubKeyLength) {
+			size_t maxLength = 0;
+			for (CNode* child : node->SubKeys)
+				maxLength = max(maxLength, child->Name.length());
+			*maxSubKeyLength = (DWORD)maxLength;
+		}
+		if (numValues)
+			*numValues = (DWORD)node->Values.size();
+		if (maxValueNameLength || maxValueLength) {
+			size_t maxName = 0;
+			size_t maxData = 0;
+			for (CValue& value : node->Values) {
+				maxName = max(maxName, value.Name.length());
+				maxData = max(maxData, value.Data.size());
+			}
+			if (maxValueNameLength)
+				*maxValueNameLength = (DWORD)maxName;
+			if (maxValueLength)
+				*maxValueLength = (DWORD)maxData;
+		}
+		if (lastWriteTime)
+			*lastWriteTime = ToFileTime(node->LastWrite);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength)
+	{
+		if (nameLength == NULL)
+			return ERROR_INVALID_PARAMETER;
+
+		shared_lock<shared_mutex> lock(m_lock);
+		CNode* node = Resolve(key, NULL);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+		if (index >= node->SubKeys.size())
+			return ERROR_NO_MORE_ITEMS;
+
+		const pmr::wstring& childName = node->SubKeys[index]->Name;
+		if (name == NULL || *nameLength <= childName.length()) {
+			*nameLength = (DWORD)childName.length();
+			return ERROR_MORE_DATA;
+		}
+		wmemcpy(name, childName.data(), childName.length());
+		name[childName.length()] = L'\0';
+		*nameLength = (DWORD)childName.length();
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+		DWORD* type, LPBYTE data, DWORD* dataLength)
+	{
+		if (nameLength == NULL)
+			return ERROR_INVALID_PARAMETER;
+
+		shared_lock<shared_mutex> lock(m_lock);
+		CNode* node = Resolve(key, NULL);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+		if (index >= node->Values.size())
+			return ERROR_NO_MORE_ITEMS;
+
+		CValue& value = node->Values[index];
+		if (name == NULL || *nameLength <= value.Name.length()) {
+			*nameLength = (DWORD)value.Name.length();
+			return ERROR_MORE_DATA;
+		}
+		wmemcpy(name, value.Name.data(), value.Name.length());
+		name[value.Name.length()] = L'\0';
+		*nameLength = (DWORD)value.Name.length();
+
+		if (type)
+			*type = value.Type;
+		if (dataLength) {
+			DWORD available = *dataLength;
+			*dataLength = (DWORD)value.Data.size();
+			if (data) {
+				if (available < value.Data.size())
+					return ERROR_MORE_DATA;
+				if (!value.Data.empty())
+					memcpy(data, value.Data.data(), value.Data.size());
+			}
+		}
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+		LPBYTE data, DWORD* dataLength)
+	{
+		shared_lock<shared_mutex> lock(m_lock);
+		CNode* node = Resolve(key, NULL);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+
+		wstring_view name = valueName ? valueName : L"";
+		for (CValue& value : node->Values) {
+			if (CompareNoCase(value.Name, name) != 0)
+				continue;
+
+			if (type)
+				*type = value.Type;
+			if (dataLength) {
+				DWORD available = *dataLength;
+				*dataLength = (DWORD)value.Data.size();
+				if (data) {
+					if (available < value.Data.size())
+						return ERROR_MORE_DATA;
+					if (!value.Data.empty())
+						memcpy(data, value.Data.data(), value.Data.size());
+				}
+			}
+			return ERROR_SUCCESS;
+		}
+		return ERROR_FILE_NOT_FOUND;
+	}
+
+	LSTATUS CMemRegBackend::SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+		const BYTE* data, DWORD dataLength)
+	{
+		if (data == NULL && dataLength > 0)
+			return ERROR_INVALID_PARAMETER;
+
+		unique_lock<shared_mutex> lock(m_lock);
+		CTransactionLog* log = NULL;
+		CNode* node = Resolve(key, &log);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+		if (log && !log->Active)
+			return ERROR_TRANSACTION_NOT_ACTIVE;
+
+		wstring_view name = valueName ? valueName : L"";
+		auto value = find_if(node->Values.begin(), node->Values.end(), [&](CValue& v) {
+			return CompareNoCase(v.Name, name) == 0;
+			});
+
+		if (log) {
+			CTransactionLog::CEntry entry{ CTransactionLog::EKind::VALUE, node, node->LastWrite };
+			entry.Name = name;
+			if (value != node->Values.end()) {
+				entry.Existed = true;
+				entry.Position = value - node->Values.begin();
+				entry.Type = value->Type;
+				entry.Data.assign(value->Data.begin(), value->Data.end());
+			}
+			log->Entries.push_back(move(entry));
+		}
+
+		if (value == node->Values.end()) {
+			node->Values.emplace_back(&m_arena);
+			value = node->Values.end() - 1;
+			value->Name = name;
+		}
+		value->Type = type;
+		value->Data.assign(data, data + dataLength);
+		Touch(node);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::DeleteValue(HKEY key, LPCWSTR valueName)
+	{
+		unique_lock<shared_mutex> lock(m_lock);
+		CTransactionLog* log = NULL;
+		CNode* node = Resolve(key, &log);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+		if (log && !log->Active)
+			return ERROR_TRANSACTION_NOT_ACTIVE;
+
+		wstring_view name = valueName ? valueName : L"";
+		auto value = find_if(node->Values.begin(), node->Values.end(), [&](CValue& v) {
+			return CompareNoCase(v.Name, name) == 0;
+			});
+		if (value == node->Values.end())
+			return ERROR_FILE_NOT_FOUND;
+
+		if (log) {
+			CTransactionLog::CEntry entry{ CTransactionLog::EKind::VALUE, node, node->LastWrite };
+			entry.Name = name;
+			entry.Existed = true;
+			entry.Position = value - node->Values.begin();
+			entry.Type = value->Type;
+			entry.Data.assign(value->Data.begin(), value->Data.end());
+			log->Entries.push_back(move(entry));
+		}
+
+		node->Values.erase(value);
+		Touch(node);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction)
+	{
+		unique_lock<shared_mutex> lock(m_lock);
+		CTransactionLog* log = NULL;
+		CNode* node = Resolve(parent, &log);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+		if (ToLog(transaction))
+			log = ToLog(transaction);
+		if (log && !log->Active)
+			return ERROR_TRANSACTION_NOT_ACTIVE;
+
+		bool found = ForEachSegment(subKey, [&](wstring_view segment) {
+			node = FindChild(node, segment, NULL);
+			return node != NULL;
+			});
+		if (!found)
+			return ERROR_FILE_NOT_FOUND;
+
+		//Roots cannot be deleted, and keys with children need DeleteTree
+		if (node->Parent == NULL || node == m_roots[5])
+			return ERROR_ACCESS_DENIED;
+		if (!node->SubKeys.empty())
+			return ERROR_ACCESS_DENIED;
+
+		CNode* parentNode = node->Parent;
+		if (log) {
+			CTransactionLog::CEntry entry{ CTransactionLog::EKind::DELETE_KEY, node, parentNode->LastWrite };
+			entry.Parent = parentNode;
+			log->Entries.push_back(move(entry));
+		}
+		DetachChild(node);
+		MarkDeleted(node, true);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::DeleteTree(HKEY key, LPCWSTR subKey)
+	{
+		unique_lock<shared_mutex> lock(m_lock);
+		CTransactionLog* log = NULL;
+		CNode* node = Resolve(key, &log);
+		if (node == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (node->Deleted)
+			return ERROR_KEY_DELETED;
+		if (log && !log->Active)
+			return ERROR_TRANSACTION_NOT_ACTIVE;
+
+		bool found = ForEachSegment(subKey, [&](wstring_view segment) {
+			node = FindChild(node, segment, NULL);
+			return node != NULL;
+			});
+		if (!found)
+			return ERROR_FILE_NOT_FOUND;
+
+		bool deleteSelf = (subKey != NULL && *subKey != L'\0');
+		if (deleteSelf && (node->Parent == NULL || node == m_roots[5]))
+			return ERROR_ACCESS_DENIED;
+
+		//Detaching the top of a subtree is enough to make it disappear
+		vector<CNode*> detach;
+		if (deleteSelf)
+			detach.push_back(node);
+		else
+			detach.assign(node->SubKeys.begin(), node->SubKeys.end());
+
+		for (CNode* child : detach) {
+			CNode* parentNode = child->Parent;
+			if (log) {
+				CTransactionLog::CEntry entry{ CTransactionLog::EKind::DELETE_KEY, child, parentNode->LastWrite };
+				entry.Parent = parentNode;
+				log->Entries.push_back(move(entry));
+			}
+			DetachChild(child);
+			MarkDeleted(child, true);
+		}
+
+		//Without a subkey, the values of the key itself are deleted too
+		if (!deleteSelf) {
+			if (log) {
+				//logged as if deleted from the last one, so Undo puts them back in order
+				for (size_t i = node->Values.size(); i-- > 0;) {
+					CValue& value = node->Values[i];
+					CTransactionLog::CEntry entry{ CTransactionLog::EKind::VALUE, node, node->LastWrite };
+					entry.Name = value.Name;
+					entry.Existed = true;
+					entry.Position = i;
+					entry.Type = value.Type;
+					entry.Data.assign(value.Data.begin(), value.Data.end());
+					log->Entries.push_back(move(entry));
+				}
+			}
+			node->Values.clear();
+			Touch(node);
+		}
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::CreateTransaction(HANDLE* transaction)
+	{
+		if (transaction == NULL)
+			return ERROR_INVALID_PARAMETER;
+		*transaction = static_cast<HANDLE>(new CTransactionLog());
+		return ERROR_SUCCESS;
+	}
+
+	//Committing is nothing more than forgetting how to undo
+	LSTATUS CMemRegBackend::CommitTransaction(HANDLE transaction)
+	{
+		CTransactionLog* log = ToLog(transaction);
+		if (log == NULL)
+			return ERROR_INVALID_HANDLE;
+
+		unique_lock<shared_mutex> lock(m_lock);
+		if (!log->Active)
+			return ERROR_TRANSACTION_NOT_ACTIVE;
+		log->Entries.clear();
+		log->Active = false;
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CMemRegBackend::RollbackTransaction(HANDLE transaction)
+	{
+		CTransactionLog* log = ToLog(transaction);
+		if (log == NULL)
+			return ERROR_INVALID_HANDLE;
+
+		unique_lock<shared_mutex> lock(m_lock);
+		if (!log->Active)
+			return ERROR_TRANSACTION_NOT_ACTIVE;
+		Undo(log);
+		log->Active = false;
+		return ERROR_SUCCESS;
+	}
+
+	//Keys that were opened under the transaction keep it alive, but they can
+	//no longer be used for writing once it was committed or rolled back
+	LSTATUS CMemRegBackend::CloseTransaction(HANDLE transaction)
+	{
+		CTransactionLog* log = ToLog(transaction);
+		if (log == NULL)
+			return ERROR_INVALID_HANDLE;
+		log->Release();
+		return ERROR_SUCCESS;
+	}
+}
@@ -0,0 +1,102 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include "RegBackend.h"
+#include <memory_resource>
+#include <shared_mutex>
+#include <string_view>
+
+namespace w32
+{
+	/// <summary>
+	/// A registry hive that lives entirely in memory. It does not use any Win32 API, so it
+	/// can be used to exercise CHKey based code deterministically and without touching the
+	/// real registry, or on platforms that have no registry at all.
+	///
+	/// Keys, names and value data are allocated from a monotonic arena that is released in
+	/// one go when the hive is destroyed. Deleted keys are unlinked but their memory is not
+	/// reclaimed until then, which is what makes rolling back a deletion cheap.
+	///
+	/// There is one root key for each predefined key. HKEY_CLASSES_ROOT is an alias for
+	/// HKLM\SOFTWARE\Classes, because that is where the registrations that we care about
+	/// end up on a real system.
+	///
+	/// Readers can run concurrently. Writers are serialized. Transactions are atomic
+	/// (they can be rolled back as a whole) but not isolated: changes are immediately
+	/// visible to everyone. A rollback also restores the order of the values and the
+	/// last write times of the keys.
+	/// </summary>
+	class CMemRegBackend : public IRegBackend
+	{
+	public:
+		struct CNode;
+		struct CValue;
+		struct CTransactionLog;
+		struct CKeyHandle;
+
+	private:
+		std::pmr::monotonic_buffer_resource m_arena;
+		mutable std::shared_mutex m_lock;
+		CNode* m_roots[6] = {};
+		unsigned long long m_clock = 0;
+
+		CNode* NewNode(CNode* parent, std::wstring_view name);
+		CNode* RootFor(HKEY key);
+		CNode* Resolve(HKEY key, CTransactionLog** transaction);
+		CNode* FindChild(CNode* parent, std::wstring_view name, size_t* position);
+		void AttachChild(CNode* parent, CNode* child);
+		void DetachChild(CNode* child);
+		void MarkDeleted(CNode* node, bool deleted);
+		void Touch(CNode* node);
+		void Undo(CTransactionLog* log);
+		HKEY NewHandle(CNode* node, CTransactionLog* transaction);
+
+	public:
+		CMemRegBackend();
+		~CMemRegBackend();
+
+		CMemRegBackend(const CMemRegBackend&) = delete;
+		CMemRegBackend& operator = (const CMemRegBackend&) = delete;
+
+		//Number of keys in the hive, for reporting purposes
+		size_t KeyCount();
+
+		LSTATUS OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) override;
+		LSTATUS CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) override;
+		LSTATUS CloseKey(HKEY key) override;
+		LSTATUS QueryInfoKey(HKEY key,
+			DWORD* numSubKeys, DWORD* maxSubKeyLength,
+			DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+			FILETIME* lastWriteTime) override;
+		LSTATUS EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength) override;
+		LSTATUS EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+			DWORD* type, LPBYTE data, DWORD* dataLength) override;
+		LSTATUS QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+			LPBYTE data, DWORD* dataLength) override;
+		LSTATUS SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+			const BYTE* data, DWORD dataLength) override;
+		LSTATUS DeleteValue(HKEY key, LPCWSTR valueName) override;
+		LSTATUS DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction) override;
+		LSTATUS DeleteTree(HKEY key, LPCWSTR subKey) override;
+		LSTATUS CreateTransaction(HANDLE* transaction) override;
+		LSTATUS CommitTransaction(HANDLE transaction) override;
+		LSTATUS RollbackTransaction(HANDLE transaction) override;
+		LSTATUS CloseTransaction(HANDLE transaction) override;
+	};
+}
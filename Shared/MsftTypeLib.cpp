@@ -0,0 +1,317 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "MsftTypeLib.h"
+#include "Exception.h"
+#include <cstring>
+
+namespace w32
+{
+    //Layout of the file, as far as it is used here. All values are little endian.
+    //Header:
+    static const DWORD MsftMagic = 0x5446534D;      //"MSFT"
+    static const size_t HeaderGuid = 0x08;          //offset of the library in the GUID table
+    static const size_t HeaderLcid = 0x0C;
+    static const size_t HeaderVarFlags = 0x14;      //low nibble is the SYSKIND
+    static const size_t HeaderVersion = 0x18;       //major in the low word, minor in the high word
+    static const size_t HeaderFlags = 0x1C;         //LIBFLAGS
+    static const size_t HeaderTypeCount = 0x20;
+    static const size_t HeaderDocString = 0x24;     //offset in the string table
+    static const size_t HeaderName = 0x38;          //offset in the name table
+    static const size_t HeaderSize = 0x54;
+    static const DWORD HelpDllFlag = 0x100;         //in the var flags: a DWORD follows the header
+
+    //The segment directory follows the type info offsets. Each entry is offset, length
+    //and two reserved DWORDs, in this order.
+    static const size_t SegmentEntrySize = 16;
+    static const size_t SegmentCount = 15;
+    static const size_t SegmentTypeInfos = 0;
+    static const size_t SegmentGuids = 5;
+    static const size_t SegmentNames = 7;
+    static const size_t SegmentStrings = 8;
+    static const size_t SegmentTypeDescs = 9;
+    static const size_t SegmentArrayDescs = 10;
+    static const size_t SegmentCustData = 11;
+
+    //Type info record
+    static const size_t TypeRecordSize = 0x64;
+    static const size_t RecordKind = 0x00;          //low nibble is the TYPEKIND
+    static const size_t RecordGuid = 0x2C;
+    static const size_t RecordFlags = 0x30;
+    static const size_t RecordName = 0x34;
+    static const size_t RecordVersion = 0x38;
+
+    //GUID table entries are the GUID followed by two DWORDs
+    //Name table entries are three DWORDs, the low byte of the last one being the
+    //length, followed by the characters
+    static const size_t NameIntroSize = 12;
+
+    bool CMsftTypeLib::IsMsft(const BYTE* data, size_t size)
+    {
+        if (size < HeaderSize)
+            return false;
+        DWORD magic;
+        memcpy(&magic, data, sizeof(magic));
+        return magic == MsftMagic;
+    }
+
+    std::unique_ptr<CMsftTypeLib> CMsftTypeLib::TryOpen(const std::wstring& path)
+    {
+        auto file = std::make_unique<CMappedFile>(path);
+        if (!IsMsft(file->Data(), file->Size()))
+            return NULL;
+        return std::unique_ptr<CMsftTypeLib>(new CMsftTypeLib(std::move(file)));
+    }
+
+    CMsftTypeLib::CMsftTypeLib(std::unique_ptr<CMappedFile> file) :
+        m_file(std::move(file))
+    {
+        m_data = m_file->Data();
+        m_size = m_file->Size();
+
+        m_typeCount = ReadDWord(HeaderTypeCount);
+        size_t directory = HeaderSize + (size_t)m_typeCount * sizeof(DWORD);
+        if (ReadDWord(HeaderVarFlags) & HelpDllFlag)
+            directory += sizeof(DWORD);
+
+        //make sure the whole directory is there before picking segments from it
+        At(directory, SegmentCount * SegmentEntrySize);
+        auto segment = [&](size_t index) {
+            CSegment result;
+            result.offset = ReadDWord(directory + index * SegmentEntrySize);
+            result.length = ReadDWord(directory + index * SegmentEntrySize + sizeof(DWORD));
+            //unused segments have an offset of -1
+            if (result.offset == 0xFFFFFFFF)
+                result = CSegment();
+            At(result.offset, result.length);
+            return result;
+        };
+        m_typeInfos = segment(SegmentTypeInfos);
+        m_guids = segment(SegmentGuids);
+        m_names = segment(SegmentNames);
+        m_strings = segment(SegmentStrings);
+        m_typeDescs = segment(SegmentTypeDescs);
+        m_arrayDescs = segment(SegmentArrayDescs);
+        m_custData = segment(SegmentCustData);
+
+        if ((size_t)m_typeCount * TypeRecordSize > m_typeInfos.length)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"The type info table of the type library is truncated");
+
+        //the kind decides how the rest of a record is read
+        for (size_t i = 0; i < m_typeCount; i++) {
+            DWORD kind;
+            memcpy(&kind, m_data + m_typeInfos.offset + i * TypeRecordSize + RecordKind, sizeof(kind));
+            if ((kind & 0x0F) >= TKIND_MAX)
+                throw ExWin32Error(ERROR_BAD_FORMAT, L"The type library has a type of an unknown kind");
+        }
+    }
+
+    //Pointer to a range of the file, after checking that it is inside the file
+    const BYTE* CMsftTypeLib::At(size_t offset, size_t length) const
+    {
+        if (offset > m_size || length > m_size - offset)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"The type library refers to data beyond the end of the file");
+        return m_data + offset;
+    }
+
+    DWORD CMsftTypeLib::ReadDWord(size_t offset) const
+    {
+        DWORD value;
+        memcpy(&value, At(offset, sizeof(value)), sizeof(value));
+        return value;
+    }
+
+    const BYTE* CMsftTypeLib::TypeRecord(size_t index) const
+    {
+        if (index >= m_typeCount)
+            throw ExWin32Error(ERROR_INVALID_PARAMETER, L"Type index out of range");
+        return At(m_typeInfos.offset + index * TypeRecordSize, TypeRecordSize);
+    }
+
+    //Offsets within a segment are -1 for 'none'
+    GUID CMsftTypeLib::ReadGuid(int offset) const
+    {
+        GUID guid = {};
+        if (offset < 0)
+            return guid;
+        if ((size_t)offset + sizeof(GUID) > m_guids.length)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"The type library refers to a GUID outside its GUID table");
+        memcpy(&guid, At(m_guids.offset + offset, sizeof(GUID)), sizeof(GUID));
+        return guid;
+    }
+
+    //Names are a fixed intro followed by the characters
+    std::string_view CMsftTypeLib::NameBytes(int offset) const
+    {
+        if (offset < 0)
+            return std::string_view();
+        if ((size_t)offset + NameIntroSize > m_names.length)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"The type library refers to a name outside its name table");
+
+        size_t length = ReadDWord(m_names.offset + offset + 2 * sizeof(DWORD)) & 0xFF;
+        if ((size_t)offset + NameIntroSize + length > m_names.length)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"A name in the type library is truncated");
+
+        const BYTE* chars = At(m_names.offset + offset + NameIntroSize, length);
+        return std::string_view((const char*)chars, length);
+    }
+
+    //Strings are a WORD length followed by the characters
+    std::string_view CMsftTypeLib::StringBytes(int offset) const
+    {
+        if (offset < 0)
+            return std::string_view();
+        if ((size_t)offset + sizeof(WORD) > m_strings.length)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"The type library refers to a string outside its string table");
+
+        WORD length;
+        memcpy(&length, At(m_strings.offset + offset, sizeof(length)), sizeof(length));
+        if ((size_t)offset + sizeof(WORD) + length > m_strings.length)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"A string in the type library is truncated");
+
+        const BYTE* chars = At(m_strings.offset + offset + sizeof(WORD), length);
+        return std::string_view((const char*)chars, length);
+    }
+
+    //Names and strings are stored in the code page of the library. In practice they are
+    //plain ASCII, and they are widened as Latin-1.
+    std::wstring CMsftTypeLib::ReadName(int offset) const
+    {
+        std::string_view chars = NameBytes(offset);
+        return std::wstring((const BYTE*)chars.data(), (const BYTE*)chars.data() + chars.size());
+    }
+
+    std::wstring CMsftTypeLib::ReadString(int offset) const
+    {
+        std::string_view chars = StringBytes(offset);
+        return std::wstring((const BYTE*)chars.data(), (const BYTE*)chars.data() + chars.size());
+    }
+
+    GUID CMsftTypeLib::Guid() const
+    {
+        return ReadGuid((int)ReadDWord(HeaderGuid));
+    }
+
+    LCID CMsftTypeLib::LocaleID() const
+    {
+        return ReadDWord(HeaderLcid);
+    }
+
+    SYSKIND CMsftTypeLib::SysKind() const
+    {
+        return (SYSKIND)(ReadDWord(HeaderVarFlags) & 0x0F);
+    }
+
+    WORD CMsftTypeLib::MajorVersion() const
+    {
+        return LOWORD(ReadDWord(HeaderVersion));
+    }
+
+    WORD CMsftTypeLib::MinorVersion() const
+    {
+        return HIWORD(ReadDWord(HeaderVersion));
+    }
+
+    WORD CMsftTypeLib::Flags() const
+    {
+        return LOWORD(ReadDWord(HeaderFlags));
+    }
+
+    std::wstring CMsftTypeLib::Name() const
+    {
+        return ReadName((int)ReadDWord(HeaderName));
+    }
+
+    std::wstring CMsftTypeLib::DocString() const
+    {
+        return ReadString((int)ReadDWord(HeaderDocString));
+    }
+
+    size_t CMsftTypeLib::TypeCount() const
+    {
+        return m_typeCount;
+    }
+
+    TYPEKIND CMsftTypeLib::TypeKind(size_t index) const
+    {
+        DWORD kind;
+        memcpy(&kind, TypeRecord(index) + RecordKind, sizeof(kind));
+        return (TYPEKIND)(kind & 0x0F);
+    }
+
+    GUID CMsftTypeLib::TypeGuid(size_t index) const
+    {
+        int offset;
+        memcpy(&offset, TypeRecord(index) + RecordGuid, sizeof(offset));
+        return ReadGuid(offset);
+    }
+
+    CTlbTypeEntry CMsftTypeLib::Type(size_t index) const
+    {
+        const BYTE* record = TypeRecord(index);
+        DWORD flags, version;
+        int name;
+        memcpy(&flags, record + RecordFlags, sizeof(flags));
+        memcpy(&name, record + RecordName, sizeof(name));
+        memcpy(&version, record + RecordVersion, sizeof(version));
+
+        CTlbTypeEntry entry;
+        entry.Kind = TypeKind(index);
+        entry.Guid = TypeGuid(index);
+        entry.Name = ReadName(name);
+        entry.Flags = LOWORD(flags);
+        entry.MajorVersion = LOWORD(version);
+        entry.MinorVersion = HIWORD(version);
+        return entry;
+    }
+
+    void CMsftTypeLib::Fill(CTlbInfo& info) const
+    {
+        info.Guid = Guid();
+        info.MajorVersion = MajorVersion();
+        info.MinorVersion = MinorVersion();
+        info.Flags = Flags();
+        info.LocaleID = LocaleID();
+        info.SysKind = SysKind();
+
+        //only these kinds are registered, see CTypeLibrary.
+        //The constructor checked that the records are inside the file and have a known
+        //kind, so this loop reads them directly and only touches the kind and GUID of each.
+        const BYTE* record = m_data + m_typeInfos.offset;
+        for (size_t i = 0; i < m_typeCount; i++, record += TypeRecordSize) {
+            DWORD kind;
+            int guid;
+            memcpy(&kind, record + RecordKind, sizeof(kind));
+            memcpy(&guid, record + RecordGuid, sizeof(guid));
+
+            switch (kind & 0x0F)
+            {
+            case TKIND_INTERFACE:
+                info.Interfaces.push_back(ReadGuid(guid));
+                break;
+            case TKIND_DISPATCH:
+                info.DispInterfaces.push_back(ReadGuid(guid));
+                break;
+            case TKIND_COCLASS:
+                info.CoClasses.push_back(ReadGuid(guid));
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
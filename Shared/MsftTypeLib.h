@@ -0,0 +1,101 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <ole2.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "MappedFile.h"
+#include "TlbInfo.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Reads a type library file in the MSFT format - the format that MIDL has written
+	/// since 32 bit Windows - directly from a memory mapped file, without OLE.
+	///
+	/// The file starts with a header, followed by the offsets of the type infos and a
+	/// directory of segments: a table with one fixed size record per type info, a GUID
+	/// table, a name table, a string table, type descriptions and several others.
+	/// Records refer to GUIDs, names and strings by their offset in those segments.
+	/// Nothing is decoded up front: every accessor reads the data it needs from the file.
+	///
+	/// Every offset is checked against the size of the file, and a file that does not
+	/// add up is rejected with ERROR_BAD_FORMAT.
+	/// </summary>
+	class CMsftTypeLib
+	{
+		struct CSegment
+		{
+			DWORD offset = 0;
+			DWORD length = 0;
+		};
+
+		std::unique_ptr<CMappedFile> m_file;
+		const BYTE* m_data;
+		size_t m_size;
+		DWORD m_typeCount = 0;
+		CSegment m_typeInfos;
+		CSegment m_guids;
+		CSegment m_names;
+		CSegment m_strings;
+		CSegment m_typeDescs;
+		CSegment m_arrayDescs;
+		CSegment m_custData;
+
+		//decodes the members of the types, which are only read through it
+		friend class CTypeModel;
+
+		CMsftTypeLib(std::unique_ptr<CMappedFile> file);
+
+		const BYTE* At(size_t offset, size_t length) const;
+		DWORD ReadDWord(size_t offset) const;
+		const BYTE* TypeRecord(size_t index) const;
+		GUID ReadGuid(int offset) const;
+		std::string_view NameBytes(int offset) const;
+		std::string_view StringBytes(int offset) const;
+		std::wstring ReadName(int offset) const;
+		std::wstring ReadString(int offset) const;
+
+	public:
+		//Open a file if it is an MSFT type library. Returns NULL if it is something
+		//else, e.g. an SLTG library or a DLL with a library in its resources. Throws if
+		//the file cannot be read or is an MSFT library that is damaged.
+		static std::unique_ptr<CMsftTypeLib> TryOpen(const std::wstring& path);
+
+		//Does the data start like an MSFT type library
+		static bool IsMsft(const BYTE* data, size_t size);
+
+		GUID Guid() const;
+		LCID LocaleID() const;
+		SYSKIND SysKind() const;
+		WORD MajorVersion() const;
+		WORD MinorVersion() const;
+		WORD Flags() const;                 //LIBFLAGS
+		std::wstring Name() const;
+		std::wstring DocString() const;
+
+		size_t TypeCount() const;
+		TYPEKIND TypeKind(size_t index) const;
+		GUID TypeGuid(size_t index) const;
+		CTlbTypeEntry Type(size_t index) const;
+
+		//Fill in the library attributes and the GUIDs of the coclasses and interfaces,
+		//the same as CTypeLibrary does through ITypeLib
+		void Fill(CTlbInfo& info) const;
+	};
+}
@@ -0,0 +1,126 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "NameIndex.h"
+#include "StringHelper.h"
+
+namespace w32
+{
+    //FNV-1a over the uppercased characters
+    uint32_t CNameIndex::Hash(std::wstring_view name)
+    {
+        uint32_t hash = 2166136261u;
+        for (wchar_t c : name) {
+            hash ^= (uint32_t)ToWUpperChar(c);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    //Find the name, or the empty slot where it would go
+    size_t CNameIndex::Probe(std::wstring_view name, uint32_t hash, size_t* slot) const
+    {
+        size_t mask = m_slots.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            uint32_t entry = m_slots[i];
+            if (entry == 0) {
+                *slot = i;
+                return npos;
+            }
+            entry--;
+            if (m_hashes[entry] == hash && CompareNoCase(Name(entry), name) == 0) {
+                *slot = i;
+                return entry;
+            }
+        }
+    }
+
+    //Double the table, keeping it at most half full
+    void CNameIndex::Grow()
+    {
+        size_t size = m_slots.empty() ? 16 : m_slots.size() * 2;
+        m_slots.assign(size, 0);
+        size_t mask = size - 1;
+        for (size_t entry = 0; entry < m_hashes.size(); entry++) {
+            size_t i = m_hashes[entry] & mask;
+            while (m_slots[i] != 0)
+                i = (i + 1) & mask;
+            m_slots[i] = (uint32_t)(entry + 1);
+        }
+    }
+
+    void CNameIndex::Reserve(size_t count)
+    {
+        m_offsets.reserve(count);
+        m_lengths.reserve(count);
+        m_hashes.reserve(count);
+        while (m_slots.size() < count * 2)
+            Grow();
+    }
+
+    size_t CNameIndex::Add(std::wstring_view name)
+    {
+        if ((m_hashes.size() + 1) * 2 > m_slots.size())
+            Grow();
+
+        uint32_t hash = Hash(name);
+        size_t slot;
+        size_t entry = Probe(name, hash, &slot);
+        if (entry != npos)
+            return entry;
+
+        entry = m_hashes.size();
+        m_offsets.push_back((uint32_t)m_chars.size());
+        m_lengths.push_back((uint32_t)name.length());
+        m_hashes.push_back(hash);
+        m_chars.insert(m_chars.end(), name.begin(), name.end());
+        m_slots[slot] = (uint32_t)(entry + 1);
+        return entry;
+    }
+
+    size_t CNameIndex::Find(std::wstring_view name) const
+    {
+        if (m_hashes.empty())
+            return npos;
+        size_t slot;
+        return Probe(name, Hash(name), &slot);
+    }
+
+    bool CNameIndex::Contains(std::wstring_view name) const
+    {
+        return Find(name) != npos;
+    }
+
+    size_t CNameIndex::Count() const
+    {
+        return m_hashes.size();
+    }
+
+    std::wstring_view CNameIndex::Name(size_t index) const
+    {
+        return std::wstring_view(m_chars.data() + m_offsets[index], m_lengths[index]);
+    }
+
+    void CNameIndex::Clear()
+    {
+        m_chars.clear();
+        m_offsets.clear();
+        m_lengths.clear();
+        m_hashes.clear();
+        m_slots.clear();
+    }
+}
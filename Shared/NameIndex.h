@@ -0,0 +1,72 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace w32
+{
+    /// <summary>
+    /// Set of names that are compared without regard to case, the way the registry
+    /// compares key and value names. Meant for checking many names against a large key,
+    /// e.g. a list of GUIDs against HKCR\CLSID, without going back to the registry or
+    /// scanning a list for every name.
+    ///
+    /// The table is a flat array with open addressing and linear probing. The names are
+    /// packed in one character buffer, and the case folded hash of every name is kept so
+    /// that probing only compares names whose hashes match.
+    /// Names keep their original spelling; each name is stored only once.
+    /// </summary>
+    class CNameIndex
+    {
+        std::vector<wchar_t> m_chars;       //all names, back to back
+        std::vector<uint32_t> m_offsets;
+        std::vector<uint32_t> m_lengths;
+        std::vector<uint32_t> m_hashes;
+        std::vector<uint32_t> m_slots;      //0 is empty, otherwise the name index + 1
+
+        static uint32_t Hash(std::wstring_view name);
+        size_t Probe(std::wstring_view name, uint32_t hash, size_t* slot) const;
+        void Grow();
+
+    public:
+        static const size_t npos = (size_t)-1;
+
+        //Make room for a number of names without growing the table
+        void Reserve(size_t count);
+
+        //Add a name if it is not in the set yet. Returns the index of the name.
+        size_t Add(std::wstring_view name);
+
+        //Index of a name, or npos if it is not in the set
+        size_t Find(std::wstring_view name) const;
+
+        //Is the name in the set
+        bool Contains(std::wstring_view name) const;
+
+        //Number of names
+        size_t Count() const;
+
+        //A name as it was added
+        std::wstring_view Name(size_t index) const;
+
+        //Remove all names
+        void Clear();
+    };
+}
@@ -0,0 +1,264 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "PathTrie.h"
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace w32
+{
+	struct CKeyPath::CNode
+	{
+		CNode* parent;          //holds a reference to the parent
+		std::wstring name;
+		size_t depth;
+		std::atomic<size_t> refs;
+	};
+
+	/// <summary>
+	/// The table of all nodes, indexed by parent and name.
+	/// The table is split in shards by parent, each with its own lock, so that threads
+	/// that open keys below different parents do not wait for each other.
+	/// A reference count only drops to 0, and a node is only found in the table, while
+	/// the lock of the shard of its parent is held. That way a node cannot be found and
+	/// destroyed at the same time.
+	/// </summary>
+	class CPathTrie
+	{
+		struct CSlot
+		{
+			CKeyPath::CNode* parent;
+			std::wstring_view name;     //refers to the name in the node
+
+			bool operator == (const CSlot& other) const {
+				return parent == other.parent && name == other.name;
+			}
+		};
+
+		struct CSlotHash
+		{
+			size_t operator () (const CSlot& slot) const {
+				return std::hash<std::wstring_view>()(slot.name) ^
+					(std::hash<void*>()(slot.parent) * 31);
+			}
+		};
+
+		struct alignas(64) CShard
+		{
+			std::mutex lock;
+			std::unordered_map<CSlot, CKeyPath::CNode*, CSlotHash> table;
+		};
+
+		static const size_t ShardCount = 64;
+		CShard m_shards[ShardCount];
+
+		CShard& ShardOf(CKeyPath::CNode* parent)
+		{
+			//nodes are heap allocated, the low bits of their address are always the same
+			size_t hash = std::hash<void*>()(parent);
+			return m_shards[(hash ^ (hash >> 6) ^ (hash >> 12)) % ShardCount];
+		}
+
+	public:
+		//The node for a segment below a parent, with a reference for the caller
+		CKeyPath::CNode* Intern(CKeyPath::CNode* parent, std::wstring_view name)
+		{
+			CShard& shard = ShardOf(parent);
+			std::lock_guard<std::mutex> guard(shard.lock);
+			auto it = shard.table.find(CSlot{ parent, name });
+			if (it != shard.table.end()) {
+				it->second->refs++;
+				return it->second;
+			}
+
+			CKeyPath::CNode* node = new CKeyPath::CNode{ parent, std::wstring(name),
+				parent ? parent->depth + 1 : 1, 1 };
+			if (parent)
+				parent->refs++;
+			shard.table.emplace(CSlot{ parent, node->name }, node);
+			return node;
+		}
+
+		void AddRef(CKeyPath::CNode* node)
+		{
+			//the caller has a reference, so this never goes up from 0
+			node->refs++;
+		}
+
+		void Release(CKeyPath::CNode* node)
+		{
+			while (node) {
+				//Most releases do not drop the last reference and need no lock
+				size_t refs = node->refs.load();
+				while (refs > 1) {
+					if (node->refs.compare_exchange_weak(refs, refs - 1))
+						return;
+				}
+
+				CKeyPath::CNode* parent = node->parent;
+				{
+					CShard& shard = ShardOf(parent);
+					std::lock_guard<std::mutex> guard(shard.lock);
+					if (--node->refs != 0)
+						return;
+					shard.table.erase(CSlot{ parent, node->name });
+					delete node;
+				}
+				//the node held a reference to its parent
+				node = parent;
+			}
+		}
+
+		size_t Count()
+		{
+			size_t count = 0;
+			for (CShard& shard : m_shards) {
+				std::lock_guard<std::mutex> guard(shard.lock);
+				count += shard.table.size();
+			}
+			return count;
+		}
+	};
+
+	//Deliberately never destroyed, so that paths in static objects can still be
+	//released during process shutdown.
+	static CPathTrie& Trie()
+	{
+		static CPathTrie* trie = new CPathTrie();
+		return *trie;
+	}
+
+	CKeyPath::CKeyPath(CNode* node) : m_node(node) {}
+
+	CKeyPath::CKeyPath(const CKeyPath& other) : m_node(other.m_node)
+	{
+		if (m_node)
+			Trie().AddRef(m_node);
+	}
+
+	CKeyPath::CKeyPath(CKeyPath&& other) noexcept : m_node(other.m_node)
+	{
+		other.m_node = NULL;
+	}
+
+	CKeyPath::~CKeyPath()
+	{
+		if (m_node)
+			Trie().Release(m_node);
+	}
+
+	CKeyPath& CKeyPath::operator = (const CKeyPath& other)
+	{
+		if (other.m_node)
+			Trie().AddRef(other.m_node);
+		if (m_node)
+			Trie().Release(m_node);
+		m_node = other.m_node;
+		return *this;
+	}
+
+	CKeyPath& CKeyPath::operator = (CKeyPath&& other) noexcept
+	{
+		if (this != &other) {
+			if (m_node)
+				Trie().Release(m_node);
+			m_node = other.m_node;
+			other.m_node = NULL;
+		}
+		return *this;
+	}
+
+	CKeyPath CKeyPath::Root(std::wstring_view name)
+	{
+		return CKeyPath(Trie().Intern(NULL, name));
+	}
+
+	CKeyPath CKeyPath::Append(std::wstring_view relPath) const
+	{
+		CPathTrie& trie = Trie();
+		CNode* node = m_node;
+		if (node)
+			trie.AddRef(node);
+
+		//empty segments (leading, trailing or double separators) are skipped
+		size_t start = 0;
+		while (start <= relPath.length()) {
+			size_t end = relPath.find(L'\\', start);
+			if (end == std::wstring_view::npos)
+				end = relPath.length();
+			if (end > start) {
+				CNode* child = trie.Intern(node, relPath.substr(start, end - start));
+				if (node)
+					trie.Release(node);
+				node = child;
+			}
+			start = end + 1;
+		}
+		return CKeyPath(node);
+	}
+
+	bool CKeyPath::IsEmpty() const
+	{
+		return m_node == NULL;
+	}
+
+	size_t CKeyPath::Depth() const
+	{
+		return m_node ? m_node->depth : 0;
+	}
+
+	std::wstring_view CKeyPath::Name() const
+	{
+		return m_node ? std::wstring_view(m_node->name) : std::wstring_view();
+	}
+
+	std::wstring CKeyPath::ToString() const
+	{
+		return ToString(Depth());
+	}
+
+	std::wstring CKeyPath::ToString(size_t lastSegments) const
+	{
+		if (lastSegments > Depth())
+			lastSegments = Depth();
+
+		//measure first, so the string is allocated once
+		size_t length = 0;
+		CNode* node = m_node;
+		for (size_t i = 0; i < lastSegments; i++, node = node->parent)
+			length += node->name.length() + 1;
+		if (length == 0)
+			return std::wstring();
+
+		std::wstring path(length - 1, L'\\');
+		size_t end = path.length();
+		node = m_node;
+		for (size_t i = 0; i < lastSegments; i++, node = node->parent) {
+			end -= node->name.length();
+			path.replace(end, node->name.length(), node->name);
+			end--;      //separator
+		}
+		return path;
+	}
+
+	size_t CKeyPath::NodeCount()
+	{
+		return Trie().Count();
+	}
+}
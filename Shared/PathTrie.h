@@ -0,0 +1,80 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace w32
+{
+	/// <summary>
+	/// A registry path, stored as a node in a process wide trie of path segments.
+	///
+	/// Every distinct path exists only once: a node holds one segment name and refers to
+	/// the node of its parent path. Appending a segment to a path looks up the existing
+	/// node for it, or adds one. Keys that are opened below the same parent therefore
+	/// share everything but their own name, and copying a path is a reference count
+	/// increment. The full string is only built when ToString is called.
+	///
+	/// Nodes are reference counted and removed from the trie when the last path that
+	/// uses them goes away. Segments are compared exactly, so paths that differ only in
+	/// case are different nodes; that keeps the spelling for display purposes.
+	/// Paths can be created, copied and released from multiple threads.
+	/// </summary>
+	class CKeyPath
+	{
+	public:
+		struct CNode;
+
+	private:
+		CNode* m_node = NULL;
+
+		explicit CKeyPath(CNode* node);
+
+	public:
+		CKeyPath() {}
+		CKeyPath(const CKeyPath& other);
+		CKeyPath(CKeyPath&& other) noexcept;
+		~CKeyPath();
+
+		CKeyPath& operator = (const CKeyPath& other);
+		CKeyPath& operator = (CKeyPath&& other) noexcept;
+
+		//A path that consists of one segment, e.g. the name of a predefined key
+		static CKeyPath Root(std::wstring_view name);
+
+		//The path with one or more segments added. relPath may contain separators.
+		CKeyPath Append(std::wstring_view relPath) const;
+
+		//Does the path have any segments?
+		bool IsEmpty() const;
+
+		//Number of segments
+		size_t Depth() const;
+
+		//The last segment
+		std::wstring_view Name() const;
+
+		//The segments joined by separators
+		std::wstring ToString() const;
+
+		//Only the last few segments joined by separators
+		std::wstring ToString(size_t lastSegments) const;
+
+		//Number of distinct paths in use in the process, for reporting purposes
+		static size_t NodeCount();
+	};
+}
@@ -0,0 +1,329 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "Win32Compat.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/////////////////////////////////////////////////////////////
+//Handles and transactions
+/////////////////////////////////////////////////////////////
+
+DWORD GetLastError()
+{
+    return (DWORD)errno;
+}
+
+//The portable build has no kernel objects. Handles only come from the
+//backends, which do not close them here.
+BOOL CloseHandle(HANDLE handle)
+{
+    return handle != NULL && handle != INVALID_HANDLE_VALUE;
+}
+
+HANDLE GetCurrentProcess()
+{
+    return (HANDLE)(intptr_t)-1;
+}
+
+BOOL DuplicateHandle(HANDLE, HANDLE source, HANDLE, HANDLE* target, DWORD, BOOL, DWORD)
+{
+    *target = source;
+    return TRUE;
+}
+
+HANDLE CreateTransaction(void*, void*, DWORD, DWORD, DWORD, DWORD, LPWSTR)
+{
+    errno = ERROR_NOT_SUPPORTED;
+    return INVALID_HANDLE_VALUE;
+}
+
+BOOL CommitTransaction(HANDLE)
+{
+    errno = ERROR_NOT_SUPPORTED;
+    return FALSE;
+}
+
+BOOL RollbackTransaction(HANDLE)
+{
+    errno = ERROR_NOT_SUPPORTED;
+    return FALSE;
+}
+
+/////////////////////////////////////////////////////////////
+//Messages
+/////////////////////////////////////////////////////////////
+
+//There is no message table, so every error is described by its number
+template<class C>
+static DWORD FormatErrorNumber(DWORD flags, DWORD messageId, C* buffer, DWORD size)
+{
+    std::string text = "Error " + std::to_string(messageId);
+    C* target = buffer;
+    if (flags & FORMAT_MESSAGE_ALLOCATE_BUFFER) {
+        target = static_cast<C*>(malloc((text.length() + 1) * sizeof(C)));
+        *reinterpret_cast<C**>(buffer) = target;
+    }
+    else if (size <= text.length()) {
+        return 0;
+    }
+    for (size_t i = 0; i < text.length(); i++)
+        target[i] = (C)text[i];
+    target[text.length()] = 0;
+    return (DWORD)text.length();
+}
+
+DWORD FormatMessageA(DWORD flags, const void*, DWORD messageId, DWORD, LPSTR buffer, DWORD size, void*)
+{
+    return FormatErrorNumber(flags, messageId, buffer, size);
+}
+
+DWORD FormatMessageW(DWORD flags, const void*, DWORD messageId, DWORD, LPWSTR buffer, DWORD size, void*)
+{
+    return FormatErrorNumber(flags, messageId, buffer, size);
+}
+
+void* LocalFree(void* memory)
+{
+    free(memory);
+    return NULL;
+}
+
+/////////////////////////////////////////////////////////////
+//Code pages
+/////////////////////////////////////////////////////////////
+
+//Windows-1252 characters 0x80 to 0x9F; the rest of the code page is Latin-1
+static const wchar_t g_cp1252[32] = {
+    0x20AC, 0x0081, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+    0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008D, 0x017D, 0x008F,
+    0x0090, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+    0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0x009D, 0x017E, 0x0178
+};
+
+static void AppendUtf8(std::string& out, char32_t c)
+{
+    if (c < 0x80) {
+        out += (char)c;
+    }
+    else if (c < 0x800) {
+        out += (char)(0xC0 | (c >> 6));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+    else if (c < 0x10000) {
+        out += (char)(0xE0 | (c >> 12));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+    else {
+        out += (char)(0xF0 | (c >> 18));
+        out += (char)(0x80 | ((c >> 12) & 0x3F));
+        out += (char)(0x80 | ((c >> 6) & 0x3F));
+        out += (char)(0x80 | (c & 0x3F));
+    }
+}
+
+static void AppendAnsi(std::string& out, wchar_t c)
+{
+    if (c < 0x80 || (c >= 0xA0 && c <= 0xFF)) {
+        out += (char)c;
+        return;
+    }
+    for (int i = 0; i < 32; i++) {
+        if (g_cp1252[i] == c) {
+            out += (char)(0x80 + i);
+            return;
+        }
+    }
+    out += '?';
+}
+
+int WideCharToMultiByte(UINT codePage, DWORD, LPCWSTR wide, int wideLength,
+    char* narrow, int narrowSize, const char*, BOOL*)
+{
+    size_t length = wideLength < 0 ? wcslen(wide) + 1 : (size_t)wideLength;
+    std::string out;
+    for (size_t i = 0; i < length; i++) {
+        if (codePage == CP_UTF8)
+            AppendUtf8(out, (char32_t)wide[i]);
+        else
+            AppendAnsi(out, wide[i]);
+    }
+    if (narrow == NULL)
+        return (int)out.length();
+    if (out.length() > (size_t)narrowSize) {
+        errno = ERROR_INSUFFICIENT_BUFFER;
+        return 0;
+    }
+    memcpy(narrow, out.data(), out.length());
+    return (int)out.length();
+}
+
+int MultiByteToWideChar(UINT codePage, DWORD, const char* narrow, int narrowLength,
+    LPWSTR wide, int wideSize)
+{
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(narrow);
+    size_t length = narrowLength < 0 ? strlen(narrow) + 1 : (size_t)narrowLength;
+    std::wstring out;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = in[i];
+        if (codePage != CP_UTF8) {
+            out += (c >= 0x80 && c < 0xA0) ? g_cp1252[c - 0x80] : (wchar_t)c;
+            continue;
+        }
+        int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : c >= 0xC0 ? 1 : 0;
+        char32_t value = extra == 0 ? c : c & (0x3F >> extra);
+        if (c >= 0x80 && extra == 0) {
+            out += (wchar_t)0xFFFD;
+            continue;
+        }
+        bool valid = true;
+        for (int n = 0; n < extra; n++) {
+            if (i + 1 >= length || (in[i + 1] & 0xC0) != 0x80) {
+                valid = false;
+                break;
+            }
+            value = (value << 6) | (in[++i] & 0x3F);
+        }
+        out += valid ? (wchar_t)value : (wchar_t)0xFFFD;
+    }
+    if (wide == NULL)
+        return (int)out.length();
+    if (out.length() > (size_t)wideSize) {
+        errno = ERROR_INSUFFICIENT_BUFFER;
+        return 0;
+    }
+    wmemcpy(wide, out.data(), out.length());
+    return (int)out.length();
+}
+
+//Expands %NAME% from the environment. Names are case sensitive on this platform.
+DWORD ExpandEnvironmentStringsW(LPCWSTR source, LPWSTR destination, DWORD size)
+{
+    std::wstring in(source);
+    std::wstring out;
+    size_t pos = 0;
+    while (pos < in.length()) {
+        size_t start = in.find(L'%', pos);
+        size_t end = start == std::wstring::npos ? std::wstring::npos : in.find(L'%', start + 1);
+        if (end == std::wstring::npos) {
+            out.append(in, pos, std::wstring::npos);
+            break;
+        }
+        out.append(in, pos, start - pos);
+        std::wstring name = in.substr(start + 1, end - start - 1);
+        std::string narrowName(name.begin(), name.end());
+        const char* value = name.empty() ? NULL : getenv(narrowName.c_str());
+        if (value) {
+            int length = MultiByteToWideChar(CP_UTF8, 0, value, -1, NULL, 0);
+            std::wstring wideValue(length, L'\0');
+            MultiByteToWideChar(CP_UTF8, 0, value, -1, wideValue.data(), length);
+            out.append(wideValue.c_str());
+        }
+        else {
+            out.append(in, start, end - start + 1);
+        }
+        pos = end + 1;
+    }
+    if (destination && size > out.length())
+        wcscpy(destination, out.c_str());
+    return (DWORD)out.length() + 1;
+}
+
+/////////////////////////////////////////////////////////////
+//GUIDs
+/////////////////////////////////////////////////////////////
+
+int StringFromGUID2(REFGUID guid, LPWSTR buffer, int size)
+{
+    if (size < 39)
+        return 0;
+    swprintf(buffer, size, L"{%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X}",
+        guid.Data1, guid.Data2, guid.Data3, guid.Data4[0], guid.Data4[1], guid.Data4[2],
+        guid.Data4[3], guid.Data4[4], guid.Data4[5], guid.Data4[6], guid.Data4[7]);
+    return 39;
+}
+
+HRESULT IIDFromString(LPCWSTR text, IID* iid)
+{
+    //{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}
+    static const char pattern[] = "{XXXXXXXX-XXXX-XXXX-XXXX-XXXXXXXXXXXX}";
+    if (text == NULL || wcslen(text) != sizeof(pattern) - 1)
+        return E_INVALIDARG;
+    BYTE bytes[16];
+    int count = 0;
+    for (size_t i = 0; i < sizeof(pattern) - 1; i++) {
+        if (pattern[i] != 'X') {
+            if (text[i] != (wchar_t)pattern[i])
+                return E_INVALIDARG;
+            continue;
+        }
+        if (!iswxdigit(text[i]))
+            return E_INVALIDARG;
+        int digit = iswdigit(text[i]) ? text[i] - L'0' : (towupper(text[i]) - L'A' + 10);
+        if (count % 2 == 0)
+            bytes[count / 2] = (BYTE)(digit << 4);
+        else
+            bytes[count / 2] |= (BYTE)digit;
+        count++;
+    }
+    iid->Data1 = ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+    iid->Data2 = (uint16_t)((bytes[4] << 8) | bytes[5]);
+    iid->Data3 = (uint16_t)((bytes[6] << 8) | bytes[7]);
+    memcpy(iid->Data4, bytes + 8, 8);
+    return S_OK;
+}
+
+HRESULT CLSIDFromString(LPCWSTR text, CLSID* clsid)
+{
+    return IIDFromString(text, clsid);
+}
+
+/////////////////////////////////////////////////////////////
+//OLE Automation
+/////////////////////////////////////////////////////////////
+
+HRESULT LoadTypeLibEx(LPCWSTR, REGKIND, ITypeLib** typeLib)
+{
+    *typeLib = NULL;
+    return E_NOTIMPL;
+}
+
+HRESULT RegisterTypeLib(ITypeLib*, LPCWSTR, LPCWSTR)
+{
+    return E_NOTIMPL;
+}
+
+HRESULT RegisterTypeLibForUser(ITypeLib*, OLECHAR*, OLECHAR*)
+{
+    return E_NOTIMPL;
+}
+
+HRESULT UnRegisterTypeLib(REFGUID, WORD, WORD, LCID, SYSKIND)
+{
+    return E_NOTIMPL;
+}
+
+HRESULT UnRegisterTypeLibForUser(REFGUID, WORD, WORD, LCID, SYSKIND)
+{
+    return E_NOTIMPL;
+}
+
+void SysFreeString(BSTR)
+{
+}
@@ -0,0 +1,427 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+
+//The parts of the Windows SDK that Shared uses, for the portable build on other
+//platforms. Only the in-memory and offline hive backends, the file formats and the
+//native type library reader are built there. Functions that need the live registry,
+//COM or kernel transactions are declared so that the sources compile, and fail at
+//run time with an error code.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint32_t ULONG;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG;
+typedef int INT;
+typedef unsigned int UINT;
+typedef short SHORT;
+typedef unsigned short USHORT;
+typedef int BOOL;
+typedef uintptr_t ULONG_PTR;
+typedef ULONG_PTR DWORD_PTR;
+typedef LONG LSTATUS;
+typedef LONG HRESULT;
+typedef DWORD REGSAM;
+typedef DWORD LCID;
+typedef BYTE* LPBYTE;
+typedef DWORD* LPDWORD;
+typedef void* LPVOID;
+typedef void* HANDLE;
+typedef char* LPSTR;
+typedef char* PCHAR;
+typedef wchar_t WCHAR;
+typedef WCHAR* LPWSTR;
+typedef WCHAR* PWCHAR;
+typedef const WCHAR* LPCWSTR;
+typedef LPCWSTR LPCTSTR;
+typedef wchar_t OLECHAR;
+typedef OLECHAR* BSTR;
+
+typedef struct HKEY__ { int unused; } *HKEY;
+typedef HKEY* PHKEY;
+
+typedef struct _FILETIME {
+    DWORD dwLowDateTime;
+    DWORD dwHighDateTime;
+} FILETIME, *PFILETIME;
+
+typedef union _LARGE_INTEGER {
+    struct {
+        DWORD LowPart;
+        LONG HighPart;
+    };
+    LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _GUID {
+    uint32_t Data1;
+    uint16_t Data2;
+    uint16_t Data3;
+    uint8_t Data4[8];
+} GUID, IID, CLSID;
+typedef const GUID& REFGUID;
+
+inline const GUID GUID_NULL = {};
+
+inline bool operator == (const GUID& a, const GUID& b) { return memcmp(&a, &b, sizeof(GUID)) == 0; }
+inline bool operator != (const GUID& a, const GUID& b) { return !(a == b); }
+
+#define WINAPI
+#define CALLBACK
+#define __stdcall
+#define __declspec(x)
+#define __forceinline inline
+#define FALSE 0
+#define TRUE 1
+#define MAX_PATH 260
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define _countof(a) (sizeof(a) / sizeof((a)[0]))
+
+#define LOWORD(l) ((WORD)(((DWORD_PTR)(l)) & 0xffff))
+#define HIWORD(l) ((WORD)((((DWORD_PTR)(l)) >> 16) & 0xffff))
+#define MAKELONG(a, b) ((LONG)(((WORD)(((DWORD_PTR)(a)) & 0xffff)) | ((DWORD)((WORD)(((DWORD_PTR)(b)) & 0xffff))) << 16))
+#define MAKELANGID(p, s) ((((WORD)(s)) << 10) | (WORD)(p))
+#define LANG_NEUTRAL 0
+#define SUBLANG_DEFAULT 1
+#define LOCALE_NEUTRAL 0
+
+/////////////////////////////////////////////////////////////
+//Error codes
+/////////////////////////////////////////////////////////////
+
+#define ERROR_SUCCESS 0L
+#define NO_ERROR 0L
+#define ERROR_INVALID_FUNCTION 1L
+#define ERROR_FILE_NOT_FOUND 2L
+#define ERROR_PATH_NOT_FOUND 3L
+#define ERROR_ACCESS_DENIED 5L
+#define ERROR_INVALID_HANDLE 6L
+#define ERROR_NOT_ENOUGH_MEMORY 8L
+#define ERROR_BAD_FORMAT 11L
+#define ERROR_INVALID_DATA 13L
+#define ERROR_WRITE_FAULT 29L
+#define ERROR_SHARING_VIOLATION 32L
+#define ERROR_HANDLE_EOF 38L
+#define ERROR_NOT_SUPPORTED 50L
+#define ERROR_INVALID_PARAMETER 87L
+#define ERROR_OPEN_FAILED 110L
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_ALREADY_EXISTS 183L
+#define ERROR_MORE_DATA 234L
+#define ERROR_NO_MORE_ITEMS 259L
+#define ERROR_OPERATION_ABORTED 995L
+#define ERROR_BADDB 1009L
+#define ERROR_BADKEY 1010L
+#define ERROR_CANTREAD 1012L
+#define ERROR_CANTWRITE 1013L
+#define ERROR_REGISTRY_CORRUPT 1015L
+#define ERROR_KEY_DELETED 1018L
+#define ERROR_KEY_HAS_CHILDREN 1020L
+#define ERROR_CANCELLED 1223L
+#define ERROR_UNSUPPORTED_TYPE 1630L
+#define ERROR_INVALID_TRANSACTION 6700L
+#define ERROR_TRANSACTION_NOT_ACTIVE 6701L
+#define ERROR_TRANSACTIONAL_CONFLICT 6800L
+
+#define S_OK ((HRESULT)0L)
+#define S_FALSE ((HRESULT)1L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define TYPE_E_INVDATAREAD ((HRESULT)0x80028018L)
+#define TYPE_E_UNSUPFORMAT ((HRESULT)0x80028019L)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? ((HRESULT)(x)) : ((HRESULT)(((x) & 0x0000FFFF) | (7 << 16) | 0x80000000)))
+
+/////////////////////////////////////////////////////////////
+//Registry
+/////////////////////////////////////////////////////////////
+
+#define HKEY_CLASSES_ROOT ((HKEY)(ULONG_PTR)((LONG)0x80000000))
+#define HKEY_CURRENT_USER ((HKEY)(ULONG_PTR)((LONG)0x80000001))
+#define HKEY_LOCAL_MACHINE ((HKEY)(ULONG_PTR)((LONG)0x80000002))
+#define HKEY_USERS ((HKEY)(ULONG_PTR)((LONG)0x80000003))
+#define HKEY_PERFORMANCE_DATA ((HKEY)(ULONG_PTR)((LONG)0x80000004))
+#define HKEY_CURRENT_CONFIG ((HKEY)(ULONG_PTR)((LONG)0x80000005))
+#define HKEY_DYN_DATA ((HKEY)(ULONG_PTR)((LONG)0x80000006))
+#define HKEY_CURRENT_USER_LOCAL_SETTINGS ((HKEY)(ULONG_PTR)((LONG)0x80000007))
+#define HKEY_PERFORMANCE_TEXT ((HKEY)(ULONG_PTR)((LONG)0x80000050))
+#define HKEY_PERFORMANCE_NLSTEXT ((HKEY)(ULONG_PTR)((LONG)0x80000060))
+
+#define REG_NONE 0
+#define REG_SZ 1
+#define REG_EXPAND_SZ 2
+#define REG_BINARY 3
+#define REG_DWORD 4
+#define REG_DWORD_BIG_ENDIAN 5
+#define REG_LINK 6
+#define REG_MULTI_SZ 7
+#define REG_RESOURCE_LIST 8
+#define REG_FULL_RESOURCE_DESCRIPTOR 9
+#define REG_RESOURCE_REQUIREMENTS_LIST 10
+#define REG_QWORD 11
+
+#define RRF_RT_REG_SZ 0x2
+#define RRF_RT_REG_EXPAND_SZ 0x4
+#define RRF_RT_REG_BINARY 0x8
+#define RRF_RT_REG_DWORD 0x10
+#define RRF_RT_REG_MULTI_SZ 0x20
+#define RRF_RT_REG_QWORD 0x40
+#define RRF_RT_ANY 0xffff
+#define RRF_NOEXPAND 0x10000000
+
+#define DELETE 0x10000L
+#define GENERIC_ALL 0x10000000L
+#define GENERIC_WRITE 0x40000000L
+#define GENERIC_READ 0x80000000L
+#define KEY_QUERY_VALUE 0x0001
+#define KEY_SET_VALUE 0x0002
+#define KEY_CREATE_SUB_KEY 0x0004
+#define KEY_ENUMERATE_SUB_KEYS 0x0008
+#define KEY_WOW64_64KEY 0x0100
+#define KEY_WRITE 0x20006
+#define KEY_READ 0x20019
+#define KEY_ALL_ACCESS 0xF003F
+#define REG_OPTION_NON_VOLATILE 0
+#define REG_CREATED_NEW_KEY 1
+#define REG_OPENED_EXISTING_KEY 2
+
+/////////////////////////////////////////////////////////////
+//Files, handles and strings
+/////////////////////////////////////////////////////////////
+
+#define FILE_SHARE_READ 1
+#define FILE_SHARE_WRITE 2
+#define FILE_SHARE_DELETE 4
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define PAGE_READONLY 2
+#define FILE_MAP_READ 4
+#define DUPLICATE_SAME_ACCESS 2
+
+#define CP_ACP 0
+#define CP_UTF8 65001
+
+#define FORMAT_MESSAGE_ALLOCATE_BUFFER 0x100
+#define FORMAT_MESSAGE_IGNORE_INSERTS 0x200
+#define FORMAT_MESSAGE_FROM_SYSTEM 0x1000
+
+DWORD GetLastError();
+BOOL CloseHandle(HANDLE handle);
+HANDLE GetCurrentProcess();
+BOOL DuplicateHandle(HANDLE sourceProcess, HANDLE source, HANDLE targetProcess, HANDLE* target,
+    DWORD access, BOOL inherit, DWORD options);
+HANDLE CreateTransaction(void* attributes, void* uow, DWORD options, DWORD isolationLevel,
+    DWORD isolationFlags, DWORD timeout, LPWSTR description);
+BOOL CommitTransaction(HANDLE transaction);
+BOOL RollbackTransaction(HANDLE transaction);
+
+DWORD FormatMessageA(DWORD flags, const void* source, DWORD messageId, DWORD languageId,
+    LPSTR buffer, DWORD size, void* arguments);
+DWORD FormatMessageW(DWORD flags, const void* source, DWORD messageId, DWORD languageId,
+    LPWSTR buffer, DWORD size, void* arguments);
+void* LocalFree(void* memory);
+
+//Code pages: CP_UTF8, and CP_ACP which is taken to be Windows-1252
+int WideCharToMultiByte(UINT codePage, DWORD flags, LPCWSTR wide, int wideLength,
+    char* narrow, int narrowSize, const char* defaultChar, BOOL* usedDefaultChar);
+int MultiByteToWideChar(UINT codePage, DWORD flags, const char* narrow, int narrowLength,
+    LPWSTR wide, int wideSize);
+DWORD ExpandEnvironmentStringsW(LPCWSTR source, LPWSTR destination, DWORD size);
+
+int StringFromGUID2(REFGUID guid, LPWSTR buffer, int size);
+HRESULT IIDFromString(LPCWSTR text, IID* iid);
+HRESULT CLSIDFromString(LPCWSTR text, CLSID* clsid);
+
+inline int lstrlen(LPCWSTR text) { return (int)wcslen(text); }
+inline int _wcsicmp(const wchar_t* a, const wchar_t* b) { return wcscasecmp(a, b); }
+inline int _wcsnicmp(const wchar_t* a, const wchar_t* b, size_t n) { return wcsncasecmp(a, b, n); }
+
+/////////////////////////////////////////////////////////////
+//OLE Automation
+/////////////////////////////////////////////////////////////
+
+//The enums have int as their type like with MSVC, so any value read from a file is valid
+typedef enum tagSYSKIND : int { SYS_WIN16, SYS_WIN32, SYS_MAC, SYS_WIN64 } SYSKIND;
+typedef enum tagTYPEKIND : int {
+    TKIND_ENUM, TKIND_RECORD, TKIND_MODULE, TKIND_INTERFACE, TKIND_DISPATCH,
+    TKIND_COCLASS, TKIND_ALIAS, TKIND_UNION, TKIND_MAX
+} TYPEKIND;
+typedef enum tagFUNCKIND : int { FUNC_VIRTUAL, FUNC_PUREVIRTUAL, FUNC_NONVIRTUAL, FUNC_STATIC, FUNC_DISPATCH } FUNCKIND;
+typedef enum tagINVOKEKIND : int {
+    INVOKE_FUNC = 1, INVOKE_PROPERTYGET = 2, INVOKE_PROPERTYPUT = 4, INVOKE_PROPERTYPUTREF = 8
+} INVOKEKIND;
+typedef enum tagCALLCONV : int { CC_FASTCALL, CC_CDECL, CC_MSCPASCAL, CC_PASCAL = CC_MSCPASCAL, CC_MACPASCAL, CC_STDCALL } CALLCONV;
+typedef enum tagVARKIND : int { VAR_PERINSTANCE, VAR_STATIC, VAR_CONST, VAR_DISPATCH } VARKIND;
+typedef enum tagTYPEFLAGS : int {
+    TYPEFLAG_FAPPOBJECT = 0x1, TYPEFLAG_FCANCREATE = 0x2, TYPEFLAG_FLICENSED = 0x4,
+    TYPEFLAG_FPREDECLID = 0x8, TYPEFLAG_FHIDDEN = 0x10, TYPEFLAG_FCONTROL = 0x20,
+    TYPEFLAG_FDUAL = 0x40, TYPEFLAG_FNONEXTENSIBLE = 0x80, TYPEFLAG_FOLEAUTOMATION = 0x100
+} TYPEFLAGS;
+typedef enum tagLIBFLAGS : int {
+    LIBFLAG_FRESTRICTED = 0x1, LIBFLAG_FCONTROL = 0x2, LIBFLAG_FHIDDEN = 0x4, LIBFLAG_FHASDISKIMAGE = 0x8
+} LIBFLAGS;
+#define PARAMFLAG_NONE 0x0
+#define PARAMFLAG_FIN 0x1
+#define PARAMFLAG_FOUT 0x2
+#define PARAMFLAG_FLCID 0x4
+#define PARAMFLAG_FRETVAL 0x8
+#define PARAMFLAG_FOPT 0x10
+#define PARAMFLAG_FHASDEFAULT 0x20
+typedef enum tagREGKIND : int { REGKIND_DEFAULT, REGKIND_REGISTER, REGKIND_NONE } REGKIND;
+
+enum VARENUM {
+    VT_EMPTY = 0, VT_NULL = 1, VT_I2 = 2, VT_I4 = 3, VT_R4 = 4, VT_R8 = 5, VT_CY = 6, VT_DATE = 7,
+    VT_BSTR = 8, VT_DISPATCH = 9, VT_ERROR = 10, VT_BOOL = 11, VT_VARIANT = 12, VT_UNKNOWN = 13,
+    VT_I1 = 16, VT_UI1 = 17, VT_UI2 = 18, VT_UI4 = 19, VT_I8 = 20, VT_UI8 = 21, VT_INT = 22,
+    VT_UINT = 23, VT_VOID = 24, VT_HRESULT = 25, VT_PTR = 26, VT_SAFEARRAY = 27, VT_CARRAY = 28,
+    VT_USERDEFINED = 29, VT_LPSTR = 30, VT_LPWSTR = 31
+};
+#define VT_TYPEMASK 0xfff
+
+typedef unsigned short VARTYPE;
+typedef LONG MEMBERID;
+typedef DWORD HREFTYPE;
+#define MEMBERID_NIL (-1)
+
+typedef struct tagTLIBATTR {
+    GUID guid;
+    LCID lcid;
+    SYSKIND syskind;
+    WORD wMajorVerNum;
+    WORD wMinorVerNum;
+    WORD wLibFlags;
+} TLIBATTR;
+
+typedef struct tagTYPEATTR {
+    GUID guid;
+    LCID lcid;
+    DWORD dwReserved;
+    MEMBERID memidConstructor;
+    MEMBERID memidDestructor;
+    LPWSTR lpstrSchema;
+    ULONG cbSizeInstance;
+    TYPEKIND typekind;
+    WORD cFuncs;
+    WORD cVars;
+    WORD cImplTypes;
+    WORD cbSizeVft;
+    WORD cbAlignment;
+    WORD wTypeFlags;
+    WORD wMajorVerNum;
+    WORD wMinorVerNum;
+} TYPEATTR;
+
+struct IUnknown
+{
+    virtual ULONG AddRef() = 0;
+    virtual ULONG Release() = 0;
+};
+
+struct ITypeInfo : IUnknown
+{
+    virtual HRESULT GetTypeAttr(TYPEATTR** attr) = 0;
+    virtual void ReleaseTypeAttr(TYPEATTR* attr) = 0;
+    virtual HRESULT GetDocumentation(MEMBERID id, BSTR* name, BSTR* doc, DWORD* helpContext, BSTR* helpFile) = 0;
+};
+
+struct ITypeLib : IUnknown
+{
+    virtual UINT GetTypeInfoCount() = 0;
+    virtual HRESULT GetTypeInfo(UINT index, ITypeInfo** info) = 0;
+    virtual HRESULT GetLibAttr(TLIBATTR** attr) = 0;
+    virtual void ReleaseTLibAttr(TLIBATTR* attr) = 0;
+    virtual HRESULT GetDocumentation(INT index, BSTR* name, BSTR* doc, DWORD* helpContext, BSTR* helpFile) = 0;
+};
+
+//There is no COM: loading and registering type libraries fails with E_NOTIMPL
+HRESULT LoadTypeLibEx(LPCWSTR file, REGKIND kind, ITypeLib** typeLib);
+HRESULT RegisterTypeLib(ITypeLib* typeLib, LPCWSTR fullPath, LPCWSTR helpDir);
+HRESULT RegisterTypeLibForUser(ITypeLib* typeLib, OLECHAR* fullPath, OLECHAR* helpDir);
+HRESULT UnRegisterTypeLib(REFGUID libId, WORD major, WORD minor, LCID lcid, SYSKIND syskind);
+HRESULT UnRegisterTypeLibForUser(REFGUID libId, WORD major, WORD minor, LCID lcid, SYSKIND syskind);
+void SysFreeString(BSTR text);
+
+template<class T>
+class CComPtr
+{
+public:
+    T* p = nullptr;
+
+    CComPtr() {}
+    CComPtr(T* other) : p(other) {}
+    ~CComPtr() { Release(); }
+
+    CComPtr(const CComPtr& other) : p(other.p)
+    {
+        if (p)
+            p->AddRef();
+    }
+
+    CComPtr(CComPtr&& other) noexcept : p(other.p)
+    {
+        other.p = nullptr;
+    }
+
+    CComPtr& operator = (CComPtr other)
+    {
+        T* previous = p;
+        p = other.p;
+        other.p = previous;
+        return *this;
+    }
+
+    T* operator -> () const { return p; }
+    T** operator & () { return &p; }
+    operator T* () const { return p; }
+
+    void Release()
+    {
+        if (p)
+            p->Release();
+        p = nullptr;
+    }
+};
+
+class CComBSTR
+{
+public:
+    BSTR m_str = nullptr;
+
+    CComBSTR() {}
+    ~CComBSTR() { SysFreeString(m_str); }
+
+    CComBSTR(const CComBSTR&) = delete;
+    CComBSTR& operator = (const CComBSTR&) = delete;
+
+    BSTR* operator & () { return &m_str; }
+    operator BSTR() const { return m_str; }
+    unsigned int Length() const { return m_str ? (unsigned int)wcslen(m_str) : 0; }
+};
@@ -0,0 +1,132 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Exception.h"
+
+namespace w32
+{
+    /// <summary>
+    /// Appends the fields of a record to a buffer, for the file formats that are memory
+    /// mapped and searched in place. Numbers are little endian with a fixed size, so that
+    /// a field can be found without decoding what comes before it. Strings and lists are
+    /// a 4 byte count followed by the items; characters are UTF-16 code units.
+    /// </summary>
+    class CRecordWriter
+    {
+        std::vector<BYTE>& m_buffer;
+
+    public:
+        CRecordWriter(std::vector<BYTE>& buffer) : m_buffer(buffer) {}
+
+        void Number(uint64_t value, size_t size)
+        {
+            for (size_t i = 0; i < size; i++)
+                m_buffer.push_back((BYTE)(value >> (8 * i)));
+        }
+
+        void String(std::wstring_view value)
+        {
+            Number(value.length(), 4);
+            for (wchar_t c : value)
+                Number((uint16_t)c, 2);
+        }
+
+        void Guid(const GUID& guid)
+        {
+            const BYTE* bytes = reinterpret_cast<const BYTE*>(&guid);
+            m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(GUID));
+        }
+
+        void Guids(const std::vector<GUID>& guids)
+        {
+            Number(guids.size(), 4);
+            for (const GUID& guid : guids)
+                Guid(guid);
+        }
+    };
+
+    /// <summary>
+    /// Reads the fields that CRecordWriter wrote, from a range of a mapped file.
+    /// Reading past the end of the range throws an AppException with the message that
+    /// the reader was given, since it means that the file is damaged.
+    /// </summary>
+    class CRecordReader
+    {
+        const BYTE* m_pos;
+        const BYTE* m_end;
+        const char* m_damaged;
+
+        const BYTE* Take(uint64_t size)
+        {
+            if (size > (uint64_t)(m_end - m_pos))
+                throw AppException(std::string(m_damaged));
+            const BYTE* bytes = m_pos;
+            m_pos += size;
+            return bytes;
+        }
+
+    public:
+        CRecordReader(const BYTE* pos, const BYTE* end, const char* damaged) :
+            m_pos(pos), m_end(end), m_damaged(damaged) {}
+
+        uint64_t Number(size_t size)
+        {
+            const BYTE* bytes = Take(size);
+            uint64_t value = 0;
+            for (size_t i = 0; i < size; i++)
+                value |= (uint64_t)bytes[i] << (8 * i);
+            return value;
+        }
+
+        std::wstring String()
+        {
+            uint64_t length = Number(4);
+            const BYTE* chars = Take(length * 2);
+            std::wstring value;
+            value.reserve((size_t)length);
+            for (uint64_t i = 0; i < length; i++)
+                value.push_back((wchar_t)(chars[2 * i] | (chars[2 * i + 1] << 8)));
+            return value;
+        }
+
+        GUID Guid()
+        {
+            GUID guid;
+            memcpy(&guid, Take(sizeof(GUID)), sizeof(GUID));
+            return guid;
+        }
+
+        void Guids(std::vector<GUID>& guids)
+        {
+            uint64_t count = Number(4);
+            //check the size first, so that a damaged count fails before it allocates
+            const BYTE* bytes = Take(count * sizeof(GUID));
+            guids.resize((size_t)count);
+            if (count > 0)
+                memcpy(guids.data(), bytes, (size_t)count * sizeof(GUID));
+        }
+
+        //Where the next field starts
+        const BYTE* Position() const { return m_pos; }
+    };
+}
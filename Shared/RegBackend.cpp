@@ -0,0 +1,110 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "RegBackend.h"
+#include "Exception.h"
+#include <atomic>
+#ifdef _WIN32
+#include "Win32RegBackend.h"
+#endif
+
+namespace w32
+{
+	/////////////////////////////////////////////////////////////
+	//Default backend
+	/////////////////////////////////////////////////////////////
+
+	static std::atomic<IRegBackend*> g_defaultBackend = NULL;
+
+	IRegBackend* GetDefaultRegBackend()
+	{
+		IRegBackend* backend = g_defaultBackend.load();
+		if (backend)
+			return backend;
+#ifdef _WIN32
+		return CWin32RegBackend::Instance();
+#else
+		//there is no live registry to fall back on
+		throw AppException(L"No default registry backend was configured");
+#endif
+	}
+
+	IRegBackend* SetDefaultRegBackend(IRegBackend* backend)
+	{
+		return g_defaultBackend.exchange(backend);
+	}
+
+	CDefaultRegBackendScope::CDefaultRegBackendScope(IRegBackend* backend) :
+		m_previous(SetDefaultRegBackend(backend)) {
+	}
+
+	CDefaultRegBackendScope::~CDefaultRegBackendScope() {
+		SetDefaultRegBackend(m_previous);
+	}
+
+	/////////////////////////////////////////////////////////////
+	//CRegTransaction
+	/////////////////////////////////////////////////////////////
+
+	CRegTransaction::CRegTransaction(IRegBackend* backend) :
+		m_backend(backend ? backend : GetDefaultRegBackend()) {
+	}
+
+	//an open transaction that was never completed is rolled back
+	CRegTransaction::~CRegTransaction() {
+		if (IsValid()) {
+			if (!m_completed)
+				m_backend->RollbackTransaction(m_handle);
+			m_backend->CloseTransaction(m_handle);
+			m_handle = INVALID_HANDLE_VALUE;
+		}
+	}
+
+	void CRegTransaction::Create() {
+		if (IsValid())
+			throw AppException(L"The transaction was already created");
+
+		LSTATUS retVal = m_backend->CreateTransaction(&m_handle);
+		if (retVal != ERROR_SUCCESS) {
+			m_handle = INVALID_HANDLE_VALUE;
+			throw ExWin32Error(retVal);
+		}
+		m_completed = false;
+	}
+
+	void CRegTransaction::Commit() {
+		LSTATUS retVal = m_backend->CommitTransaction(m_handle);
+		if (retVal != ERROR_SUCCESS)
+			throw ExWin32Error(retVal);
+		m_completed = true;
+	}
+
+	void CRegTransaction::RollBack() {
+		LSTATUS retVal = m_backend->RollbackTransaction(m_handle);
+		if (retVal != ERROR_SUCCESS)
+			throw ExWin32Error(retVal);
+		m_completed = true;
+	}
+
+	bool CRegTransaction::IsValid() {
+		return IsTransaction(m_handle);
+	}
+
+	CRegTransaction::operator HANDLE () {
+		return m_handle;
+	}
+}
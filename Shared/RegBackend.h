@@ -0,0 +1,152 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+
+namespace w32
+{
+	/// <summary>
+	/// Interface for the storage that sits underneath CHKey.
+	/// The methods deliberately mirror the Win32 registry API: they take the same kind of
+	/// arguments and return the same LSTATUS codes, so that the live registry backend is a
+	/// thin forwarder and CHKey can keep turning error codes into exceptions in one place.
+	///
+	/// Key handles are opaque HKEY values that are only meaningful to the backend that
+	/// produced them. The predefined keys (HKEY_LOCAL_MACHINE and friends) are accepted
+	/// as parent keys by every backend.
+	///
+	/// Transactions are opaque HANDLE values that were created by the same backend.
+	/// Like with the Win32 API, a key that is opened or created under a transaction
+	/// performs all its changes as part of that transaction.
+	/// </summary>
+	class IRegBackend
+	{
+	public:
+		virtual ~IRegBackend() {}
+
+		//Open an existing key below the parent. subKey may contain multiple levels.
+		virtual LSTATUS OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) = 0;
+
+		//Open a key below the parent, creating it (and any missing levels) if needed.
+		virtual LSTATUS CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) = 0;
+
+		//Close a key that was opened or created by this backend
+		virtual LSTATUS CloseKey(HKEY key) = 0;
+
+		//Get the counts and maximum lengths (in characters, excluding the terminator)
+		//of the subkey and value names, and the maximum value size in bytes.
+		//Each output parameter is optional.
+		virtual LSTATUS QueryInfoKey(HKEY key,
+			DWORD* numSubKeys, DWORD* maxSubKeyLength,
+			DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+			FILETIME* lastWriteTime) = 0;
+
+		//Get the name of the subkey at a given index. nameLength is the size of the buffer
+		//in characters on input, and the length of the name without terminator on output.
+		virtual LSTATUS EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength) = 0;
+
+		//Get the name, type and data of the value at a given index. Same conventions as
+		//RegEnumValue: type, data and dataLength are optional.
+		virtual LSTATUS EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+			DWORD* type, LPBYTE data, DWORD* dataLength) = 0;
+
+		//Get the type and data of a named value. Same conventions as RegQueryValueEx:
+		//if data is NULL, only the type and required size are returned.
+		virtual LSTATUS QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+			LPBYTE data, DWORD* dataLength) = 0;
+
+		//Create or overwrite a value
+		virtual LSTATUS SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+			const BYTE* data, DWORD dataLength) = 0;
+
+		//Delete a single value
+		virtual LSTATUS DeleteValue(HKEY key, LPCWSTR valueName) = 0;
+
+		//Delete a single subkey. The subkey may not have subkeys of its own.
+		virtual LSTATUS DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction) = 0;
+
+		//Delete a subkey and everything below it. If subKey is NULL, the contents of
+		//the key are deleted but the key itself remains.
+		virtual LSTATUS DeleteTree(HKEY key, LPCWSTR subKey) = 0;
+
+		//Transaction support
+		virtual LSTATUS CreateTransaction(HANDLE* transaction) = 0;
+		virtual LSTATUS CommitTransaction(HANDLE transaction) = 0;
+		virtual LSTATUS RollbackTransaction(HANDLE transaction) = 0;
+		virtual LSTATUS CloseTransaction(HANDLE transaction) = 0;
+	};
+
+	/// <summary>
+	/// Transaction that belongs to a specific backend. This is the backend-neutral
+	/// counterpart of CTransaction. If the transaction is still open when the object
+	/// goes out of scope, it is rolled back.
+	/// </summary>
+	class CRegTransaction
+	{
+		IRegBackend* m_backend;
+		HANDLE m_handle = INVALID_HANDLE_VALUE;
+		bool m_completed = false;
+
+	public:
+		CRegTransaction(IRegBackend* backend);
+		~CRegTransaction();
+
+		CRegTransaction(const CRegTransaction&) = delete;
+		CRegTransaction& operator = (const CRegTransaction&) = delete;
+
+		void Create();
+		void Commit();
+		void RollBack();
+		bool IsValid();
+
+		//cast to a HANDLE for passing to CHKey methods
+		operator HANDLE ();
+	};
+
+	//Get the backend that is used by CHKey when none is specified.
+	//Unless overridden, this is the live Windows registry.
+	IRegBackend* GetDefaultRegBackend();
+
+	//Replace the default backend. Passing NULL restores the live registry.
+	//The caller retains ownership and must keep the backend alive.
+	//Returns the backend that was set before, NULL if there was none.
+	IRegBackend* SetDefaultRegBackend(IRegBackend* backend);
+
+	/// <summary>
+	/// Makes a backend the default for as long as the object exists. The default that
+	/// was set before is restored when it goes out of scope, also when an exception
+	/// leaves the scope.
+	/// </summary>
+	class CDefaultRegBackendScope
+	{
+		IRegBackend* m_previous;
+
+	public:
+		CDefaultRegBackendScope(IRegBackend* backend);
+		~CDefaultRegBackendScope();
+
+		CDefaultRegBackendScope(const CDefaultRegBackendScope&) = delete;
+		CDefaultRegBackendScope& operator = (const CDefaultRegBackendScope&) = delete;
+	};
+
+	//Is the transaction handle a real one, as opposed to a 'no transaction' marker
+	inline bool IsTransaction(HANDLE transaction) {
+		return transaction != INVALID_HANDLE_VALUE && transaction != NULL;
+	}
+}
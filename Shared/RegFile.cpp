@@ -0,0 +1,780 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "RegFile.h"
+#include "TreeWalker.h"
+#include "WriteBatch.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <bit>
+#include <climits>
+#include <cstring>
+#include <cwchar>
+#include <filesystem>
+#include <vector>
+
+//The scanner compares 8 characters at a time where wchar_t is 16 bits wide
+#if (defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)) && WCHAR_MAX <= 0xFFFF
+#define W32_REGFILE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace w32
+{
+	static const wchar_t* Regedit5Header = L"Windows Registry Editor Version 5.00";
+	static const wchar_t* Regedit4Header = L"REGEDIT4";
+
+	//Size of the blocks in which files are read and written
+	static const size_t BlockSize = 64 * 1024;
+
+	//Root keys by their full name, as used in .reg files, and their short name
+	struct CRootName
+	{
+		HKEY key;
+		const wchar_t* name;
+		const wchar_t* shortName;
+	};
+
+	static const CRootName RootNames[] = {
+		{ HKEY_LOCAL_MACHINE, L"HKEY_LOCAL_MACHINE", L"HKLM" },
+		{ HKEY_CURRENT_USER, L"HKEY_CURRENT_USER", L"HKCU" },
+		{ HKEY_CLASSES_ROOT, L"HKEY_CLASSES_ROOT", L"HKCR" },
+		{ HKEY_USERS, L"HKEY_USERS", L"HKU" },
+		{ HKEY_CURRENT_CONFIG, L"HKEY_CURRENT_CONFIG", L"HKCC" } };
+
+	/////////////////////////////////////////////////////////////
+	//Scanner
+	/////////////////////////////////////////////////////////////
+
+	//First occurrence of either character, or end
+	static const wchar_t* FindEither(const wchar_t* pos, const wchar_t* end, wchar_t a, wchar_t b)
+	{
+#ifdef W32_REGFILE_SSE2
+		const __m128i va = _mm_set1_epi16((short)a);
+		const __m128i vb = _mm_set1_epi16((short)b);
+		while (end - pos >= 8) {
+			__m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+			__m128i match = _mm_or_si128(_mm_cmpeq_epi16(chars, va), _mm_cmpeq_epi16(chars, vb));
+			unsigned mask = (unsigned)_mm_movemask_epi8(match);
+			if (mask != 0)
+				return pos + std::countr_zero(mask) / 2;
+			pos += 8;
+		}
+#endif
+		while (pos < end && *pos != a && *pos != b)
+			pos++;
+		return pos;
+	}
+
+	static bool IsSpace(wchar_t c)
+	{
+		return c == L' ' || c == L'\t';
+	}
+
+	static std::wstring_view Trim(std::wstring_view text)
+	{
+		while (!text.empty() && IsSpace(text.front()))
+			text.remove_prefix(1);
+		while (!text.empty() && IsSpace(text.back()))
+			text.remove_suffix(1);
+		return text;
+	}
+
+	//Value of a hex digit, or -1
+	static int HexDigit(wchar_t c)
+	{
+		static const signed char digits[128] = {
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+			-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+		return (unsigned)c < 128 ? digits[c] : -1;
+	}
+
+	/////////////////////////////////////////////////////////////
+	//CRegTextReader
+	//Reads a file in blocks, decodes it and hands it out line by line
+	/////////////////////////////////////////////////////////////
+
+	class CRegTextReader
+	{
+		std::ifstream m_file;
+		bool m_utf16 = false;
+		bool m_utf8 = false;            //neither means the ANSI code page
+		bool m_started = false;
+		std::vector<BYTE> m_bytes;      //read, but not decoded yet
+		std::wstring m_text;            //decoded, m_pos is the start of the next line
+		size_t m_pos = 0;
+		size_t m_scanned = 0;           //no line end before this offset
+		size_t m_line = 0;
+
+		size_t DecodeUtf8(const BYTE* bytes, size_t size);
+		size_t DecodeAnsi(const BYTE* bytes, size_t size, bool last);
+		size_t DecodeUtf16(const BYTE* bytes, size_t size);
+		bool Fill();
+		bool NextPhysicalLine(std::wstring& line);
+
+	public:
+		CRegTextReader(const std::wstring& fileName);
+
+		//Next line, with continuation lines joined to it
+		bool NextLine(std::wstring& line);
+
+		//Number of the last line that was read
+		size_t LineNumber() const { return m_line; }
+	};
+
+	CRegTextReader::CRegTextReader(const std::wstring& fileName) :
+		m_file(std::filesystem::path(fileName), std::ios::binary)
+	{
+		if (!m_file)
+			throw ExWin32Error(ERROR_OPEN_FAILED, L"Cannot open " + fileName);
+	}
+
+	//Decode as many complete characters as there are. Returns the bytes consumed.
+	size_t CRegTextReader::DecodeUtf8(const BYTE* bytes, size_t size)
+	{
+		size_t i = 0;
+		while (i < size) {
+			BYTE b = bytes[i];
+			if (b < 0x80) {
+				m_text += (wchar_t)b;
+				i++;
+				continue;
+			}
+
+			size_t length = b >= 0xF0 ? 4 : b >= 0xE0 ? 3 : b >= 0xC0 ? 2 : 1;
+			if (i + length > size)
+				break;
+			uint32_t c = length == 4 ? b & 0x07 : length == 3 ? b & 0x0F : b & 0x1F;
+			bool valid = length > 1;
+			for (size_t k = 1; k < length; k++) {
+				if ((bytes[i + k] & 0xC0) != 0x80) {
+					valid = false;
+					length = k;
+					break;
+				}
+				c = (c << 6) | (bytes[i + k] & 0x3F);
+			}
+			i += length;
+
+			if (!valid)
+				m_text += (wchar_t)0xFFFD;
+			else if (c >= 0x10000 && sizeof(wchar_t) == 2) {
+				c -= 0x10000;
+				m_text += (wchar_t)(0xD800 + (c >> 10));
+				m_text += (wchar_t)(0xDC00 + (c & 0x3FF));
+			}
+			else
+				m_text += (wchar_t)c;
+		}
+		return i;
+	}
+
+	//Decode up to the last line break, so that a character of a multi-byte code page
+	//is never cut in half. At the end of the file everything is decoded.
+	size_t CRegTextReader::DecodeAnsi(const BYTE* bytes, size_t size, bool last)
+	{
+		if (!last) {
+			while (size > 0 && bytes[size - 1] != '\n')
+				size--;
+		}
+		if (size == 0)
+			return 0;
+
+		int length = MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char*>(bytes), (int)size, NULL, 0);
+		if (length <= 0)
+			throw ExWin32Error();
+		size_t offset = m_text.length();
+		m_text.resize(offset + length);
+		MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char*>(bytes), (int)size, &m_text[offset], length);
+		return size;
+	}
+
+	size_t CRegTextReader::DecodeUtf16(const BYTE* bytes, size_t size)
+	{
+		size_t count = size / 2;
+		size_t offset = m_text.length();
+		m_text.resize(offset + count);
+		if (sizeof(wchar_t) == 2)
+			memcpy(&m_text[offset], bytes, count * 2);
+		else {
+			for (size_t i = 0; i < count; i++)
+				m_text[offset + i] = (wchar_t)(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+		}
+		return count * 2;
+	}
+
+	//Read and decode the next block. Returns false at the end of the file.
+	bool CRegTextReader::Fill()
+	{
+		//drop the lines that were handed out
+		m_text.erase(0, m_pos);
+		m_scanned -= m_pos;
+		m_pos = 0;
+
+		size_t kept = m_bytes.size();
+		m_bytes.resize(kept + BlockSize);
+		m_file.read(reinterpret_cast<char*>(m_bytes.data() + kept), BlockSize);
+		size_t read = (size_t)m_file.gcount();
+		m_bytes.resize(kept + read);
+		bool last = read < BlockSize;
+		if (read == 0 && (m_bytes.empty() || m_utf16 || m_utf8))
+			return false;
+
+		size_t start = 0;
+		if (!m_started && m_bytes.size() >= 2) {
+			m_started = true;
+			if (m_bytes[0] == 0xFF && m_bytes[1] == 0xFE) {
+				m_utf16 = true;
+				start = 2;
+			}
+			else if (m_bytes.size() >= 3 && m_bytes[0] == 0xEF && m_bytes[1] == 0xBB && m_bytes[2] == 0xBF) {
+				m_utf8 = true;
+				start = 3;
+			}
+			else
+				m_utf16 = m_bytes[1] == 0;      //UTF-16 without byte order mark
+		}
+
+		size_t used = start;
+		if (m_utf16)
+			used += DecodeUtf16(m_bytes.data() + start, m_bytes.size() - start);
+		else if (m_utf8)
+			used += DecodeUtf8(m_bytes.data() + start, m_bytes.size() - start);
+		else
+			used += DecodeAnsi(m_bytes.data() + start, m_bytes.size() - start, last);
+		m_bytes.erase(m_bytes.begin(), m_bytes.begin() + used);
+		return true;
+	}
+
+	bool CRegTextReader::NextPhysicalLine(std::wstring& line)
+	{
+		size_t newLine;
+		for (;;) {
+			const wchar_t* text = m_text.data();
+			newLine = FindEither(text + m_scanned, text + m_text.length(), L'\n', L'\n') - text;
+			if (newLine < m_text.length())
+				break;
+			m_scanned = m_text.length();
+			if (!Fill()) {
+				//the last line does not have to end in a line break
+				if (m_pos == m_text.length())
+					return false;
+				newLine = m_text.length();
+				break;
+			}
+		}
+
+		line.assign(m_text, m_pos, newLine - m_pos);
+		if (!line.empty() && line.back() == L'\r')
+			line.pop_back();
+		m_pos = (std::min)(newLine + 1, m_text.length());
+		m_scanned = m_pos;
+		m_line++;
+		return true;
+	}
+
+	bool CRegTextReader::NextLine(std::wstring& line)
+	{
+		if (!NextPhysicalLine(line))
+			return false;
+
+		//hex data that does not fit on one line ends in a backslash
+		std::wstring next;
+		for (;;) {
+			std::wstring_view trimmed = Trim(line);
+			if (trimmed.empty() || trimmed.back() != L'\\' || trimmed.front() == L';')
+				return true;
+			//a file that ends here was cut: the backslash stays, so the value does not parse
+			if (!NextPhysicalLine(next))
+				return true;
+			line.resize(trimmed.data() - line.data() + trimmed.length() - 1);
+			line += Trim(next);
+		}
+	}
+
+	/////////////////////////////////////////////////////////////
+	//CRegFileImporter
+	/////////////////////////////////////////////////////////////
+
+	//Error in a .reg file, with its location
+	static void ThrowSyntax(const std::wstring& fileName, size_t line, const std::wstring& message)
+	{
+		throw AppException(fileName + L"(" + std::to_wstring(line) + L"): " + message);
+	}
+
+	//Parse a quoted string at pos, which is on the opening quote. Leaves pos after
+	//the closing quote. Returns false if the string is not terminated.
+	static bool ParseString(std::wstring_view text, size_t& pos, std::wstring& result)
+	{
+		result.clear();
+		const wchar_t* begin = text.data();
+		const wchar_t* end = begin + text.length();
+		const wchar_t* current = begin + pos + 1;
+		for (;;) {
+			const wchar_t* special = FindEither(current, end, L'"', L'\\');
+			if (special == end)
+				return false;
+			result.append(current, special);
+			if (*special == L'"') {
+				pos = special - begin + 1;
+				return true;
+			}
+			//an escaped character
+			if (special + 1 == end)
+				return false;
+			result += special[1];
+			current = special + 2;
+		}
+	}
+
+#ifdef W32_REGFILE_SSE2
+	//Decode 24 characters of the form "hh,hh,hh,hh,hh,hh,hh,hh," into 8 bytes.
+	//Returns false if they are not exactly in that form.
+	static bool ParseHex8(const wchar_t* text, BYTE* bytes)
+	{
+		//the lanes that hold a comma, in each group of 8 characters
+		alignas(16) static const short commaLanes[3][8] = {
+			{ 0, 0, -1, 0, 0, -1, 0, 0 },
+			{ -1, 0, 0, -1, 0, 0, -1, 0 },
+			{ 0, -1, 0, 0, -1, 0, 0, -1 } };
+
+		alignas(16) uint16_t nibbles[24];
+		for (int k = 0; k < 3; k++) {
+			__m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 8 * k));
+			__m128i lower = _mm_or_si128(chars, _mm_set1_epi16(0x20));
+			__m128i digit = _mm_and_si128(_mm_cmpgt_epi16(chars, _mm_set1_epi16('0' - 1)),
+				_mm_cmplt_epi16(chars, _mm_set1_epi16('9' + 1)));
+			__m128i letter = _mm_and_si128(_mm_cmpgt_epi16(lower, _mm_set1_epi16('a' - 1)),
+				_mm_cmplt_epi16(lower, _mm_set1_epi16('f' + 1)));
+			__m128i comma = _mm_cmpeq_epi16(chars, _mm_set1_epi16(','));
+			__m128i expected = _mm_load_si128(reinterpret_cast<const __m128i*>(commaLanes[k]));
+			__m128i valid = _mm_or_si128(
+				_mm_andnot_si128(expected, _mm_or_si128(digit, letter)),
+				_mm_and_si128(expected, comma));
+			if (_mm_movemask_epi8(valid) != 0xFFFF)
+				return false;
+
+			__m128i value = _mm_or_si128(
+				_mm_and_si128(digit, _mm_sub_epi16(chars, _mm_set1_epi16('0'))),
+				_mm_and_si128(letter, _mm_sub_epi16(lower, _mm_set1_epi16('a' - 10))));
+			_mm_store_si128(reinterpret_cast<__m128i*>(nibbles + 8 * k), value);
+		}
+
+		//the digit pairs are 3 characters apart, which SSE2 has no shuffle for
+		for (int i = 0; i < 8; i++)
+			bytes[i] = (BYTE)((nibbles[3 * i] << 4) | nibbles[3 * i + 1]);
+		return true;
+	}
+#endif
+
+	//Parse comma separated hex bytes
+	static bool ParseHex(std::wstring_view text, std::vector<BYTE>& data)
+	{
+		//every byte but the last takes at least 3 characters
+		data.resize(text.length() / 3 + 1);
+		size_t count = 0;
+		size_t i = 0;
+		while (i < text.length()) {
+#ifdef W32_REGFILE_SSE2
+			//regedit writes the bytes without spaces, which is decoded 8 bytes at a
+			//time. Anything else is left to the loop below.
+			while (text.length() - i >= 24 && ParseHex8(text.data() + i, data.data() + count)) {
+				count += 8;
+				i += 24;
+			}
+			if (i == text.length())
+				break;
+#endif
+			while (i < text.length() && IsSpace(text[i]))
+				i++;
+			if (i == text.length())
+				break;
+			if (i + 1 >= text.length())
+				return false;
+			int high = HexDigit(text[i]);
+			int low = HexDigit(text[i + 1]);
+			if (high < 0 || low < 0)
+				return false;
+			data[count++] = (BYTE)((high << 4) | low);
+			i += 2;
+			while (i < text.length() && IsSpace(text[i]))
+				i++;
+			if (i < text.length()) {
+				if (text[i] != L',')
+					return false;
+				i++;
+			}
+		}
+		data.resize(count);
+		return true;
+	}
+
+	//Find the root of a key path and split it off
+	static HKEY ParseRoot(std::wstring_view path, std::wstring& subKey)
+	{
+		size_t separator = path.find(L'\\');
+		std::wstring_view rootName = path.substr(0, separator);
+		for (const CRootName& root : RootNames) {
+			if (CompareNoCase(rootName, root.name) == 0 || CompareNoCase(rootName, root.shortName) == 0) {
+				subKey = separator == std::wstring_view::npos ? L"" : path.substr(separator + 1);
+				return root.key;
+			}
+		}
+		return NULL;
+	}
+
+	//Apply what is in the batch, and start a new one
+	static void FlushBatch(CWriteBatch& batch, HANDLE transaction, const std::wstring& fileName)
+	{
+		if (batch.Count() == 0)
+			return;
+		if (!batch.Apply(transaction)) {
+			for (size_t i = 0; i < batch.Count(); i++) {
+				if (batch.Status(i) != ERROR_SUCCESS)
+					throw ExWin32Error(batch.Status(i), L"Cannot import " + fileName);
+			}
+		}
+		batch.Clear();
+	}
+
+	CRegFileImporter::CRegFileImporter(IRegBackend* backend) :
+		m_backend(backend ? backend : GetDefaultRegBackend())
+	{
+	}
+
+	void CRegFileImporter::SetBatchSize(size_t operations)
+	{
+		m_batchSize = operations ? operations : 1;
+	}
+
+	size_t CRegFileImporter::KeyCount() const
+	{
+		return m_keys;
+	}
+
+	size_t CRegFileImporter::ValueCount() const
+	{
+		return m_values;
+	}
+
+	void CRegFileImporter::Import(const std::wstring& fileName, HANDLE transaction)
+	{
+		m_keys = 0;
+		m_values = 0;
+
+		CRegTextReader reader(fileName);
+		CWriteBatch batch(m_backend);
+		std::wstring line;
+
+		//the header is the first line that is not empty
+		bool haveHeader = false;
+		while (!haveHeader && reader.NextLine(line)) {
+			std::wstring_view header = Trim(line);
+			if (header.empty())
+				continue;
+			if (header != Regedit5Header && header != Regedit4Header)
+				ThrowSyntax(fileName, reader.LineNumber(), L"not a registry file");
+			haveHeader = true;
+		}
+		if (!haveHeader)
+			ThrowSyntax(fileName, reader.LineNumber(), L"not a registry file");
+
+		HKEY root = NULL;               //NULL outside a key, or after a deleted key
+		std::wstring path;
+		std::wstring name;
+		std::wstring text;
+		std::vector<BYTE> data;
+		while (reader.NextLine(line)) {
+			std::wstring_view statement = Trim(line);
+			if (statement.empty() || statement.front() == L';')
+				continue;
+
+			if (statement.front() == L'[') {
+				size_t close = statement.rfind(L']');
+				if (close == std::wstring_view::npos)
+					ThrowSyntax(fileName, reader.LineNumber(), L"missing ]");
+				std::wstring_view keyPath = statement.substr(1, close - 1);
+				bool deleteKey = !keyPath.empty() && keyPath.front() == L'-';
+				if (deleteKey)
+					keyPath.remove_prefix(1);
+
+				HKEY keyRoot = ParseRoot(keyPath, path);
+				if (keyRoot == NULL)
+					ThrowSyntax(fileName, reader.LineNumber(), L"unknown root key");
+				if (deleteKey) {
+					//deleting a root is never what was meant
+					if (path.empty())
+						ThrowSyntax(fileName, reader.LineNumber(), L"a root key cannot be deleted");
+					batch.DeleteTree(keyRoot, path);
+					root = NULL;
+				}
+				else {
+					batch.CreateKey(keyRoot, path);
+					root = keyRoot;
+				}
+				m_keys++;
+			}
+			else if (statement.front() == L'"' || statement.front() == L'@') {
+				if (root == NULL)
+					ThrowSyntax(fileName, reader.LineNumber(), L"value outside of a key");
+
+				size_t pos = 0;
+				if (statement.front() == L'@') {
+					name.clear();
+					pos = 1;
+				}
+				else if (!ParseString(statement, pos, name))
+					ThrowSyntax(fileName, reader.LineNumber(), L"unterminated value name");
+
+				std::wstring_view rest = Trim(statement.substr(pos));
+				if (rest.empty() || rest.front() != L'=')
+					ThrowSyntax(fileName, reader.LineNumber(), L"missing =");
+				rest = Trim(rest.substr(1));
+
+				if (rest == L"-") {
+					batch.DeleteValue(root, path, name);
+				}
+				else if (!rest.empty() && rest.front() == L'"') {
+					size_t end = 0;
+					if (!ParseString(rest, end, text) || !Trim(rest.substr(end)).empty())
+						ThrowSyntax(fileName, reader.LineNumber(), L"invalid string value");
+					batch.SetValue(root, path, name, REG_SZ, reinterpret_cast<const BYTE*>(text.c_str()),
+						(DWORD)((text.length() + 1) * sizeof(wchar_t)));
+				}
+				else if (rest.substr(0, 6) == L"dword:") {
+					std::wstring_view digits = rest.substr(6);
+					DWORD value = 0;
+					if (digits.empty() || digits.length() > 8)
+						ThrowSyntax(fileName, reader.LineNumber(), L"invalid dword value");
+					for (wchar_t c : digits) {
+						int digit = HexDigit(c);
+						if (digit < 0)
+							ThrowSyntax(fileName, reader.LineNumber(), L"invalid dword value");
+						value = (value << 4) | digit;
+					}
+					batch.SetValue(root, path, name, value);
+				}
+				else if (rest.substr(0, 3) == L"hex") {
+					DWORD type = REG_BINARY;
+					size_t colon = rest.find(L':');
+					if (colon == std::wstring_view::npos)
+						ThrowSyntax(fileName, reader.LineNumber(), L"invalid hex value");
+					if (colon > 3) {
+						//hex(type):
+						std::wstring_view typeText = rest.substr(3, colon - 3);
+						if (typeText.length() < 3 || typeText.front() != L'(' || typeText.back() != L')')
+							ThrowSyntax(fileName, reader.LineNumber(), L"invalid value type");
+						type = 0;
+						for (wchar_t c : typeText.substr(1, typeText.length() - 2)) {
+							int digit = HexDigit(c);
+							if (digit < 0)
+								ThrowSyntax(fileName, reader.LineNumber(), L"invalid value type");
+							type = (type << 4) | digit;
+						}
+					}
+					if (!ParseHex(rest.substr(colon + 1), data))
+						ThrowSyntax(fileName, reader.LineNumber(), L"invalid hex data");
+					batch.SetValue(root, path, name, type, data.data(), (DWORD)data.size());
+				}
+				else
+					ThrowSyntax(fileName, reader.LineNumber(), L"unknown value type");
+				m_values++;
+			}
+			else
+				ThrowSyntax(fileName, reader.LineNumber(), L"unexpected text");
+
+			if (batch.Count() >= m_batchSize)
+				FlushBatch(batch, transaction, fileName);
+		}
+		FlushBatch(batch, transaction, fileName);
+	}
+
+	/////////////////////////////////////////////////////////////
+	//CRegFileExporter
+	/////////////////////////////////////////////////////////////
+
+	//Writes every key of a tree walk
+	class CExportVisitor : public IKeyVisitor
+	{
+		CRegFileExporter& m_exporter;
+
+	public:
+		CExportVisitor(CRegFileExporter& exporter) : m_exporter(exporter) {}
+
+		void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+		{
+			m_exporter.WriteKey(key.Path(), values);
+		}
+	};
+
+	//Quote a name or string, escaping quotes and backslashes
+	static void AppendQuoted(std::wstring& buffer, std::wstring_view text)
+	{
+		buffer += L'"';
+		const wchar_t* pos = text.data();
+		const wchar_t* end = pos + text.length();
+		for (;;) {
+			const wchar_t* special = FindEither(pos, end, L'"', L'\\');
+			buffer.append(pos, special);
+			if (special == end)
+				break;
+			buffer += L'\\';
+			buffer += *special;
+			pos = special + 1;
+		}
+		buffer += L'"';
+	}
+
+	CRegFileExporter::CRegFileExporter(const std::wstring& fileName) :
+		m_file(std::filesystem::path(fileName), std::ios::binary | std::ios::trunc),
+		m_fileName(fileName)
+	{
+		if (!m_file)
+			throw ExWin32Error(ERROR_OPEN_FAILED, L"Cannot create " + fileName);
+		m_buffer += (wchar_t)0xFEFF;
+		m_buffer += Regedit5Header;
+		m_buffer += L"\r\n";
+	}
+
+	CRegFileExporter::~CRegFileExporter()
+	{
+		try {
+			Close();
+		}
+		catch (...) {
+		}
+	}
+
+	void CRegFileExporter::Flush()
+	{
+		if (sizeof(wchar_t) == 2)
+			m_file.write(reinterpret_cast<const char*>(m_buffer.data()), m_buffer.length() * 2);
+		else {
+			std::vector<char> bytes(m_buffer.length() * 2);
+			for (size_t i = 0; i < m_buffer.length(); i++) {
+				bytes[2 * i] = (char)(m_buffer[i] & 0xFF);
+				bytes[2 * i + 1] = (char)((m_buffer[i] >> 8) & 0xFF);
+			}
+			m_file.write(bytes.data(), bytes.size());
+		}
+		m_buffer.clear();
+		if (!m_file)
+			throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot write " + m_fileName);
+	}
+
+	void CRegFileExporter::Close()
+	{
+		if (!m_file.is_open())
+			return;
+		Flush();
+		m_file.close();
+	}
+
+	void CRegFileExporter::Export(CHKey& root, CThreadPool& pool)
+	{
+		CExportVisitor visitor(*this);
+		CTreeWalker walker(pool);
+		walker.Walk(root, visitor);
+	}
+
+	//Write data as hex bytes, wrapped the way regedit does it
+	void CRegFileExporter::WriteHex(DWORD type, const BYTE* data, DWORD size, size_t column)
+	{
+		static const wchar_t* digits = L"0123456789abcdef";
+		if (type == REG_BINARY)
+			m_buffer += L"hex:";
+		else {
+			wchar_t typeText[16];
+			swprintf(typeText, 16, L"hex(%x):", type);
+			m_buffer += typeText;
+		}
+		column += 4;
+
+		for (DWORD i = 0; i < size; i++) {
+			m_buffer += digits[data[i] >> 4];
+			m_buffer += digits[data[i] & 0xF];
+			column += 2;
+			if (i + 1 < size) {
+				m_buffer += L',';
+				column++;
+				if (column > 76) {
+					m_buffer += L"\\\r\n  ";
+					column = 2;
+				}
+			}
+		}
+	}
+
+	void CRegFileExporter::WriteKey(const std::wstring& path, const CKeySnapshot& values)
+	{
+		//paths use the short root names, .reg files the full ones
+		std::wstring_view rest(path);
+		std::wstring_view rootName = rest.substr(0, rest.find(L'\\'));
+		m_buffer += L"\r\n[";
+		const CRootName* root = NULL;
+		for (const CRootName& candidate : RootNames) {
+			if (rootName == candidate.shortName)
+				root = &candidate;
+		}
+		if (root) {
+			m_buffer += root->name;
+			rest.remove_prefix(rootName.length());
+		}
+		m_buffer += rest;
+		m_buffer += L"]\r\n";
+
+		for (size_t i = 0; i < values.Count(); i++) {
+			size_t start = m_buffer.length();
+			std::wstring_view name = values.Name(i);
+			if (name.empty())
+				m_buffer += L'@';
+			else
+				AppendQuoted(m_buffer, name);
+			m_buffer += L'=';
+
+			DWORD type = values.Type(i);
+			DWORD size = values.DataSize(i);
+			const BYTE* data = values.Data(i);
+			const wchar_t* text = reinterpret_cast<const wchar_t*>(data);
+			size_t length = size / sizeof(wchar_t);
+
+			//strings are only written as text if that reads back as the same data,
+			//which a line break inside the quotes does not
+			if (type == REG_SZ && size % sizeof(wchar_t) == 0 && length > 0 &&
+				text[length - 1] == 0 && wcsnlen(text, length) == length - 1 &&
+				FindEither(text, text + length - 1, L'\r', L'\n') == text + length - 1)
+				AppendQuoted(m_buffer, std::wstring_view(text, length - 1));
+			else if (type == REG_DWORD && size == sizeof(DWORD)) {
+				wchar_t number[16];
+				swprintf(number, 16, L"dword:%08x", values.DWValue(i));
+				m_buffer += number;
+			}
+			else
+				WriteHex(type, data, size, m_buffer.length() - start);
+			m_buffer += L"\r\n";
+		}
+
+		if (m_buffer.length() >= BlockSize)
+			Flush();
+	}
+}
@@ -0,0 +1,93 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <fstream>
+#include <string>
+#include "HKey.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Applies a .reg file, as written by regedit, to a registry backend.
+	///
+	/// Both formats are accepted: 'Windows Registry Editor Version 5.00' (UTF-16) and
+	/// 'REGEDIT4' (the ANSI code page, or UTF-8 if it starts with a byte order mark).
+	/// The file is read in chunks and parsed one line at a time, so memory use does not
+	/// depend on the size of the file. Changes are collected in a CWriteBatch that is
+	/// applied every time it holds a given number of operations.
+	///
+	/// Supported: [key], [-key], "name"="string", @=..., dword:, hex:, hex(type): with
+	/// line continuations, "name"=- and ; comments.
+	/// </summary>
+	class CRegFileImporter
+	{
+		IRegBackend* m_backend;
+		size_t m_batchSize = 4096;
+		size_t m_keys = 0;
+		size_t m_values = 0;
+
+	public:
+		CRegFileImporter(IRegBackend* backend = NULL);      //NULL means the default backend
+
+		//Maximum number of operations that are applied at once
+		void SetBatchSize(size_t operations);
+
+		//Apply a .reg file. Throws on a syntax error, with the line number, or when a
+		//change cannot be applied.
+		//If a transaction is supplied, every batch becomes part of it. Otherwise each
+		//batch is committed on its own, and a failure leaves earlier batches applied.
+		void Import(const std::wstring& fileName, HANDLE transaction = INVALID_HANDLE_VALUE);
+
+		//Number of key and value lines in the last imported file
+		size_t KeyCount() const;
+		size_t ValueCount() const;
+	};
+
+	/// <summary>
+	/// Writes registry trees to a .reg file in the format of regedit: UTF-16 with a byte
+	/// order mark, 'Windows Registry Editor Version 5.00' and CRLF line endings.
+	/// Output is buffered and written in large blocks.
+	/// </summary>
+	class CRegFileExporter
+	{
+		std::ofstream m_file;
+		std::wstring m_fileName;
+		std::wstring m_buffer;
+
+		void Flush();
+		void WriteHex(DWORD type, const BYTE* data, DWORD size, size_t column);
+
+	public:
+		//Create or replace the file and write the header
+		CRegFileExporter(const std::wstring& fileName);
+		~CRegFileExporter();
+
+		CRegFileExporter(const CRegFileExporter&) = delete;
+		CRegFileExporter& operator = (const CRegFileExporter&) = delete;
+
+		//Write a key and everything below it
+		void Export(CHKey& root, CThreadPool& pool = CThreadPool::Default());
+
+		//Write a single key and its values
+		void WriteKey(const std::wstring& path, const CKeySnapshot& values);
+
+		//Write what is buffered to the file. Throws if that fails.
+		void Close();
+	};
+}
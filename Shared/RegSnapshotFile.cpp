@@ -0,0 +1,555 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "RegSnapshotFile.h"
+#include "TreeWalker.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+
+namespace w32
+{
+	/////////////////////////////////////////////////////////////
+	//File layout
+	//  header:  "RGSN", version (4 bytes), number of keys (8 bytes)
+	//  key:     shared path length, suffix length, suffix characters,
+	//           size of the value block, value block
+	//  values:  number of values, then for each value:
+	//           shared name length, suffix length, suffix characters,
+	//           type, data size, data
+	//Lengths, counts, types and sizes are variable length integers (7 bits per byte,
+	//low bits first). Characters are UTF-16 code units, little endian.
+	//Two keys with the same values have byte for byte identical value blocks.
+	/////////////////////////////////////////////////////////////
+
+	static const char SnapshotMagic[4] = { 'R', 'G', 'S', 'N' };
+	static const uint32_t SnapshotVersion = 1;
+	static const size_t HeaderSize = 16;
+
+	static void PutNumber(std::vector<BYTE>& buffer, uint64_t number)
+	{
+		while (number >= 0x80) {
+			buffer.push_back((BYTE)(number | 0x80));
+			number >>= 7;
+		}
+		buffer.push_back((BYTE)number);
+	}
+
+	static void PutChars(std::vector<BYTE>& buffer, std::wstring_view chars)
+	{
+		for (wchar_t c : chars) {
+			buffer.push_back((BYTE)(c & 0xFF));
+			buffer.push_back((BYTE)((c >> 8) & 0xFF));
+		}
+	}
+
+	//Number of leading characters that two strings have in common
+	static size_t SharedLength(std::wstring_view left, std::wstring_view right)
+	{
+		size_t length = (std::min)(left.length(), right.length());
+		size_t i = 0;
+		while (i < length && left[i] == right[i])
+			i++;
+		return i;
+	}
+
+	static void ThrowCorrupt()
+	{
+		throw AppException(std::string("The snapshot file is damaged"));
+	}
+
+	static uint64_t GetNumber(const BYTE*& pos, const BYTE* end)
+	{
+		uint64_t number = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (pos == end)
+				ThrowCorrupt();
+			BYTE b = *pos++;
+			number |= (uint64_t)(b & 0x7F) << shift;
+			if ((b & 0x80) == 0)
+				return number;
+		}
+		ThrowCorrupt();
+		return 0;
+	}
+
+	static const BYTE* GetBytes(const BYTE*& pos, const BYTE* end, uint64_t size)
+	{
+		if (size > (uint64_t)(end - pos))
+			ThrowCorrupt();
+		const BYTE* bytes = pos;
+		pos += size;
+		return bytes;
+	}
+
+	template<class T>
+	static void GetChars(const BYTE*& pos, const BYTE* end, uint64_t count, T& target)
+	{
+		//check before multiplying, so that a damaged count cannot wrap around
+		if (count > (uint64_t)(end - pos) / 2)
+			ThrowCorrupt();
+		const BYTE* chars = GetBytes(pos, end, count * 2);
+		for (uint64_t i = 0; i < count; i++)
+			target.push_back((wchar_t)(chars[2 * i] | (chars[2 * i + 1] << 8)));
+	}
+
+	int CompareKeyPaths(std::wstring_view left, std::wstring_view right)
+	{
+		//the separator sorts before everything else, so that "a\b" comes before "a b"
+		size_t length = (std::min)(left.length(), right.length());
+		for (size_t i = 0; i < length; i++) {
+			wchar_t l = left[i] == L'\\' ? 0 : ToWUpperChar(left[i]);
+			wchar_t r = right[i] == L'\\' ? 0 : ToWUpperChar(right[i]);
+			if (l != r)
+				return l < r ? -1 : 1;
+		}
+		if (left.length() == right.length())
+			return 0;
+		return left.length() < right.length() ? -1 : 1;
+	}
+
+	/////////////////////////////////////////////////////////////
+	//CRegSnapshotWriter
+	/////////////////////////////////////////////////////////////
+
+	//Bytes that are collected before they are written to the file
+	static const size_t StreamBufferSize = 1024 * 1024;
+
+	//Writes keys to a snapshot file in the order in which they are stored
+	class CSnapshotStream
+	{
+		std::wstring m_fileName;
+		std::ofstream m_file;
+		std::vector<BYTE> m_buffer;
+		std::wstring m_previous;
+		uint64_t m_keyCount = 0;
+
+		void Flush()
+		{
+			m_file.write((const char*)m_buffer.data(), m_buffer.size());
+			if (!m_file)
+				throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot write snapshot file " + m_fileName);
+			m_buffer.clear();
+		}
+
+	public:
+		CSnapshotStream(const std::wstring& fileName) :
+			m_fileName(fileName),
+			m_file(std::filesystem::path(fileName), std::ios::binary | std::ios::trunc)
+		{
+			if (!m_file)
+				throw ExWin32Error(ERROR_OPEN_FAILED, L"Cannot create snapshot file " + fileName);
+			m_buffer.reserve(StreamBufferSize);
+
+			//the key count is filled in by Close
+			m_buffer.resize(HeaderSize);
+			memcpy(m_buffer.data(), SnapshotMagic, 4);
+			for (int i = 0; i < 4; i++)
+				m_buffer[4 + i] = (BYTE)(SnapshotVersion >> (8 * i));
+		}
+
+		void Put(std::wstring_view path, const BYTE* values, size_t size)
+		{
+			if (m_keyCount > 0 && CompareKeyPaths(m_previous, path) >= 0)
+				throw AppException(std::string("The keys of a snapshot are not in order"));
+
+			size_t shared = SharedLength(m_previous, path);
+			PutNumber(m_buffer, shared);
+			PutNumber(m_buffer, path.length() - shared);
+			PutChars(m_buffer, path.substr(shared));
+			PutNumber(m_buffer, size);
+			m_buffer.insert(m_buffer.end(), values, values + size);
+			m_previous.assign(path);
+			m_keyCount++;
+
+			if (m_buffer.size() >= StreamBufferSize)
+				Flush();
+		}
+
+		uint64_t KeyCount() const
+		{
+			return m_keyCount;
+		}
+
+		void Close()
+		{
+			Flush();
+			BYTE count[8];
+			for (int i = 0; i < 8; i++)
+				count[i] = (BYTE)(m_keyCount >> (8 * i));
+			m_file.seekp(8);
+			m_file.write((const char*)count, sizeof(count));
+			m_file.flush();
+			if (!m_file)
+				throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot write snapshot file " + m_fileName);
+			m_file.close();
+		}
+	};
+
+	//Encodes the values of every key of a tree walk and writes them to a stream
+	class CSnapshotCollector : public IKeyVisitor
+	{
+		CSnapshotStream& m_stream;
+		std::vector<size_t> m_order;
+		std::vector<BYTE> m_values;
+
+	public:
+		CSnapshotCollector(CSnapshotStream& stream) : m_stream(stream) {}
+
+		void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+		{
+			m_order.resize(values.Count());
+			for (size_t i = 0; i < m_order.size(); i++)
+				m_order[i] = i;
+			std::sort(m_order.begin(), m_order.end(), [&](size_t l, size_t r) {
+				return CompareNoCase(values.Name(l), values.Name(r)) < 0;
+			});
+
+			m_values.clear();
+			PutNumber(m_values, values.Count());
+			std::wstring_view previous;
+			for (size_t i : m_order) {
+				std::wstring_view name = values.Name(i);
+				size_t shared = SharedLength(previous, name);
+				PutNumber(m_values, shared);
+				PutNumber(m_values, name.length() - shared);
+				PutChars(m_values, name.substr(shared));
+				PutNumber(m_values, values.Type(i));
+				PutNumber(m_values, values.DataSize(i));
+				m_values.insert(m_values.end(),
+					values.Data(i), values.Data(i) + values.DataSize(i));
+				previous = name;
+			}
+			m_stream.Put(key.Path(), m_values.data(), m_values.size());
+		}
+	};
+
+	CRegSnapshotWriter::CRegSnapshotWriter(const std::wstring& fileName, CThreadPool& pool) :
+		m_pool(pool),
+		m_fileName(fileName)
+	{
+	}
+
+	CRegSnapshotWriter::~CRegSnapshotWriter()
+	{
+		std::error_code error;
+		for (std::wstring& run : m_runs)
+			std::filesystem::remove(std::filesystem::path(run), error);
+	}
+
+	void CRegSnapshotWriter::Add(CHKey& root)
+	{
+		std::wstring run = m_fileName + L"." + std::to_wstring(m_runs.size()) + L".run";
+		try {
+			//the walk visits subkeys in the order in which they are stored,
+			//so the run comes out sorted
+			CSnapshotStream stream(run);
+			CSnapshotCollector collector(stream);
+			CTreeWalker walker(m_pool);
+			walker.SetOrder(CompareKeyPaths);
+			walker.Walk(root, collector);
+			stream.Close();
+			m_keyCount += (size_t)stream.KeyCount();
+		}
+		catch (...) {
+			std::error_code error;
+			std::filesystem::remove(std::filesystem::path(run), error);
+			throw;
+		}
+		m_runs.push_back(run);
+	}
+
+	size_t CRegSnapshotWriter::KeyCount() const
+	{
+		return m_keyCount;
+	}
+
+	void CRegSnapshotWriter::Save()
+	{
+		{
+			std::vector<std::unique_ptr<CRegSnapshotFile>> files;
+			std::vector<CRegSnapshotFile::CCursor> cursors;
+			std::vector<bool> more;
+			for (std::wstring& run : m_runs) {
+				files.push_back(std::make_unique<CRegSnapshotFile>(run));
+				cursors.push_back(files.back()->Keys());
+				more.push_back(cursors.back().Next());
+			}
+
+			//Merge the runs. Of a key that is in more than one run, the copy from the
+			//run that was added last is kept.
+			CSnapshotStream stream(m_fileName);
+			for (;;) {
+				size_t next = SIZE_MAX;
+				for (size_t i = 0; i < cursors.size(); i++) {
+					if (more[i] && (next == SIZE_MAX ||
+						CompareKeyPaths(cursors[i].Path(), cursors[next].Path()) <= 0))
+						next = i;
+				}
+				if (next == SIZE_MAX)
+					break;
+
+				CRegSnapshotFile::CCursor& key = cursors[next];
+				stream.Put(key.Path(), key.m_block, key.m_blockSize);
+				for (size_t i = 0; i < cursors.size(); i++) {
+					if (i != next && more[i] && CompareKeyPaths(cursors[i].Path(), key.Path()) == 0)
+						more[i] = cursors[i].Next();
+				}
+				more[next] = key.Next();
+			}
+			stream.Close();
+			m_keyCount = (size_t)stream.KeyCount();
+		}
+
+		std::error_code error;
+		for (std::wstring& run : m_runs)
+			std::filesystem::remove(std::filesystem::path(run), error);
+		m_runs.clear();
+	}
+
+	/////////////////////////////////////////////////////////////
+	//CRegSnapshotFile
+	/////////////////////////////////////////////////////////////
+
+	CRegSnapshotFile::CRegSnapshotFile(const std::wstring& fileName) : m_file(fileName)
+	{
+		const BYTE* data = m_file.Data();
+		if (m_file.Size() < HeaderSize || memcmp(data, SnapshotMagic, 4) != 0)
+			throw AppException(fileName + L" is not a registry snapshot file");
+
+		uint32_t version = 0;
+		for (int i = 0; i < 4; i++)
+			version |= (uint32_t)data[4 + i] << (8 * i);
+		if (version != SnapshotVersion)
+			throw AppException(fileName + L" has an unsupported snapshot version");
+
+		uint64_t keyCount = 0;
+		for (int i = 0; i < 8; i++)
+			keyCount |= (uint64_t)data[8 + i] << (8 * i);
+		m_keyCount = (size_t)keyCount;
+	}
+
+	size_t CRegSnapshotFile::KeyCount() const
+	{
+		return m_keyCount;
+	}
+
+	CRegSnapshotFile::CCursor CRegSnapshotFile::Keys() const
+	{
+		return CCursor(m_file.Data() + HeaderSize, m_file.Data() + m_file.Size(), m_keyCount);
+	}
+
+	CRegSnapshotFile::CCursor::CCursor(const BYTE* pos, const BYTE* end, size_t keyCount) :
+		m_pos(pos), m_end(end), m_remaining(keyCount)
+	{
+	}
+
+	bool CRegSnapshotFile::CCursor::Next()
+	{
+		if (m_remaining == 0) {
+			if (m_pos != m_end)
+				ThrowCorrupt();
+			return false;
+		}
+		m_remaining--;
+
+		uint64_t shared = GetNumber(m_pos, m_end);
+		uint64_t suffix = GetNumber(m_pos, m_end);
+		if (shared > m_path.length())
+			ThrowCorrupt();
+		m_previous.swap(m_path);
+		m_path.assign(m_previous, 0, (size_t)shared);
+		GetChars(m_pos, m_end, suffix, m_path);
+		if (!m_previous.empty() && CompareKeyPaths(m_previous, m_path) >= 0)
+			ThrowCorrupt();
+
+		uint64_t blockSize = GetNumber(m_pos, m_end);
+		m_block = GetBytes(m_pos, m_end, blockSize);
+		m_blockSize = (size_t)blockSize;
+		m_decoded = false;
+		return true;
+	}
+
+	std::wstring_view CRegSnapshotFile::CCursor::Path() const
+	{
+		return m_path;
+	}
+
+	//Values are only decoded when they are asked for
+	void CRegSnapshotFile::CCursor::Decode() const
+	{
+		if (m_decoded)
+			return;
+
+		const BYTE* pos = m_block;
+		const BYTE* end = m_block + m_blockSize;
+		uint64_t count = GetNumber(pos, end);
+		if (count > m_blockSize)
+			ThrowCorrupt();
+
+		//the name buffer may move while it grows, so the views are made afterwards
+		m_names.clear();
+		m_nameOffsets.clear();
+		m_values.resize((size_t)count);
+		size_t previousOffset = 0;
+		size_t previousLength = 0;
+		for (CSnapshotValue& value : m_values) {
+			uint64_t shared = GetNumber(pos, end);
+			uint64_t suffix = GetNumber(pos, end);
+			if (shared > previousLength)
+				ThrowCorrupt();
+			size_t offset = m_names.size();
+			for (size_t i = 0; i < shared; i++)
+				m_names.push_back(m_names[previousOffset + i]);
+			GetChars(pos, end, suffix, m_names);
+			m_nameOffsets.push_back(offset);
+
+			value.Type = (DWORD)GetNumber(pos, end);
+			uint64_t size = GetNumber(pos, end);
+			value.Data = GetBytes(pos, end, size);
+			value.Size = (DWORD)size;
+
+			previousOffset = offset;
+			previousLength = m_names.size() - offset;
+		}
+
+		for (size_t i = 0; i < m_values.size(); i++) {
+			size_t next = i + 1 < m_values.size() ? m_nameOffsets[i + 1] : m_names.size();
+			m_values[i].Name = std::wstring_view(m_names.data() + m_nameOffsets[i],
+				next - m_nameOffsets[i]);
+		}
+		m_decoded = true;
+	}
+
+	size_t CRegSnapshotFile::CCursor::ValueCount() const
+	{
+		Decode();
+		return m_values.size();
+	}
+
+	const CSnapshotValue& CRegSnapshotFile::CCursor::Value(size_t index) const
+	{
+		Decode();
+		return m_values[index];
+	}
+
+	bool CRegSnapshotFile::CCursor::SameValues(const CCursor& other) const
+	{
+		return m_blockSize == other.m_blockSize &&
+			memcmp(m_block, other.m_block, m_blockSize) == 0;
+	}
+
+	/////////////////////////////////////////////////////////////
+	//Diff
+	/////////////////////////////////////////////////////////////
+
+	static bool SameData(const CSnapshotValue& left, const CSnapshotValue& right)
+	{
+		return left.Type == right.Type && left.Size == right.Size &&
+			memcmp(left.Data, right.Data, left.Size) == 0;
+	}
+
+	//Report every value of a key that was added or removed
+	static size_t DiffAllValues(const CRegSnapshotFile::CCursor& key, bool added, ISnapshotDiff& diff)
+	{
+		for (size_t i = 0; i < key.ValueCount(); i++) {
+			if (added)
+				diff.OnValueChanged(key.Path(), NULL, &key.Value(i));
+			else
+				diff.OnValueChanged(key.Path(), &key.Value(i), NULL);
+		}
+		return key.ValueCount();
+	}
+
+	//Merge the sorted values of a key that exists in both snapshots
+	static size_t DiffValues(const CRegSnapshotFile::CCursor& before,
+		const CRegSnapshotFile::CCursor& after, ISnapshotDiff& diff)
+	{
+		size_t differences = 0;
+		size_t b = 0;
+		size_t a = 0;
+		while (b < before.ValueCount() || a < after.ValueCount()) {
+			int order;
+			if (b == before.ValueCount())
+				order = 1;
+			else if (a == after.ValueCount())
+				order = -1;
+			else
+				order = CompareNoCase(before.Value(b).Name, after.Value(a).Name);
+
+			if (order < 0) {
+				diff.OnValueChanged(after.Path(), &before.Value(b++), NULL);
+				differences++;
+			}
+			else if (order > 0) {
+				diff.OnValueChanged(after.Path(), NULL, &after.Value(a++));
+				differences++;
+			}
+			else {
+				if (!SameData(before.Value(b), after.Value(a))) {
+					diff.OnValueChanged(after.Path(), &before.Value(b), &after.Value(a));
+					differences++;
+				}
+				b++;
+				a++;
+			}
+		}
+		return differences;
+	}
+
+	size_t DiffSnapshots(const CRegSnapshotFile& before, const CRegSnapshotFile& after,
+		ISnapshotDiff& diff)
+	{
+		size_t differences = 0;
+		CRegSnapshotFile::CCursor b = before.Keys();
+		CRegSnapshotFile::CCursor a = after.Keys();
+		bool haveBefore = b.Next();
+		bool haveAfter = a.Next();
+		while (haveBefore || haveAfter) {
+			int order;
+			if (!haveBefore)
+				order = 1;
+			else if (!haveAfter)
+				order = -1;
+			else
+				order = CompareKeyPaths(b.Path(), a.Path());
+
+			if (order < 0) {
+				diff.OnKeyRemoved(b.Path());
+				differences += 1 + DiffAllValues(b, false, diff);
+				haveBefore = b.Next();
+			}
+			else if (order > 0) {
+				diff.OnKeyAdded(a.Path());
+				differences += 1 + DiffAllValues(a, true, diff);
+				haveAfter = a.Next();
+			}
+			else {
+				//most keys are unchanged, and then their value blocks are identical
+				if (!b.SameValues(a))
+					differences += DiffValues(b, a, diff);
+				haveBefore = b.Next();
+				haveAfter = a.Next();
+			}
+		}
+		return differences;
+	}
+}
@@ -0,0 +1,167 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "HKey.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Saves one or more registry trees as a binary snapshot file.
+	///
+	/// Keys are stored by their full path (e.g. HKEY_LOCAL_MACHINE\Software\...), sorted
+	/// case insensitively so that a key is followed by everything below it. Each path
+	/// only stores the part that differs from the path before it. The values of a key
+	/// are sorted by name and prefix compressed the same way, followed by their type
+	/// and raw data. Sizes and counts are stored as variable length integers.
+	///
+	/// Keys are written out as the walk produces them, through a buffer of a fixed size.
+	/// Each tree is walked with its subkeys in sorted order and written to a run file next
+	/// to the snapshot file; Save merges the runs into the snapshot file one key at a time.
+	/// So memory use does not grow with the number of keys.
+	/// </summary>
+	class CRegSnapshotWriter
+	{
+		CThreadPool& m_pool;
+		std::wstring m_fileName;
+		std::vector<std::wstring> m_runs;       //one file for every tree that was added
+		size_t m_keyCount = 0;
+
+	public:
+		CRegSnapshotWriter(const std::wstring& fileName, CThreadPool& pool = CThreadPool::Default());
+
+		//Removes the run files if Save was not called
+		~CRegSnapshotWriter();
+
+		CRegSnapshotWriter(const CRegSnapshotWriter&) = delete;
+		CRegSnapshotWriter& operator = (const CRegSnapshotWriter&) = delete;
+
+		//Add a key and everything below it
+		void Add(CHKey& root);
+
+		//Number of keys added so far. After Save, keys that were added more than once
+		//are counted once.
+		size_t KeyCount() const;
+
+		//Write all keys to the file, replacing it if it exists. A key that was added
+		//more than once is saved as it was added last.
+		void Save();
+	};
+
+	/// <summary>
+	/// A value read from a snapshot file. The data points into the mapped file.
+	/// </summary>
+	struct CSnapshotValue
+	{
+		std::wstring_view Name;
+		DWORD Type;
+		const BYTE* Data;
+		DWORD Size;
+	};
+
+	/// <summary>
+	/// A snapshot file, mapped into memory. Keys are read one after the other with a
+	/// cursor, in the order in which they were saved.
+	/// </summary>
+	class CRegSnapshotFile
+	{
+		CMappedFile m_file;
+		size_t m_keyCount = 0;
+
+	public:
+		/// <summary>
+		/// Position in a snapshot file. Decodes one key at a time; the path and value
+		/// names are only valid until the next call to Next.
+		/// </summary>
+		class CCursor
+		{
+			const BYTE* m_pos;
+			const BYTE* m_end;
+			size_t m_remaining;                     //keys that the header promises after this one
+			std::wstring m_path;
+			std::wstring m_previous;
+			const BYTE* m_block = NULL;             //encoded values of the current key
+			size_t m_blockSize = 0;
+
+			mutable bool m_decoded = false;
+			mutable std::vector<wchar_t> m_names;
+			mutable std::vector<size_t> m_nameOffsets;
+			mutable std::vector<CSnapshotValue> m_values;
+
+			void Decode() const;
+
+			friend class CRegSnapshotWriter;
+
+		public:
+			CCursor(const BYTE* pos, const BYTE* end, size_t keyCount);
+
+			//Move to the next key. Returns false after the last key. Throws if the file
+			//ends before the number of keys in its header, or the keys are out of order.
+			bool Next();
+
+			std::wstring_view Path() const;
+			size_t ValueCount() const;
+			const CSnapshotValue& Value(size_t index) const;
+
+			//Does the other key have exactly the same values. Compares the encoded
+			//values, without decoding them.
+			bool SameValues(const CCursor& other) const;
+		};
+
+		//Map a snapshot file. Throws if it is not a snapshot file.
+		CRegSnapshotFile(const std::wstring& fileName);
+
+		//Number of keys in the file
+		size_t KeyCount() const;
+
+		//A cursor before the first key
+		CCursor Keys() const;
+	};
+
+	/// <summary>
+	/// Receives the differences found by DiffSnapshots.
+	/// The keys of both files are walked in sorted order, so differences are reported
+	/// in that order too. Added and removed keys also report each of their values.
+	/// </summary>
+	class ISnapshotDiff
+	{
+	public:
+		virtual ~ISnapshotDiff() {}
+
+		virtual void OnKeyAdded(std::wstring_view path) = 0;
+		virtual void OnKeyRemoved(std::wstring_view path) = 0;
+
+		//before is NULL for a value that was added, after is NULL for one that was removed
+		virtual void OnValueChanged(std::wstring_view path,
+			const CSnapshotValue* before, const CSnapshotValue* after) = 0;
+	};
+
+	//Compare two snapshots in one pass over both files.
+	//Returns the number of keys and values that differ.
+	size_t DiffSnapshots(const CRegSnapshotFile& before, const CRegSnapshotFile& after,
+		ISnapshotDiff& diff);
+
+	//Order in which keys are stored: case insensitive, with a parent directly
+	//followed by its subkeys
+	int CompareKeyPaths(std::wstring_view left, std::wstring_view right);
+}
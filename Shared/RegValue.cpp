@@ -0,0 +1,167 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "RegValue.h"
+#include "Exception.h"
+#include <cwchar>
+
+namespace w32
+{
+	/////////////////////////////////////////////////////////////
+	//CMultiString
+	/////////////////////////////////////////////////////////////
+
+	CMultiString::CIterator::CIterator(const wchar_t* pos, const wchar_t* end) :
+		m_pos(pos), m_end(end)
+	{
+		m_length = m_pos < m_end ? wcsnlen(m_pos, m_end - m_pos) : 0;
+		if (m_length == 0)
+			m_pos = NULL;
+	}
+
+	std::wstring_view CMultiString::CIterator::operator*() const
+	{
+		return std::wstring_view(m_pos, m_length);
+	}
+
+	CMultiString::CIterator& CMultiString::CIterator::operator++()
+	{
+		*this = CIterator(m_pos + m_length + 1, m_end);
+		return *this;
+	}
+
+	CMultiString::CIterator CMultiString::CIterator::operator++(int)
+	{
+		CIterator previous = *this;
+		++*this;
+		return previous;
+	}
+
+	bool CMultiString::CIterator::operator==(const CIterator& other) const
+	{
+		return m_pos == other.m_pos;
+	}
+
+	CMultiString::CMultiString(const wchar_t* data, size_t length) :
+		m_begin(data), m_end(data + length)
+	{
+	}
+
+	CMultiString::CIterator CMultiString::begin() const
+	{
+		return CIterator(m_begin, m_end);
+	}
+
+	CMultiString::CIterator CMultiString::end() const
+	{
+		return CIterator();
+	}
+
+	size_t CMultiString::Count() const
+	{
+		size_t count = 0;
+		for (CIterator it = begin(); it != end(); ++it)
+			count++;
+		return count;
+	}
+
+	/////////////////////////////////////////////////////////////
+	//CRegValue
+	/////////////////////////////////////////////////////////////
+
+	CRegValue::CRegValue(DWORD type, const BYTE* data, DWORD size) :
+		m_type(type), m_data(data), m_size(size)
+	{
+	}
+
+	DWORD CRegValue::Type() const
+	{
+		return m_type;
+	}
+
+	std::span<const BYTE> CRegValue::Binary() const
+	{
+		return std::span<const BYTE>(m_data, m_size);
+	}
+
+	std::wstring_view CRegValue::String() const
+	{
+		if (m_type != REG_SZ && m_type != REG_EXPAND_SZ)
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
+
+		//REG_SZ may or may not be stored with a 0 termination
+		const wchar_t* str = reinterpret_cast<const wchar_t*>(m_data);
+		size_t length = m_size / sizeof(wchar_t);
+		while (length > 0 && str[length - 1] == L'\0')
+			length--;
+		return std::wstring_view(str, length);
+	}
+
+	DWORD CRegValue::DWord() const
+	{
+		if ((m_type != REG_DWORD && m_type != REG_DWORD_BIG_ENDIAN) || m_size != sizeof(DWORD))
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
+
+		DWORD value = *reinterpret_cast<const DWORD*>(m_data);
+		if (m_type == REG_DWORD_BIG_ENDIAN)
+			value = (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+		return value;
+	}
+
+	ULONGLONG CRegValue::QWord() const
+	{
+		if (m_type != REG_QWORD || m_size != sizeof(ULONGLONG))
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
+		return *reinterpret_cast<const ULONGLONG*>(m_data);
+	}
+
+	CMultiString CRegValue::MultiString() const
+	{
+		if (m_type != REG_MULTI_SZ)
+			throw ExWin32Error(ERROR_UNSUPPORTED_TYPE);
+		return CMultiString(reinterpret_cast<const wchar_t*>(m_data), m_size / sizeof(wchar_t));
+	}
+
+	void VisitValue(std::wstring_view name, const CRegValue& value, IValueVisitor& visitor)
+	{
+		DWORD size = (DWORD)value.Binary().size();
+		switch (value.Type())
+		{
+		case REG_SZ:
+		case REG_EXPAND_SZ:
+			visitor.OnString(name, value.String(), value.Type() == REG_EXPAND_SZ);
+			return;
+		case REG_DWORD:
+		case REG_DWORD_BIG_ENDIAN:
+			if (size == sizeof(DWORD)) {
+				visitor.OnDWord(name, value.DWord());
+				return;
+			}
+			break;
+		case REG_QWORD:
+			if (size == sizeof(ULONGLONG)) {
+				visitor.OnQWord(name, value.QWord());
+				return;
+			}
+			break;
+		case REG_MULTI_SZ:
+			visitor.OnMultiString(name, value.MultiString());
+			return;
+		}
+		visitor.OnBinary(name, value.Type(), value.Binary());
+	}
+}
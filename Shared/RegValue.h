@@ -0,0 +1,122 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <iterator>
+#include <span>
+#include <string_view>
+
+namespace w32
+{
+	/// <summary>
+	/// The strings of a REG_MULTI_SZ value, for use in range based for loops.
+	/// The strings are views into the value data; nothing is copied.
+	/// The list ends at the first empty string or at the end of the data, whichever
+	/// comes first, so missing terminators are tolerated.
+	/// </summary>
+	class CMultiString
+	{
+		const wchar_t* m_begin;
+		const wchar_t* m_end;
+
+	public:
+		class CIterator
+		{
+			const wchar_t* m_pos = NULL;        //NULL at the end
+			const wchar_t* m_end = NULL;
+			size_t m_length = 0;
+
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = std::wstring_view;
+			using difference_type = ptrdiff_t;
+			using pointer = const std::wstring_view*;
+			using reference = std::wstring_view;
+
+			CIterator() {}
+			CIterator(const wchar_t* pos, const wchar_t* end);
+
+			std::wstring_view operator*() const;
+			CIterator& operator++();
+			CIterator operator++(int);
+			bool operator==(const CIterator& other) const;
+		};
+
+		CMultiString(const wchar_t* data, size_t length);
+
+		CIterator begin() const;
+		CIterator end() const;
+
+		//Number of strings
+		size_t Count() const;
+	};
+
+	/// <summary>
+	/// Typed view of the data of a registry value. It does not own the data: it refers
+	/// to the buffer that the value was read into, e.g. a CKeySnapshot or a buffer that
+	/// is passed to CHKey::GetValue, and is only valid as long as that buffer is.
+	/// The data must be aligned for its type, which those buffers are.
+	///
+	/// The typed accessors throw ERROR_UNSUPPORTED_TYPE if the value has a different type.
+	/// </summary>
+	class CRegValue
+	{
+		DWORD m_type;
+		const BYTE* m_data;
+		DWORD m_size;
+
+	public:
+		CRegValue(DWORD type, const BYTE* data, DWORD size);
+
+		DWORD Type() const;
+
+		//The raw data, whatever the type
+		std::span<const BYTE> Binary() const;
+
+		//REG_SZ or REG_EXPAND_SZ, without terminator. Environment variables are not expanded.
+		std::wstring_view String() const;
+
+		//REG_DWORD, or REG_DWORD_BIG_ENDIAN converted to the native order
+		DWORD DWord() const;
+
+		//REG_QWORD
+		ULONGLONG QWord() const;
+
+		//REG_MULTI_SZ
+		CMultiString MultiString() const;
+	};
+
+	/// <summary>
+	/// Receives a value with its data in the form that fits its type.
+	/// Any type without a dedicated method - REG_BINARY, REG_NONE, REG_LINK, resource
+	/// lists, and data that does not match its type - goes to OnBinary.
+	/// </summary>
+	class IValueVisitor
+	{
+	public:
+		virtual ~IValueVisitor() {}
+
+		virtual void OnString(std::wstring_view name, std::wstring_view value, bool expand) = 0;
+		virtual void OnDWord(std::wstring_view name, DWORD value) = 0;
+		virtual void OnQWord(std::wstring_view name, ULONGLONG value) = 0;
+		virtual void OnMultiString(std::wstring_view name, const CMultiString& value) = 0;
+		virtual void OnBinary(std::wstring_view name, DWORD type, std::span<const BYTE> value) = 0;
+	};
+
+	//Call the visitor method that fits the type of the value
+	void VisitValue(std::wstring_view name, const CRegValue& value, IValueVisitor& visitor);
+}
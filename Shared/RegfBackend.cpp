@@ -0,0 +1,615 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "RegfBackend.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <climits>
+#include <vector>
+
+using namespace std;
+
+namespace w32
+{
+	namespace
+	{
+		//Layout of the regf format. All offsets are relative to the start of a structure.
+		//Cell offsets inside the file are relative to the first hive bin.
+		const size_t BASE_BLOCK_SIZE = 0x1000;
+		const size_t BASE_MINOR_VERSION = 0x18;
+		const size_t BASE_ROOT_CELL = 0x24;
+		const size_t BASE_BINS_SIZE = 0x28;
+
+		const size_t NK_FLAGS = 0x02;
+		const size_t NK_LAST_WRITE = 0x04;
+		const size_t NK_NUM_SUBKEYS = 0x14;
+		const size_t NK_SUBKEY_LIST = 0x1C;
+		const size_t NK_NUM_VALUES = 0x24;
+		const size_t NK_VALUE_LIST = 0x28;
+		const size_t NK_NAME_LENGTH = 0x48;
+		const size_t NK_NAME = 0x4C;
+		const WORD KEY_COMP_NAME = 0x0020;
+
+		const size_t VK_NAME_LENGTH = 0x02;
+		const size_t VK_DATA_SIZE = 0x04;
+		const size_t VK_DATA_OFFSET = 0x08;
+		const size_t VK_TYPE = 0x0C;
+		const size_t VK_FLAGS = 0x10;
+		const size_t VK_NAME = 0x14;
+		const WORD VALUE_COMP_NAME = 0x0001;
+		const DWORD DATA_INLINE = 0x80000000;
+
+		//values larger than this are split into segments in hives of version 1.4 and up
+		const DWORD BIG_DATA_SEGMENT = 16344;
+
+		const DWORD NO_CELL = 0xFFFFFFFF;
+
+		template<class T>
+		T ReadLE(const BYTE* p)
+		{
+			T value;
+			memcpy(&value, p, sizeof(T));
+			return value;
+		}
+
+		bool HasSignature(const BYTE* p, const char* signature)
+		{
+			return p[0] == (BYTE)signature[0] && p[1] == (BYTE)signature[1];
+		}
+
+		//A key or value name as it is stored in the hive: either one byte per
+		//character (Latin-1) or UTF-16LE
+		struct CCellName
+		{
+			const BYTE* Data;
+			size_t Length;  //in characters
+			bool Compressed;
+
+			wchar_t At(size_t i) const {
+				return Compressed ? (wchar_t)Data[i] : (wchar_t)ReadLE<WORD>(Data + 2 * i);
+			}
+
+			int Compare(wstring_view other) const {
+				size_t length = min(Length, other.length());
+				for (size_t i = 0; i < length; i++) {
+					wchar_t a = ToWUpperChar(At(i));
+					wchar_t b = ToWUpperChar(other[i]);
+					if (a != b)
+						return (a < b) ? -1 : 1;
+				}
+				if (Length == other.length())
+					return 0;
+				return (Length < other.length()) ? -1 : 1;
+			}
+
+			//copy into a caller supplied buffer, using the conventions of RegEnumKeyEx
+			LSTATUS CopyTo(LPWSTR buffer, DWORD* bufferLength) const {
+				if (buffer == NULL || *bufferLength <= Length) {
+					*bufferLength = (DWORD)Length;
+					return ERROR_MORE_DATA;
+				}
+				for (size_t i = 0; i < Length; i++)
+					buffer[i] = At(i);
+				buffer[Length] = L'\0';
+				*bufferLength = (DWORD)Length;
+				return ERROR_SUCCESS;
+			}
+		};
+
+		//A key or value cell is only used when its fixed part and its name fit
+		//inside the cell. After that the name can be read without further checks.
+		bool IsKeyCell(const BYTE* cell, DWORD size)
+		{
+			return cell != NULL && size >= NK_NAME && HasSignature(cell, "nk") &&
+				NK_NAME + (size_t)ReadLE<WORD>(cell + NK_NAME_LENGTH) <= size;
+		}
+
+		bool IsValueCell(const BYTE* cell, DWORD size)
+		{
+			return cell != NULL && size >= VK_NAME && HasSignature(cell, "vk") &&
+				VK_NAME + (size_t)ReadLE<WORD>(cell + VK_NAME_LENGTH) <= size;
+		}
+
+		CCellName KeyName(const BYTE* keyCell)
+		{
+			WORD length = ReadLE<WORD>(keyCell + NK_NAME_LENGTH);
+			bool compressed = (ReadLE<WORD>(keyCell + NK_FLAGS) & KEY_COMP_NAME) != 0;
+			return { keyCell + NK_NAME, compressed ? length : length / 2u, compressed };
+		}
+
+		CCellName ValueName(const BYTE* valueCell)
+		{
+			WORD length = ReadLE<WORD>(valueCell + VK_NAME_LENGTH);
+			bool compressed = (ReadLE<WORD>(valueCell + VK_FLAGS) & VALUE_COMP_NAME) != 0;
+			return { valueCell + VK_NAME, compressed ? length : length / 2u, compressed };
+		}
+	}
+
+	CRegfBackend::CRegfBackend(const std::wstring& path) : m_file(path)
+	{
+		const BYTE* data = m_file.Data();
+		if (m_file.Size() < BASE_BLOCK_SIZE || memcmp(data, "regf", 4) != 0)
+			throw AppException(path + L" is not a registry hive file");
+
+		m_minorVersion = ReadLE<DWORD>(data + BASE_MINOR_VERSION);
+		m_rootCell = ReadLE<DWORD>(data + BASE_ROOT_CELL);
+		m_bins = data + BASE_BLOCK_SIZE;
+
+		//Trust the header for the size of the bins, but never look past the end of the file.
+		//Truncated hives are common in disk images, and whatever is there is still usable.
+		m_binsSize = min((size_t)ReadLE<DWORD>(data + BASE_BINS_SIZE), m_file.Size() - BASE_BLOCK_SIZE);
+
+		DWORD size = 0;
+		const BYTE* root = Cell(m_rootCell, &size);
+		if (!IsKeyCell(root, size))
+			throw AppException(path + L" does not have a valid root key");
+	}
+
+	//Get the data of a cell and its usable size. Returns NULL for offsets that
+	//point outside of the hive bins.
+	const BYTE* CRegfBackend::Cell(DWORD offset, DWORD* size)
+	{
+		if (offset == NO_CELL || (size_t)offset + 4 > m_binsSize)
+			return NULL;
+
+		//allocated cells have a negative size. INT_MIN cannot be negated.
+		int rawSize = ReadLE<int>(m_bins + offset);
+		if (rawSize == INT_MIN)
+			return NULL;
+		DWORD cellSize = (DWORD)(rawSize < 0 ? -rawSize : rawSize);
+		if (cellSize < 4 || (size_t)offset + cellSize > m_binsSize)
+			return NULL;
+
+		if (size)
+			*size = cellSize - 4;
+		return m_bins + offset + 4;
+	}
+
+	//Translate a HKEY to the key cell it points to
+	const BYTE* CRegfBackend::KeyCell(HKEY key)
+	{
+		const BYTE* cell = reinterpret_cast<const BYTE*>(key);
+		if (cell >= m_bins + 4 && cell < m_bins + m_binsSize) {
+			DWORD size = 0;
+			const BYTE* keyCell = Cell((DWORD)(cell - m_bins - 4), &size);
+			return IsKeyCell(keyCell, size) ? keyCell : NULL;
+		}
+
+		//every predefined key is mapped to the root of the hive
+		if (key == HKEY_LOCAL_MACHINE || key == HKEY_CURRENT_USER ||
+			key == HKEY_USERS || key == HKEY_CLASSES_ROOT ||
+			key == HKEY_CURRENT_CONFIG || key == HKEY_CURRENT_USER_LOCAL_SETTINGS)
+			return Cell(m_rootCell, NULL);
+
+		return NULL;
+	}
+
+	HKEY CRegfBackend::ToHandle(const BYTE* keyCell)
+	{
+		return reinterpret_cast<HKEY>(const_cast<BYTE*>(keyCell));
+	}
+
+	//Get the subkey at a specific index. Subkey lists are either a single
+	//leaf list (lf, lh, li) or an index root (ri) that points to leaf lists.
+	const BYTE* CRegfBackend::SubKeyAt(const BYTE* keyCell, DWORD index)
+	{
+		DWORD listOffset = ReadLE<DWORD>(keyCell + NK_SUBKEY_LIST);
+		for (int depth = 0; depth < 2; depth++) {
+			DWORD size = 0;
+			const BYTE* list = Cell(listOffset, &size);
+			if (list == NULL || size < 4)
+				return NULL;
+
+			WORD count = ReadLE<WORD>(list + 2);
+			if (HasSignature(list, "lf") || HasSignature(list, "lh")) {
+				if (index >= count || 4 + (size_t)count * 8 > size)
+					return NULL;
+				const BYTE* key = Cell(ReadLE<DWORD>(list + 4 + index * 8), &size);
+				return IsKeyCell(key, size) ? key : NULL;
+			}
+			if (HasSignature(list, "li")) {
+				if (index >= count || 4 + (size_t)count * 4 > size)
+					return NULL;
+				const BYTE* key = Cell(ReadLE<DWORD>(list + 4 + index * 4), &size);
+				return IsKeyCell(key, size) ? key : NULL;
+			}
+			if (!HasSignature(list, "ri") || 4 + (size_t)count * 4 > size)
+				return NULL;
+
+			//find the leaf list that contains the index
+			listOffset = NO_CELL;
+			for (WORD i = 0; i < count; i++) {
+				DWORD leafOffset = ReadLE<DWORD>(list + 4 + i * 4);
+				DWORD leafSize = 0;
+				const BYTE* leaf = Cell(leafOffset, &leafSize);
+				if (leaf == NULL || leafSize < 4)
+					return NULL;
+				WORD leafCount = ReadLE<WORD>(leaf + 2);
+				if (index < leafCount) {
+					listOffset = leafOffset;
+					break;
+				}
+				index -= leafCount;
+			}
+		}
+		return NULL;
+	}
+
+	//Look for a subkey by name in a subkey list. Leaf lists are sorted by
+	//uppercase name, which allows a binary search.
+	LSTATUS CRegfBackend::FindInList(DWORD listOffset, wstring_view name, int depth, const BYTE** result)
+	{
+		DWORD size = 0;
+		const BYTE* list = Cell(listOffset, &size);
+		if (list == NULL || size < 4)
+			return ERROR_REGISTRY_CORRUPT;
+
+		WORD count = ReadLE<WORD>(list + 2);
+		if (HasSignature(list, "ri")) {
+			if (depth > 0 || 4 + (size_t)count * 4 > size)
+				return ERROR_REGISTRY_CORRUPT;
+			for (WORD i = 0; i < count; i++) {
+				LSTATUS retVal = FindInList(ReadLE<DWORD>(list + 4 + i * 4), name, depth + 1, result);
+				if (retVal != ERROR_FILE_NOT_FOUND)
+					return retVal;
+			}
+			return ERROR_FILE_NOT_FOUND;
+		}
+
+		size_t stride = 0;
+		if (HasSignature(list, "lf") || HasSignature(list, "lh"))
+			stride = 8;
+		else if (HasSignature(list, "li"))
+			stride = 4;
+		if (stride == 0 || 4 + (size_t)count * stride > size)
+			return ERROR_REGISTRY_CORRUPT;
+
+		size_t low = 0;
+		size_t high = count;
+		while (low < high) {
+			size_t middle = (low + high) / 2;
+			DWORD keySize = 0;
+			const BYTE* key = Cell(ReadLE<DWORD>(list + 4 + middle * stride), &keySize);
+			if (!IsKeyCell(key, keySize))
+				return ERROR_REGISTRY_CORRUPT;
+
+			int comparison = KeyName(key).Compare(name);
+			if (comparison == 0) {
+				*result = key;
+				return ERROR_SUCCESS;
+			}
+			if (comparison < 0)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+		return ERROR_FILE_NOT_FOUND;
+	}
+
+	LSTATUS CRegfBackend::FindSubKey(const BYTE* keyCell, wstring_view name, const BYTE** result)
+	{
+		if (ReadLE<DWORD>(keyCell + NK_NUM_SUBKEYS) == 0)
+			return ERROR_FILE_NOT_FOUND;
+		return FindInList(ReadLE<DWORD>(keyCell + NK_SUBKEY_LIST), name, 0, result);
+	}
+
+	//Values are stored as a plain array of offsets to value cells
+	const BYTE* CRegfBackend::ValueAt(const BYTE* keyCell, DWORD index)
+	{
+		DWORD count = ReadLE<DWORD>(keyCell + NK_NUM_VALUES);
+		if (index >= count)
+			return NULL;
+
+		DWORD size = 0;
+		const BYTE* list = Cell(ReadLE<DWORD>(keyCell + NK_VALUE_LIST), &size);
+		if (list == NULL || (size_t)count * 4 > size)
+			return NULL;
+
+		const BYTE* value = Cell(ReadLE<DWORD>(list + index * 4), &size);
+		return IsValueCell(value, size) ? value : NULL;
+	}
+
+	LSTATUS CRegfBackend::FindValue(const BYTE* keyCell, wstring_view name, const BYTE** result)
+	{
+		DWORD count = ReadLE<DWORD>(keyCell + NK_NUM_VALUES);
+		for (DWORD i = 0; i < count; i++) {
+			const BYTE* value = ValueAt(keyCell, i);
+			if (value == NULL)
+				return ERROR_REGISTRY_CORRUPT;
+			if (ValueName(value).Compare(name) == 0) {
+				*result = value;
+				return ERROR_SUCCESS;
+			}
+		}
+		return ERROR_FILE_NOT_FOUND;
+	}
+
+	//Copy the data of a value, using the conventions of RegQueryValueEx
+	LSTATUS CRegfBackend::ReadData(const BYTE* valueCell, DWORD* type, LPBYTE data, DWORD* dataLength)
+	{
+		DWORD size = ReadLE<DWORD>(valueCell + VK_DATA_SIZE);
+		DWORD offset = ReadLE<DWORD>(valueCell + VK_DATA_OFFSET);
+		bool isInline = (size & DATA_INLINE) != 0;
+		size &= ~DATA_INLINE;
+
+		//small values are stored in the offset field itself
+		if (isInline && size > sizeof(DWORD))
+			return ERROR_REGISTRY_CORRUPT;
+
+		DWORD valueType = ReadLE<DWORD>(valueCell + VK_TYPE);
+		if (type)
+			*type = valueType;
+		if (dataLength == NULL)
+			return ERROR_SUCCESS;
+
+		//Locate the data before reporting the size, so that a size that does not
+		//match the hive is never handed to the caller to allocate a buffer for
+		const BYTE* cell = NULL;
+		const BYTE* segmentList = NULL;
+		WORD segments = 0;
+		if (!isInline && size > 0) {
+			DWORD cellSize = 0;
+			cell = Cell(offset, &cellSize);
+			if (cell == NULL)
+				return ERROR_REGISTRY_CORRUPT;
+
+			//big data: a db cell that points to a list of segments
+			if (size > BIG_DATA_SEGMENT && m_minorVersion > 3 && cellSize >= 8 && HasSignature(cell, "db")) {
+				segments = ReadLE<WORD>(cell + 2);
+				DWORD listSize = 0;
+				segmentList = Cell(ReadLE<DWORD>(cell + 4), &listSize);
+				if (segmentList == NULL || (size_t)segments * 4 > listSize ||
+					(size_t)segments * BIG_DATA_SEGMENT < size)
+					return ERROR_REGISTRY_CORRUPT;
+			}
+			else if (cellSize < size) {
+				return ERROR_REGISTRY_CORRUPT;
+			}
+		}
+
+		//The hive stores strings as UTF-16. Where wchar_t is wider, they are widened
+		//so that callers get the same data as from the other backends.
+		bool widen = sizeof(wchar_t) != sizeof(WORD) && (valueType == REG_SZ ||
+			valueType == REG_EXPAND_SZ || valueType == REG_MULTI_SZ || valueType == REG_LINK);
+		DWORD reportedSize = widen ? size / sizeof(WORD) * sizeof(wchar_t) : size;
+
+		DWORD available = *dataLength;
+		*dataLength = reportedSize;
+		if (data == NULL)
+			return ERROR_SUCCESS;
+		if (available < reportedSize)
+			return ERROR_MORE_DATA;
+
+		vector<BYTE> utf16;
+		BYTE* target = data;
+		if (widen) {
+			utf16.resize(size);
+			target = utf16.data();
+		}
+
+		if (isInline) {
+			memcpy(target, valueCell + VK_DATA_OFFSET, size);
+		}
+		else if (segmentList) {
+			DWORD copied = 0;
+			for (WORD i = 0; i < segments && copied < size; i++) {
+				DWORD segmentSize = 0;
+				const BYTE* segment = Cell(ReadLE<DWORD>(segmentList + i * 4), &segmentSize);
+				DWORD chunk = min(size - copied, BIG_DATA_SEGMENT);
+				if (segment == NULL || segmentSize < chunk)
+					return ERROR_REGISTRY_CORRUPT;
+				memcpy(target + copied, segment, chunk);
+				copied += chunk;
+			}
+			if (copied != size)
+				return ERROR_REGISTRY_CORRUPT;
+		}
+		else if (size > 0) {
+			memcpy(target, cell, size);
+		}
+
+		for (size_t i = 0; i < utf16.size() / sizeof(WORD); i++) {
+			wchar_t c = ReadLE<WORD>(utf16.data() + i * sizeof(WORD));
+			memcpy(data + i * sizeof(wchar_t), &c, sizeof(wchar_t));
+		}
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CRegfBackend::OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		if (result == NULL)
+			return ERROR_INVALID_PARAMETER;
+
+		const BYTE* key = KeyCell(parent);
+		if (key == NULL)
+			return ERROR_INVALID_HANDLE;
+
+		//walk the path one segment at a time
+		wstring_view remaining = subKey ? subKey : L"";
+		while (!remaining.empty()) {
+			size_t separator = remaining.find(L'\\');
+			wstring_view segment = remaining.substr(0, separator);
+			if (!segment.empty()) {
+				LSTATUS retVal = FindSubKey(key, segment, &key);
+				if (retVal != ERROR_SUCCESS)
+					return retVal;
+			}
+			if (separator == wstring_view::npos)
+				break;
+			remaining.remove_prefix(separator + 1);
+		}
+
+		*result = ToHandle(key);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CRegfBackend::CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		return ERROR_ACCESS_DENIED;
+	}
+
+	//Handles point into the mapping, there is nothing to release
+	LSTATUS CRegfBackend::CloseKey(HKEY key)
+	{
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CRegfBackend::QueryInfoKey(HKEY key,
+		DWORD* numSubKeys, DWORD* maxSubKeyLength,
+		DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+		FILETIME* lastWriteTime)
+	{
+		const BYTE* keyCell = KeyCell(key);
+		if (keyCell == NULL)
+			return ERROR_INVALID_HANDLE;
+
+		DWORD subKeyCount = ReadLE<DWORD>(keyCell + NK_NUM_SUBKEYS);
+		DWORD valueCount = ReadLE<DWORD>(keyCell + NK_NUM_VALUES);
+		if (numSubKeys)
+			*numSubKeys = subKeyCount;
+		if (numValues)
+			*numValues = valueCount;
+
+		//The maximum lengths that are cached in the key cell are stored differently
+		//depending on the version of Windows that wrote the hive, so we measure.
+		if (maxSubKeyLength) {
+			size_t maxLength = 0;
+			for (DWORD i = 0; i < subKeyCount; i++) {
+				const BYTE* subKey = SubKeyAt(keyCell, i);
+				if (subKey == NULL)
+					return ERROR_REGISTRY_CORRUPT;
+				maxLength = max(maxLength, KeyName(subKey).Length);
+			}
+			*maxSubKeyLength = (DWORD)maxLength;
+		}
+		if (maxValueNameLength || maxValueLength) {
+			size_t maxName = 0;
+			DWORD maxData = 0;
+			for (DWORD i = 0; i < valueCount; i++) {
+				const BYTE* value = ValueAt(keyCell, i);
+				if (value == NULL)
+					return ERROR_REGISTRY_CORRUPT;
+				maxName = max(maxName, ValueName(value).Length);
+				maxData = max(maxData, ReadLE<DWORD>(value + VK_DATA_SIZE) & ~DATA_INLINE);
+			}
+			if (maxValueNameLength)
+				*maxValueNameLength = (DWORD)maxName;
+			//strings grow when they are widened, see ReadData
+			if (maxValueLength)
+				*maxValueLength = maxData / sizeof(WORD) * sizeof(wchar_t) + maxData % sizeof(WORD);
+		}
+		if (lastWriteTime)
+			*lastWriteTime = ReadLE<FILETIME>(keyCell + NK_LAST_WRITE);
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CRegfBackend::EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength)
+	{
+		if (nameLength == NULL)
+			return ERROR_INVALID_PARAMETER;
+
+		const BYTE* keyCell = KeyCell(key);
+		if (keyCell == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (index >= ReadLE<DWORD>(keyCell + NK_NUM_SUBKEYS))
+			return ERROR_NO_MORE_ITEMS;
+
+		const BYTE* subKey = SubKeyAt(keyCell, index);
+		if (subKey == NULL)
+			return ERROR_REGISTRY_CORRUPT;
+		return KeyName(subKey).CopyTo(name, nameLength);
+	}
+
+	LSTATUS CRegfBackend::EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+		DWORD* type, LPBYTE data, DWORD* dataLength)
+	{
+		if (nameLength == NULL)
+			return ERROR_INVALID_PARAMETER;
+
+		const BYTE* keyCell = KeyCell(key);
+		if (keyCell == NULL)
+			return ERROR_INVALID_HANDLE;
+		if (index >= ReadLE<DWORD>(keyCell + NK_NUM_VALUES))
+			return ERROR_NO_MORE_ITEMS;
+
+		const BYTE* value = ValueAt(keyCell, index);
+		if (value == NULL)
+			return ERROR_REGISTRY_CORRUPT;
+
+		LSTATUS retVal = ValueName(value).CopyTo(name, nameLength);
+		if (retVal != ERROR_SUCCESS)
+			return retVal;
+		return ReadData(value, type, data, dataLength);
+	}
+
+	LSTATUS CRegfBackend::QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+		LPBYTE data, DWORD* dataLength)
+	{
+		const BYTE* keyCell = KeyCell(key);
+		if (keyCell == NULL)
+			return ERROR_INVALID_HANDLE;
+
+		const BYTE* value = NULL;
+		LSTATUS retVal = FindValue(keyCell, valueName ? valueName : L"", &value);
+		if (retVal != ERROR_SUCCESS)
+			return retVal;
+		return ReadData(value, type, data, dataLength);
+	}
+
+	LSTATUS CRegfBackend::SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+		const BYTE* data, DWORD dataLength)
+	{
+		return ERROR_ACCESS_DENIED;
+	}
+
+	LSTATUS CRegfBackend::DeleteValue(HKEY key, LPCWSTR valueName)
+	{
+		return ERROR_ACCESS_DENIED;
+	}
+
+	LSTATUS CRegfBackend::DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction)
+	{
+		return ERROR_ACCESS_DENIED;
+	}
+
+	LSTATUS CRegfBackend::DeleteTree(HKEY key, LPCWSTR subKey)
+	{
+		return ERROR_ACCESS_DENIED;
+	}
+
+	LSTATUS CRegfBackend::CreateTransaction(HANDLE* transaction)
+	{
+		return ERROR_ACCESS_DENIED;
+	}
+
+	LSTATUS CRegfBackend::CommitTransaction(HANDLE transaction)
+	{
+		return ERROR_INVALID_HANDLE;
+	}
+
+	LSTATUS CRegfBackend::RollbackTransaction(HANDLE transaction)
+	{
+		return ERROR_INVALID_HANDLE;
+	}
+
+	LSTATUS CRegfBackend::CloseTransaction(HANDLE transaction)
+	{
+		return ERROR_INVALID_HANDLE;
+	}
+}
@@ -0,0 +1,86 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include "RegBackend.h"
+#include "MappedFile.h"
+#include <string>
+#include <string_view>
+
+namespace w32
+{
+	/// <summary>
+	/// Read-only backend for an offline registry hive file (regf format), such as an
+	/// exported hive or the SOFTWARE / NTUSER.DAT file of a disk image.
+	///
+	/// The file is memory mapped and parsed in place: an HKEY handed out by this backend
+	/// is simply the address of the key cell inside the mapping, so opening and closing
+	/// keys costs nothing and no key or value data is copied until a caller asks for it.
+	///
+	/// A hive file has a single root. It is mounted under every predefined key, so the
+	/// TypeLib key of an exported SOFTWARE hive is HKLM\Classes\TypeLib, and that of an
+	/// NTUSER.DAT file is HKCU\Software\Classes\TypeLib.
+	///
+	/// Every modifying method fails with ERROR_ACCESS_DENIED.
+	/// </summary>
+	class CRegfBackend : public IRegBackend
+	{
+		CMappedFile m_file;
+		const BYTE* m_bins = NULL;      //start of the hive bins
+		size_t m_binsSize = 0;
+		DWORD m_minorVersion = 0;
+		DWORD m_rootCell = 0;
+
+		const BYTE* Cell(DWORD offset, DWORD* size);
+		const BYTE* KeyCell(HKEY key);
+		HKEY ToHandle(const BYTE* keyCell);
+
+		const BYTE* SubKeyAt(const BYTE* keyCell, DWORD index);
+		LSTATUS FindSubKey(const BYTE* keyCell, std::wstring_view name, const BYTE** result);
+		LSTATUS FindInList(DWORD listOffset, std::wstring_view name, int depth, const BYTE** result);
+		const BYTE* ValueAt(const BYTE* keyCell, DWORD index);
+		LSTATUS FindValue(const BYTE* keyCell, std::wstring_view name, const BYTE** result);
+		LSTATUS ReadData(const BYTE* valueCell, DWORD* type, LPBYTE data, DWORD* dataLength);
+
+	public:
+		//Map and validate the hive file. Throws if the file is not a hive.
+		CRegfBackend(const std::wstring& path);
+
+		LSTATUS OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) override;
+		LSTATUS CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+			HANDLE transaction, HKEY* result) override;
+		LSTATUS CloseKey(HKEY key) override;
+		LSTATUS QueryInfoKey(HKEY key,
+			DWORD* numSubKeys, DWORD* maxSubKeyLength,
+			DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+			FILETIME* lastWriteTime) override;
+		LSTATUS EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength) override;
+		LSTATUS EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+			DWORD* type, LPBYTE data, DWORD* dataLength) override;
+		LSTATUS QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+			LPBYTE data, DWORD* dataLength) override;
+		LSTATUS SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+			const BYTE* data, DWORD dataLength) override;
+		LSTATUS DeleteValue(HKEY key, LPCWSTR valueName) override;
+		LSTATUS DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction) override;
+		LSTATUS DeleteTree(HKEY key, LPCWSTR subKey) override;
+		LSTATUS CreateTransaction(HANDLE* transaction) override;
+		LSTATUS CommitTransaction(HANDLE transaction) override;
+		LSTATUS RollbackTransaction(HANDLE transaction) override;
+		LSTATUS CloseTransaction(HANDLE transaction) override;
+	};
+}
@@ -0,0 +1,229 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "Stats.h"
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <mutex>
+
+namespace w32
+{
+    const wchar_t* StatOpName(EStatOp op)
+    {
+        static const wchar_t* names[] = {
+            L"OpenKey", L"CreateKey", L"CloseKey", L"QueryInfoKey", L"EnumKey",
+            L"EnumValue", L"QueryValue", L"SetValue", L"DeleteValue", L"DeleteKey",
+            L"DeleteTree", L"Transaction", L"LoadTypeLib", L"RegisterTypeLib",
+            L"UnRegisterTypeLib" };
+        static_assert(sizeof(names) / sizeof(names[0]) == (size_t)EStatOp::Count);
+        return (size_t)op < (size_t)EStatOp::Count ? names[(size_t)op] : L"?";
+    }
+
+    /////////////////////////////////////////////////////////////
+    //CLatencyHistogram
+    /////////////////////////////////////////////////////////////
+
+    //The first group holds 0 .. SubBuckets-1 one by one. After that, every power of
+    //two 2^e gets SubBuckets buckets of 2^(e-SubBucketBits) wide.
+    size_t CLatencyHistogram::BucketIndex(ULONGLONG nanoseconds)
+    {
+        if (nanoseconds < SubBuckets)
+            return (size_t)nanoseconds;
+
+        size_t exponent = std::bit_width(nanoseconds) - 1;
+        if (exponent > MaxExponent)
+            return BucketCount - 1;
+
+        size_t sub = (size_t)(nanoseconds >> (exponent - SubBucketBits)) & (SubBuckets - 1);
+        return (exponent - SubBucketBits + 1) * SubBuckets + sub;
+    }
+
+    ULONGLONG CLatencyHistogram::BucketLimit(size_t index)
+    {
+        size_t group = index / SubBuckets;
+        size_t sub = index % SubBuckets;
+        if (group == 0)
+            return sub;
+
+        size_t shift = group - 1;
+        ULONGLONG lower = (ULONGLONG)(SubBuckets + sub) << shift;
+        return lower + (1ull << shift) - 1;
+    }
+
+    CLatencyHistogram::CLatencyHistogram() :
+        m_counts(BucketCount, 0)
+    {
+    }
+
+    void CLatencyHistogram::Add(ULONGLONG nanoseconds, ULONGLONG count)
+    {
+        AddToBucket(BucketIndex(nanoseconds), count);
+    }
+
+    void CLatencyHistogram::AddToBucket(size_t index, ULONGLONG count)
+    {
+        m_counts[index] += count;
+        m_total += count;
+    }
+
+    ULONGLONG CLatencyHistogram::Count() const
+    {
+        return m_total;
+    }
+
+    ULONGLONG CLatencyHistogram::Percentile(double fraction) const
+    {
+        if (m_total == 0)
+            return 0;
+
+        //the rank of the call we are looking for, counting from 1
+        ULONGLONG rank = (ULONGLONG)(fraction * m_total + 0.5);
+        if (rank < 1)
+            rank = 1;
+        if (rank > m_total)
+            rank = m_total;
+
+        ULONGLONG seen = 0;
+        for (size_t i = 0; i < BucketCount; i++) {
+            seen += m_counts[i];
+            if (seen >= rank)
+                return BucketLimit(i);
+        }
+        return BucketLimit(BucketCount - 1);
+    }
+
+    /////////////////////////////////////////////////////////////
+    //CStats
+    /////////////////////////////////////////////////////////////
+
+    namespace
+    {
+        //Counters of one thread. Only the owning thread writes them, so they are
+        //updated with a relaxed load and store instead of an interlocked add. They are
+        //atomic only so that Collect can read them while the owner is writing.
+        struct CThreadOpCounters
+        {
+            std::atomic<ULONGLONG> calls = 0;
+            std::atomic<ULONGLONG> errors = 0;
+            std::atomic<ULONGLONG> bytesRead = 0;
+            std::atomic<ULONGLONG> bytesWritten = 0;
+            std::atomic<ULONGLONG> totalNanoseconds = 0;
+            std::atomic<ULONGLONG> buckets[CLatencyHistogram::BucketCount] = {};
+        };
+
+        struct CThreadCounters
+        {
+            CThreadOpCounters ops[(size_t)EStatOp::Count];
+        };
+
+        inline void Bump(std::atomic<ULONGLONG>& counter, ULONGLONG amount)
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+        }
+
+        void AddCounters(COpStats& stats, const CThreadOpCounters& counters)
+        {
+            stats.Calls += counters.calls.load(std::memory_order_relaxed);
+            stats.Errors += counters.errors.load(std::memory_order_relaxed);
+            stats.BytesRead += counters.bytesRead.load(std::memory_order_relaxed);
+            stats.BytesWritten += counters.bytesWritten.load(std::memory_order_relaxed);
+            stats.TotalNanoseconds += counters.totalNanoseconds.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < CLatencyHistogram::BucketCount; i++) {
+                ULONGLONG count = counters.buckets[i].load(std::memory_order_relaxed);
+                if (count)
+                    stats.Latency.AddToBucket(i, count);
+            }
+        }
+
+        //The counters of all running threads, and the totals of the threads that ended
+        struct CCounterRegistry
+        {
+            std::mutex lock;
+            std::vector<CThreadCounters*> live;
+            CStatsReport ended;
+
+            static CCounterRegistry& Instance()
+            {
+                static CCounterRegistry registry;
+                return registry;
+            }
+        };
+
+        //Owns the counters of the current thread and hands them over when it ends
+        struct CThreadCountersOwner
+        {
+            std::unique_ptr<CThreadCounters> counters = std::make_unique<CThreadCounters>();
+
+            CThreadCountersOwner()
+            {
+                CCounterRegistry& registry = CCounterRegistry::Instance();
+                std::lock_guard<std::mutex> guard(registry.lock);
+                registry.live.push_back(counters.get());
+            }
+
+            ~CThreadCountersOwner()
+            {
+                CCounterRegistry& registry = CCounterRegistry::Instance();
+                std::lock_guard<std::mutex> guard(registry.lock);
+                for (size_t op = 0; op < (size_t)EStatOp::Count; op++)
+                    AddCounters(registry.ended.Ops[op], counters->ops[op]);
+                std::erase(registry.live, counters.get());
+            }
+        };
+    }
+
+#ifndef W32_NO_INSTRUMENTATION
+    void CStats::Record(EStatOp op, ULONGLONG nanoseconds, bool failed,
+        ULONGLONG bytesRead, ULONGLONG bytesWritten)
+    {
+        static thread_local CThreadCountersOwner owner;
+        CThreadOpCounters& counters = owner.counters->ops[(size_t)op];
+
+        Bump(counters.calls, 1);
+        if (failed)
+            Bump(counters.errors, 1);
+        if (bytesRead)
+            Bump(counters.bytesRead, bytesRead);
+        if (bytesWritten)
+            Bump(counters.bytesWritten, bytesWritten);
+        Bump(counters.totalNanoseconds, nanoseconds);
+        Bump(counters.buckets[CLatencyHistogram::BucketIndex(nanoseconds)], 1);
+    }
+#endif
+
+    CStatsReport CStats::Collect()
+    {
+        CStatsReport report;
+        CCounterRegistry& registry = CCounterRegistry::Instance();
+        std::lock_guard<std::mutex> guard(registry.lock);
+        for (size_t op = 0; op < (size_t)EStatOp::Count; op++) {
+            COpStats& stats = report.Ops[op];
+            const COpStats& ended = registry.ended.Ops[op];
+            stats.Calls = ended.Calls;
+            stats.Errors = ended.Errors;
+            stats.BytesRead = ended.BytesRead;
+            stats.BytesWritten = ended.BytesWritten;
+            stats.TotalNanoseconds = ended.TotalNanoseconds;
+            stats.Latency = ended.Latency;
+            for (CThreadCounters* counters : registry.live)
+                AddCounters(stats, counters->ops[op]);
+        }
+        return report;
+    }
+}
@@ -0,0 +1,174 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <WinBase.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace w32
+{
+    //The operations that are counted
+    enum class EStatOp
+    {
+        OpenKey,
+        CreateKey,
+        CloseKey,
+        QueryInfoKey,
+        EnumKey,
+        EnumValue,
+        QueryValue,
+        SetValue,
+        DeleteValue,
+        DeleteKey,
+        DeleteTree,
+        Transaction,
+        LoadTypeLib,
+        RegisterTypeLib,
+        UnRegisterTypeLib,
+        Count
+    };
+
+    const wchar_t* StatOpName(EStatOp op);
+
+    /// <summary>
+    /// Histogram of latencies in nanoseconds, with buckets in the style of HdrHistogram:
+    /// every power of two is split in 8 linear sub buckets, so a percentile is accurate
+    /// to within 12.5% across the whole range, with a few hundred buckets.
+    /// Latencies above about a minute go into the last bucket.
+    /// </summary>
+    class CLatencyHistogram
+    {
+    public:
+        static const size_t SubBucketBits = 3;
+        static const size_t SubBuckets = 1 << SubBucketBits;
+        static const size_t MaxExponent = 36;
+        static const size_t BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+        //Bucket that a latency falls into
+        static size_t BucketIndex(ULONGLONG nanoseconds);
+
+        //Highest latency that falls into a bucket
+        static ULONGLONG BucketLimit(size_t index);
+
+    private:
+        std::vector<ULONGLONG> m_counts;
+        ULONGLONG m_total = 0;
+
+    public:
+        CLatencyHistogram();
+
+        void Add(ULONGLONG nanoseconds, ULONGLONG count = 1);
+        void AddToBucket(size_t index, ULONGLONG count);
+
+        ULONGLONG Count() const;
+
+        //Latency below which the given fraction (0..1) of the calls fall. 0 if empty.
+        ULONGLONG Percentile(double fraction) const;
+    };
+
+    //Totals for one kind of operation
+    struct COpStats
+    {
+        ULONGLONG Calls = 0;
+        ULONGLONG Errors = 0;
+        ULONGLONG BytesRead = 0;
+        ULONGLONG BytesWritten = 0;
+        ULONGLONG TotalNanoseconds = 0;
+        CLatencyHistogram Latency;
+    };
+
+    //Totals of all threads, per operation
+    struct CStatsReport
+    {
+        COpStats Ops[(size_t)EStatOp::Count];
+
+        const COpStats& operator[](EStatOp op) const { return Ops[(size_t)op]; }
+    };
+
+    /// <summary>
+    /// Process wide operation counters.
+    ///
+    /// Every thread counts in its own block, so recording is a handful of plain stores
+    /// without locks or interlocked instructions. Collect adds up the blocks of all
+    /// threads, including threads that have ended since.
+    ///
+    /// Defining W32_NO_INSTRUMENTATION turns Record and CStatScope into empty inline
+    /// functions, so the compiler removes them, and Collect returns an empty report.
+    /// </summary>
+    class CStats
+    {
+    public:
+#ifdef W32_NO_INSTRUMENTATION
+        static constexpr bool Enabled = false;
+
+        static void Record(EStatOp, ULONGLONG, bool, ULONGLONG = 0, ULONGLONG = 0) {}
+#else
+        static constexpr bool Enabled = true;
+
+        //Count one call
+        static void Record(EStatOp op, ULONGLONG nanoseconds, bool failed,
+            ULONGLONG bytesRead = 0, ULONGLONG bytesWritten = 0);
+#endif
+
+        //Totals of all threads so far. Counts that are being recorded while this runs
+        //may or may not be included.
+        static CStatsReport Collect();
+    };
+
+    /// <summary>
+    /// Times the operation from construction to destruction and records it.
+    /// </summary>
+#ifdef W32_NO_INSTRUMENTATION
+    class CStatScope
+    {
+    public:
+        CStatScope(EStatOp) {}
+        void Fail() {}
+        void Read(ULONGLONG) {}
+        void Written(ULONGLONG) {}
+    };
+#else
+    class CStatScope
+    {
+        EStatOp m_op;
+        std::chrono::steady_clock::time_point m_start;
+        bool m_failed = false;
+        ULONGLONG m_read = 0;
+        ULONGLONG m_written = 0;
+
+    public:
+        CStatScope(EStatOp op) : m_op(op), m_start(std::chrono::steady_clock::now()) {}
+
+        ~CStatScope()
+        {
+            auto elapsed = std::chrono::steady_clock::now() - m_start;
+            CStats::Record(m_op,
+                (ULONGLONG)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                m_failed, m_read, m_written);
+        }
+
+        CStatScope(const CStatScope&) = delete;
+        CStatScope& operator = (const CStatScope&) = delete;
+
+        void Fail() { m_failed = true; }
+        void Read(ULONGLONG bytes) { m_read += bytes; }
+        void Written(ULONGLONG bytes) { m_written += bytes; }
+    };
+#endif
+}
@@ -77,6 +77,44 @@ namespace w32
             throw ExHResult(hRes);
     }
 
+    //expand environment variables in a string
+    wstring ExpandEnvironment(wstring const& ws) {
+        if (ws.find(L'%') == wstring::npos)
+            return ws;
+
+        DWORD size = ExpandEnvironmentStringsW(ws.c_str(), NULL, 0);
+        while (size > 0) {
+            wstring expanded(size, L'\0');
+            DWORD needed = ExpandEnvironmentStringsW(ws.c_str(), &expanded[0], size);
+            if (needed == 0)
+                break;
+            //the environment can change between the two calls
+            if (needed <= size) {
+                expanded.resize(needed - 1);
+                return expanded;
+            }
+            size = needed;
+        }
+        throw ExWin32Error();
+    }
+
+    //the file that a registered path refers to
+    wstring RegisteredFile(wstring_view path) {
+        wstring file(path);
+        if (!file.empty() && file[0] == L'"') {
+            size_t quote = file.find(L'"', 1);
+            file = file.substr(1, quote == wstring::npos ? wstring::npos : quote - 1);
+        }
+        file = ExpandEnvironment(file);
+
+        //a library that is a resource of a module is registered as module\number
+        size_t separator = file.find_last_of(L'\\');
+        if (separator != wstring::npos && separator + 1 < file.length() &&
+            file.find_first_not_of(L"0123456789", separator + 1) == wstring::npos)
+            file.resize(separator);
+        return file;
+    }
+
     //Get the human readable message for a windows error code
     std::wstring GetMessageForError(int code)
     {
@@ -112,4 +150,26 @@ namespace w32
         transform(ws.begin(), ws.end(), ws.begin(), towupper);
     }
 
+    //uppercase copy for name comparisons
+    std::wstring ToWUpperName(std::wstring_view ws) {
+        std::wstring upper(ws.length(), L'\0');
+        for (size_t i = 0; i < ws.length(); i++)
+            upper[i] = ToWUpperChar(ws[i]);
+        return upper;
+    }
+
+    //compare without regard to case
+    int CompareNoCase(std::wstring_view a, std::wstring_view b) {
+        size_t length = min(a.length(), b.length());
+        for (size_t i = 0; i < length; i++) {
+            wchar_t ca = ToWUpperChar(a[i]);
+            wchar_t cb = ToWUpperChar(b[i]);
+            if (ca != cb)
+                return (ca < cb) ? -1 : 1;
+        }
+        if (a.length() == b.length())
+            return 0;
+        return (a.length() < b.length()) ? -1 : 1;
+    }
+
 }
\ No newline at end of file
@@ -18,6 +18,7 @@
 
 #include <WinBase.h>
 #include <string>
+#include <string_view>
 
 namespace w32
 {
@@ -70,6 +71,15 @@ namespace w32
     //Parse a GUID from a string
     void GUIDFromWString(const std::wstring& strGuid, GUID& guid);
 
+    //Replace %NAME% references by the value of the environment variable, as is
+    //done for REG_EXPAND_SZ values. Unknown names are left as they are.
+    std::wstring ExpandEnvironment(std::wstring const& ws);
+
+    //The file that a registered path (a TypeLib win32/win64 or an InprocServer32 value)
+    //refers to: unquoted, with environment variables expanded and without the resource
+    //number of a type library inside a module, as in module.dll\2
+    std::wstring RegisteredFile(std::wstring_view path);
+
     //Get the canonical message from a Windows error code
     std::wstring GetMessageForError(int code);
 
@@ -79,4 +89,19 @@ namespace w32
     //convert a wstring to all uppercase
     void ToWUpperInPlace(std::wstring& ws);
 
+    //Uppercase a single character the way the registry does for name comparisons
+    inline wchar_t ToWUpperChar(wchar_t c) {
+        if (c < 0x80)
+            return (c >= L'a' && c <= L'z') ? (wchar_t)(c - (L'a' - L'A')) : c;
+        return (wchar_t)towupper(c);
+    }
+
+    //Uppercase copy of a string, the way the registry does for name comparisons.
+    //Every character maps to exactly one character, so offsets stay the same.
+    std::wstring ToWUpperName(std::wstring_view ws);
+
+    //Compare two strings without regard to case, like the registry does for key and value names.
+    //Returns <0, 0 or >0 in the manner of wcscmp.
+    int CompareNoCase(std::wstring_view a, std::wstring_view b);
+
 }
\ No newline at end of file
@@ -0,0 +1,333 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "ThreadPool.h"
+
+namespace w32
+{
+    template<class T> class CTask;
+
+    namespace detail
+    {
+        //What the promises of all tasks have in common: the coroutine that awaits the
+        //task, and the exception if it failed
+        struct CTaskPromiseBase
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr error;
+
+            //When the task is done, continue with the coroutine that awaits it
+            struct CFinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                template<class P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> task) noexcept
+                {
+                    std::coroutine_handle<> continuation = task.promise().continuation;
+                    return continuation ? continuation : std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            CFinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+        template<class T>
+        struct CTaskPromise : CTaskPromiseBase
+        {
+            std::optional<T> result;
+
+            CTask<T> get_return_object();
+            void return_value(T value) { result.emplace(std::move(value)); }
+
+            T TakeResult()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+                return std::move(*result);
+            }
+        };
+
+        template<>
+        struct CTaskPromise<void> : CTaskPromiseBase
+        {
+            CTask<void> get_return_object();
+            void return_void() {}
+
+            void TakeResult()
+            {
+                if (error)
+                    std::rethrow_exception(error);
+            }
+        };
+
+        //Coroutine that is started and not awaited by anyone. It cleans up after itself.
+        struct CDetached
+        {
+            struct promise_type
+            {
+                CDetached get_return_object() { return {}; }
+                std::suspend_never initial_suspend() noexcept { return {}; }
+                std::suspend_never final_suspend() noexcept { return {}; }
+                void return_void() {}
+                void unhandled_exception() { std::terminate(); }
+            };
+        };
+    }
+
+    /// <summary>
+    /// Result of a coroutine that is computed asynchronously.
+    ///
+    /// A task does not start until it is awaited, with co_await from another coroutine or
+    /// with SyncWait from regular code. It runs on the thread that awaits it until it
+    /// awaits something else, e.g. ResumeOn to move to a thread pool. When it finishes,
+    /// the awaiting coroutine continues on the thread where the task finished.
+    /// An exception that escapes the coroutine is rethrown to the awaiting code.
+    ///
+    /// A task is awaited once. It owns the coroutine frame and destroys it when it goes
+    /// out of scope, so it must outlive the work: await it before letting it go.
+    /// </summary>
+    template<class T>
+    class CTask
+    {
+    public:
+        using promise_type = detail::CTaskPromise<T>;
+
+    private:
+        std::coroutine_handle<promise_type> m_coroutine;
+
+    public:
+        explicit CTask(std::coroutine_handle<promise_type> coroutine) : m_coroutine(coroutine) {}
+        CTask(CTask&& other) noexcept : m_coroutine(std::exchange(other.m_coroutine, nullptr)) {}
+
+        CTask& operator = (CTask&& other) noexcept
+        {
+            if (this != &other) {
+                if (m_coroutine)
+                    m_coroutine.destroy();
+                m_coroutine = std::exchange(other.m_coroutine, nullptr);
+            }
+            return *this;
+        }
+
+        ~CTask()
+        {
+            if (m_coroutine)
+                m_coroutine.destroy();
+        }
+
+        CTask(const CTask&) = delete;
+        CTask& operator = (const CTask&) = delete;
+
+        bool await_ready() const noexcept
+        {
+            return m_coroutine.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+            m_coroutine.promise().continuation = awaiting;
+            return m_coroutine;
+        }
+
+        T await_resume()
+        {
+            return m_coroutine.promise().TakeResult();
+        }
+
+        //Awaiting this waits for the task to finish, without taking its result
+        struct CReadyAwaiter
+        {
+            std::coroutine_handle<promise_type> coroutine;
+
+            bool await_ready() const noexcept { return coroutine.done(); }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+            {
+                coroutine.promise().continuation = awaiting;
+                return coroutine;
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        CReadyAwaiter WhenReady()
+        {
+            return CReadyAwaiter{ m_coroutine };
+        }
+    };
+
+    namespace detail
+    {
+        template<class T>
+        CTask<T> CTaskPromise<T>::get_return_object()
+        {
+            return CTask<T>(std::coroutine_handle<CTaskPromise<T>>::from_promise(*this));
+        }
+
+        inline CTask<void> CTaskPromise<void>::get_return_object()
+        {
+            return CTask<void>(std::coroutine_handle<CTaskPromise<void>>::from_promise(*this));
+        }
+
+        //Counts down the tasks of WhenAll; the last one to finish resumes the awaiter
+        struct CWhenAllLatch
+        {
+            std::atomic<size_t> remaining;
+            std::coroutine_handle<> continuation;
+
+            bool Arrive() { return --remaining == 0; }
+        };
+
+        template<class T>
+        CDetached RunForLatch(CTask<T>& task, CWhenAllLatch& latch)
+        {
+            //the result or exception stays in the task, to be collected afterwards
+            co_await task.WhenReady();
+            if (latch.Arrive())
+                latch.continuation.resume();
+        }
+
+        template<class T>
+        struct CWhenAllAwaiter
+        {
+            std::vector<CTask<T>>& tasks;
+            CWhenAllLatch latch;
+
+            CWhenAllAwaiter(std::vector<CTask<T>>& t) : tasks(t)
+            {
+                latch.remaining = tasks.size() + 1;
+            }
+
+            bool await_ready() { return tasks.empty(); }
+
+            bool await_suspend(std::coroutine_handle<> awaiting)
+            {
+                latch.continuation = awaiting;
+                for (CTask<T>& task : tasks)
+                    RunForLatch(task, latch);
+                //if every task finished already, carry on without suspending
+                return !latch.Arrive();
+            }
+
+            void await_resume() {}
+        };
+    }
+
+    /// <summary>
+    /// Awaiting this moves the coroutine to a thread of the pool. With a NULL pool it
+    /// continues on the current thread, which is how the synchronous wrappers run the
+    /// same code without a thread switch.
+    /// </summary>
+    class CResumeOn
+    {
+        CThreadPool* m_pool;
+
+    public:
+        CResumeOn(CThreadPool* pool) : m_pool(pool) {}
+
+        bool await_ready() const noexcept { return m_pool == NULL; }
+
+        void await_suspend(std::coroutine_handle<> coroutine)
+        {
+            m_pool->Submit([coroutine]() { coroutine.resume(); });
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    inline CResumeOn ResumeOn(CThreadPool* pool)
+    {
+        return CResumeOn(pool);
+    }
+
+    //Run all tasks at the same time and wait until all of them are done.
+    //Results are in the order of the tasks. If any of them failed, the exception of the
+    //first one that failed (in that order) is thrown.
+    template<class T>
+    CTask<std::vector<T>> WhenAll(std::vector<CTask<T>> tasks)
+    {
+        co_await detail::CWhenAllAwaiter<T>(tasks);
+        std::vector<T> results;
+        results.reserve(tasks.size());
+        for (CTask<T>& task : tasks)
+            results.push_back(co_await task);
+        co_return results;
+    }
+
+    inline CTask<void> WhenAll(std::vector<CTask<void>> tasks)
+    {
+        co_await detail::CWhenAllAwaiter<void>(tasks);
+        for (CTask<void>& task : tasks)
+            co_await task;
+    }
+
+    namespace detail
+    {
+        struct CSyncEvent
+        {
+            std::mutex lock;
+            std::condition_variable done;
+            bool isDone = false;
+
+            void Set()
+            {
+                //notify under the lock, the waiter destroys the event as soon as it sees isDone
+                std::lock_guard<std::mutex> guard(lock);
+                isDone = true;
+                done.notify_all();
+            }
+
+            void Wait()
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                done.wait(guard, [this]() { return isDone; });
+            }
+        };
+
+        template<class T>
+        CDetached RunForEvent(CTask<T>& task, CSyncEvent& event)
+        {
+            co_await task.WhenReady();
+            event.Set();
+        }
+    }
+
+    //Start a task and block the current thread until it is done. Returns its result or
+    //throws its exception. Must not be called from a pool thread that the task needs.
+    template<class T>
+    T SyncWait(CTask<T> task)
+    {
+        detail::CSyncEvent event;
+        detail::RunForEvent(task, event);
+        event.Wait();
+        return task.await_resume();
+    }
+}
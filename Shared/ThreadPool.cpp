@@ -0,0 +1,131 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+    //The pool and queue that the current thread works for, if it is a worker
+    static thread_local CThreadPool* t_pool = NULL;
+    static thread_local size_t t_queue = 0;
+
+    CThreadPool::CThreadPool(size_t threads)
+    {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        if (threads == 0)
+            threads = 1;
+
+        for (size_t i = 0; i < threads; i++)
+            m_queues.push_back(std::make_unique<CWorkQueue>());
+        for (size_t i = 0; i < threads; i++)
+            m_threads.emplace_back(&CThreadPool::WorkerMain, this, i);
+    }
+
+    CThreadPool::~CThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_wakeLock);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& thread : m_threads)
+            thread.join();
+    }
+
+    void CThreadPool::Submit(std::function<void()> task)
+    {
+        size_t index;
+        if (t_pool == this)
+            index = t_queue;
+        else
+            index = m_nextQueue++ % m_queues.size();
+
+        //count it first, so that the counter never drops below the number of queued tasks
+        m_pending++;
+        {
+            std::lock_guard<std::mutex> guard(m_queues[index]->lock);
+            m_queues[index]->tasks.push_back(std::move(task));
+        }
+
+        //Taking the lock guarantees that a worker is either waiting already and gets
+        //woken, or has not yet checked m_pending and will see the new value.
+        {
+            std::lock_guard<std::mutex> guard(m_wakeLock);
+        }
+        m_wake.notify_one();
+    }
+
+    size_t CThreadPool::ThreadCount()
+    {
+        return m_threads.size();
+    }
+
+    CThreadPool& CThreadPool::Default()
+    {
+        static CThreadPool pool;
+        return pool;
+    }
+
+    //Take the newest task from our own queue
+    bool CThreadPool::TryPop(size_t index, std::function<void()>& task)
+    {
+        CWorkQueue& queue = *m_queues[index];
+        std::lock_guard<std::mutex> guard(queue.lock);
+        if (queue.tasks.empty())
+            return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    //Take the oldest task from someone else's queue
+    bool CThreadPool::TrySteal(size_t index, std::function<void()>& task)
+    {
+        for (size_t i = 1; i < m_queues.size(); i++) {
+            CWorkQueue& queue = *m_queues[(index + i) % m_queues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void CThreadPool::WorkerMain(size_t index)
+    {
+        t_pool = this;
+        t_queue = index;
+
+        for (;;)
+        {
+            std::function<void()> task;
+            if (TryPop(index, task) || TrySteal(index, task)) {
+                m_pending--;
+                task();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_wakeLock);
+            m_wake.wait(lock, [this]() { return m_pending > 0 || m_stop; });
+            if (m_stop && m_pending == 0)
+                return;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace w32
+{
+    /// <summary>
+    /// Fixed size pool of worker threads with work stealing.
+    /// Every worker has its own queue. Work that is submitted from a worker thread goes
+    /// onto that worker's queue, and the worker takes the most recently submitted work
+    /// first, which keeps the work of one subtree together on one thread. A worker that
+    /// runs out of work steals the oldest work from another worker's queue.
+    /// Work that is submitted from outside the pool is spread over the queues round robin.
+    ///
+    /// Tasks must not throw. Callers that need to report errors capture them in the task.
+    /// </summary>
+    class CThreadPool
+    {
+        struct CWorkQueue
+        {
+            std::mutex lock;
+            std::deque<std::function<void()>> tasks;
+        };
+
+        std::vector<std::unique_ptr<CWorkQueue>> m_queues;
+        std::vector<std::thread> m_threads;
+        std::mutex m_wakeLock;
+        std::condition_variable m_wake;
+        std::atomic<size_t> m_pending = 0;  //submitted but not yet started
+        std::atomic<size_t> m_nextQueue = 0;
+        bool m_stop = false;
+
+        void WorkerMain(size_t index);
+        bool TryPop(size_t index, std::function<void()>& task);
+        bool TrySteal(size_t index, std::function<void()>& task);
+
+    public:
+        //Start the pool. 0 threads means one per logical processor.
+        CThreadPool(size_t threads = 0);
+
+        //Finish the work that is queued and stop the threads
+        ~CThreadPool();
+
+        CThreadPool(const CThreadPool&) = delete;
+        CThreadPool& operator = (const CThreadPool&) = delete;
+
+        //Queue a task for execution
+        void Submit(std::function<void()> task);
+
+        //Number of worker threads
+        size_t ThreadCount();
+
+        //The pool that is shared by everything in the process
+        static CThreadPool& Default();
+    };
+}
@@ -0,0 +1,447 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TlbCache.h"
+#include "TypeLibrary.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include "RecordStream.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <set>
+
+namespace w32
+{
+    /////////////////////////////////////////////////////////////
+    //File layout, see CRecordWriter for how fields are stored
+    //  header:  "RGTC", version (4 bytes), number of entries (8 bytes)
+    //  index:   offset of every entry in the file (8 bytes each), in the order of the keys
+    //  entry:   key, path, size, write time, hash, library GUID, major, minor, flags,
+    //           syskind, lcid, version, name, doc string, coclass, interface and dispinterface
+    //           GUIDs, types (kind, flags, major, minor, GUID, name)
+    /////////////////////////////////////////////////////////////
+
+    static const char CacheMagic[4] = { 'R', 'G', 'T', 'C' };
+    static const uint32_t CacheVersion = 1;
+    static const size_t HeaderSize = 16;
+
+    static const char* CacheDamaged = "The type library cache is damaged; rebuild it";
+
+    //Hashes 8 bytes at a time. Fast enough to hash a library in the time it takes to
+    //open it, and good enough to notice that it changed.
+    static uint64_t HashBytes(const BYTE* data, size_t size)
+    {
+        const uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+        uint64_t hash = 0xCBF29CE484222325ULL ^ size;
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            hash = (hash ^ word) * multiplier;
+            hash ^= hash >> 29;
+        }
+        uint64_t tail = 0;
+        memcpy(&tail, data + i, size - i);
+        hash = (hash ^ tail) * multiplier;
+        return hash ^ (hash >> 32);
+    }
+
+    static void WriteEntry(std::vector<BYTE>& buffer, const std::wstring& key, const CTlbCache::CStamp& stamp,
+        const CTlbMetadata& metadata)
+    {
+        CRecordWriter writer(buffer);
+        writer.String(key);
+        writer.String(metadata.Path);
+        writer.Number(stamp.Size, 8);
+        writer.Number((uint64_t)stamp.WriteTime, 8);
+        writer.Number(stamp.Hash, 8);
+        writer.Guid(metadata.Guid);
+        writer.Number(metadata.MajorVersion, 2);
+        writer.Number(metadata.MinorVersion, 2);
+        writer.Number(metadata.Flags, 2);
+        writer.Number(metadata.SysKind, 2);
+        writer.Number(metadata.LocaleID, 4);
+        writer.String(metadata.Version);
+        writer.String(metadata.Name);
+        writer.String(metadata.DocString);
+        writer.Guids(metadata.CoClasses);
+        writer.Guids(metadata.Interfaces);
+        writer.Guids(metadata.DispInterfaces);
+        writer.Number(metadata.Types.size(), 4);
+        for (const CTlbTypeEntry& type : metadata.Types) {
+            writer.Number(type.Kind, 2);
+            writer.Number(type.Flags, 2);
+            writer.Number(type.MajorVersion, 2);
+            writer.Number(type.MinorVersion, 2);
+            writer.Guid(type.Guid);
+            writer.String(type.Name);
+        }
+    }
+
+    static void ReadEntry(CRecordReader& reader, CTlbCache::CStamp& stamp, CTlbMetadata& metadata)
+    {
+        reader.String();    //key
+        metadata.Path = reader.String();
+        stamp.Size = reader.Number(8);
+        stamp.WriteTime = (int64_t)reader.Number(8);
+        stamp.Hash = reader.Number(8);
+        metadata.Guid = reader.Guid();
+        metadata.MajorVersion = (WORD)reader.Number(2);
+        metadata.MinorVersion = (WORD)reader.Number(2);
+        metadata.Flags = (WORD)reader.Number(2);
+        metadata.SysKind = (SYSKIND)reader.Number(2);
+        metadata.LocaleID = (LCID)reader.Number(4);
+        metadata.Version = reader.String();
+        metadata.Name = reader.String();
+        metadata.DocString = reader.String();
+        reader.Guids(metadata.CoClasses);
+        reader.Guids(metadata.Interfaces);
+        reader.Guids(metadata.DispInterfaces);
+        uint64_t typeCount = reader.Number(4);
+        for (uint64_t i = 0; i < typeCount; i++) {
+            CTlbTypeEntry type;
+            uint64_t kind = reader.Number(2);
+            if (kind >= TKIND_MAX)
+                throw AppException(std::string(CacheDamaged));
+            type.Kind = (TYPEKIND)kind;
+            type.Flags = (WORD)reader.Number(2);
+            type.MajorVersion = (WORD)reader.Number(2);
+            type.MinorVersion = (WORD)reader.Number(2);
+            type.Guid = reader.Guid();
+            type.Name = reader.String();
+            metadata.Types.push_back(std::move(type));
+        }
+    }
+
+    CTlbCache::CTlbCache(const std::wstring& fileName) :
+        m_fileName(fileName)
+    {
+        Map();
+    }
+
+    //Map the file, if there is one that is usable
+    void CTlbCache::Map()
+    {
+        m_file.reset();
+        m_count = 0;
+        std::error_code error;
+        if (!std::filesystem::exists(std::filesystem::path(m_fileName), error))
+            return;
+
+        auto file = std::make_unique<CMappedFile>(m_fileName);
+        const BYTE* data = file->Data();
+        size_t size = file->Size();
+        if (size < HeaderSize || memcmp(data, CacheMagic, 4) != 0)
+            return;
+        CRecordReader header(data + 4, data + HeaderSize, CacheDamaged);
+        if (header.Number(4) != CacheVersion)
+            return;
+        uint64_t count = header.Number(8);
+        if (count > (size - HeaderSize) / sizeof(uint64_t))
+            return;
+
+        //offsets have to be in order and inside the file, then every entry has an end
+        CRecordReader index(data + HeaderSize, data + size, CacheDamaged);
+        uint64_t previous = HeaderSize + count * sizeof(uint64_t);
+        for (uint64_t i = 0; i < count; i++) {
+            uint64_t offset = index.Number(8);
+            if (offset < previous || offset >= size)
+                return;
+            previous = offset;
+        }
+        m_file = std::move(file);
+        m_count = (size_t)count;
+    }
+
+    const BYTE* CTlbCache::MappedRecord(size_t index, const BYTE** end) const
+    {
+        const BYTE* data = m_file->Data();
+        CRecordReader offsets(data + HeaderSize + index * sizeof(uint64_t), data + m_file->Size(), CacheDamaged);
+        uint64_t offset = offsets.Number(8);
+        *end = index + 1 < m_count ? data + offsets.Number(8) : data + m_file->Size();
+        return data + offset;
+    }
+
+    std::wstring_view CTlbCache::MappedKey(size_t index) const
+    {
+        //keys are not aligned, so they are compared through a copy
+        thread_local std::wstring key;
+        const BYTE* end;
+        const BYTE* record = MappedRecord(index, &end);
+        key = CRecordReader(record, end, CacheDamaged).String();
+        return key;
+    }
+
+    bool CTlbCache::FindMapped(const std::wstring& key, size_t& index) const
+    {
+        size_t low = 0;
+        size_t high = m_count;
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            int order = MappedKey(middle).compare(key);
+            if (order == 0) {
+                index = middle;
+                return true;
+            }
+            if (order < 0)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        return false;
+    }
+
+    bool CTlbCache::Find(const std::wstring& key, CEntry& entry) const
+    {
+        auto changed = m_changes.find(key);
+        if (changed != m_changes.end()) {
+            if (changed->second.Removed)
+                return false;
+            entry = changed->second;
+            return true;
+        }
+
+        size_t index;
+        if (!m_file || !FindMapped(key, index))
+            return false;
+        const BYTE* end;
+        const BYTE* record = MappedRecord(index, &end);
+        CRecordReader reader(record, end, CacheDamaged);
+        entry = CEntry();
+        ReadEntry(reader, entry.Stamp, entry.Metadata);
+        return true;
+    }
+
+    std::vector<std::wstring> CTlbCache::Keys() const
+    {
+        std::set<std::wstring> keys;
+        for (size_t i = 0; i < m_count; i++)
+            keys.insert(std::wstring(MappedKey(i)));
+        for (const auto& change : m_changes) {
+            if (change.second.Removed)
+                keys.erase(change.first);
+            else
+                keys.insert(change.first);
+        }
+        return std::vector<std::wstring>(keys.begin(), keys.end());
+    }
+
+    std::wstring CTlbCache::NormalizePath(const std::wstring& path)
+    {
+        return ToWUpperName(std::filesystem::absolute(path).lexically_normal().wstring());
+    }
+
+    bool CTlbCache::StampFile(const std::wstring& path, bool withHash, CStamp& stamp)
+    {
+        std::error_code error;
+        std::filesystem::path file;
+        try {
+            file = path;
+        }
+        catch (const std::filesystem::filesystem_error&) {
+            //a name the file system cannot represent, e.g. from a damaged cache file
+            return false;
+        }
+        stamp.Size = std::filesystem::file_size(file, error);
+        if (error)
+            return false;
+        stamp.WriteTime = std::filesystem::last_write_time(file, error).time_since_epoch().count();
+        if (error)
+            return false;
+        stamp.Hash = 0;
+        if (withHash && stamp.Size > 0) {
+            CMappedFile contents(path);
+            stamp.Hash = HashBytes(contents.Data(), contents.Size());
+        }
+        return true;
+    }
+
+    bool CTlbCache::TryGet(const std::wstring& path, CTlbMetadata& metadata)
+    {
+        std::wstring key = NormalizePath(path);
+        CEntry entry;
+        CStamp stamp;
+        if (!Find(key, entry) || !StampFile(path, false, stamp) || stamp.Size != entry.Stamp.Size)
+            return false;
+
+        if (stamp.WriteTime != entry.Stamp.WriteTime) {
+            //same size, other time: only a copy or a touch if the contents are the same.
+            //A file that cannot be read is not known to be the same.
+            try {
+                StampFile(path, true, stamp);
+            }
+            catch (const AppException&) {
+                return false;
+            }
+            if (stamp.Hash != entry.Stamp.Hash)
+                return false;
+            entry.Stamp = stamp;
+            m_changes[key] = entry;
+        }
+        metadata = std::move(entry.Metadata);
+        return true;
+    }
+
+    CTlbMetadata CTlbCache::Get(const std::wstring& path)
+    {
+        CTlbMetadata metadata;
+        if (TryGet(path, metadata))
+            return metadata;
+
+        CEntry entry;
+        entry.Metadata = CTypeLibrary(path).Metadata();
+        StampFile(path, true, entry.Stamp);
+        m_changes[NormalizePath(path)] = entry;
+        return entry.Metadata;
+    }
+
+    CTlbCache::CVerifyResult CTlbCache::Verify(std::vector<std::wstring>* stale) const
+    {
+        CVerifyResult result;
+        for (const std::wstring& key : Keys()) {
+            CEntry entry;
+            Find(key, entry);
+            CStamp stamp;
+            bool exists;
+            bool readable = true;
+            try {
+                exists = StampFile(entry.Metadata.Path, true, stamp);
+            }
+            catch (const AppException&) {
+                //the file is there but cannot be mapped, e.g. because it is locked
+                exists = true;
+                readable = false;
+            }
+
+            if (!exists) {
+                result.Missing++;
+            }
+            else if (readable && stamp.Size == entry.Stamp.Size && stamp.Hash == entry.Stamp.Hash) {
+                result.Current++;
+                continue;
+            }
+            else {
+                result.Changed++;
+            }
+            if (stale)
+                stale->push_back(entry.Metadata.Path);
+        }
+        return result;
+    }
+
+    size_t CTlbCache::Rebuild()
+    {
+        size_t read = 0;
+        for (const std::wstring& key : Keys()) {
+            CEntry entry;
+            Find(key, entry);
+            std::wstring path = entry.Metadata.Path;
+
+            //a library that can no longer be read is dropped like one that is gone
+            CEntry rebuilt;
+            try {
+                if (StampFile(path, true, rebuilt.Stamp)) {
+                    rebuilt.Metadata = CTypeLibrary(path).Metadata();
+                    m_changes[key] = rebuilt;
+                    read++;
+                    continue;
+                }
+            }
+            catch (const AppException&) {
+            }
+            m_changes[key].Removed = true;
+        }
+        return read;
+    }
+
+    size_t CTlbCache::Count() const
+    {
+        return Keys().size();
+    }
+
+    bool CTlbCache::Modified() const
+    {
+        return !m_changes.empty();
+    }
+
+    bool CTlbCache::Save()
+    {
+        if (!Modified())
+            return true;
+
+        //merge the entries of the file with the changes, both are in key order.
+        //Entries that did not change are copied as they are.
+        std::vector<BYTE> entries;
+        std::vector<uint64_t> offsets;
+        auto change = m_changes.begin();
+        size_t mapped = 0;
+        while (mapped < m_count || change != m_changes.end()) {
+            int order = mapped == m_count ? 1 : change == m_changes.end() ? -1 :
+                MappedKey(mapped).compare(change->first);
+            if (order < 0) {
+                const BYTE* end;
+                const BYTE* record = MappedRecord(mapped, &end);
+                offsets.push_back(entries.size());
+                entries.insert(entries.end(), record, end);
+                mapped++;
+                continue;
+            }
+            if (!change->second.Removed) {
+                offsets.push_back(entries.size());
+                WriteEntry(entries, change->first, change->second.Stamp, change->second.Metadata);
+            }
+            if (order == 0)
+                mapped++;
+            ++change;
+        }
+
+        std::vector<BYTE> buffer;
+        CRecordWriter writer(buffer);
+        buffer.insert(buffer.end(), CacheMagic, CacheMagic + 4);
+        writer.Number(CacheVersion, 4);
+        writer.Number(offsets.size(), 8);
+        uint64_t start = HeaderSize + offsets.size() * sizeof(uint64_t);
+        for (uint64_t offset : offsets)
+            writer.Number(start + offset, 8);
+        buffer.insert(buffer.end(), entries.begin(), entries.end());
+
+        std::wstring tempName = m_fileName + L".new";
+        {
+            std::ofstream file(std::filesystem::path(tempName), std::ios::binary | std::ios::trunc);
+            if (!file)
+                throw ExWin32Error(ERROR_OPEN_FAILED, L"Cannot create type library cache " + tempName);
+            file.write((const char*)buffer.data(), buffer.size());
+            file.flush();
+            if (!file)
+                throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot write type library cache " + tempName);
+        }
+
+        //the mapping keeps the old file in use, so it goes first
+        m_file.reset();
+        std::error_code error;
+        std::filesystem::rename(std::filesystem::path(tempName), std::filesystem::path(m_fileName), error);
+        if (error) {
+            std::filesystem::remove(std::filesystem::path(tempName), error);
+            Map();
+            return false;
+        }
+        m_changes.clear();
+        Map();
+        return true;
+    }
+}
@@ -0,0 +1,120 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "TlbInfo.h"
+
+namespace w32
+{
+	/// <summary>
+	/// A file with the CTlbMetadata of type libraries that were read before, so that
+	/// querying or registering the same libraries again does not parse them again.
+	///
+	/// Entries are keyed by the full path of the library, normalized and uppercased, and
+	/// sorted by that key. The file is memory mapped and an entry is found with a binary
+	/// search over an index of offsets; only the entry that is found is decoded.
+	/// An entry is used if the size and last write time of the library are still what
+	/// they were. When they are not, but the contents hash to the same value (the file
+	/// was copied or touched), the entry is kept with the new time instead of parsing the
+	/// library again. The hash is not cryptographic; it only detects changes.
+	///
+	/// New and changed entries are kept in memory until Save, which writes a new file
+	/// next to the old one and then replaces it. A file that is missing, has another
+	/// version or is not a cache file is treated as an empty cache.
+	/// </summary>
+	class CTlbCache
+	{
+	public:
+		//What the cache remembers about the file of a library
+		struct CStamp
+		{
+			uint64_t Size = 0;
+			int64_t WriteTime = 0;
+			uint64_t Hash = 0;
+		};
+
+		//Outcome of Verify
+		struct CVerifyResult
+		{
+			size_t Current = 0;     //the file is the one that was cached
+			size_t Changed = 0;     //the file has other contents, or cannot be read
+			size_t Missing = 0;     //the file no longer exists
+		};
+
+	private:
+		struct CEntry
+		{
+			CStamp Stamp;
+			CTlbMetadata Metadata;
+			bool Removed = false;
+		};
+
+		std::wstring m_fileName;
+		std::unique_ptr<CMappedFile> m_file;        //NULL if there is no usable file
+		size_t m_count = 0;
+		std::map<std::wstring, CEntry> m_changes;   //key -> entry that replaces the one in the file
+
+		void Map();
+		std::wstring_view MappedKey(size_t index) const;
+		const BYTE* MappedRecord(size_t index, const BYTE** end) const;
+		bool FindMapped(const std::wstring& key, size_t& index) const;
+		bool Find(const std::wstring& key, CEntry& entry) const;
+		std::vector<std::wstring> Keys() const;
+
+	public:
+		//Open a cache file. It is created by Save if it does not exist.
+		CTlbCache(const std::wstring& fileName);
+
+		//The metadata of a library: from the cache if the file did not change, otherwise
+		//read from the file and added to the cache. Throws if the library cannot be read.
+		CTlbMetadata Get(const std::wstring& path);
+
+		//The metadata of a library, only if the cache has it for the file as it is now
+		bool TryGet(const std::wstring& path, CTlbMetadata& metadata);
+
+		//Check every entry against its file, including the hash of the contents.
+		//The paths of the entries that are not current are added to stale, if supplied.
+		CVerifyResult Verify(std::vector<std::wstring>* stale = NULL) const;
+
+		//Read every library in the cache again and drop the ones whose file is gone.
+		//Returns the number of libraries that were read. Call Save to keep the result.
+		size_t Rebuild();
+
+		//Number of libraries in the cache
+		size_t Count() const;
+
+		//Are there entries that Save would write
+		bool Modified() const;
+
+		//Write the cache to its file. Returns false if the file cannot be replaced right
+		//now, e.g. because another process has it open; the cache stays as it is.
+		bool Save();
+
+		//Key of a library path: absolute, normalized and uppercased
+		static std::wstring NormalizePath(const std::wstring& path);
+
+		//Size and write time of a file, and the hash of its contents if withHash is true.
+		//Returns false if the file does not exist.
+		static bool StampFile(const std::wstring& path, bool withHash, CStamp& stamp);
+	};
+}
@@ -0,0 +1,197 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TlbChecker.h"
+#include "TlbRegistrar.h"
+#include "HKey.h"
+#include "TreeWalker.h"
+#include "StringHelper.h"
+
+namespace w32
+{
+    static std::wstring FormatVersion(WORD major, WORD minor)
+    {
+        wchar_t version[16];
+        swprintf(version, 16, L"%x.%x", major, minor);
+        return version;
+    }
+
+    static std::wstring Describe(std::wstring_view libId, std::wstring_view version)
+    {
+        std::wstring description(libId);
+        if (!version.empty()) {
+            description += L" ";
+            description += version;
+        }
+        return description;
+    }
+
+    //Looks up the TypeLib key of every interface or class of a walk over the Interface or
+    //CLSID tree in the tables of the checker: Interface\{iid}\TypeLib, CLSID\{clsid}\TypeLib
+    class CTypeLibKeyJoin : public IKeyVisitor
+    {
+        CTlbChecker& m_checker;
+        bool m_perUser;
+        bool m_interfaces;
+        std::wstring m_guid;
+
+        void Report(ETlbCheckIssue issue, std::wstring found, std::wstring expected)
+        {
+            std::wstring key = (m_interfaces ? L"Interface\\" : L"CLSID\\") + m_guid + L"\\TypeLib";
+            m_checker.m_issues.push_back({ issue, m_perUser, key, found, expected });
+        }
+
+        void Join(const CKeySnapshot& values)
+        {
+            std::wstring_view libId;
+            std::wstring_view version;
+            size_t index = values.Find(L"");
+            if (index != CKeySnapshot::npos && values.Type(index) == REG_SZ)
+                libId = values.WSValue(index);
+            index = values.Find(L"Version");
+            if (m_interfaces && index != CKeySnapshot::npos && values.Type(index) == REG_SZ)
+                version = values.WSValue(index);
+            std::wstring lib = ToWUpperName(libId);
+
+            const CTlbChecker::CDefinition* first = NULL;
+            bool sameLibrary = false;
+            bool sameVersion = false;
+            std::wstring guid = ToWUpperName(m_guid);
+            auto definitions = m_checker.m_definitions.find(guid);
+            if (definitions != m_checker.m_definitions.end()) {
+                for (const CTlbChecker::CDefinition& definition : definitions->second) {
+                    if (definition.Interface != m_interfaces)
+                        continue;
+                    const CTlbChecker::CLibrary& library = m_checker.m_libraries[definition.Library];
+                    if (!first)
+                        first = &definition;
+                    if (library.LibId == lib) {
+                        sameLibrary = true;
+                        sameVersion = sameVersion || !m_interfaces || CompareNoCase(library.Version, version) == 0;
+                    }
+                }
+            }
+
+            if (!first) {
+                //a key of a library that was checked, for a type that it does not have
+                if (m_checker.m_libIds.Contains(libId))
+                    Report(ETlbCheckIssue::STALE, Describe(libId, version), L"");
+                return;
+            }
+            m_checker.m_found.Add(guid);
+            const CTlbChecker::CLibrary& expected = m_checker.m_libraries[first->Library];
+            if (!sameLibrary)
+                Report(ETlbCheckIssue::CONFLICT, Describe(libId, version), Describe(expected.LibId, expected.Version));
+            else if (!sameVersion)
+                Report(ETlbCheckIssue::STALE, Describe(libId, version), Describe(expected.LibId, expected.Version));
+        }
+
+    public:
+        CTypeLibKeyJoin(CTlbChecker& checker, bool perUser, bool interfaces) :
+            m_checker(checker), m_perUser(perUser), m_interfaces(interfaces)
+        {
+        }
+
+        void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+        {
+            if (depth == 1)
+                m_guid = key.Name();
+            else if (depth == 2 && CompareNoCase(key.Name(), L"TypeLib") == 0)
+                Join(values);
+        }
+    };
+
+    CTlbChecker::CTlbChecker(IRegBackend* backend, CThreadPool& pool) :
+        m_backend(backend ? backend : GetDefaultRegBackend()),
+        m_pool(pool)
+    {
+    }
+
+    void CTlbChecker::Add(const CTlbMetadata& library)
+    {
+        size_t index = m_libraries.size();
+        CLibrary entry;
+        entry.LibId = ToWUpperName(WStringFromGUID(library.Guid));
+        entry.Version = FormatVersion(library.MajorVersion, library.MinorVersion);
+        m_libIds.Add(entry.LibId);
+        m_libraries.push_back(std::move(entry));
+
+        for (const CTlbTypeEntry& type : library.Types) {
+            bool isInterface = type.Kind == TKIND_INTERFACE || type.Kind == TKIND_DISPATCH;
+            if ((!isInterface && type.Kind != TKIND_COCLASS) || type.Guid == GUID_NULL)
+                continue;
+            CDefinition definition;
+            definition.Library = index;
+            definition.Interface = isInterface;
+            definition.Registered = isInterface && CTlbRegistrar::RegistersInterface(type);
+            m_definitions[ToWUpperName(WStringFromGUID(type.Guid))].push_back(definition);
+        }
+    }
+
+    size_t CTlbChecker::LibraryCount() const
+    {
+        return m_libraries.size();
+    }
+
+    size_t CTlbChecker::GuidCount() const
+    {
+        return m_definitions.size();
+    }
+
+    void CTlbChecker::CheckTree(bool perUser, bool interfaces)
+    {
+        HKEY root = perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
+        std::wstring path = interfaces ? L"Software\\Classes\\Interface" : L"Software\\Classes\\CLSID";
+        if (!CHKey::Exists(root, path, INVALID_HANDLE_VALUE, m_backend))
+            return;
+        CHKey key = CHKey::Open(root, path, GENERIC_READ, INVALID_HANDLE_VALUE, m_backend);
+        CTypeLibKeyJoin join(*this, perUser, interfaces);
+        CTreeWalker walker(m_pool);
+        walker.SetMaxDepth(2);
+        walker.Walk(key, join);
+    }
+
+    void CTlbChecker::Check()
+    {
+        m_issues.clear();
+        m_found.Clear();
+        for (bool perUser : { false, true }) {
+            CheckTree(perUser, true);
+            CheckTree(perUser, false);
+        }
+
+        //the interfaces that registration writes a key for, that no hive has
+        for (const auto& definitions : m_definitions) {
+            if (m_found.Contains(definitions.first))
+                continue;
+            for (const CDefinition& definition : definitions.second) {
+                if (definition.Registered) {
+                    const CLibrary& library = m_libraries[definition.Library];
+                    m_issues.push_back({ ETlbCheckIssue::MISSING, false,
+                        L"Interface\\" + definitions.first + L"\\TypeLib", L"",
+                        Describe(library.LibId, library.Version) });
+                    break;
+                }
+            }
+        }
+    }
+
+    const std::vector<CTlbCheckIssue>& CTlbChecker::Issues() const
+    {
+        return m_issues;
+    }
+}
@@ -0,0 +1,110 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "NameIndex.h"
+#include "TlbInfo.h"
+#include "RegBackend.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+	enum class ETlbCheckIssue
+	{
+		MISSING,        //registration writes the key, but it is not there
+		STALE,          //the key points at the library, but at another version, or at a
+		                //library that no longer has the interface or class
+		CONFLICT        //the key points at another library than the one that has the type
+	};
+
+	/// <summary>
+	/// Something that does not match between the libraries and the registry.
+	/// Key is relative to the Classes key, like in CTlbRegValue.
+	/// </summary>
+	struct CTlbCheckIssue
+	{
+		ETlbCheckIssue Issue;
+		bool PerUser;               //MISSING is not about a hive and is always false
+		std::wstring Key;           //Interface\{iid}\TypeLib or CLSID\{clsid}\TypeLib
+		std::wstring Found;         //libid and version in the registry, empty for MISSING
+		std::wstring Expected;      //libid and version of the library that has the type
+	};
+
+	/// <summary>
+	/// Checks that the Interface\{iid}\TypeLib and CLSID\{clsid}\TypeLib keys of the
+	/// machine and the current user agree with type libraries.
+	///
+	/// The interfaces, dispinterfaces and coclasses of every library that is added go into
+	/// a hash table by GUID, and the libids into another. Check walks the Interface and the
+	/// CLSID tree of each hive once, with CTreeWalker, and looks every TypeLib key it meets
+	/// up in those tables: a hash join, instead of opening a key per GUID.
+	///
+	/// Only interfaces that registering the library writes (see
+	/// CTlbRegistrar::RegistersInterface) can be missing. A class key is written by the
+	/// server rather than by registering the library, so for classes only the keys that
+	/// are there are checked.
+	/// </summary>
+	class CTlbChecker
+	{
+		struct CLibrary
+		{
+			std::wstring LibId;             //uppercased
+			std::wstring Version;           //as registration writes it
+		};
+
+		//A library that has a type with a given GUID
+		struct CDefinition
+		{
+			size_t Library;
+			bool Interface;                 //interface or dispinterface, otherwise coclass
+			bool Registered;                //registering the library writes its key
+		};
+
+		IRegBackend* m_backend;
+		CThreadPool& m_pool;
+		std::vector<CLibrary> m_libraries;
+		std::unordered_map<std::wstring, std::vector<CDefinition>> m_definitions;   //uppercased GUID
+		CNameIndex m_libIds;
+		CNameIndex m_found;                         //GUIDs with a TypeLib key
+		std::vector<CTlbCheckIssue> m_issues;
+
+		void CheckTree(bool perUser, bool interfaces);
+
+		friend class CTypeLibKeyJoin;
+
+	public:
+		CTlbChecker(IRegBackend* backend = NULL,       //NULL means the default backend
+			CThreadPool& pool = CThreadPool::Default());
+
+		//Check the registrations of the types of a library
+		void Add(const CTlbMetadata& library);
+
+		//Number of libraries that were added
+		size_t LibraryCount() const;
+
+		//Number of distinct interface and class GUIDs of those libraries
+		size_t GuidCount() const;
+
+		//Walk the registry and collect the issues
+		void Check();
+
+		const std::vector<CTlbCheckIssue>& Issues() const;
+	};
+}
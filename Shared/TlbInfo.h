@@ -22,6 +22,19 @@
 
 namespace w32
 {
+	/// <summary>
+	/// Attributes of one type in a TLB file
+	/// </summary>
+	struct CTlbTypeEntry
+	{
+		TYPEKIND Kind;
+		GUID Guid;              //GUID_NULL if the type has none
+		std::wstring Name;
+		WORD Flags;             //TYPEFLAGS
+		WORD MajorVersion;
+		WORD MinorVersion;
+	};
+
 	/// <summary>
 	/// A set of information that represents some of the contents of a TLB file
 	/// </summary>
@@ -34,10 +47,24 @@ namespace w32
 		std::vector<GUID> DispInterfaces;
 		WORD MajorVersion;
 		WORD MinorVersion;
+		WORD Flags;             //LIBFLAGS
 		LCID LocaleID;
 		SYSKIND SysKind;
 
 		void PrintTlbInfo();
 	};
+
+	/// <summary>
+	/// What querying or registering a library needs from its file: the CTlbInfo, plus the
+	/// names and attributes of the library and of every type. It is a plain copy that can
+	/// be kept, or cached, without the file.
+	/// </summary>
+	struct CTlbMetadata : CTlbInfo
+	{
+		std::wstring Path;
+		std::wstring Name;
+		std::wstring DocString;
+		std::vector<CTlbTypeEntry> Types;
+	};
 }
 
@@ -0,0 +1,277 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TlbOrphanScanner.h"
+#include "HKey.h"
+#include "TreeWalker.h"
+#include "Task.h"
+#include "WriteBatch.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <algorithm>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace w32
+{
+    static const wchar_t* const ClassesPath = L"Software\\Classes\\";
+    static const wchar_t* const TypeLibPath = L"Software\\Classes\\TypeLib";
+
+    //Collects the platform keys of a walk over a TypeLib tree:
+    //TypeLib\{libid}\version\lcid\platform
+    class CRegistrationCollector : public IKeyVisitor
+    {
+        std::vector<CTlbRegistration>& m_registrations;
+        bool m_perUser;
+        std::vector<std::wstring> m_names;
+
+    public:
+        CRegistrationCollector(std::vector<CTlbRegistration>& registrations, bool perUser) :
+            m_registrations(registrations), m_perUser(perUser)
+        {
+        }
+
+        void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+        {
+            if (depth == 0)
+                return;
+            m_names.resize(depth - 1);
+            m_names.push_back(key.Name());
+            if (depth != 4)
+                return;
+
+            const std::wstring& platform = m_names[3];
+            if (CompareNoCase(platform, L"win16") != 0 && CompareNoCase(platform, L"win32") != 0 &&
+                CompareNoCase(platform, L"win64") != 0)
+                return;
+            size_t index = values.Find(L"");
+            if (index == CKeySnapshot::npos || (values.Type(index) != REG_SZ && values.Type(index) != REG_EXPAND_SZ))
+                return;
+
+            CTlbRegistration registration;
+            registration.PerUser = m_perUser;
+            registration.Key = L"TypeLib\\" + m_names[0] + L"\\" + m_names[1] + L"\\" + m_names[2] + L"\\" + platform;
+            registration.LibId = m_names[0];
+            registration.Version = m_names[1];
+            registration.Locale = m_names[2];
+            registration.Platform = platform;
+            registration.Path = values.WSValue(index);
+            m_registrations.push_back(std::move(registration));
+        }
+    };
+
+    static ETlbFileState CheckFile(const std::wstring& file)
+    {
+        std::filesystem::path path(file);
+        if (file.empty() || !path.is_absolute())
+            return ETlbFileState::UNCHECKED;
+        std::error_code error;
+        return std::filesystem::exists(path, error) ? ETlbFileState::PRESENT : ETlbFileState::MISSING;
+    }
+
+    //Check a range of files on a thread of the pool
+    static CTask<bool> CheckFileRange(const std::vector<std::wstring>& files, std::vector<ETlbFileState>& states,
+        size_t begin, size_t end, CThreadPool* pool)
+    {
+        co_await ResumeOn(pool);
+        for (size_t i = begin; i < end; i++)
+            states[i] = CheckFile(files[i]);
+        co_return true;
+    }
+
+    CTlbOrphanScanner::CTlbOrphanScanner(IRegBackend* backend, CThreadPool& pool) :
+        m_backend(backend ? backend : GetDefaultRegBackend()),
+        m_pool(pool)
+    {
+    }
+
+    void CTlbOrphanScanner::SetIoThreads(size_t threads)
+    {
+        m_ioThreads = std::max<size_t>(threads, 1);
+    }
+
+    void CTlbOrphanScanner::SetBatchSize(size_t keys)
+    {
+        m_batchSize = std::max<size_t>(keys, 1);
+    }
+
+    void CTlbOrphanScanner::ReadRegistrations(bool perUser)
+    {
+        HKEY root = perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
+        if (!CHKey::Exists(root, TypeLibPath, INVALID_HANDLE_VALUE, m_backend))
+            return;
+        CHKey key = CHKey::Open(root, TypeLibPath, GENERIC_READ, INVALID_HANDLE_VALUE, m_backend);
+        CRegistrationCollector collector(m_registrations, perUser);
+        CTreeWalker walker(m_pool);
+        walker.SetMaxDepth(4);
+        walker.Walk(key, collector);
+    }
+
+    void CTlbOrphanScanner::CheckFiles()
+    {
+        //many registrations share a file, e.g. every version of a library on both platforms
+        std::vector<std::wstring> files;
+        std::unordered_map<std::wstring, size_t> fileIndex;
+        std::vector<size_t> fileOf;
+        fileOf.reserve(m_registrations.size());
+        for (const CTlbRegistration& registration : m_registrations) {
+            std::wstring file = FileOf(registration.Path);
+            auto found = fileIndex.emplace(ToWUpperName(file), files.size());
+            if (found.second)
+                files.push_back(file);
+            fileOf.push_back(found.first->second);
+        }
+
+        //a few ranges per thread, so that a slow share does not hold up the rest
+        std::vector<ETlbFileState> states(files.size(), ETlbFileState::UNCHECKED);
+        {
+            CThreadPool ioPool(m_ioThreads);
+            size_t rangeSize = std::max<size_t>(1, files.size() / (m_ioThreads * 4));
+            std::vector<CTask<bool>> tasks;
+            for (size_t begin = 0; begin < files.size(); begin += rangeSize)
+                tasks.push_back(CheckFileRange(files, states, begin, std::min(begin + rangeSize, files.size()), &ioPool));
+            SyncWait(WhenAll(std::move(tasks)));
+        }
+
+        m_files = files.size();
+        m_states.clear();
+        m_states.reserve(m_registrations.size());
+        for (size_t file : fileOf)
+            m_states.push_back(states[file]);
+    }
+
+    void CTlbOrphanScanner::Scan()
+    {
+        m_registrations.clear();
+        ReadRegistrations(false);
+        ReadRegistrations(true);
+        CheckFiles();
+    }
+
+    const std::vector<CTlbRegistration>& CTlbOrphanScanner::Registrations() const
+    {
+        return m_registrations;
+    }
+
+    const std::vector<ETlbFileState>& CTlbOrphanScanner::States() const
+    {
+        return m_states;
+    }
+
+    size_t CTlbOrphanScanner::FileCount() const
+    {
+        return m_files;
+    }
+
+    std::vector<size_t> CTlbOrphanScanner::Orphans() const
+    {
+        std::vector<size_t> orphans;
+        for (size_t i = 0; i < m_states.size(); i++) {
+            if (m_states[i] == ETlbFileState::MISSING)
+                orphans.push_back(i);
+        }
+        return orphans;
+    }
+
+    std::vector<std::wstring> CTlbOrphanScanner::OrphanKeys(bool perUser) const
+    {
+        //the library, version and locale keys, with how many of the registrations below
+        //them have a file and how many do not
+        struct CCount
+        {
+            size_t present = 0;
+            size_t missing = 0;
+        };
+        std::map<std::wstring, CCount> counts;
+        auto levels = [](const CTlbRegistration& registration) {
+            std::wstring library = L"TypeLib\\" + registration.LibId;
+            std::wstring version = library + L"\\" + registration.Version;
+            std::wstring locale = version + L"\\" + registration.Locale;
+            return std::vector<std::wstring>{ library, version, locale, registration.Key };
+        };
+        for (size_t i = 0; i < m_registrations.size(); i++) {
+            if (m_registrations[i].PerUser != perUser)
+                continue;
+            for (const std::wstring& level : levels(m_registrations[i])) {
+                CCount& count = counts[ToWUpperName(level)];
+                if (m_states[i] == ETlbFileState::MISSING)
+                    count.missing++;
+                else
+                    count.present++;
+            }
+        }
+
+        //delete the highest key that has nothing but orphans below it
+        std::set<std::wstring> deleted;
+        std::vector<std::wstring> keys;
+        for (size_t i : Orphans()) {
+            if (m_registrations[i].PerUser != perUser)
+                continue;
+            for (const std::wstring& level : levels(m_registrations[i])) {
+                std::wstring id = ToWUpperName(level);
+                if (counts[id].present > 0)
+                    continue;
+                if (deleted.insert(id).second)
+                    keys.push_back(level);
+                break;
+            }
+        }
+        return keys;
+    }
+
+    size_t CTlbOrphanScanner::Fix()
+    {
+        size_t deleted = 0;
+        for (bool perUser : { false, true }) {
+            HKEY root = perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
+            std::vector<std::wstring> keys = OrphanKeys(perUser);
+            for (size_t begin = 0; begin < keys.size(); begin += m_batchSize) {
+                size_t end = std::min(begin + m_batchSize, keys.size());
+                CWriteBatch batch(m_backend);
+                for (size_t i = begin; i < end; i++)
+                    batch.DeleteTree(root, ClassesPath + keys[i]);
+                if (!batch.Apply()) {
+                    for (size_t i = 0; i < batch.Count(); i++) {
+                        if (batch.Status(i) != ERROR_SUCCESS)
+                            throw ExWin32Error(batch.Status(i), L"Cannot delete " + keys[begin + i]);
+                    }
+                }
+                deleted += end - begin;
+            }
+        }
+
+        //what is left are the registrations that have a file
+        size_t kept = 0;
+        for (size_t i = 0; i < m_registrations.size(); i++) {
+            if (m_states[i] != ETlbFileState::MISSING) {
+                m_registrations[kept] = std::move(m_registrations[i]);
+                m_states[kept] = m_states[i];
+                kept++;
+            }
+        }
+        m_registrations.resize(kept);
+        m_states.resize(kept);
+        return deleted;
+    }
+
+    std::wstring CTlbOrphanScanner::FileOf(const std::wstring& path)
+    {
+        return RegisteredFile(path);
+    }
+}
@@ -0,0 +1,112 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <string>
+#include <vector>
+#include "RegBackend.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+	/// <summary>
+	/// One file that a type library is registered with: TypeLib\{libid}\version\lcid\platform.
+	/// Key is relative to the Classes key, like in CTlbRegValue.
+	/// </summary>
+	struct CTlbRegistration
+	{
+		bool PerUser;
+		std::wstring Key;
+		std::wstring LibId;
+		std::wstring Version;
+		std::wstring Locale;
+		std::wstring Platform;
+		std::wstring Path;          //as registered
+	};
+
+	enum class ETlbFileState
+	{
+		PRESENT,
+		MISSING,
+		UNCHECKED       //not a full path, it is found through the search path when loaded
+	};
+
+	/// <summary>
+	/// Finds type library registrations whose file no longer exists, and removes them.
+	///
+	/// The TypeLib trees of the machine and the current user are walked with CTreeWalker.
+	/// Every distinct file is then checked once, on a pool of its own with a bounded
+	/// number of threads: checking a file is waiting for the disk or the network, so more
+	/// of them can be in flight than there are processors, but not so many that they
+	/// flood a file server.
+	///
+	/// Fix deletes the platform keys of the orphans, and the keys above them that are
+	/// left without a file: the locale, the version and the library. The deletions are
+	/// cut into batches, each applied in its own transaction, so a large cleanup does not
+	/// become one huge transaction. Like CTreeDeleter this is not atomic as a whole; if it
+	/// fails part way, scanning and fixing again finishes the job.
+	/// </summary>
+	class CTlbOrphanScanner
+	{
+		IRegBackend* m_backend;
+		CThreadPool& m_pool;
+		size_t m_ioThreads = 16;
+		size_t m_batchSize = 256;
+		std::vector<CTlbRegistration> m_registrations;
+		std::vector<ETlbFileState> m_states;
+		size_t m_files = 0;
+
+		void ReadRegistrations(bool perUser);
+		void CheckFiles();
+
+	public:
+		CTlbOrphanScanner(IRegBackend* backend = NULL,     //NULL means the default backend
+			CThreadPool& pool = CThreadPool::Default());
+
+		//Number of files that are checked at the same time
+		void SetIoThreads(size_t threads);
+
+		//Maximum number of keys that are deleted in one transaction
+		void SetBatchSize(size_t keys);
+
+		//Read the registrations and check their files
+		void Scan();
+
+		const std::vector<CTlbRegistration>& Registrations() const;
+
+		//State of the file of each registration, in the same order
+		const std::vector<ETlbFileState>& States() const;
+
+		//Number of distinct files that were checked
+		size_t FileCount() const;
+
+		//Indexes of the registrations whose file is missing
+		std::vector<size_t> Orphans() const;
+
+		//The keys that Fix deletes, for the machine or the current user, relative to the
+		//Classes key. A key is listed once, and not if a key above it is listed.
+		std::vector<std::wstring> OrphanKeys(bool perUser) const;
+
+		//Delete the orphans. Returns the number of keys that were deleted.
+		//Throws the error of the first batch that fails; the batches before it stay deleted.
+		size_t Fix();
+
+		//The file to check for a registered path: unquoted, with environment variables
+		//expanded and without the resource number of a library inside a module
+		static std::wstring FileOf(const std::wstring& path);
+	};
+}
@@ -0,0 +1,163 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TlbRegPlan.h"
+#include "WriteBatch.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <iostream>
+
+using namespace std;
+
+namespace w32
+{
+    CTlbRegPlan::CTlbRegPlan(bool perUser, IRegBackend* backend) :
+        m_root(perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE),
+        m_backend(backend ? backend : GetDefaultRegBackend()),
+        m_keys(64, m_backend)
+    {
+    }
+
+    void CTlbRegPlan::Add(const CTlbMetadata& library)
+    {
+        std::vector<CTlbRegValue> values;
+        CTlbRegistrar::GetValues(library, values);
+        Compare(values);
+        FindStaleInterfaces(library);
+    }
+
+    //The values of one key are next to each other, so every key is read once
+    void CTlbRegPlan::Compare(const std::vector<CTlbRegValue>& values)
+    {
+        CKeySnapshot snapshot;
+        bool exists = false;
+        const std::wstring* current = NULL;
+        for (const CTlbRegValue& value : values) {
+            if (current == NULL || *current != value.Key) {
+                current = &value.Key;
+                std::shared_ptr<CHKey> key = m_keys.TryOpen(m_root, CTlbRegistrar::ClassesPath + value.Key);
+                exists = key != NULL;
+                if (exists)
+                    key->Snapshot(snapshot);
+            }
+
+            size_t index = exists ? snapshot.Find(value.Name) : CKeySnapshot::npos;
+            if (index == CKeySnapshot::npos) {
+                m_changes.push_back({ ETlbRegChange::CREATE, value.Key, value.Name, L"", value.Data });
+                continue;
+            }
+
+            DWORD type = snapshot.Type(index);
+            if (type == REG_SZ && snapshot.WSValue(index) == value.Data) {
+                m_unchanged++;
+                continue;
+            }
+            std::wstring old = type == REG_SZ || type == REG_EXPAND_SZ ?
+                std::wstring(snapshot.WSValue(index)) : L"<type " + std::to_wstring(type) + L">";
+            m_changes.push_back({ ETlbRegChange::UPDATE, value.Key, value.Name, old, value.Data });
+        }
+    }
+
+    //Interfaces that lost [oleautomation], or dispinterfaces that became plain
+    //interfaces, keep pointing at the library after it is registered again
+    void CTlbRegPlan::FindStaleInterfaces(const CTlbMetadata& library)
+    {
+        std::wstring libId = WStringFromGUID(library.Guid);
+        wchar_t version[16];
+        swprintf(version, 16, L"%x.%x", library.MajorVersion, library.MinorVersion);
+
+        for (const CTlbTypeEntry& type : library.Types) {
+            if (type.Kind != TKIND_INTERFACE || (type.Flags & TYPEFLAG_FOLEAUTOMATION))
+                continue;
+
+            std::wstring interfaceKey = L"Interface\\" + WStringFromGUID(type.Guid);
+            std::shared_ptr<CHKey> key = m_keys.TryOpen(m_root, CTlbRegistrar::ClassesPath + interfaceKey + L"\\TypeLib");
+            if (!key)
+                continue;
+
+            CKeySnapshot snapshot = key->Snapshot();
+            size_t owner = snapshot.Find(L"");
+            size_t ownerVersion = snapshot.Find(L"Version");
+            if (owner == CKeySnapshot::npos || ownerVersion == CKeySnapshot::npos ||
+                snapshot.Type(owner) != REG_SZ || snapshot.Type(ownerVersion) != REG_SZ)
+                continue;
+            if (CompareNoCase(snapshot.WSValue(owner), libId) == 0 && snapshot.WSValue(ownerVersion) == version)
+                m_changes.push_back({ ETlbRegChange::DELETE_KEY, interfaceKey, L"", L"", L"" });
+        }
+    }
+
+    const std::vector<CTlbRegChange>& CTlbRegPlan::Changes() const
+    {
+        return m_changes;
+    }
+
+    size_t CTlbRegPlan::UnchangedCount() const
+    {
+        return m_unchanged;
+    }
+
+    HKEY CTlbRegPlan::Root() const
+    {
+        return m_root;
+    }
+
+    void CTlbRegPlan::Apply(HANDLE transaction)
+    {
+        if (m_changes.empty())
+            return;
+
+        CWriteBatch batch(m_backend);
+        for (const CTlbRegChange& change : m_changes) {
+            std::wstring path = CTlbRegistrar::ClassesPath + change.Key;
+            if (change.Change == ETlbRegChange::DELETE_KEY)
+                batch.DeleteTree(m_root, path);
+            else
+                batch.SetValue(m_root, path, change.Name, change.NewData);
+        }
+
+        bool success = batch.Apply(transaction);
+        m_keys.Clear();
+        if (!success) {
+            for (size_t i = 0; i < batch.Count(); i++) {
+                if (batch.Status(i) != ERROR_SUCCESS)
+                    throw ExWin32Error(batch.Status(i), L"Cannot register type library");
+            }
+        }
+    }
+
+    void CTlbRegPlan::Print() const
+    {
+        std::wstring root = CHKey::GetWellKnownKeyName(m_root) + L"\\" + CTlbRegistrar::ClassesPath;
+        for (const CTlbRegChange& change : m_changes) {
+            const wchar_t* name = change.Name.empty() ? L"(Default)" : change.Name.c_str();
+            switch (change.Change)
+            {
+            case ETlbRegChange::CREATE:
+                wcout << L"+ " << root << change.Key << L" " << name << L" = " << change.NewData << endl;
+                break;
+            case ETlbRegChange::UPDATE:
+                wcout << L"~ " << root << change.Key << L" " << name << L" = " << change.NewData <<
+                    L" (was " << change.OldData << L")" << endl;
+                break;
+            case ETlbRegChange::DELETE_KEY:
+                wcout << L"- " << root << change.Key << endl;
+                break;
+            }
+        }
+        wcout << m_changes.size() << L" changes, " << m_unchanged << L" values unchanged" << endl;
+    }
+}
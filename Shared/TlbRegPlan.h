@@ -0,0 +1,92 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <string>
+#include <vector>
+#include "TlbRegistrar.h"
+#include "KeyCache.h"
+
+namespace w32
+{
+	enum class ETlbRegChange
+	{
+		CREATE,         //the value does not exist
+		UPDATE,         //the value exists with other data or another type
+		DELETE_KEY      //a key that a previous registration left behind
+	};
+
+	/// <summary>
+	/// A difference between the registry and what registration writes. Keys are relative
+	/// to the Classes key, like in CTlbRegValue. DELETE_KEY has no name or data and
+	/// removes the key with everything below it.
+	/// </summary>
+	struct CTlbRegChange
+	{
+		ETlbRegChange Change;
+		std::wstring Key;
+		std::wstring Name;
+		std::wstring OldData;       //UPDATE; a description of the data if it is not a string
+		std::wstring NewData;       //CREATE and UPDATE
+	};
+
+	/// <summary>
+	/// Works out what registering type libraries would change, so that registering a
+	/// library that is already registered writes nothing.
+	///
+	/// For every library that is added, the values of CTlbRegistrar are compared with the
+	/// registry: every key they go into is read once, values that are already there with
+	/// the same data are left out. Interfaces of the library that are not registered (any
+	/// more), but whose TypeLib key still points at this version of the library, are
+	/// deleted, the same as UnRegisterTypeLib would for those that are.
+	///
+	/// The plan reflects the registry at the time the library was added. Apply writes
+	/// only the changes, in one transaction; Print shows them without writing anything.
+	/// </summary>
+	class CTlbRegPlan
+	{
+		HKEY m_root;
+		IRegBackend* m_backend;
+		CKeyCache m_keys;
+		std::vector<CTlbRegChange> m_changes;
+		size_t m_unchanged = 0;
+
+		void Compare(const std::vector<CTlbRegValue>& values);
+		void FindStaleInterfaces(const CTlbMetadata& library);
+
+	public:
+		CTlbRegPlan(bool perUser, IRegBackend* backend = NULL);   //NULL means the default backend
+
+		//Compare the values that registering the library writes with the registry
+		void Add(const CTlbMetadata& library);
+
+		const std::vector<CTlbRegChange>& Changes() const;
+
+		//Number of values that are already registered as they should be
+		size_t UnchangedCount() const;
+
+		HKEY Root() const;
+
+		//Write the changes. If a transaction is supplied, they become part of it and the
+		//caller decides whether to commit. Otherwise a local transaction is used.
+		//Throws the error of the first change that could not be made.
+		void Apply(HANDLE transaction = INVALID_HANDLE_VALUE);
+
+		//Show the changes on the console
+		void Print() const;
+	};
+}
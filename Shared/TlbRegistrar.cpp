@@ -0,0 +1,119 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TlbRegistrar.h"
+#include "WriteBatch.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include <filesystem>
+
+namespace w32
+{
+    const wchar_t* const CTlbRegistrar::ClassesPath = L"Software\\Classes\\";
+
+    //Proxy/stub of interfaces that are marshaled with the type library (PSOAInterface),
+    //and of dispinterfaces that are only called through IDispatch (PSDispatch)
+    static const wchar_t* const TypeLibProxy = L"{00020424-0000-0000-C000-000000000046}";
+    static const wchar_t* const DispatchProxy = L"{00020420-0000-0000-C000-000000000046}";
+
+    static const wchar_t* PlatformName(SYSKIND sysKind)
+    {
+        switch (sysKind)
+        {
+        case SYS_WIN16:
+            return L"win16";
+        case SYS_WIN32:
+            return L"win32";
+        case SYS_WIN64:
+            return L"win64";
+        default:
+            throw ExWin32Error(ERROR_NOT_SUPPORTED, L"The type library is for a platform that cannot be registered");
+        }
+    }
+
+    CTlbRegistrar::CTlbRegistrar(bool perUser, IRegBackend* backend) :
+        m_root(perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE),
+        m_backend(backend ? backend : GetDefaultRegBackend())
+    {
+    }
+
+    bool CTlbRegistrar::RegistersInterface(const CTlbTypeEntry& type)
+    {
+        return type.Kind == TKIND_DISPATCH ||
+            (type.Kind == TKIND_INTERFACE && (type.Flags & TYPEFLAG_FOLEAUTOMATION));
+    }
+
+    void CTlbRegistrar::GetValues(const CTlbMetadata& library, std::vector<CTlbRegValue>& values)
+    {
+        std::wstring libId = WStringFromGUID(library.Guid);
+        wchar_t version[16];
+        swprintf(version, 16, L"%x.%x", library.MajorVersion, library.MinorVersion);
+        wchar_t locale[16];
+        swprintf(locale, 16, L"%lx", (unsigned long)library.LocaleID);
+
+        std::wstring versionKey = L"TypeLib\\" + libId + L"\\" + version;
+        const std::wstring& description = library.DocString.empty() ? library.Name : library.DocString;
+        values.push_back({ versionKey, L"", description });
+        values.push_back({ versionKey + L"\\" + locale + L"\\" + PlatformName(library.SysKind), L"", library.Path });
+        values.push_back({ versionKey + L"\\FLAGS", L"", std::to_wstring(library.Flags) });
+        values.push_back({ versionKey + L"\\HELPDIR", L"",
+            std::filesystem::path(library.Path).parent_path().wstring() });
+
+        for (const CTlbTypeEntry& type : library.Types) {
+            if (!RegistersInterface(type))
+                continue;
+
+            std::wstring interfaceKey = L"Interface\\" + WStringFromGUID(type.Guid);
+            const wchar_t* proxy = type.Kind == TKIND_INTERFACE || (type.Flags & TYPEFLAG_FDUAL) ?
+                TypeLibProxy : DispatchProxy;
+            values.push_back({ interfaceKey, L"", type.Name });
+            values.push_back({ interfaceKey + L"\\ProxyStubClsid", L"", proxy });
+            values.push_back({ interfaceKey + L"\\ProxyStubClsid32", L"", proxy });
+            values.push_back({ interfaceKey + L"\\TypeLib", L"", libId });
+            values.push_back({ interfaceKey + L"\\TypeLib", L"Version", version });
+        }
+    }
+
+    void CTlbRegistrar::Add(const CTlbMetadata& library)
+    {
+        GetValues(library, m_values);
+    }
+
+    const std::vector<CTlbRegValue>& CTlbRegistrar::Values() const
+    {
+        return m_values;
+    }
+
+    HKEY CTlbRegistrar::Root() const
+    {
+        return m_root;
+    }
+
+    void CTlbRegistrar::Apply(HANDLE transaction)
+    {
+        CWriteBatch batch(m_backend);
+        for (const CTlbRegValue& value : m_values)
+            batch.SetValue(m_root, ClassesPath + value.Key, value.Name, value.Data);
+
+        if (!batch.Apply(transaction)) {
+            for (size_t i = 0; i < batch.Count(); i++) {
+                if (batch.Status(i) != ERROR_SUCCESS)
+                    throw ExWin32Error(batch.Status(i), L"Cannot register type library");
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <string>
+#include <vector>
+#include "TypeLibrary.h"
+#include "RegBackend.h"
+
+namespace w32
+{
+	/// <summary>
+	/// A REG_SZ value that registering a type library writes. The key is relative to
+	/// the Classes key of the hive, and an empty name is the default value of the key.
+	/// </summary>
+	struct CTlbRegValue
+	{
+		std::wstring Key;
+		std::wstring Name;
+		std::wstring Data;
+	};
+
+	/// <summary>
+	/// Registers type libraries by writing the same registry entries as RegisterTypeLib,
+	/// without going through OLE:
+	///   TypeLib\{libid}\{major}.{minor}                 description, or name if there is none
+	///   TypeLib\{libid}\{major}.{minor}\{lcid}\win32    path of the file (win16, win32 or win64)
+	///   TypeLib\{libid}\{major}.{minor}\FLAGS           LIBFLAGS in decimal
+	///   TypeLib\{libid}\{major}.{minor}\HELPDIR         folder of the file
+	/// and for every dispinterface and every interface with [oleautomation]:
+	///   Interface\{iid}                                 name of the interface
+	///   Interface\{iid}\ProxyStubClsid and ProxyStubClsid32
+	///   Interface\{iid}\TypeLib                         libid, and Version {major}.{minor}
+	/// Version numbers and the LCID are in hexadecimal, like OLE writes them.
+	///
+	/// Libraries are added first and then written all at once with a CWriteBatch, in one
+	/// transaction and through any backend, so that registering many libraries, or
+	/// registering into an in-memory or offline hive, does not need a registry call per
+	/// value and either succeeds or changes nothing.
+	///
+	/// Unlike RegisterTypeLib, only the registry view of the backend is written; OLE also
+	/// writes the Interface keys into the 32 bit view on 64 bit Windows.
+	/// </summary>
+	class CTlbRegistrar
+	{
+		HKEY m_root;
+		IRegBackend* m_backend;
+		std::vector<CTlbRegValue> m_values;
+
+	public:
+		//The Classes key of HKEY_LOCAL_MACHINE or HKEY_CURRENT_USER, below the root
+		static const wchar_t* const ClassesPath;
+
+		CTlbRegistrar(bool perUser, IRegBackend* backend = NULL);   //NULL means the default backend
+
+		//Does registering a library write an Interface key for the type: the same interfaces
+		//as RegisterTypeLib, those that can be marshaled without a proxy DLL of their own
+		static bool RegistersInterface(const CTlbTypeEntry& type);
+
+		//The values that registering the library writes, appended to the list
+		static void GetValues(const CTlbMetadata& library, std::vector<CTlbRegValue>& values);
+
+		//Add the values of a library
+		void Add(const CTlbMetadata& library);
+
+		//The values of every library that was added
+		const std::vector<CTlbRegValue>& Values() const;
+
+		HKEY Root() const;
+
+		//Write all values. If a transaction is supplied, the values become part of it and
+		//the caller decides whether to commit. Otherwise a local transaction is used.
+		//Throws the error of the first value that could not be written.
+		void Apply(HANDLE transaction = INVALID_HANDLE_VALUE);
+	};
+}
@@ -0,0 +1,420 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TreeDeleter.h"
+#include "TreeWalker.h"
+#include "StringHelper.h"
+#include "Exception.h"
+#include "MappedFile.h"
+#include "RecordStream.h"
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+
+namespace w32
+{
+	static const char CheckpointMagic[4] = { 'R', 'G', 'D', 'C' };
+	static const uint32_t CheckpointVersion = 1;
+	static const char* CheckpointDamaged = "The checkpoint file is damaged";
+
+	//Number of times a batch is tried when it conflicts with another transaction
+	static const int ConflictRetries = 5;
+
+	//Collects the relative path of every key below the root, by depth
+	class CCollectVisitor : public IKeyVisitor
+	{
+		std::vector<std::vector<std::wstring>>& m_levels;
+		std::vector<std::wstring> m_stack;      //path of the key that was visited last
+
+	public:
+		CCollectVisitor(std::vector<std::vector<std::wstring>>& levels) : m_levels(levels) {}
+
+		void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+		{
+			if (depth == 0)
+				return;
+
+			//keys are visited in pre-order, so the parent is what is left on the stack
+			m_stack.resize(depth - 1);
+			m_stack.push_back(std::wstring(key.Name()));
+			std::wstring path = m_stack[0];
+			for (size_t i = 1; i < m_stack.size(); i++)
+				path += L"\\" + m_stack[i];
+
+			if (m_levels.size() < depth)
+				m_levels.resize(depth);
+			m_levels[depth - 1].push_back(std::move(path));
+		}
+	};
+
+	//The part of a relative path up to the last separator
+	static std::wstring_view ParentOf(std::wstring_view path)
+	{
+		size_t index = path.find_last_of(L'\\');
+		return index == std::wstring_view::npos ? std::wstring_view() : path.substr(0, index);
+	}
+
+	CTreeDeleter::CTreeDeleter(IRegBackend* backend, CThreadPool& pool) :
+		m_backend(backend ? backend : GetDefaultRegBackend()),
+		m_pool(pool)
+	{
+	}
+
+	void CTreeDeleter::SetBatchSize(size_t keys)
+	{
+		m_batchSize = keys ? keys : 1;
+	}
+
+	void CTreeDeleter::SetProgress(IDeleteProgress* progress)
+	{
+		m_progress = progress;
+	}
+
+	void CTreeDeleter::SetCheckpointFile(const std::wstring& path)
+	{
+		m_checkpointFile = path;
+	}
+
+	size_t CTreeDeleter::DeletedCount()
+	{
+		return m_deleted;
+	}
+
+	void CTreeDeleter::DeleteTree(HKEY root, const std::wstring& subKey, bool deleteSubKey)
+	{
+		//Same safety checks as CHKey::DeleteTree
+		if (root == NULL || subKey.empty())
+			throw ExWin32Error(ERROR_INVALID_PARAMETER);
+
+		m_deleted = 0;
+		m_levels.clear();
+		m_batches.clear();
+
+		{
+			CHKey key = CHKey::Open(root, subKey, KEY_READ | KEY_WRITE,
+				INVALID_HANDLE_VALUE, m_backend);
+			std::wstring rootPath = key.Path();
+
+			if (m_checkpointFile.empty() || !LoadCheckpoint(rootPath)) {
+				Enumerate(key);
+				MakeBatches();
+				if (!m_checkpointFile.empty())
+					SaveCheckpoint(rootPath);
+			}
+
+			size_t total = 0;
+			for (std::vector<std::wstring>& level : m_levels)
+				total += level.size();
+			for (CBatch& batch : m_batches) {
+				if (batch.done)
+					m_deleted += batch.count;
+			}
+
+			//deepest level first, so every key is a leaf by the time it is deleted
+			for (size_t level = m_levels.size(); level > 0; level--)
+				DeleteLevel(key, level - 1, total);
+		}
+
+		if (deleteSubKey) {
+			LSTATUS retVal = m_backend->DeleteKey(root, subKey.c_str(), INVALID_HANDLE_VALUE);
+			if (retVal != ERROR_SUCCESS && retVal != ERROR_FILE_NOT_FOUND)
+				throw ExWin32Error(retVal);
+		}
+		else {
+			ClearValues(root, subKey);
+		}
+
+		if (!m_checkpointFile.empty()) {
+			std::error_code error;
+			std::filesystem::remove(std::filesystem::path(m_checkpointFile), error);
+		}
+	}
+
+	void CTreeDeleter::Enumerate(CHKey& root)
+	{
+		//only the names matter, not the values
+		CCollectVisitor visitor(m_levels);
+		CTreeWalker walker(m_pool, false);
+		walker.Walk(root, visitor);
+	}
+
+	//Cut every level into batches, deepest level first
+	void CTreeDeleter::MakeBatches()
+	{
+		for (size_t level = m_levels.size(); level > 0; level--) {
+			size_t count = m_levels[level - 1].size();
+			for (size_t first = 0; first < count; first += m_batchSize) {
+				CBatch batch;
+				batch.level = level - 1;
+				batch.first = first;
+				batch.count = (count - first < m_batchSize) ? count - first : m_batchSize;
+				m_batches.push_back(batch);
+			}
+		}
+	}
+
+	//Delete the values of the root in a final transaction, like RegDeleteTree does
+	void CTreeDeleter::ClearValues(HKEY root, const std::wstring& subKey)
+	{
+		CRegTransaction transaction(m_backend);
+		transaction.Create();
+		CHKey key = CHKey::Open(root, subKey, KEY_READ | KEY_WRITE, transaction, m_backend);
+		for (const std::wstring& name : key.GetValues())
+			key.DeleteValue(name);
+		transaction.Commit();
+	}
+
+	//Delete the keys of one batch in one transaction
+	void CTreeDeleter::DeleteBatch(HKEY root, const CBatch& batch)
+	{
+		const std::vector<std::wstring>& keys = m_levels[batch.level];
+		for (int attempt = 1;; attempt++)
+		{
+			CRegTransaction transaction(m_backend);
+			transaction.Create();
+
+			LSTATUS retVal = ERROR_SUCCESS;
+			size_t i;
+			for (i = batch.first; i < batch.first + batch.count; i++) {
+				retVal = m_backend->DeleteKey(root, keys[i].c_str(), transaction);
+				//a key that is already gone was deleted by an earlier, interrupted run
+				if (retVal == ERROR_FILE_NOT_FOUND)
+					retVal = ERROR_SUCCESS;
+				if (retVal != ERROR_SUCCESS)
+					break;
+			}
+
+			if (retVal == ERROR_SUCCESS) {
+				try {
+					transaction.Commit();
+					return;
+				}
+				catch (Win32Exception& e) {
+					retVal = e.Value();
+					if (retVal != ERROR_TRANSACTIONAL_CONFLICT || attempt == ConflictRetries)
+						throw;
+				}
+			}
+			else {
+				transaction.RollBack();
+				if (retVal != ERROR_TRANSACTIONAL_CONFLICT || attempt == ConflictRetries)
+					throw ExWin32Error(retVal, L"Cannot delete " + keys[i]);
+			}
+		}
+	}
+
+	//Delete all the keys of a level on the pool, and report each batch as it completes
+	void CTreeDeleter::DeleteLevel(HKEY root, size_t level, size_t total)
+	{
+		//Batches whose boundary falls between siblings go in the same lane, so that
+		//they are not committed in parallel under the same parent.
+		std::vector<std::vector<size_t>> lanes;
+		const std::vector<std::wstring>& keys = m_levels[level];
+		for (size_t b = 0; b < m_batches.size(); b++) {
+			CBatch& batch = m_batches[b];
+			if (batch.level != level || batch.done)
+				continue;
+			bool sameParent = !lanes.empty() && batch.first > 0 &&
+				m_batches[lanes.back().back()].level == level &&
+				m_batches[lanes.back().back()].first + m_batches[lanes.back().back()].count == batch.first &&
+				ParentOf(keys[batch.first - 1]) == ParentOf(keys[batch.first]);
+			if (sameParent)
+				lanes.back().push_back(b);
+			else
+				lanes.push_back(std::vector<size_t>{ b });
+		}
+
+		std::mutex lock;
+		std::condition_variable changed;
+		std::vector<size_t> completed;
+		size_t runningLanes = lanes.size();
+		std::exception_ptr error;
+		bool cancelled = false;
+
+		for (std::vector<size_t>& lane : lanes) {
+			m_pool.Submit([&, root]() {
+				for (size_t b : lane) {
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						if (cancelled)
+							break;
+					}
+					try {
+						DeleteBatch(root, m_batches[b]);
+					}
+					catch (...) {
+						std::lock_guard<std::mutex> guard(lock);
+						if (!error)
+							error = std::current_exception();
+						cancelled = true;
+						break;
+					}
+					std::lock_guard<std::mutex> guard(lock);
+					completed.push_back(b);
+					changed.notify_all();
+				}
+				std::lock_guard<std::mutex> guard(lock);
+				runningLanes--;
+				changed.notify_all();
+			});
+		}
+
+		//Record progress on this thread, so that the checkpoint file and the
+		//progress callback are not used concurrently. Batches that are committed after
+		//another one failed are still recorded, so a rerun does not repeat them.
+		bool record = !m_checkpointFile.empty();
+		std::unique_lock<std::mutex> guard(lock);
+		for (;;) {
+			changed.wait(guard, [&]() { return !completed.empty() || runningLanes == 0; });
+			std::vector<size_t> batches;
+			batches.swap(completed);
+			bool finished = runningLanes == 0;
+			bool report = !cancelled;
+
+			guard.unlock();
+			try {
+				for (size_t b : batches) {
+					m_batches[b].done = true;
+					m_deleted += m_batches[b].count;
+					if (record)
+						MarkCheckpoint(b);
+					if (report && m_progress)
+						m_progress->OnProgress(m_deleted, total);
+				}
+			}
+			catch (...) {
+				//the lanes still use the state on this stack, so wait for them first
+				guard.lock();
+				if (!error)
+					error = std::current_exception();
+				cancelled = true;
+				guard.unlock();
+				//the checkpoint file or the progress callback failed, stop using either
+				record = false;
+			}
+			guard.lock();
+
+			if (finished && completed.empty())
+				break;
+		}
+
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	/////////////////////////////////////////////////////////////
+	//Checkpoint file, see CRecordWriter for how fields are stored
+	//  header:  "RGDC", version (4 bytes), root path, batch size (8 bytes),
+	//           number of levels (4 bytes)
+	//  level:   number of keys (4 bytes), relative path of every key
+	//  then a batch number (8 bytes) for every committed batch
+	/////////////////////////////////////////////////////////////
+
+	void CTreeDeleter::SaveCheckpoint(const std::wstring& rootPath)
+	{
+		std::vector<BYTE> buffer;
+		CRecordWriter writer(buffer);
+		buffer.insert(buffer.end(), CheckpointMagic, CheckpointMagic + 4);
+		writer.Number(CheckpointVersion, 4);
+		writer.String(rootPath);
+		writer.Number(m_batchSize, 8);
+		writer.Number(m_levels.size(), 4);
+		for (std::vector<std::wstring>& level : m_levels) {
+			writer.Number(level.size(), 4);
+			for (std::wstring& key : level)
+				writer.String(key);
+		}
+
+		std::ofstream file(std::filesystem::path(m_checkpointFile), std::ios::binary | std::ios::trunc);
+		if (!file)
+			throw ExWin32Error(ERROR_OPEN_FAILED, L"Cannot create checkpoint file " + m_checkpointFile);
+		file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+		file.flush();
+		if (!file)
+			throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot write checkpoint file " + m_checkpointFile);
+	}
+
+	void CTreeDeleter::MarkCheckpoint(size_t batch)
+	{
+		std::vector<BYTE> buffer;
+		CRecordWriter(buffer).Number(batch, 8);
+
+		std::ofstream file(std::filesystem::path(m_checkpointFile), std::ios::binary | std::ios::app);
+		file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+		file.flush();
+		if (!file)
+			throw ExWin32Error(ERROR_WRITE_FAULT, L"Cannot write checkpoint file " + m_checkpointFile);
+	}
+
+	bool CTreeDeleter::LoadCheckpoint(const std::wstring& rootPath)
+	{
+		std::error_code error;
+		if (!std::filesystem::is_regular_file(std::filesystem::path(m_checkpointFile), error))
+			return false;
+
+		CMappedFile file(m_checkpointFile);
+		const BYTE* data = file.Data();
+		const BYTE* end = data + file.Size();
+		if (file.Size() < 8 || memcmp(data, CheckpointMagic, 4) != 0)
+			return false;
+
+		//a damaged checkpoint is treated like a missing one: the tree is enumerated again
+		try {
+			CRecordReader reader(data + 4, end, CheckpointDamaged);
+			if (reader.Number(4) != CheckpointVersion)
+				return false;
+
+			//a checkpoint for a different tree or with different batches is of no use
+			if (CompareNoCase(reader.String().c_str(), rootPath) != 0)
+				return false;
+			if (reader.Number(8) != m_batchSize)
+				return false;
+
+			uint64_t levels = reader.Number(4);
+			//every level takes at least 4 bytes, so a damaged count fails before it allocates
+			if (levels > (uint64_t)(end - reader.Position()) / 4)
+				return false;
+			std::vector<std::vector<std::wstring>> keys((size_t)levels);
+			for (std::vector<std::wstring>& level : keys) {
+				uint64_t count = reader.Number(4);
+				if (count > (uint64_t)(end - reader.Position()) / 4)
+					return false;
+				level.reserve((size_t)count);
+				for (uint64_t i = 0; i < count; i++)
+					level.push_back(reader.String());
+			}
+
+			m_levels.swap(keys);
+			MakeBatches();
+
+			//the batches that were committed. A partly written last record is ignored.
+			while (end - reader.Position() >= 8) {
+				uint64_t batch = reader.Number(8);
+				if (batch < m_batches.size())
+					m_batches[(size_t)batch].done = true;
+			}
+		}
+		catch (AppException&) {
+			m_levels.clear();
+			m_batches.clear();
+			return false;
+		}
+		return true;
+	}
+}
@@ -0,0 +1,104 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <string>
+#include <vector>
+#include "HKey.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Receives progress reports of a CTreeDeleter.
+	/// </summary>
+	class IDeleteProgress
+	{
+	public:
+		virtual ~IDeleteProgress() {}
+
+		//Called on the thread that deletes the tree, every time a batch is committed
+		virtual void OnProgress(size_t deleted, size_t total) = 0;
+	};
+
+	/// <summary>
+	/// Deletes a large registry tree in many small transactions instead of one big one.
+	///
+	/// The tree is enumerated first. Then it is deleted one level at a time, starting with
+	/// the deepest level, so every key that is deleted is a leaf at that point. The keys of
+	/// a level are cut into batches of a bounded size, and each batch is deleted and
+	/// committed in its own transaction. Batches run in parallel on the thread pool. Keys
+	/// with the same parent are kept together on one thread as much as possible, so that
+	/// parallel transactions do not compete for the same parent key. A batch that does
+	/// run into a transactional conflict is retried.
+	///
+	/// Unlike CHKey::DeleteTree this is not atomic: if it fails or is interrupted, part of
+	/// the tree is gone. Running it again finishes the job. With a checkpoint file, a rerun
+	/// does not even have to enumerate the tree again: the list of keys and the batches
+	/// that were committed are recorded in the file, which is removed when the tree is gone.
+	/// When the key itself is kept, its values are deleted in a final transaction, so the
+	/// result is the same as that of CHKey::DeleteTree.
+	/// DeleteTree waits for the pool, so it must not be called from a task on the same pool.
+	/// </summary>
+	class CTreeDeleter
+	{
+		struct CBatch
+		{
+			size_t level;
+			size_t first;               //index of the first key in the level
+			size_t count;
+			bool done = false;
+		};
+
+		IRegBackend* m_backend;
+		CThreadPool& m_pool;
+		size_t m_batchSize = 256;
+		IDeleteProgress* m_progress = NULL;
+		std::wstring m_checkpointFile;
+		size_t m_deleted = 0;
+
+		std::vector<std::vector<std::wstring>> m_levels;    //relative paths, by depth
+		std::vector<CBatch> m_batches;
+
+		void Enumerate(CHKey& root);
+		void MakeBatches();
+		bool LoadCheckpoint(const std::wstring& rootPath);
+		void SaveCheckpoint(const std::wstring& rootPath);
+		void MarkCheckpoint(size_t batch);
+		void DeleteBatch(HKEY root, const CBatch& batch);
+		void ClearValues(HKEY root, const std::wstring& subKey);
+		void DeleteLevel(HKEY root, size_t level, size_t total);
+
+	public:
+		CTreeDeleter(IRegBackend* backend = NULL,      //NULL means the default backend
+			CThreadPool& pool = CThreadPool::Default());
+
+		//Maximum number of keys that are deleted in one transaction
+		void SetBatchSize(size_t keys);
+
+		//Receive progress reports. The caller retains ownership.
+		void SetProgress(IDeleteProgress* progress);
+
+		//Record progress in a file, and pick up from it if it exists
+		void SetCheckpointFile(const std::wstring& path);
+
+		//Delete all values and keys below a key and - optionally - the key itself
+		void DeleteTree(HKEY root, const std::wstring& subKey, bool deleteSubKey);
+
+		//Number of keys deleted by the last DeleteTree
+		size_t DeletedCount();
+	};
+}
@@ -0,0 +1,224 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TreeWalker.h"
+#include <algorithm>
+#include <exception>
+
+namespace w32
+{
+	//A key in the walk. It is filled in by a pool task, and becomes ready when
+	//the key has been opened, its values read and its subkeys listed.
+	struct CTreeWalker::CNode
+	{
+		CNode* parent = NULL;
+		std::wstring name;      //of the key relative to the parent
+		size_t depth = 0;
+		CHKey* key = NULL;
+		std::unique_ptr<CHKey> ownedKey;
+		CKeySnapshot values;
+		std::vector<std::unique_ptr<CNode>> children;
+		std::exception_ptr error;
+		std::list<CNode*>::iterator pendingPosition;    //protected by m_lock
+		bool pending = false;                           //protected by m_lock
+		bool scheduled = false;                         //protected by m_lock
+		bool ready = false;                             //protected by m_lock
+	};
+
+	CTreeWalker::CTreeWalker(CThreadPool& pool, bool readValues, bool readInfo) :
+		m_pool(pool),
+		m_readValues(readValues),
+		m_readInfo(readInfo),
+		m_window(DefaultWindow),
+		m_maxDepth(Unlimited)
+	{
+	}
+
+	void CTreeWalker::SetWindow(size_t keys)
+	{
+		m_window = keys > 0 ? keys : 1;
+	}
+
+	void CTreeWalker::SetMaxDepth(size_t maxDepth)
+	{
+		m_maxDepth = maxDepth;
+	}
+
+	void CTreeWalker::SetOrder(int (*compare)(std::wstring_view left, std::wstring_view right))
+	{
+		m_order = compare;
+	}
+
+	void CTreeWalker::Walk(CHKey& root, IKeyVisitor& visitor)
+	{
+		CNode rootNode;
+		rootNode.key = &root;
+		m_cancelled = false;
+		m_inWindow = 0;
+		m_pending.clear();
+
+		try {
+			Visit(&rootNode, visitor);
+		}
+		catch (...) {
+			//the tasks that are still running refer to the tree
+			m_cancelled = true;
+			Drain();
+			m_pending.clear();
+			throw;
+		}
+		Drain();
+	}
+
+	//Queue a task for a key. The caller holds m_lock.
+	void CTreeWalker::Schedule(CNode* node)
+	{
+		if (node->pending) {
+			m_pending.erase(node->pendingPosition);
+			node->pending = false;
+		}
+		node->scheduled = true;
+		m_outstanding++;
+		m_inWindow++;
+	}
+
+	//Take the pending keys that fit in the window. The caller holds m_lock,
+	//and submits the keys after releasing it.
+	std::vector<CTreeWalker::CNode*> CTreeWalker::TakeRunnable()
+	{
+		std::vector<CNode*> runnable;
+		while (!m_cancelled && m_inWindow < m_window && !m_pending.empty()) {
+			CNode* node = m_pending.front();
+			Schedule(node);
+			runnable.push_back(node);
+		}
+		return runnable;
+	}
+
+	void CTreeWalker::Submit(const std::vector<CNode*>& nodes)
+	{
+		for (CNode* node : nodes)
+			m_pool.Submit([this, node]() { Expand(node); });
+	}
+
+	//Pool task: open a key, read its values and list its subkeys
+	void CTreeWalker::Expand(CNode* node)
+	{
+		if (!m_cancelled) {
+			try {
+				if (node->parent) {
+					node->ownedKey = std::make_unique<CHKey>(node->parent->key->OpenSubKey(node->name));
+					node->key = node->ownedKey.get();
+				}
+				if (m_readValues)
+					node->values = node->key->Snapshot();
+				else if (m_readInfo)
+					node->values = CKeySnapshot::CaptureInfo(node->key->Backend(), *node->key);
+				if (node->depth < m_maxDepth) {
+					for (std::wstring_view name : node->key->SubKeys()) {
+						std::unique_ptr<CNode> child = std::make_unique<CNode>();
+						child->parent = node;
+						child->name = name;
+						child->depth = node->depth + 1;
+						node->children.push_back(std::move(child));
+					}
+					if (m_order) {
+						std::sort(node->children.begin(), node->children.end(),
+							[this](const std::unique_ptr<CNode>& l, const std::unique_ptr<CNode>& r) {
+								return m_order(l->name, r->name) < 0;
+							});
+					}
+				}
+			}
+			catch (...) {
+				node->error = std::current_exception();
+			}
+		}
+
+		std::vector<CNode*> runnable;
+		{
+			//Notify while holding the lock: once the last task lets go of it, the walker
+			//may return from Walk and be destroyed.
+			//Most of the time the walk is behind the pool and nobody is waiting.
+			std::lock_guard<std::mutex> guard(m_lock);
+			node->ready = true;
+
+			//The children go before the keys that were already pending, which comes
+			//closest to the order in which they are visited
+			if (!node->error && !m_cancelled) {
+				auto position = m_pending.begin();
+				for (std::unique_ptr<CNode>& child : node->children) {
+					child->pendingPosition = m_pending.insert(position, child.get());
+					child->pending = true;
+				}
+			}
+			runnable = TakeRunnable();
+			m_outstanding--;
+			if (m_waiters > 0)
+				m_ready.notify_all();
+		}
+		//the tasks in runnable are outstanding, so the walker is still there
+		Submit(runnable);
+	}
+
+	void CTreeWalker::Visit(CNode* node, IKeyVisitor& visitor)
+	{
+		WaitReady(node);
+		if (node->error)
+			std::rethrow_exception(node->error);
+
+		visitor.Visit(*node->key, node->values, node->depth);
+		node->values = CKeySnapshot();
+
+		std::vector<CNode*> runnable;
+		{
+			std::lock_guard<std::mutex> guard(m_lock);
+			m_inWindow--;
+			runnable = TakeRunnable();
+		}
+		Submit(runnable);
+
+		for (std::unique_ptr<CNode>& child : node->children) {
+			Visit(child.get(), visitor);
+			//the whole subtree has been visited and no task refers to it anymore
+			child.reset();
+		}
+	}
+
+	//Wait for a key. If it is not queued yet, because the window is full,
+	//it is queued now: the walk cannot go on without it.
+	void CTreeWalker::WaitReady(CNode* node)
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		if (!node->scheduled) {
+			Schedule(node);
+			m_pool.Submit([this, node]() { Expand(node); });
+		}
+		m_waiters++;
+		m_ready.wait(lock, [node]() { return node->ready; });
+		m_waiters--;
+	}
+
+	//Wait until no task refers to the tree anymore
+	void CTreeWalker::Drain()
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_waiters++;
+		m_ready.wait(lock, [this]() { return m_outstanding == 0; });
+		m_waiters--;
+	}
+}
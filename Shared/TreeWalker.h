@@ -0,0 +1,120 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "HKey.h"
+#include "ThreadPool.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Receives the keys of a tree walk.
+	/// </summary>
+	class IKeyVisitor
+	{
+	public:
+		virtual ~IKeyVisitor() {}
+
+		//Called once for every key, parents before children and siblings in enumeration
+		//order, or in the order set with CTreeWalker::SetOrder. depth is 0 for the key
+		//where the walk started.
+		virtual void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) = 0;
+	};
+
+	/// <summary>
+	/// Walks a registry tree in parallel, and hands the keys to a visitor in the same
+	/// order as a recursive walk on a single thread would.
+	///
+	/// Opening keys, enumerating subkeys and reading values is done on a thread pool:
+	/// every key is a task that opens the key relative to its parent, reads its values and
+	/// lists the names of its subkeys. The thread that calls Walk follows behind in
+	/// pre-order, waiting for a key only if the pool has not got to it yet, and calls the
+	/// visitor.
+	///
+	/// The pool runs at most a window of keys ahead of the visitor. A key counts against
+	/// the window from the moment its task is queued until it has been visited, and no new
+	/// tasks are queued while the window is full, except for the key that the visitor
+	/// waits for. At any time the walk holds at most window + depth open keys: those in the
+	/// window and those on the path from the root to the key being visited. Values are
+	/// only held for keys in the window, and subkeys that have not been queued yet are
+	/// held as names only.
+	///
+	/// If a key cannot be read, the error is thrown from Walk at the point where a
+	/// recursive walk would have thrown it, after the keys before it were visited.
+	/// The visitor is only ever called from the thread that calls Walk.
+	/// Walk waits for the pool, so it must not be called from a task on the same pool.
+	/// </summary>
+	class CTreeWalker
+	{
+		struct CNode;
+
+		CThreadPool& m_pool;
+		bool m_readValues;
+		bool m_readInfo;
+		size_t m_window;
+		size_t m_maxDepth;
+		int (*m_order)(std::wstring_view, std::wstring_view) = NULL;
+		std::mutex m_lock;
+		std::condition_variable m_ready;
+		size_t m_outstanding = 0;           //tasks that have not finished
+		size_t m_inWindow = 0;              //keys that were queued and not visited yet
+		size_t m_waiters = 0;               //threads waiting for m_ready
+		std::list<CNode*> m_pending;        //keys waiting for room in the window, next first
+		std::atomic<bool> m_cancelled = false;
+
+		void Expand(CNode* node);
+		void Visit(CNode* node, IKeyVisitor& visitor);
+		void WaitReady(CNode* node);
+		void Drain();
+		std::vector<CNode*> TakeRunnable();
+		void Schedule(CNode* node);
+		void Submit(const std::vector<CNode*>& nodes);
+
+	public:
+		static constexpr size_t DefaultWindow = 1024;
+		static constexpr size_t Unlimited = SIZE_MAX;
+
+		//If readValues is false, the visitor gets an empty snapshot for every key.
+		//That saves reading the values when only the structure of the tree matters.
+		//With readInfo, such a snapshot still has the subkey count and last write time.
+		CTreeWalker(CThreadPool& pool = CThreadPool::Default(), bool readValues = true,
+			bool readInfo = false);
+
+		CTreeWalker(const CTreeWalker&) = delete;
+		CTreeWalker& operator = (const CTreeWalker&) = delete;
+
+		//Number of keys the pool may run ahead of the visitor. At least 1.
+		void SetWindow(size_t keys);
+
+		//Do not go below this depth; the keys at maxDepth are visited without their
+		//subkeys. 0 visits only the root.
+		void SetMaxDepth(size_t maxDepth);
+
+		//Visit the subkeys of a key sorted with this comparison instead of in
+		//enumeration order. NULL restores the enumeration order.
+		void SetOrder(int (*compare)(std::wstring_view left, std::wstring_view right));
+
+		//Visit the root and everything below it
+		void Walk(CHKey& root, IKeyVisitor& visitor);
+	};
+}
@@ -19,6 +19,8 @@
 #include "TypeLibrary.h"
 #include "Transaction.h"
 #include "HKey.h"
+#include "MsftTypeLib.h"
+#include "Stats.h"
 #include <iostream>
 #include <filesystem>
 
@@ -39,14 +41,38 @@ namespace w32
         //absolute paths.
         m_path = filesystem::absolute(path).wstring();
 
-        HRESULT hRes = LoadTypeLibEx(path.c_str(), REGKIND_NONE, &m_typeLib);
-        if (FAILED(hRes)) {
-            throw ExHResult(hRes, L"Cannot open library ");
+        //the native reader only needs the file
+        m_msft = CMsftTypeLib::TryOpen(m_path);
+        if (m_msft) {
+            m_msft->Fill(*this);
+        }
+        else {
+            ReadTypeLib();
+        }
+    }
+
+    //The ITypeLib, loaded on first use
+    ITypeLib* CTypeLibrary::TypeLib()
+    {
+        if (!m_typeLib) {
+            CStatScope scope(EStatOp::LoadTypeLib);
+            HRESULT hRes = LoadTypeLibEx(m_path.c_str(), REGKIND_NONE, &m_typeLib);
+            if (FAILED(hRes)) {
+                scope.Fail();
+                throw ExHResult(hRes, L"Cannot open library ");
+            }
         }
+        return m_typeLib;
+    }
+
+    //Get the library attributes and type GUIDs through ITypeLib
+    void CTypeLibrary::ReadTypeLib()
+    {
+        ITypeLib* typeLib = TypeLib();
 
         //Get TLB guid and version.
         TLIBATTR* tlbAttr = NULL;
-        hRes = m_typeLib->GetLibAttr(&tlbAttr);
+        HRESULT hRes = typeLib->GetLibAttr(&tlbAttr);
         if (FAILED(hRes)) {
             throw ExHResult(hRes, L"Cannot get typelib attributes ");
         }
@@ -54,22 +80,23 @@ namespace w32
         Guid = tlbAttr->guid;
         MajorVersion = tlbAttr->wMajorVerNum;
         MinorVersion = tlbAttr->wMinorVerNum;
+        Flags = tlbAttr->wLibFlags;
         LocaleID = tlbAttr->lcid;
         SysKind = tlbAttr->syskind;
-        m_typeLib->ReleaseTLibAttr(tlbAttr);
+        typeLib->ReleaseTLibAttr(tlbAttr);
 
         //load the type definitions from the tlb file.
-        UINT numTypeInfos = m_typeLib->GetTypeInfoCount();
+        UINT numTypeInfos = typeLib->GetTypeInfoCount();
 
         for (UINT i = 0; i < numTypeInfos; ++i) {
             CComPtr<ITypeInfo> itypeInfo;
-            hRes = m_typeLib->GetTypeInfo(i, &itypeInfo);
+            hRes = typeLib->GetTypeInfo(i, &itypeInfo);
             if (FAILED(hRes)) {
                 throw ExHResult(hRes, L"Cannot get GetTypeInfo");
             }
 
             TYPEATTR* typeAttr = NULL;
-            HRESULT hr = itypeInfo->GetTypeAttr(&typeAttr);
+            hRes = itypeInfo->GetTypeAttr(&typeAttr);
             if (FAILED(hRes)) {
                 throw ExHResult(hRes, L"Cannot get GetTypeInfo Attributes");
             }
@@ -91,32 +118,150 @@ namespace w32
         }
     }
 
+    const std::wstring& CTypeLibrary::Path() const
+    {
+        return m_path;
+    }
+
+    std::wstring CTypeLibrary::Name()
+    {
+        if (m_msft)
+            return m_msft->Name();
+
+        CComBSTR name;
+        HRESULT hRes = TypeLib()->GetDocumentation(-1, &name, NULL, NULL, NULL);
+        if (FAILED(hRes)) {
+            throw ExHResult(hRes, L"Cannot get the name of the type library");
+        }
+        return name.m_str ? std::wstring(name.m_str) : std::wstring();
+    }
+
+    std::wstring CTypeLibrary::DocString()
+    {
+        if (m_msft)
+            return m_msft->DocString();
+
+        CComBSTR doc;
+        HRESULT hRes = TypeLib()->GetDocumentation(-1, NULL, &doc, NULL, NULL);
+        if (FAILED(hRes)) {
+            throw ExHResult(hRes, L"Cannot get the description of the type library");
+        }
+        return doc.m_str ? std::wstring(doc.m_str) : std::wstring();
+    }
+
+    size_t CTypeLibrary::TypeCount()
+    {
+        if (m_msft)
+            return m_msft->TypeCount();
+        return TypeLib()->GetTypeInfoCount();
+    }
+
+    CTlbTypeEntry CTypeLibrary::Type(size_t index)
+    {
+        if (m_msft)
+            return m_msft->Type(index);
+
+        CComPtr<ITypeInfo> typeInfo;
+        HRESULT hRes = TypeLib()->GetTypeInfo((UINT)index, &typeInfo);
+        if (FAILED(hRes)) {
+            throw ExHResult(hRes, L"Cannot get GetTypeInfo");
+        }
+
+        TYPEATTR* typeAttr = NULL;
+        hRes = typeInfo->GetTypeAttr(&typeAttr);
+        if (FAILED(hRes)) {
+            throw ExHResult(hRes, L"Cannot get GetTypeInfo Attributes");
+        }
+
+        CTlbTypeEntry entry;
+        entry.Kind = typeAttr->typekind;
+        entry.Guid = typeAttr->guid;
+        entry.Flags = typeAttr->wTypeFlags;
+        entry.MajorVersion = typeAttr->wMajorVerNum;
+        entry.MinorVersion = typeAttr->wMinorVerNum;
+        typeInfo->ReleaseTypeAttr(typeAttr);
+
+        CComBSTR name;
+        hRes = typeInfo->GetDocumentation(MEMBERID_NIL, &name, NULL, NULL, NULL);
+        if (FAILED(hRes)) {
+            throw ExHResult(hRes, L"Cannot get the name of a type");
+        }
+        entry.Name = name.m_str ? std::wstring(name.m_str) : std::wstring();
+        return entry;
+    }
+
+    CTlbMetadata CTypeLibrary::Metadata()
+    {
+        CTlbMetadata metadata;
+        static_cast<CTlbInfo&>(metadata) = *this;
+        metadata.Path = m_path;
+        metadata.Name = Name();
+        metadata.DocString = DocString();
+        size_t count = TypeCount();
+        metadata.Types.reserve(count);
+        for (size_t i = 0; i < count; i++)
+            metadata.Types.push_back(Type(i));
+        return metadata;
+    }
+
+    //Load a type library on a thread of the pool
+    CTask<CTypeLibrary> CTypeLibrary::LoadTypeLibAsync(std::wstring path, CThreadPool* pool)
+    {
+        co_await ResumeOn(pool);
+        co_return CTypeLibrary(path);
+    }
+
     //Register the current type library in the registry
     void CTypeLibrary::Register(bool perUser)
     {
+        SyncWait(RegisterAsync(perUser, NULL));
+    }
+
+    CTask<void> CTypeLibrary::RegisterAsync(bool perUser, CThreadPool* pool)
+    {
+        co_await ResumeOn(pool);
+
+        ITypeLib* typeLib = TypeLib();
+
+        CStatScope scope(EStatOp::RegisterTypeLib);
         HRESULT hRes = S_OK;
         if (perUser) {
-            hRes = RegisterTypeLibForUser(m_typeLib, const_cast<OLECHAR*>(m_path.c_str()), NULL);
+            hRes = RegisterTypeLibForUser(typeLib, const_cast<OLECHAR*>(m_path.c_str()), NULL);
         }
         else {
-            hRes = RegisterTypeLib(m_typeLib, const_cast<OLECHAR*>(m_path.c_str()), NULL);
+            hRes = RegisterTypeLib(typeLib, const_cast<OLECHAR*>(m_path.c_str()), NULL);
         }
         if (FAILED(hRes)) {
+            scope.Fail();
             throw ExHResult(hRes, L"Cannot register type library");
         }
-
     }
 
     //unregister the type library from the registry, based on the identifying information
     //inside the loaded tlb
     void CTypeLibrary::UnRegister(bool perUser)
     {
-        UnRegister(perUser, Guid, MajorVersion, MinorVersion, LocaleID, SysKind);
+        SyncWait(UnRegisterAsync(perUser, NULL));
+    }
+
+    CTask<void> CTypeLibrary::UnRegisterAsync(bool perUser, CThreadPool* pool)
+    {
+        return UnRegisterAsync(perUser, Guid, MajorVersion, MinorVersion, LocaleID, SysKind, pool);
     }
 
     //unregister the type library from the registry
     void CTypeLibrary::UnRegister(bool perUser, const GUID& guid, WORD major, WORD minor, LCID locale, SYSKIND syskind)
     {
+        SyncWait(UnRegisterAsync(perUser, guid, major, minor, locale, syskind, NULL));
+    }
+
+    //the identification is taken by value, it has to live in the coroutine frame
+    CTask<void> CTypeLibrary::UnRegisterAsync(bool perUser, GUID guid, WORD major, WORD minor,
+        LCID locale, SYSKIND syskind, CThreadPool* pool)
+    {
+        co_await ResumeOn(pool);
+
+        CStatScope scope(EStatOp::UnRegisterTypeLib);
         HRESULT hRes = S_OK;
         if (perUser) {
             hRes = UnRegisterTypeLibForUser(guid, major, minor, locale, syskind);
@@ -125,6 +270,7 @@ namespace w32
             hRes = UnRegisterTypeLib(guid, major, minor, locale, syskind);
         }
         if (FAILED(hRes)) {
+            scope.Fail();
             throw ExHResult(hRes, L"Cannot unregister type library");
         }
     }
@@ -138,4 +284,13 @@ namespace w32
 
         return CHKey::Exists(hive, regPath);
     }
+
+    bool CTypeLibrary::Exists(const GUID& guid, bool perUser, CKeyCache& cache)
+    {
+        HKEY hive = perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
+        std::wstring regPath = L"Software\\Classes\\TypeLib\\";
+        regPath += WStringFromGUID(guid);
+
+        return cache.Exists(hive, regPath);
+    }
 }
\ No newline at end of file
@@ -18,6 +18,9 @@
 #pragma once
 
 #include "TlbInfo.h"
+#include "KeyCache.h"
+#include "MsftTypeLib.h"
+#include "Task.h"
 
 namespace w32
 {
@@ -28,12 +31,29 @@ namespace w32
 	/// Unregistration can be done either via the tlb file itself (using that file
 	/// as a source for the necessary information), or by specifying everything that
 	/// is needed to identify the registration in the registry.
+	///
+	/// Libraries in the MSFT format are read with CMsftTypeLib, which does not need
+	/// OLE. Other files (SLTG libraries, libraries embedded in a DLL) are read through
+	/// LoadTypeLibEx. The ITypeLib is only loaded when the library is registered.
+	///
+	/// Construction only reads what registration needs: the library attributes and the
+	/// kind and GUID of every type. Names, descriptions and the other attributes of the
+	/// types are read from the file when they are requested.
+	///
+	/// The Async methods do the work on a thread of a pool, so that several libraries
+	/// can be loaded and registered at the same time, e.g. with WhenAll. The synchronous
+	/// methods run the same coroutines inline on the calling thread.
+	/// The pool threads do not initialize COM; the oleaut32 functions that are used here
+	/// do not require it.
 	/// </summary>
 	class CTypeLibrary : public CTlbInfo
 	{
-		CComPtr<ITypeLib> m_typeLib;
+		CComPtr<ITypeLib> m_typeLib;       //only loaded when it is needed
+		std::unique_ptr<CMsftTypeLib> m_msft;  //NULL if the file is in another format
 		std::wstring m_path;
 		std::wstring GetVersionString();
+		ITypeLib* TypeLib();
+		void ReadTypeLib();
 	public:
 		CTypeLibrary(std::wstring path);
 
@@ -47,7 +67,40 @@ namespace w32
 			LCID locale,
 			SYSKIND syskind);
 
+		//Load a library on a thread of the pool
+		static CTask<CTypeLibrary> LoadTypeLibAsync(std::wstring path,
+			CThreadPool* pool = &CThreadPool::Default());
+
+		//The library must stay alive until these tasks are done
+		CTask<void> RegisterAsync(bool perUser, CThreadPool* pool = &CThreadPool::Default());
+		CTask<void> UnRegisterAsync(bool perUser, CThreadPool* pool = &CThreadPool::Default());
+
+		static CTask<void> UnRegisterAsync(bool perUser,
+			GUID guid,
+			WORD major,
+			WORD minor,
+			LCID locale,
+			SYSKIND syskind,
+			CThreadPool* pool = &CThreadPool::Default());
+
+		//Absolute path of the file
+		const std::wstring& Path() const;
+
+		//Name and description of the library
+		std::wstring Name();
+		std::wstring DocString();
+
+		//All types in the library, including those that are not registered
+		size_t TypeCount();
+		CTlbTypeEntry Type(size_t index);
+
+		//Everything the library has to say about registration, read at once
+		CTlbMetadata Metadata();
+
 		static bool Exists(const GUID& guid, bool perUser);
 
+		//Same as above, but the key stays open in the cache for a subsequent query
+		static bool Exists(const GUID& guid, bool perUser, CKeyCache& cache);
+
 	};
 }
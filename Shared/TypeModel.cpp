@@ -0,0 +1,504 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "TypeModel.h"
+#include "Exception.h"
+#include <algorithm>
+#include <cstring>
+
+namespace w32
+{
+    //Layout of the parts of an MSFT file that only the model reads. See CMsftTypeLib
+    //for the rest.
+    //Type info record:
+    static const size_t RecordKind = 0x00;
+    static const size_t RecordMembers = 0x04;       //offset of the member block in the file
+    static const size_t RecordElements = 0x18;      //functions in the low word, variables in the high word
+    static const size_t RecordGuid = 0x2C;
+    static const size_t RecordFlags = 0x30;
+    static const size_t RecordName = 0x34;
+    static const size_t RecordVersion = 0x38;
+    static const size_t RecordDocString = 0x3C;
+    static const size_t RecordImplTypes = 0x4C;     //WORD
+    static const size_t RecordDataType1 = 0x54;     //base interface, or the aliased type
+    static const DWORD TypeRecordSize = 0x64;
+
+    //The member block starts with the length of the records that follow it: first those
+    //of the functions, then those of the variables. After the records come an array with
+    //the member ID of every member, one with the offset of its name, and one with the
+    //offset of its record.
+    //Function record. The low word of the first DWORD is its length, which includes the
+    //parameters at the end of the record.
+    static const size_t FuncDataType = 0x04;
+    static const size_t FuncFlags = 0x08;
+    static const size_t FuncVtableOffset = 0x0C;    //short; the low bit is not part of it
+    static const size_t FuncKinds = 0x10;           //FUNCKIND, INVOKEKIND << 3, CALLCONV << 8
+    static const size_t FuncParamCount = 0x14;      //short
+    static const size_t FuncOptionalCount = 0x16;   //short
+    static const size_t FuncFixedSize = 0x18;
+    static const size_t FuncDocString = 0x1C;       //optional, present if the record is long enough
+    static const DWORD FuncHasDefaults = 0x1000;    //in FuncKinds: a default value offset per parameter
+    static const size_t ParamSize = 12;             //data type, name offset, PARAMFLAGS
+
+    //Variable record. The low byte of the first DWORD is its length.
+    static const size_t VarDataType = 0x04;
+    static const size_t VarFlags = 0x08;
+    static const size_t VarKind = 0x0C;             //short
+    static const size_t VarOffset = 0x10;           //oInst, or where to find the value of a constant
+    static const size_t VarFixedSize = 0x14;
+    static const size_t VarDocString = 0x18;
+
+    //Type descriptions are a VARTYPE, a reserved WORD and a DWORD that depends on the type.
+    //Array descriptions are the element type, the number of dimensions and a reserved
+    //WORD, followed by the bounds.
+    static const size_t TypeDescSize = 8;
+    static const size_t ArrayDescSize = 8;
+    static const size_t BoundSize = 8;
+
+    static DWORD DWordAt(const BYTE* data)
+    {
+        DWORD value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static WORD WordAt(const BYTE* data)
+    {
+        WORD value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static void ThrowBadFormat(const wchar_t* message)
+    {
+        throw ExWin32Error(ERROR_BAD_FORMAT, message);
+    }
+
+    /// <summary>
+    /// Decodes the library twice: the first pass counts the rows of every table and the
+    /// characters of every string, the second one writes them into the arena that is
+    /// allocated in between. Both passes run the same code, so they cannot disagree.
+    /// </summary>
+    class CTypeModel::CBuilder
+    {
+        const CMsftTypeLib& m_lib;
+        CTypeModel& m_model;
+        bool m_fill = false;
+        size_t m_typeDescCount;
+
+        //rows and characters used so far. After the first pass, the size of each table.
+        size_t m_types = 0;
+        size_t m_funcs = 0;
+        size_t m_params = 0;
+        size_t m_vars = 0;
+        size_t m_typeDescs = 0;
+        size_t m_bounds = 0;
+        size_t m_chars = 0;
+
+        //The tables are read only to the users of the model
+        template<class T, class V>
+        void Set(const T* column, size_t row, V value)
+        {
+            if (m_fill)
+                const_cast<T*>(column)[row] = (T)value;
+        }
+
+        CStringRef AddString(std::string_view chars)
+        {
+            CStringRef ref = { (DWORD)m_chars, (DWORD)chars.size() };
+            if (m_fill) {
+                wchar_t* pool = const_cast<wchar_t*>(m_model.m_chars) + m_chars;
+                for (char c : chars)
+                    *pool++ = (BYTE)c;
+            }
+            m_chars += chars.size();
+            return ref;
+        }
+
+        //Data types in the file are a VARTYPE if negative, else the offset of a type description
+        TypeRef Ref(int dataType) const
+        {
+            if (dataType < 0)
+                return SimpleType | (dataType & VT_TYPEMASK);
+            if (dataType % TypeDescSize != 0 || (size_t)dataType / TypeDescSize >= m_typeDescCount)
+                ThrowBadFormat(L"The type library refers to a type description that does not exist");
+            return (TypeRef)(dataType / TypeDescSize);
+        }
+
+        template<class T>
+        static void Carve(const T*& column, size_t count, BYTE* arena, size_t& offset)
+        {
+            offset = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+            if (arena != NULL)
+                column = reinterpret_cast<const T*>(arena + offset);
+            offset += count * sizeof(T);
+        }
+
+        //Place every column in the arena and return its size. With a NULL arena it only
+        //computes the size.
+        size_t Layout(BYTE* arena)
+        {
+            size_t offset = 0;
+            CTypeTable& types = m_model.m_types;
+            Carve(types.Guid, m_types, arena, offset);
+            Carve(types.Kind, m_types, arena, offset);
+            Carve(types.Name, m_types, arena, offset);
+            Carve(types.DocString, m_types, arena, offset);
+            Carve(types.FirstFunc, m_types, arena, offset);
+            Carve(types.FirstVar, m_types, arena, offset);
+            Carve(types.BaseType, m_types, arena, offset);
+            Carve(types.AliasType, m_types, arena, offset);
+            Carve(types.Flags, m_types, arena, offset);
+            Carve(types.MajorVersion, m_types, arena, offset);
+            Carve(types.MinorVersion, m_types, arena, offset);
+            Carve(types.FuncCount, m_types, arena, offset);
+            Carve(types.VarCount, m_types, arena, offset);
+            Carve(types.ImplTypeCount, m_types, arena, offset);
+
+            CFuncTable& funcs = m_model.m_funcs;
+            Carve(funcs.MemberId, m_funcs, arena, offset);
+            Carve(funcs.Name, m_funcs, arena, offset);
+            Carve(funcs.DocString, m_funcs, arena, offset);
+            Carve(funcs.ReturnType, m_funcs, arena, offset);
+            Carve(funcs.FirstParam, m_funcs, arena, offset);
+            Carve(funcs.Flags, m_funcs, arena, offset);
+            Carve(funcs.VtableOffset, m_funcs, arena, offset);
+            Carve(funcs.ParamCount, m_funcs, arena, offset);
+            Carve(funcs.OptionalParamCount, m_funcs, arena, offset);
+            Carve(funcs.FuncKind, m_funcs, arena, offset);
+            Carve(funcs.InvokeKind, m_funcs, arena, offset);
+            Carve(funcs.CallConv, m_funcs, arena, offset);
+
+            CParamTable& params = m_model.m_params;
+            Carve(params.Name, m_params, arena, offset);
+            Carve(params.Type, m_params, arena, offset);
+            Carve(params.Flags, m_params, arena, offset);
+
+            CVarTable& vars = m_model.m_vars;
+            Carve(vars.Value, m_vars, arena, offset);
+            Carve(vars.MemberId, m_vars, arena, offset);
+            Carve(vars.Name, m_vars, arena, offset);
+            Carve(vars.DocString, m_vars, arena, offset);
+            Carve(vars.Type, m_vars, arena, offset);
+            Carve(vars.Offset, m_vars, arena, offset);
+            Carve(vars.Flags, m_vars, arena, offset);
+            Carve(vars.ValueType, m_vars, arena, offset);
+            Carve(vars.VarKind, m_vars, arena, offset);
+
+            CTypeDescTable& typeDescs = m_model.m_typeDescs;
+            Carve(typeDescs.Inner, m_typeDescs, arena, offset);
+            Carve(typeDescs.RefType, m_typeDescs, arena, offset);
+            Carve(typeDescs.FirstBound, m_typeDescs, arena, offset);
+            Carve(typeDescs.VarType, m_typeDescs, arena, offset);
+            Carve(typeDescs.DimCount, m_typeDescs, arena, offset);
+
+            CBoundTable& bounds = m_model.m_bounds;
+            Carve(bounds.Elements, m_bounds, arena, offset);
+            Carve(bounds.LowerBound, m_bounds, arena, offset);
+
+            Carve(m_model.m_chars, m_chars, arena, offset);
+            return offset;
+        }
+
+        void DecodeTypeDescs()
+        {
+            const CMsftTypeLib::CSegment& segment = m_lib.m_typeDescs;
+            const BYTE* desc = m_lib.At(segment.offset, m_typeDescCount * TypeDescSize);
+            for (size_t i = 0; i < m_typeDescCount; i++, desc += TypeDescSize) {
+                VARTYPE vt = WordAt(desc) & VT_TYPEMASK;
+                int value = (int)DWordAt(desc + sizeof(DWORD));
+
+                size_t row = m_typeDescs++;
+                Set(m_model.m_typeDescs.VarType, row, vt);
+                Set(m_model.m_typeDescs.Inner, row, NoIndex);
+                Set(m_model.m_typeDescs.RefType, row, NoIndex);
+                Set(m_model.m_typeDescs.DimCount, row, 0);
+                Set(m_model.m_typeDescs.FirstBound, row, NoIndex);
+
+                switch (vt)
+                {
+                case VT_PTR:
+                case VT_SAFEARRAY:
+                    Set(m_model.m_typeDescs.Inner, row, Ref(value));
+                    break;
+                case VT_USERDEFINED:
+                    Set(m_model.m_typeDescs.RefType, row, value);
+                    break;
+                case VT_CARRAY:
+                    DecodeArray(row, value);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        void DecodeArray(size_t row, int offset)
+        {
+            const CMsftTypeLib::CSegment& segment = m_lib.m_arrayDescs;
+            if (offset < 0 || (size_t)offset + ArrayDescSize > segment.length)
+                ThrowBadFormat(L"The type library refers to an array description that does not exist");
+
+            const BYTE* desc = m_lib.At(segment.offset + offset, ArrayDescSize);
+            WORD dims = WordAt(desc + sizeof(DWORD));
+            if ((size_t)offset + ArrayDescSize + dims * BoundSize > segment.length)
+                ThrowBadFormat(L"An array description in the type library is truncated");
+
+            Set(m_model.m_typeDescs.Inner, row, Ref((int)DWordAt(desc)));
+            Set(m_model.m_typeDescs.DimCount, row, dims);
+            Set(m_model.m_typeDescs.FirstBound, row, m_bounds);
+            const BYTE* bound = m_lib.At(segment.offset + offset + ArrayDescSize, dims * BoundSize);
+            for (WORD i = 0; i < dims; i++, bound += BoundSize) {
+                size_t b = m_bounds++;
+                Set(m_model.m_bounds.Elements, b, DWordAt(bound));
+                Set(m_model.m_bounds.LowerBound, b, (LONG)DWordAt(bound + sizeof(DWORD)));
+            }
+        }
+
+        void DecodeType(size_t index)
+        {
+            const BYTE* record = m_lib.TypeRecord(index);
+            TYPEKIND kind = (TYPEKIND)(DWordAt(record + RecordKind) & 0x0F);
+            DWORD elements = DWordAt(record + RecordElements);
+            DWORD version = DWordAt(record + RecordVersion);
+            int dataType1 = (int)DWordAt(record + RecordDataType1);
+
+            size_t row = m_types++;
+            CTypeTable& types = m_model.m_types;
+            Set(types.Kind, row, kind);
+            if (m_fill)
+                Set(types.Guid, row, m_lib.ReadGuid((int)DWordAt(record + RecordGuid)));
+            Set(types.Flags, row, LOWORD(DWordAt(record + RecordFlags)));
+            Set(types.MajorVersion, row, LOWORD(version));
+            Set(types.MinorVersion, row, HIWORD(version));
+            Set(types.Name, row, AddString(m_lib.NameBytes((int)DWordAt(record + RecordName))));
+            Set(types.DocString, row, AddString(m_lib.StringBytes((int)DWordAt(record + RecordDocString))));
+            Set(types.ImplTypeCount, row, WordAt(record + RecordImplTypes));
+            Set(types.BaseType, row, kind == TKIND_INTERFACE || kind == TKIND_DISPATCH ? (DWORD)dataType1 : NoIndex);
+            Set(types.AliasType, row, kind == TKIND_ALIAS ? Ref(dataType1) : NoIndex);
+
+            WORD funcCount = LOWORD(elements);
+            WORD varCount = HIWORD(elements);
+            Set(types.FirstFunc, row, m_funcs);
+            Set(types.FuncCount, row, funcCount);
+            Set(types.FirstVar, row, m_vars);
+            Set(types.VarCount, row, varCount);
+            if (funcCount + varCount > 0)
+                DecodeMembers(DWordAt(record + RecordMembers), funcCount, varCount);
+        }
+
+        void DecodeMembers(size_t block, size_t funcCount, size_t varCount)
+        {
+            size_t memberCount = funcCount + varCount;
+            size_t recordsLength = m_lib.ReadDWord(block);
+            size_t records = block + sizeof(DWORD);
+            size_t recordsEnd = records + recordsLength;
+            size_t ids = recordsEnd;
+            size_t names = ids + memberCount * sizeof(DWORD);
+            size_t offsets = names + memberCount * sizeof(DWORD);
+            m_lib.At(records, recordsLength);
+            m_lib.At(ids, 3 * memberCount * sizeof(DWORD));
+
+            //Both accessors of a property have the same name, which is often only stored
+            //with the first one
+            CStringRef previousName = {};
+            size_t pos = records;
+            for (size_t i = 0; i < funcCount; i++) {
+                size_t length = m_lib.ReadDWord(pos) & 0xFFFF;
+                if (length < FuncFixedSize || length > recordsEnd - pos)
+                    ThrowBadFormat(L"A function record in the type library is damaged");
+                const BYTE* record = m_lib.m_data + pos;
+
+                DWORD kinds = DWordAt(record + FuncKinds);
+                WORD paramCount = WordAt(record + FuncParamCount);
+                size_t paramsLength = paramCount * ParamSize;
+                size_t optional = length - FuncFixedSize;
+                if (paramsLength > optional)
+                    ThrowBadFormat(L"A function record in the type library is damaged");
+                optional -= paramsLength;
+                if (kinds & FuncHasDefaults)
+                    optional -= std::min(optional, paramCount * sizeof(DWORD));
+
+                size_t row = m_funcs++;
+                CFuncTable& funcs = m_model.m_funcs;
+                int name = (int)m_lib.ReadDWord(names + i * sizeof(DWORD));
+                if (name >= 0 || i == 0)
+                    previousName = AddString(m_lib.NameBytes(name));
+                Set(funcs.Name, row, previousName);
+                Set(funcs.MemberId, row, (MEMBERID)m_lib.ReadDWord(ids + i * sizeof(DWORD)));
+                Set(funcs.DocString, row, optional > FuncDocString - FuncFixedSize ?
+                    AddString(m_lib.StringBytes((int)DWordAt(record + FuncDocString))) : CStringRef());
+                Set(funcs.FuncKind, row, kinds & 0x07);
+                Set(funcs.InvokeKind, row, (kinds >> 3) & 0x0F);
+                Set(funcs.CallConv, row, (kinds >> 8) & 0x0F);
+                Set(funcs.Flags, row, LOWORD(DWordAt(record + FuncFlags)));
+                Set(funcs.VtableOffset, row, (short)(WordAt(record + FuncVtableOffset) & ~1));
+                Set(funcs.ReturnType, row, Ref((int)DWordAt(record + FuncDataType)));
+                Set(funcs.FirstParam, row, m_params);
+                Set(funcs.ParamCount, row, paramCount);
+                Set(funcs.OptionalParamCount, row, WordAt(record + FuncOptionalCount));
+
+                const BYTE* param = record + length - paramsLength;
+                for (WORD p = 0; p < paramCount; p++, param += ParamSize) {
+                    size_t paramRow = m_params++;
+                    Set(m_model.m_params.Type, paramRow, Ref((int)DWordAt(param)));
+                    Set(m_model.m_params.Name, paramRow, AddString(m_lib.NameBytes((int)DWordAt(param + sizeof(DWORD)))));
+                    Set(m_model.m_params.Flags, paramRow, LOWORD(DWordAt(param + 2 * sizeof(DWORD))));
+                }
+                pos += length;
+            }
+
+            if (varCount == 0)
+                return;
+            size_t firstVar = m_lib.ReadDWord(offsets + funcCount * sizeof(DWORD));
+            if (firstVar > recordsLength)
+                ThrowBadFormat(L"A variable record in the type library is damaged");
+            pos = records + firstVar;
+            for (size_t i = funcCount; i < memberCount; i++) {
+                if (sizeof(DWORD) > recordsEnd - pos)
+                    ThrowBadFormat(L"A variable record in the type library is damaged");
+                size_t length = m_lib.ReadDWord(pos) & 0xFF;
+                if (length < VarFixedSize || length > recordsEnd - pos)
+                    ThrowBadFormat(L"A variable record in the type library is damaged");
+                const BYTE* record = m_lib.m_data + pos;
+
+                size_t row = m_vars++;
+                CVarTable& vars = m_model.m_vars;
+                WORD kind = WordAt(record + VarKind);
+                int offset = (int)DWordAt(record + VarOffset);
+                Set(vars.MemberId, row, (MEMBERID)m_lib.ReadDWord(ids + i * sizeof(DWORD)));
+                Set(vars.Name, row, AddString(m_lib.NameBytes((int)m_lib.ReadDWord(names + i * sizeof(DWORD)))));
+                Set(vars.DocString, row, length > VarDocString ?
+                    AddString(m_lib.StringBytes((int)DWordAt(record + VarDocString))) : CStringRef());
+                Set(vars.VarKind, row, kind);
+                Set(vars.Flags, row, LOWORD(DWordAt(record + VarFlags)));
+                Set(vars.Type, row, Ref((int)DWordAt(record + VarDataType)));
+                Set(vars.Offset, row, kind == VAR_CONST ? 0 : offset);
+                Set(vars.ValueType, row, VT_EMPTY);
+                Set(vars.Value, row, 0);
+                if (kind == VAR_CONST && m_fill)
+                    DecodeConstant(row, offset);
+                pos += length;
+            }
+        }
+
+        //Small constants are stored in the offset itself: the VARTYPE in bits 26 to 30 and
+        //the value in the bits below. Other ones are in the custom data: a VARTYPE followed
+        //by the value.
+        void DecodeConstant(size_t row, int offset)
+        {
+            VARTYPE vt;
+            ULONGLONG raw = 0;
+            if (offset < 0) {
+                vt = (VARTYPE)((offset & 0x7C000000) >> 26);
+                raw = offset & 0x03FFFFFF;
+            }
+            else {
+                const CMsftTypeLib::CSegment& segment = m_lib.m_custData;
+                if ((size_t)offset + sizeof(VARTYPE) > segment.length)
+                    ThrowBadFormat(L"The type library refers to a constant outside its custom data");
+                const BYTE* data = m_lib.At(segment.offset + offset, sizeof(VARTYPE));
+                vt = WordAt(data);
+
+                size_t size = vt == VT_I8 || vt == VT_UI8 || vt == VT_CY ? sizeof(ULONGLONG) : sizeof(DWORD);
+                if ((size_t)offset + sizeof(VARTYPE) + size > segment.length)
+                    ThrowBadFormat(L"A constant in the type library is truncated");
+                memcpy(&raw, data + sizeof(VARTYPE), size);
+            }
+
+            LONGLONG value;
+            switch (vt)
+            {
+            case VT_I1: value = (signed char)raw; break;
+            case VT_UI1: value = (BYTE)raw; break;
+            case VT_I2: case VT_BOOL: value = (short)raw; break;
+            case VT_UI2: value = (WORD)raw; break;
+            case VT_I4: case VT_INT: case VT_ERROR: case VT_HRESULT: value = (LONG)raw; break;
+            case VT_UI4: case VT_UINT: value = (DWORD)raw; break;
+            case VT_I8: case VT_UI8: case VT_CY: value = (LONGLONG)raw; break;
+            default: value = 0; break;     //strings, floating point and the like are not decoded
+            }
+            Set(m_model.m_vars.ValueType, row, vt);
+            Set(m_model.m_vars.Value, row, value);
+        }
+
+        void Decode()
+        {
+            m_types = m_funcs = m_params = m_vars = m_typeDescs = m_bounds = m_chars = 0;
+            DecodeTypeDescs();
+            for (size_t i = 0; i < m_lib.TypeCount(); i++)
+                DecodeType(i);
+        }
+
+    public:
+        CBuilder(const CMsftTypeLib& lib, CTypeModel& model) :
+            m_lib(lib), m_model(model)
+        {
+            m_typeDescCount = lib.m_typeDescs.length / TypeDescSize;
+        }
+
+        void Build()
+        {
+            Decode();
+
+            m_model.m_arenaSize = Layout(NULL);
+            m_model.m_arena = std::make_unique<BYTE[]>(m_model.m_arenaSize);
+            Layout(m_model.m_arena.get());
+            m_model.m_types.Count = m_types;
+            m_model.m_funcs.Count = m_funcs;
+            m_model.m_params.Count = m_params;
+            m_model.m_vars.Count = m_vars;
+            m_model.m_typeDescs.Count = m_typeDescs;
+            m_model.m_bounds.Count = m_bounds;
+            m_model.m_charCount = m_chars;
+
+            m_fill = true;
+            Decode();
+        }
+    };
+
+    CTypeModel CTypeModel::Load(const CMsftTypeLib& lib)
+    {
+        CTypeModel model;
+        CBuilder(lib, model).Build();
+        return model;
+    }
+
+    CTypeModel CTypeModel::Load(const std::wstring& path)
+    {
+        std::unique_ptr<CMsftTypeLib> lib = CMsftTypeLib::TryOpen(path);
+        if (!lib)
+            throw ExWin32Error(ERROR_BAD_FORMAT, L"The file is not a type library in the MSFT format");
+        return Load(*lib);
+    }
+
+    std::wstring_view CTypeModel::String(CStringRef ref) const
+    {
+        if ((size_t)ref.Offset + ref.Length > m_charCount)
+            throw ExWin32Error(ERROR_INVALID_PARAMETER, L"String reference out of range");
+        return std::wstring_view(m_chars + ref.Offset, ref.Length);
+    }
+
+    //Types in the same library are referred to by the offset of their record in the type
+    //info table. Imported types have one of the low bits set.
+    CTypeModel::Index CTypeModel::LocalType(HREFTYPE ref) const
+    {
+        if (ref == NoIndex || (ref & 3) != 0 || ref / TypeRecordSize >= m_types.Count)
+            return NoIndex;
+        return ref / TypeRecordSize;
+    }
+}
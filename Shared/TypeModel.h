@@ -0,0 +1,183 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <ole2.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "MsftTypeLib.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Every type in a type library with its functions, parameters and variables, the
+	/// way ITypeInfo describes them with TYPEATTR, FUNCDESC, VARDESC and ELEMDESC.
+	///
+	/// The model is a set of tables, one per kind of item, and each table is a struct of
+	/// arrays: one array per field, all of the same length. Items refer to each other by
+	/// index, never by pointer: a type has the index of its first function and the number
+	/// of functions, which are consecutive in the function table, and the same goes for
+	/// the parameters of a function. Names and doc strings are ranges in one character
+	/// pool. All arrays and the pool live in one block of memory that is allocated once,
+	/// after a first pass over the file has counted everything.
+	///
+	/// The model is read only; it is decoded from an MSFT type library.
+	/// </summary>
+	class CTypeModel
+	{
+	public:
+		typedef DWORD Index;
+		static const Index NoIndex = 0xFFFFFFFF;
+
+		//Reference to a type description: either a simple VARTYPE, with SimpleType set,
+		//or the index of a row in the type description table
+		typedef DWORD TypeRef;
+		static const TypeRef SimpleType = 0x80000000;
+
+		static bool IsSimple(TypeRef type) { return (type & SimpleType) != 0; }
+		static VARTYPE SimpleVarType(TypeRef type) { return (VARTYPE)(type & VT_TYPEMASK); }
+
+		//A name or doc string: a range in the character pool
+		struct CStringRef
+		{
+			DWORD Offset;
+			DWORD Length;
+		};
+
+		//TYPEATTR, plus the name and doc string
+		struct CTypeTable
+		{
+			size_t Count;
+			const TYPEKIND* Kind;
+			const GUID* Guid;               //GUID_NULL if the type has none
+			const WORD* Flags;              //TYPEFLAGS
+			const WORD* MajorVersion;
+			const WORD* MinorVersion;
+			const CStringRef* Name;
+			const CStringRef* DocString;
+			const Index* FirstFunc;
+			const WORD* FuncCount;
+			const Index* FirstVar;
+			const WORD* VarCount;
+			const WORD* ImplTypeCount;
+			const HREFTYPE* BaseType;       //inherited interface; NoIndex for other kinds
+			const TypeRef* AliasType;       //aliased type of a TKIND_ALIAS; NoIndex otherwise
+		};
+
+		//FUNCDESC
+		struct CFuncTable
+		{
+			size_t Count;
+			const MEMBERID* MemberId;
+			const CStringRef* Name;
+			const CStringRef* DocString;
+			const BYTE* FuncKind;           //FUNCKIND
+			const BYTE* InvokeKind;         //INVOKEKIND
+			const BYTE* CallConv;           //CALLCONV
+			const WORD* Flags;              //FUNCFLAGS
+			const short* VtableOffset;
+			const TypeRef* ReturnType;
+			const Index* FirstParam;
+			const WORD* ParamCount;
+			const WORD* OptionalParamCount;
+		};
+
+		//ELEMDESC of a parameter, plus its name
+		struct CParamTable
+		{
+			size_t Count;
+			const CStringRef* Name;
+			const TypeRef* Type;
+			const WORD* Flags;              //PARAMFLAGS
+		};
+
+		//VARDESC
+		struct CVarTable
+		{
+			size_t Count;
+			const MEMBERID* MemberId;
+			const CStringRef* Name;
+			const CStringRef* DocString;
+			const BYTE* VarKind;            //VARKIND
+			const WORD* Flags;              //VARFLAGS
+			const TypeRef* Type;
+			const LONG* Offset;             //oInst; not used for VAR_CONST
+			const VARTYPE* ValueType;       //VAR_CONST: type of the value, VT_EMPTY otherwise
+			const LONGLONG* Value;          //VAR_CONST with an integer value
+		};
+
+		//TYPEDESC that is not a simple VARTYPE
+		struct CTypeDescTable
+		{
+			size_t Count;
+			const VARTYPE* VarType;
+			const TypeRef* Inner;           //VT_PTR, VT_SAFEARRAY and VT_CARRAY: the element type
+			const HREFTYPE* RefType;        //VT_USERDEFINED; see LocalType
+			const WORD* DimCount;           //VT_CARRAY
+			const Index* FirstBound;        //VT_CARRAY
+		};
+
+		//SAFEARRAYBOUND of a VT_CARRAY
+		struct CBoundTable
+		{
+			size_t Count;
+			const ULONG* Elements;
+			const LONG* LowerBound;
+		};
+
+	private:
+		std::unique_ptr<BYTE[]> m_arena;
+		size_t m_arenaSize = 0;
+		CTypeTable m_types = {};
+		CFuncTable m_funcs = {};
+		CParamTable m_params = {};
+		CVarTable m_vars = {};
+		CTypeDescTable m_typeDescs = {};
+		CBoundTable m_bounds = {};
+		const wchar_t* m_chars = NULL;
+		size_t m_charCount = 0;
+
+		class CBuilder;
+		CTypeModel() {}
+
+	public:
+		//Decode the whole library. Throws ERROR_BAD_FORMAT if it does not add up.
+		static CTypeModel Load(const CMsftTypeLib& lib);
+
+		//Throws ERROR_BAD_FORMAT if the file is not an MSFT type library
+		static CTypeModel Load(const std::wstring& path);
+
+		CTypeModel(CTypeModel&&) = default;
+		CTypeModel& operator = (CTypeModel&&) = default;
+
+		const CTypeTable& Types() const { return m_types; }
+		const CFuncTable& Funcs() const { return m_funcs; }
+		const CParamTable& Params() const { return m_params; }
+		const CVarTable& Vars() const { return m_vars; }
+		const CTypeDescTable& TypeDescs() const { return m_typeDescs; }
+		const CBoundTable& Bounds() const { return m_bounds; }
+
+		std::wstring_view String(CStringRef ref) const;
+
+		//Index of the type that a reference type points to, or NoIndex if the type is
+		//imported from another library
+		Index LocalType(HREFTYPE ref) const;
+
+		//Bytes of the arena, for sizing a cache of models
+		size_t MemorySize() const { return m_arenaSize; }
+	};
+}
@@ -0,0 +1,158 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "Win32RegBackend.h"
+
+//required for transaction support
+#pragma comment(lib, "KtmW32")
+
+namespace w32
+{
+	CWin32RegBackend* CWin32RegBackend::Instance()
+	{
+		static CWin32RegBackend instance;
+		return &instance;
+	}
+
+	LSTATUS CWin32RegBackend::OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		if (IsTransaction(transaction)) {
+			return RegOpenKeyTransactedW(
+				parent, subKey, 0, samDesired, result, transaction, NULL);
+		}
+		return RegOpenKeyExW(parent, subKey, 0, samDesired, result);
+	}
+
+	LSTATUS CWin32RegBackend::CreateKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired,
+		HANDLE transaction, HKEY* result)
+	{
+		if (IsTransaction(transaction)) {
+			return RegCreateKeyTransactedW(
+				parent, subKey, 0,
+				NULL,                   //user class. can be ignored
+				REG_OPTION_NON_VOLATILE,//the change is to be permanent
+				samDesired,
+				NULL,                   //security attributes. NULL -> default security inherited
+				result,
+				NULL,                   //disposition feedback -> was it created or opened? don't care.
+				transaction,
+				NULL);					//reserved
+		}
+		return RegCreateKeyExW(
+			parent,
+			subKey,
+			0,                      //reserved
+			NULL,                   //user class. can be ignored
+			REG_OPTION_NON_VOLATILE,//the change is to be permanent
+			samDesired,
+			NULL,                   //security attributes. NULL -> default security inherited
+			result,
+			NULL);                 //disposition feedback -> was it created or opened? don't care.
+	}
+
+	LSTATUS CWin32RegBackend::CloseKey(HKEY key)
+	{
+		return RegCloseKey(key);
+	}
+
+	LSTATUS CWin32RegBackend::QueryInfoKey(HKEY key,
+		DWORD* numSubKeys, DWORD* maxSubKeyLength,
+		DWORD* numValues, DWORD* maxValueNameLength, DWORD* maxValueLength,
+		FILETIME* lastWriteTime)
+	{
+		return RegQueryInfoKeyW(key, NULL, NULL, NULL, numSubKeys, maxSubKeyLength,
+			NULL, numValues, maxValueNameLength, maxValueLength, NULL, lastWriteTime);
+	}
+
+	LSTATUS CWin32RegBackend::EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength)
+	{
+		return RegEnumKeyExW(key, index, name, nameLength, NULL, NULL, NULL, NULL);
+	}
+
+	LSTATUS CWin32RegBackend::EnumValue(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength,
+		DWORD* type, LPBYTE data, DWORD* dataLength)
+	{
+		return RegEnumValueW(key, index, name, nameLength, NULL, type, data, dataLength);
+	}
+
+	LSTATUS CWin32RegBackend::QueryValue(HKEY key, LPCWSTR valueName, DWORD* type,
+		LPBYTE data, DWORD* dataLength)
+	{
+		return RegQueryValueExW(key, valueName, NULL, type, data, dataLength);
+	}
+
+	LSTATUS CWin32RegBackend::SetValue(HKEY key, LPCWSTR valueName, DWORD type,
+		const BYTE* data, DWORD dataLength)
+	{
+		return RegSetValueExW(key, valueName, 0, type, data, dataLength);
+	}
+
+	LSTATUS CWin32RegBackend::DeleteValue(HKEY key, LPCWSTR valueName)
+	{
+		return RegDeleteValueW(key, valueName);
+	}
+
+	LSTATUS CWin32RegBackend::DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction)
+	{
+		if (IsTransaction(transaction)) {
+			return RegDeleteKeyTransactedW(parent, subKey, 0, 0, transaction, NULL);
+		}
+		return RegDeleteKeyExW(parent, subKey, 0, 0);
+	}
+
+	LSTATUS CWin32RegBackend::DeleteTree(HKEY key, LPCWSTR subKey)
+	{
+		return RegDeleteTreeW(key, subKey);
+	}
+
+	LSTATUS CWin32RegBackend::CreateTransaction(HANDLE* transaction)
+	{
+		*transaction = ::CreateTransaction(
+			NULL,                   //Using default security.
+			NULL,                   //Reserved
+			0,                      //Create options, only relevant for inheriting handles
+			0,                      //Reserved
+			0,                      //Reserved
+			0,                      //Timeout
+			NULL);                  //User readable description
+		if (*transaction == INVALID_HANDLE_VALUE)
+			return GetLastError();
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CWin32RegBackend::CommitTransaction(HANDLE transaction)
+	{
+		if (!::CommitTransaction(transaction))
+			return GetLastError();
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CWin32RegBackend::RollbackTransaction(HANDLE transaction)
+	{
+		if (!::RollbackTransaction(transaction))
+			return GetLastError();
+		return ERROR_SUCCESS;
+	}
+
+	LSTATUS CWin32RegBackend::CloseTransaction(HANDLE transaction)
+	{
+		if (!::CloseHandle(transaction))
+			return GetLastError();
+		return ERROR_SUCCESS;
+	}
+}
@@ -0,0 +1,284 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#include "pch.h"
+#include "WriteBatch.h"
+#include "StringHelper.h"
+#include "Exception.h"
+
+namespace w32
+{
+	static const size_t NoOp = (size_t)-1;
+
+	//Strip the separators at either end of a path
+	static std::wstring TrimPath(const std::wstring& path)
+	{
+		size_t start = path.find_first_not_of(L'\\');
+		if (start == std::wstring::npos)
+			return std::wstring();
+		size_t end = path.find_last_not_of(L'\\');
+		return path.substr(start, end - start + 1);
+	}
+
+	CWriteBatch::CWriteBatch(IRegBackend* backend) :
+		m_backend(backend ? backend : GetDefaultRegBackend())
+	{
+	}
+
+	size_t CWriteBatch::CreateKey(HKEY root, const std::wstring& path)
+	{
+		COperation op;
+		op.op = EOp::CREATE_KEY;
+		return Add(std::move(op), root, path);
+	}
+
+	size_t CWriteBatch::SetValue(HKEY root, const std::wstring& path, const std::wstring& name,
+		DWORD type, const BYTE* data, DWORD dataLength)
+	{
+		COperation op;
+		op.op = EOp::SET_VALUE;
+		op.name = name;
+		op.type = type;
+		op.data.assign(data, data + dataLength);
+		return Add(std::move(op), root, path);
+	}
+
+	size_t CWriteBatch::SetValue(HKEY root, const std::wstring& path, const std::wstring& name,
+		const std::wstring& value)
+	{
+		return SetValue(root, path, name, REG_SZ,
+			(const BYTE*)value.c_str(), (DWORD)((value.length() + 1) * sizeof(wchar_t)));
+	}
+
+	size_t CWriteBatch::SetValue(HKEY root, const std::wstring& path, const std::wstring& name,
+		DWORD value)
+	{
+		return SetValue(root, path, name, REG_DWORD, (const BYTE*)&value, sizeof(DWORD));
+	}
+
+	size_t CWriteBatch::DeleteValue(HKEY root, const std::wstring& path, const std::wstring& name)
+	{
+		COperation op;
+		op.op = EOp::DELETE_VALUE;
+		op.name = name;
+		return Add(std::move(op), root, path);
+	}
+
+	size_t CWriteBatch::DeleteTree(HKEY root, const std::wstring& path)
+	{
+		COperation op;
+		op.op = EOp::DELETE_TREE;
+		return Add(std::move(op), root, path);
+	}
+
+	//Record an operation and coalesce it with the ones before it
+	size_t CWriteBatch::Add(COperation op, HKEY root, const std::wstring& path)
+	{
+		size_t index = m_ops.size();
+		EOp kind = op.op;
+		std::wstring trimmed = TrimPath(path);
+		std::wstring id = std::to_wstring((unsigned long long)(ULONG_PTR)root) + L":" + ToWUpperName(trimmed);
+		m_ops.push_back(std::move(op));
+		m_status.push_back(ERROR_SUCCESS);
+
+		if (kind == EOp::DELETE_TREE) {
+			//Everything that was going to happen inside the tree is pointless now,
+			//except that creating a key in it also created the parent of the tree
+			std::wstring below = trimmed.empty() ? id : id + L"\\";
+			bool createParent = false;
+			for (CStep& step : m_steps) {
+				if (step.dropped || (step.id != id && step.id.compare(0, below.length(), below) != 0))
+					continue;
+				step.dropped = true;
+				if (step.create || step.createParent)
+					createParent = true;
+				for (size_t i : step.ops) {
+					m_ops[i].replacedBy = index;
+					if (m_ops[i].op == EOp::CREATE_KEY || m_ops[i].op == EOp::SET_VALUE ||
+						m_ops[i].replacesCreate)
+						m_ops[index].replacesCreate = true;
+				}
+				m_openSteps.erase(step.id);
+			}
+
+			CStep step;
+			step.root = root;
+			step.path = trimmed;
+			step.id = id;
+			step.deleteTree = true;
+			step.createParent = createParent;
+			step.ops.push_back(index);
+			m_steps.push_back(std::move(step));
+			return index;
+		}
+
+		//All other operations on a key go in the same step, unless a tree that
+		//contains the key was deleted in the meantime.
+		auto it = m_openSteps.find(id);
+		if (it == m_openSteps.end()) {
+			CStep step;
+			step.root = root;
+			step.path = trimmed;
+			step.id = id;
+			m_steps.push_back(std::move(step));
+			it = m_openSteps.emplace(id, m_steps.size() - 1).first;
+		}
+		CStep& step = m_steps[it->second];
+
+		if (kind == EOp::CREATE_KEY) {
+			//the key is created once, whatever the number of requests
+			for (size_t i : step.ops) {
+				if (m_ops[i].op == EOp::CREATE_KEY) {
+					m_ops[index].replacedBy = i;
+					return index;
+				}
+			}
+			step.create = true;
+			step.ops.push_back(index);
+			return index;
+		}
+
+		//Only the last write to a value counts
+		if (kind == EOp::SET_VALUE)
+			step.create = true;
+		std::wstring valueId = ToWUpperName(m_ops[index].name);
+		auto value = step.values.find(valueId);
+		if (value == step.values.end()) {
+			step.values.emplace(valueId, step.ops.size());
+			step.ops.push_back(index);
+		}
+		else {
+			size_t previous = step.ops[value->second];
+			m_ops[previous].replacedBy = index;
+			if (kind == EOp::DELETE_VALUE)
+				m_ops[index].replacesCreate =
+					m_ops[previous].op == EOp::SET_VALUE || m_ops[previous].replacesCreate;
+			step.ops[value->second] = index;
+		}
+		return index;
+	}
+
+	size_t CWriteBatch::Count()
+	{
+		return m_ops.size();
+	}
+
+	size_t CWriteBatch::EffectiveCount()
+	{
+		size_t count = 0;
+		for (CStep& step : m_steps) {
+			if (!step.dropped)
+				count += step.ops.size();
+		}
+		return count;
+	}
+
+	//Perform the operations of one step
+	void CWriteBatch::ApplyStep(CStep& step, HANDLE transaction)
+	{
+		if (step.dropped)
+			return;
+
+		if (step.deleteTree) {
+			size_t index = step.ops[0];
+			LSTATUS retVal = ERROR_SUCCESS;
+			try {
+				size_t parentEnd = step.path.rfind(L'\\');
+				if (step.createParent && parentEnd != std::wstring::npos)
+					CHKey::Create(step.root, step.path.substr(0, parentEnd), KEY_READ | KEY_WRITE, transaction, m_backend);
+				CHKey::DeleteTree(step.root, step.path.c_str(), true, transaction, m_backend);
+			}
+			catch (Win32Exception& e) {
+				retVal = e.Value();
+			}
+			//the tree would have existed if the operations before it had been performed
+			if (retVal == ERROR_FILE_NOT_FOUND && m_ops[index].replacesCreate)
+				retVal = ERROR_SUCCESS;
+			m_status[index] = retVal;
+			return;
+		}
+
+		try {
+			CHKey key = step.create ?
+				CHKey::Create(step.root, step.path, KEY_READ | KEY_WRITE, transaction, m_backend) :
+				CHKey::Open(step.root, step.path, KEY_READ | KEY_WRITE, transaction, m_backend);
+
+			for (size_t index : step.ops) {
+				COperation& op = m_ops[index];
+				LSTATUS retVal = ERROR_SUCCESS;
+				try {
+					if (op.op == EOp::SET_VALUE)
+						key.SetValue(op.name, op.type, op.data.data(), (DWORD)op.data.size());
+					else if (op.op == EOp::DELETE_VALUE)
+						key.DeleteValue(op.name);
+				}
+				catch (Win32Exception& e) {
+					retVal = e.Value();
+				}
+				if (retVal == ERROR_FILE_NOT_FOUND && op.replacesCreate)
+					retVal = ERROR_SUCCESS;
+				m_status[index] = retVal;
+			}
+		}
+		catch (Win32Exception& e) {
+			//the key itself could not be opened or created
+			for (size_t index : step.ops)
+				m_status[index] = e.Value();
+		}
+	}
+
+	bool CWriteBatch::Apply(HANDLE transaction)
+	{
+		CRegTransaction localTransaction(m_backend);
+		if (!IsTransaction(transaction)) {
+			localTransaction.Create();
+			transaction = localTransaction;
+		}
+
+		for (CStep& step : m_steps)
+			ApplyStep(step, transaction);
+
+		bool success = true;
+		for (size_t i = 0; i < m_ops.size(); i++) {
+			if (Status(i) != ERROR_SUCCESS)
+				success = false;
+		}
+
+		if (localTransaction.IsValid()) {
+			if (success)
+				localTransaction.Commit();
+			else
+				localTransaction.RollBack();
+		}
+		return success;
+	}
+
+	LSTATUS CWriteBatch::Status(size_t operation)
+	{
+		//an operation that was coalesced has the result of the one that replaced it
+		while (m_ops[operation].replacedBy != NoOp)
+			operation = m_ops[operation].replacedBy;
+		return m_status[operation];
+	}
+
+	void CWriteBatch::Clear()
+	{
+		m_ops.clear();
+		m_status.clear();
+		m_steps.clear();
+		m_openSteps.clear();
+	}
+}
@@ -0,0 +1,127 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+#pragma once
+#include <WinBase.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "HKey.h"
+
+namespace w32
+{
+	/// <summary>
+	/// Collects registry changes and applies them all at once, in one transaction.
+	///
+	/// Every method that adds an operation returns its index, which can be used to get
+	/// the result of that operation after Apply. Operations are coalesced before they are
+	/// applied:
+	/// - all operations on the same key share one open handle;
+	/// - when the same value is written or deleted more than once, only the last one is
+	///   performed;
+	/// - when a tree is deleted, earlier operations on keys inside it are dropped.
+	/// An operation that was dropped reports the result of the one that replaced it.
+	///
+	/// The effect is the same as performing the operations one by one in the order in
+	/// which they were added. Setting a value creates its key if needed.
+	/// </summary>
+	class CWriteBatch
+	{
+		enum class EOp
+		{
+			CREATE_KEY,
+			SET_VALUE,
+			DELETE_VALUE,
+			DELETE_TREE
+		};
+
+		struct COperation
+		{
+			EOp op;
+			std::wstring name;              //value name
+			DWORD type = REG_NONE;
+			std::vector<BYTE> data;
+			size_t replacedBy = (size_t)-1; //index of the operation that made this one redundant
+			bool replacesCreate = false;    //a delete that makes an earlier create or set redundant
+		};
+
+		//A key with the operations on it, or a tree deletion.
+		//Steps are applied in order.
+		struct CStep
+		{
+			HKEY root;
+			std::wstring path;
+			std::wstring id;                //root + uppercased path
+			bool deleteTree = false;
+			bool create = false;            //the key has to be created
+			bool createParent = false;      //a dropped step created keys in the tree, and so its parent
+			std::vector<size_t> ops;        //operations in the order they are to be applied
+			std::unordered_map<std::wstring, size_t> values;    //uppercased value name -> position in ops
+			bool dropped = false;           //inside a tree that is deleted later on
+		};
+
+		IRegBackend* m_backend;
+		std::vector<COperation> m_ops;
+		std::vector<LSTATUS> m_status;
+		std::vector<CStep> m_steps;
+		std::unordered_map<std::wstring, size_t> m_openSteps;  //key id -> step that can still take operations
+
+		size_t Add(COperation op, HKEY root, const std::wstring& path);
+		void ApplyStep(CStep& step, HANDLE transaction);
+
+	public:
+		CWriteBatch(IRegBackend* backend = NULL);   //NULL means the default backend
+
+		//Create a key, including missing parent keys
+		size_t CreateKey(HKEY root, const std::wstring& path);
+
+		//Set a value of any type
+		size_t SetValue(HKEY root, const std::wstring& path, const std::wstring& name,
+			DWORD type, const BYTE* data, DWORD dataLength);
+
+		//Set a REG_SZ value
+		size_t SetValue(HKEY root, const std::wstring& path, const std::wstring& name,
+			const std::wstring& value);
+
+		//Set a REG_DWORD value
+		size_t SetValue(HKEY root, const std::wstring& path, const std::wstring& name,
+			DWORD value);
+
+		//Delete a single value
+		size_t DeleteValue(HKEY root, const std::wstring& path, const std::wstring& name);
+
+		//Delete a key and everything below it
+		size_t DeleteTree(HKEY root, const std::wstring& path);
+
+		//Number of operations that were added
+		size_t Count();
+
+		//Number of operations that will actually be performed
+		size_t EffectiveCount();
+
+		//Apply all operations. If a transaction is supplied, the operations become part of it
+		//and the caller decides whether to commit. Otherwise a local transaction is used,
+		//which is committed only if every operation succeeded.
+		//Returns true if every operation succeeded.
+		bool Apply(HANDLE transaction = INVALID_HANDLE_VALUE);
+
+		//Result of an operation, after Apply
+		LSTATUS Status(size_t operation);
+
+		//Remove all operations
+		void Clear();
+	};
+}
@@ -0,0 +1,202 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "ComIndex.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+#include <filesystem>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const wchar_t Libid[] = L"{11111111-0000-0000-0000-000000000001}";
+	const wchar_t Iid[] = L"{22222222-0000-0000-0000-000000000001}";
+	const wchar_t Clsid[] = L"{33333333-0000-0000-0000-000000000001}";
+
+	void Set(CMemRegBackend& hive, HKEY root, const std::wstring& path, const std::wstring& name,
+		const std::wstring& value)
+	{
+		CHKey key = CHKey::Create(root, L"Software\\Classes\\" + path, GENERIC_READ | GENERIC_WRITE,
+			INVALID_HANDLE_VALUE, &hive);
+		key.SetValue(name, value);
+	}
+
+	//A library, an interface and a class that reference each other, and 100 local servers
+	void BuildRegistry(CMemRegBackend& hive)
+	{
+		std::wstring libid(Libid), iid(Iid), clsid(Clsid);
+		Set(hive, HKEY_LOCAL_MACHINE, L"TypeLib\\" + libid + L"\\1.0\\0\\win32", L"", L"C:\\Libs\\lib.dll\\2");
+		Set(hive, HKEY_LOCAL_MACHINE, L"TypeLib\\" + libid + L"\\1.0\\0\\win64", L"", L"C:\\Libs\\lib64.tlb");
+		Set(hive, HKEY_LOCAL_MACHINE, L"TypeLib\\" + libid + L"\\1.0\\FLAGS", L"", L"0");
+		Set(hive, HKEY_LOCAL_MACHINE, L"Interface\\" + iid + L"\\TypeLib", L"", libid);
+		Set(hive, HKEY_LOCAL_MACHINE, L"Interface\\" + iid + L"\\TypeLib", L"Version", L"1.0");
+		Set(hive, HKEY_LOCAL_MACHINE, L"CLSID\\" + clsid + L"\\InprocServer32", L"", L"\"C:\\Bin\\srv.dll\"");
+		Set(hive, HKEY_LOCAL_MACHINE, L"CLSID\\" + clsid + L"\\ProgID", L"", L"Foo.Bar.1");
+		Set(hive, HKEY_LOCAL_MACHINE, L"CLSID\\" + clsid + L"\\TypeLib", L"", libid);
+		Set(hive, HKEY_CURRENT_USER, L"Foo.Bar\\CLSID", L"", clsid);
+		Set(hive, HKEY_LOCAL_MACHINE, L".txt", L"", L"txtfile");
+		for (int i = 0; i < 100; i++) {
+			wchar_t guid[64];
+			swprintf(guid, 64, L"{44444444-0000-0000-0000-%012d}", i);
+			Set(hive, HKEY_LOCAL_MACHINE, std::wstring(L"CLSID\\") + guid + L"\\LocalServer32", L"",
+				L"C:\\Bin\\server.exe /automation");
+			Set(hive, HKEY_LOCAL_MACHINE, L"Prog." + std::to_wstring(i) + L"\\CLSID", L"", guid);
+		}
+	}
+
+	void WriteIndex(const std::wstring& fileName)
+	{
+		CMemRegBackend hive;
+		BuildRegistry(hive);
+		CComIndexBuilder builder(&hive);
+		builder.Scan();
+		builder.Save(fileName);
+	}
+
+	//Dump every entry of an index and refresh from the index. Empty if there is no index.
+	std::wstring DumpIndex(const std::wstring& fileName)
+	{
+		CComIndex index(fileName);
+		if (!index.Exists())
+			return L"";
+		std::vector<CComIndexEntry> entries = index.Entries();
+		CHECK(entries.size() == index.Count());
+		std::wstring dump;
+		for (size_t i = 0; i < entries.size(); i++) {
+			const CComIndexEntry& entry = entries[i];
+			CHECK(entry.Kind >= EComIndexKind::TYPELIB_FILE && entry.Kind <= EComIndexKind::PROGID_CLASS);
+			CHECK(i == 0 || entries[i - 1].Kind <= entry.Kind);
+			dump += std::to_wstring((int)entry.Kind) + L" " + std::to_wstring(entry.PerUser) + L" " +
+				entry.Key + L" " + entry.Value + L" " + entry.Detail + L"\n";
+		}
+		CMemRegBackend empty;
+		CComIndexBuilder(&empty).Refresh(index);
+		return dump;
+	}
+}
+
+TEST(ComIndex, Find)
+{
+	CTempDir dir;
+	WriteIndex(dir.File(L"index.bin"));
+
+	CComIndex index(dir.File(L"index.bin"));
+	CHECK(index.Exists());
+	CHECK(index.Count() == index.Entries().size());
+	CHECK(index.Find(EComIndexKind::TYPELIB_FILE, Libid).size() == 2);
+	std::vector<CComIndexEntry> interfaces = index.Find(EComIndexKind::INTERFACE_TYPELIB, Iid);
+	CHECK(interfaces.size() == 1 && interfaces[0].Value == Libid && interfaces[0].Detail == L"1.0");
+	CHECK(index.Find(EComIndexKind::FILE_GUID, L"c:/bin/SRV.dll").size() == 1);
+	CHECK(index.Find(EComIndexKind::FILE_GUID, L"C:\\Bin\\server.exe").size() == 100);
+	std::vector<CComIndexEntry> progIds = index.Find(EComIndexKind::PROGID_CLASS, L"foo.bar");
+	CHECK(progIds.size() == 1 && progIds[0].PerUser);
+	CHECK(index.Find(EComIndexKind::PROGID_CLASS, L"PROG.99").size() == 1);
+	std::vector<CComIndexEntry> classes = index.Find(EComIndexKind::CLASS_PROGID, Clsid);
+	CHECK(classes.size() == 1 && classes[0].Value == L"Foo.Bar.1");
+	CHECK(index.Find(EComIndexKind::CLASS_TYPELIB, Clsid).size() == 1);
+	CHECK(index.Find(EComIndexKind::CLASS_TYPELIB, Iid).empty());
+}
+
+TEST(ComIndex, ResourceNumberIsNotPartOfTheFile)
+{
+	CHECK(CComIndex::NormalizeFile(L"C:\\x\\lib.dll\\2") == CComIndex::NormalizeFile(L"c:\\X\\LIB.DLL"));
+	CHECK(CComIndex::NormalizeFile(L"\"C:\\x\\lib.dll\"") == CComIndex::NormalizeFile(L"c:/x/lib.dll"));
+
+	CTempDir dir;
+	WriteIndex(dir.File(L"index.bin"));
+	CComIndex index(dir.File(L"index.bin"));
+	std::vector<CComIndexEntry> files = index.Find(EComIndexKind::FILE_GUID, L"C:\\Libs\\LIB.dll");
+	CHECK(files.size() == 1 && files[0].Value == Libid);
+}
+
+TEST(ComIndex, Refresh)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildRegistry(hive);
+	{
+		CComIndexBuilder builder(&hive);
+		builder.Scan();
+		builder.Save(dir.File(L"index.bin"));
+	}
+
+	Set(hive, HKEY_LOCAL_MACHINE, L"CLSID\\" + std::wstring(Clsid) + L"\\InprocServer32", L"", L"C:\\Bin\\new.dll");
+	CHKey::DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Classes\\Interface", false, INVALID_HANDLE_VALUE, &hive);
+	CComIndexBuilder builder(&hive);
+	{
+		CComIndex previous(dir.File(L"index.bin"));
+		builder.Refresh(previous);
+	}
+	CHECK(builder.ScannedGroups() == 1 && builder.ReusedGroups() == 101);
+	builder.Save(dir.File(L"index.bin"));
+
+	CComIndex index(dir.File(L"index.bin"));
+	CHECK(index.Find(EComIndexKind::FILE_GUID, L"C:\\Bin\\srv.dll").empty());
+	CHECK(index.Find(EComIndexKind::FILE_GUID, L"C:\\Bin\\new.dll").size() == 1);
+	CHECK(index.Find(EComIndexKind::INTERFACE_TYPELIB, Iid).empty());
+	CComIndexBuilder scan(&hive);
+	scan.Scan();
+	CHECK(scan.Count() == index.Count());
+}
+
+TEST(ComIndex, DamagedFile)
+{
+	CTempDir dir;
+	WriteIndex(dir.File(L"index.bin"));
+	CDamageCheck check;
+	check.Read = DumpIndex;
+	check.TruncateStep = 7;
+	check.Seed = 23;
+	check.Run(ReadBytes(dir.File(L"index.bin")), dir);
+}
+
+TEST(ComIndex, OtherFilesAreEmpty)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"junk.bin"), { 'j', 'u', 'n', 'k' });
+	CHECK(!CComIndex(dir.File(L"junk.bin")).Exists());
+	CHECK(!CComIndex(dir.File(L"missing.bin")).Exists());
+	CHECK(CComIndex(dir.File(L"missing.bin")).Find(EComIndexKind::PROGID_CLASS, L"Foo.Bar").empty());
+}
+
+TEST(ComIndex, FailedSaveKeepsTheIndex)
+{
+	CTempDir dir;
+	std::wstring fileName = dir.File(L"index.bin");
+	WriteIndex(fileName);
+	std::vector<BYTE> saved = ReadBytes(fileName);
+	CHECK(!std::filesystem::exists(std::filesystem::path(fileName + L".new")));
+
+	//the new index cannot be written next to the old one
+	std::filesystem::create_directory(std::filesystem::path(fileName + L".new"));
+	CMemRegBackend empty;
+	CComIndexBuilder builder(&empty);
+	builder.Scan();
+	CHECK_THROWS(builder.Save(fileName), Win32Exception);
+	CHECK(ReadBytes(fileName) == saved);
+	CHECK(CComIndex(fileName).Count() > 0);
+
+	std::filesystem::remove(std::filesystem::path(fileName + L".new"));
+	builder.Save(fileName);
+	CHECK(CComIndex(fileName).Exists() && CComIndex(fileName).Count() == 0);
+	CHECK(!std::filesystem::exists(std::filesystem::path(fileName + L".new")));
+}
@@ -0,0 +1,166 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "KeyCache.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	//A hive that remembers which paths it was asked to open
+	class COpenLog : public CMemRegBackend
+	{
+	public:
+		std::vector<std::wstring> Opened;
+
+		LSTATUS OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired, HANDLE transaction,
+			HKEY* result) override
+		{
+			Opened.push_back(subKey ? subKey : L"");
+			return CMemRegBackend::OpenKey(parent, subKey, samDesired, transaction, result);
+		}
+	};
+
+	void CreateKeys(IRegBackend& hive)
+	{
+		for (const wchar_t* path : { L"Software\\A\\B\\C", L"Software\\A\\D", L"Software\\E" })
+			CHKey::Create(HKEY_LOCAL_MACHINE, path, GENERIC_READ | GENERIC_WRITE, INVALID_HANDLE_VALUE, &hive);
+	}
+}
+
+TEST(KeyCache, SameKeyForEveryWayOfWritingThePath)
+{
+	COpenLog hive;
+	CreateKeys(hive);
+	CKeyCache cache(8, &hive);
+
+	std::shared_ptr<CHKey> key = cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A");
+	CHECK(key->Name() == L"A");
+	CHECK(cache.Open(HKEY_LOCAL_MACHINE, L"\\software\\a\\") == key);
+	CHECK(cache.Open(HKEY_LOCAL_MACHINE, L"SOFTWARE\\A") == key);
+	CHECK(cache.Exists(HKEY_LOCAL_MACHINE, L"Software\\A"));
+	CHECK(hive.Opened.size() == 1);
+	CHECK(cache.Hits() == 3);
+	CHECK(cache.Misses() == 1);
+	CHECK(cache.Size() == 1);
+
+	//another root is another key
+	CHECK(!cache.Exists(HKEY_CURRENT_USER, L"Software\\A"));
+}
+
+TEST(KeyCache, OpensRelativeToTheClosestAncestor)
+{
+	COpenLog hive;
+	CreateKeys(hive);
+	CKeyCache cache(8, &hive);
+
+	cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A");
+	std::shared_ptr<CHKey> key = cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A\\B\\C");
+	CHECK(key->Path() == L"HKLM\\Software\\A\\B\\C");
+	cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A\\B\\C\\");
+	std::vector<std::wstring> expected = { L"Software\\A", L"B\\C" };
+	CHECK(hive.Opened == expected);
+}
+
+TEST(KeyCache, MissingKeysAreNotRemembered)
+{
+	COpenLog hive;
+	CreateKeys(hive);
+	CKeyCache cache(8, &hive, GENERIC_READ | GENERIC_WRITE);
+
+	CHECK(!cache.Exists(HKEY_LOCAL_MACHINE, L"Software\\F"));
+	CHECK(cache.TryOpen(HKEY_LOCAL_MACHINE, L"Software\\F") == NULL);
+	CHECK_THROWS(cache.Open(HKEY_LOCAL_MACHINE, L"Software\\F"), ExWin32Error);
+	CHECK(cache.Size() == 0);
+
+	CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\F", GENERIC_READ | GENERIC_WRITE, INVALID_HANDLE_VALUE, &hive);
+	CHECK(cache.Exists(HKEY_LOCAL_MACHINE, L"Software\\F"));
+}
+
+TEST(KeyCache, LeastRecentlyUsedKeyIsClosed)
+{
+	COpenLog hive;
+	CreateKeys(hive);
+	CKeyCache cache(2, &hive);
+
+	std::shared_ptr<CHKey> a = cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A");
+	cache.Open(HKEY_LOCAL_MACHINE, L"Software\\E");
+	cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A");
+	cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A\\D");
+	CHECK(cache.Size() == 2);
+
+	//E was used least recently and is gone, A is still there
+	hive.Opened.clear();
+	CHECK(cache.Open(HKEY_LOCAL_MACHINE, L"Software\\A") == a);
+	cache.Open(HKEY_LOCAL_MACHINE, L"Software\\E");
+	std::vector<std::wstring> expected = { L"Software\\E" };
+	CHECK(hive.Opened == expected);
+
+	//keys that were handed out stay usable after they leave the cache
+	cache.Clear();
+	CHECK(cache.Size() == 0);
+	CHECK(a->SubKeyExists(L"B"));
+}
+
+TEST(KeyCache, InvalidateForgetsTheSubtree)
+{
+	COpenLog hive;
+	CreateKeys(hive);
+	CKeyCache cache(8, &hive, GENERIC_READ | GENERIC_WRITE);
+
+	for (const wchar_t* path : { L"Software\\A", L"Software\\A\\B", L"Software\\A\\B\\C", L"Software\\AB", L"Software\\E" })
+		cache.TryOpen(HKEY_LOCAL_MACHINE, path);
+	CHECK(cache.Size() == 4);
+
+	cache.Open(HKEY_LOCAL_MACHINE, L"Software")->DeleteSubKey(L"A");
+	cache.Invalidate(HKEY_LOCAL_MACHINE, L"software\\a\\");
+	CHECK(cache.Size() == 2);       //Software and Software\E
+	CHECK(!cache.Exists(HKEY_LOCAL_MACHINE, L"Software\\A\\B\\C"));
+	CHECK(cache.Exists(HKEY_LOCAL_MACHINE, L"Software\\E"));
+}
+
+TEST(KeyCache, ConcurrentLookups)
+{
+	CMemRegBackend hive;
+	CreateKeys(hive);
+	CKeyCache cache(3, &hive);
+	const wchar_t* paths[] = { L"Software\\A", L"Software\\A\\B", L"Software\\A\\B\\C", L"Software\\A\\D", L"Software\\E" };
+
+	std::atomic<size_t> wrong{ 0 };
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < 4; t++) {
+		threads.emplace_back([&, t]() {
+			CRandom random(t + 1);
+			for (int i = 0; i < 2000; i++) {
+				const wchar_t* path = paths[random.Next(5)];
+				std::shared_ptr<CHKey> key = cache.Open(HKEY_LOCAL_MACHINE, path);
+				if (key->Path() != std::wstring(L"HKLM\\") + path)
+					wrong++;
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	CHECK(wrong == 0);
+	CHECK(cache.Size() <= 3);
+	CHECK(cache.Hits() + cache.Misses() == 8000);
+}
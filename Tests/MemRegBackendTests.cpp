@@ -0,0 +1,203 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+#include <thread>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const REGSAM ReadWrite = GENERIC_READ | GENERIC_WRITE;
+
+	uint64_t LastWrite(CMemRegBackend& hive, HKEY key)
+	{
+		FILETIME time = {};
+		CHECK(hive.QueryInfoKey(key, NULL, NULL, NULL, NULL, NULL, &time) == ERROR_SUCCESS);
+		return ((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime;
+	}
+
+	//Names and data of the values of a key, in the order of enumeration
+	std::wstring Values(CHKey& key)
+	{
+		std::wstring dump;
+		std::vector<BYTE> buffer;
+		for (const std::wstring& name : key.GetValues()) {
+			CRegValue value = key.GetValue(name, buffer);
+			dump += name + L"=" + std::to_wstring(value.Type()) + L":" +
+				std::wstring(buffer.begin(), buffer.end()) + L";";
+		}
+		return dump;
+	}
+
+	//A key with values a, b and c, and subkeys One and Two
+	CHKey BuildKey(CMemRegBackend& hive)
+	{
+		CHKey key = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Test", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+		key.SetValue(L"a", L"first");
+		key.SetValue(L"b", (DWORD)2);
+		key.SetValue(L"c", L"third");
+		key.CreateSubKey(L"One", ReadWrite).SetValue(L"x", L"1");
+		key.CreateSubKey(L"Two", ReadWrite);
+		return key;
+	}
+}
+
+TEST(MemReg, KeysAndValues)
+{
+	CMemRegBackend hive;
+	CHKey key = BuildKey(hive);
+	key.CreateSubKey(L"alpha", ReadWrite);
+
+	//subkeys are sorted without regard to case, values stay in order of creation
+	std::vector<std::wstring> subKeys = key.GetSubKeys();
+	CHECK(subKeys.size() == 3 && subKeys[0] == L"alpha" && subKeys[1] == L"One" && subKeys[2] == L"Two");
+	CHECK(key.GetValues() == std::vector<std::wstring>({ L"a", L"b", L"c" }));
+	CHECK(key.GetWSValue(L"A") == L"first");
+	CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, L"SOFTWARE\\TEST\\one", INVALID_HANDLE_VALUE, &hive));
+
+	//HKEY_CLASSES_ROOT is HKLM\Software\Classes
+	CHKey::Create(HKEY_CLASSES_ROOT, L"CLSID", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+	CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\Classes\\CLSID", INVALID_HANDLE_VALUE, &hive));
+
+	key.DeleteValue(L"b");
+	CHECK(key.GetValues() == std::vector<std::wstring>({ L"a", L"c" }));
+	//like RegDeleteKey, DeleteKey only deletes keys without subkeys
+	key.CreateSubKey(L"One\\Inner", ReadWrite);
+	CHECK(hive.DeleteKey(key, L"One", INVALID_HANDLE_VALUE) == ERROR_ACCESS_DENIED);
+	CHECK(hive.DeleteKey(key, L"One\\Inner", INVALID_HANDLE_VALUE) == ERROR_SUCCESS);
+	CHECK(hive.DeleteKey(key, L"One", INVALID_HANDLE_VALUE) == ERROR_SUCCESS);
+	CHECK(!key.SubKeyExists(L"One"));
+}
+
+TEST(MemReg, DeletedKeysStopWorking)
+{
+	CMemRegBackend hive;
+	CHKey key = BuildKey(hive);
+	CHKey one = key.OpenSubKey(L"One", ReadWrite);
+	CHKey::DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Test", true, INVALID_HANDLE_VALUE, &hive);
+
+	DWORD type = 0;
+	CHECK(hive.QueryValue(one, L"x", &type, NULL, NULL) == ERROR_KEY_DELETED);
+	CHECK(hive.SetValue(key, L"d", REG_SZ, NULL, 0) == ERROR_KEY_DELETED);
+	CHECK(!CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\Test", INVALID_HANDLE_VALUE, &hive));
+}
+
+TEST(MemReg, CommitKeepsChanges)
+{
+	CMemRegBackend hive;
+	BuildKey(hive);
+	HANDLE transaction = NULL;
+	CHECK(hive.CreateTransaction(&transaction) == ERROR_SUCCESS);
+	{
+		CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Test", ReadWrite, transaction, &hive);
+		key.SetValue(L"d", L"fourth");
+		key.CreateSubKey(L"Three", ReadWrite);
+	}
+	CHECK(hive.CommitTransaction(transaction) == ERROR_SUCCESS);
+	CHECK(hive.CloseTransaction(transaction) == ERROR_SUCCESS);
+
+	CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Test", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	CHECK(key.GetWSValue(L"d") == L"fourth");
+	CHECK(key.SubKeyExists(L"Three"));
+}
+
+TEST(MemReg, RollbackRestoresEverything)
+{
+	CMemRegBackend hive;
+	CHKey key = BuildKey(hive);
+	CHKey one = key.OpenSubKey(L"One");
+	std::wstring values = Values(key);
+	std::vector<std::wstring> subKeys = key.GetSubKeys();
+	uint64_t keyTime = LastWrite(hive, key);
+	uint64_t oneTime = LastWrite(hive, one);
+
+	HANDLE transaction = NULL;
+	CHECK(hive.CreateTransaction(&transaction) == ERROR_SUCCESS);
+	{
+		CHKey changed = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Test", ReadWrite, transaction, &hive);
+		changed.DeleteValue(L"a");
+		changed.SetValue(L"b", L"changed");
+		changed.SetValue(L"d", L"new");
+		changed.DeleteValue(L"c");
+		changed.SetValue(L"a", (DWORD)1);
+		changed.CreateSubKey(L"Three\\Deeper", ReadWrite);
+		changed.OpenSubKey(L"One", ReadWrite).SetValue(L"x", L"changed");
+		changed.DeleteSubKey(L"Two");
+		CHECK(Values(changed) != values);
+	}
+	CHECK(hive.RollbackTransaction(transaction) == ERROR_SUCCESS);
+	CHECK(hive.CloseTransaction(transaction) == ERROR_SUCCESS);
+
+	CHECK(Values(key) == values);
+	CHECK(key.GetSubKeys() == subKeys);
+	CHECK(one.GetWSValue(L"x") == L"1");
+	CHECK(LastWrite(hive, key) == keyTime);
+	CHECK(LastWrite(hive, one) == oneTime);
+}
+
+TEST(MemReg, RollbackOfDeleteTree)
+{
+	CMemRegBackend hive;
+	CHKey key = BuildKey(hive);
+	std::wstring values = Values(key);
+	uint64_t keyTime = LastWrite(hive, key);
+
+	HANDLE transaction = NULL;
+	CHECK(hive.CreateTransaction(&transaction) == ERROR_SUCCESS);
+	{
+		CHKey changed = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Test", ReadWrite, transaction, &hive);
+		CHECK(hive.DeleteTree(changed, NULL) == ERROR_SUCCESS);
+		CHECK(changed.GetValues().empty() && changed.GetSubKeys().empty());
+	}
+	CHECK(hive.RollbackTransaction(transaction) == ERROR_SUCCESS);
+	CHECK(hive.CloseTransaction(transaction) == ERROR_SUCCESS);
+
+	CHECK(Values(key) == values);
+	CHECK(key.GetSubKeys() == std::vector<std::wstring>({ L"One", L"Two" }));
+	CHECK(key.OpenSubKey(L"One").GetWSValue(L"x") == L"1");
+	CHECK(LastWrite(hive, key) == keyTime);
+}
+
+TEST(MemReg, ConcurrentWriters)
+{
+	CMemRegBackend hive;
+	CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Test", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&hive, t] {
+			CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Test", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+			for (int i = 0; i < 250; i++) {
+				CHKey subKey = key.CreateSubKey(std::to_wstring(t) + L"-" + std::to_wstring(i), ReadWrite);
+				subKey.SetValue(L"", (DWORD)i);
+				key.GetSubKeys();
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+
+	CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Test", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	std::vector<std::wstring> subKeys = key.GetSubKeys();
+	CHECK(subKeys.size() == 1000);
+	CHECK(key.OpenSubKey(L"3-249").GetDWValue(L"") == 249);
+}
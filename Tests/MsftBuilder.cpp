@@ -0,0 +1,308 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "MsftBuilder.h"
+#include <cstring>
+
+namespace w32::test
+{
+	static void PutInt(std::vector<BYTE>& buffer, int32_t value)
+	{
+		for (int i = 0; i < 4; i++)
+			buffer.push_back((BYTE)((uint32_t)value >> (8 * i)));
+	}
+
+	static void PutShort(std::vector<BYTE>& buffer, int16_t value)
+	{
+		buffer.push_back((BYTE)value);
+		buffer.push_back((BYTE)((uint16_t)value >> 8));
+	}
+
+	//Records in the name and string segments are padded to 4 bytes
+	static void Pad(std::vector<BYTE>& buffer)
+	{
+		while (buffer.size() % 4 != 0)
+			buffer.push_back('W');
+	}
+
+	static int AddGuid(std::vector<BYTE>& guids, const GUID& guid)
+	{
+		int offset = (int)guids.size();
+		const BYTE* bytes = reinterpret_cast<const BYTE*>(&guid);
+		guids.insert(guids.end(), bytes, bytes + sizeof(GUID));
+		PutInt(guids, -1);                      //href type
+		PutInt(guids, -1);                      //next in hash chain
+		return offset;
+	}
+
+	static int AddName(std::vector<BYTE>& names, const std::string& name)
+	{
+		int offset = (int)names.size();
+		PutInt(names, -1);
+		PutInt(names, -1);
+		PutInt(names, (int)name.size() | 0x3800);
+		names.insert(names.end(), name.begin(), name.end());
+		Pad(names);
+		return offset;
+	}
+
+	static int AddString(std::vector<BYTE>& strings, const std::string& text)
+	{
+		int offset = (int)strings.size();
+		PutShort(strings, (int16_t)text.size());
+		strings.insert(strings.end(), text.begin(), text.end());
+		Pad(strings);
+		return offset;
+	}
+
+	void CMsftBuilder::AddType(TYPEKIND kind, const GUID& guid, const std::string& name, WORD flags,
+		WORD majorVersion, WORD minorVersion)
+	{
+		m_types.push_back({ kind, guid, name, flags, majorVersion, minorVersion, -1 });
+	}
+
+	void CMsftBuilder::AddFunction(MEMBERID memberId, const std::string& name, INVOKEKIND invokeKind,
+		int returnType, const std::string& docString)
+	{
+		std::vector<CFunc>& funcs = m_types.back().Funcs;
+		funcs.push_back({ memberId, name, docString, invokeKind, returnType, (short)(funcs.size() * 8 + 24) });
+	}
+
+	void CMsftBuilder::AddParam(const std::string& name, int dataType, WORD flags)
+	{
+		m_types.back().Funcs.back().Params.push_back({ name, dataType, flags });
+	}
+
+	void CMsftBuilder::AddField(MEMBERID memberId, const std::string& name, int dataType, LONG offset)
+	{
+		m_types.back().Vars.push_back({ memberId, name, VAR_PERINSTANCE, dataType, VT_EMPTY, offset });
+	}
+
+	void CMsftBuilder::AddConstant(MEMBERID memberId, const std::string& name, VARTYPE vt, LONGLONG value)
+	{
+		m_types.back().Vars.push_back({ memberId, name, VAR_CONST, SimpleType(vt), vt, value });
+	}
+
+	void CMsftBuilder::SetAliasType(int dataType)
+	{
+		m_types.back().DataType1 = dataType;
+	}
+
+	int CMsftBuilder::AddTypeDesc(VARTYPE vt, int value)
+	{
+		int offset = (int)m_typeDescs.size();
+		PutShort(m_typeDescs, (int16_t)vt);
+		PutShort(m_typeDescs, 0);
+		PutInt(m_typeDescs, value);
+		return offset;
+	}
+
+	int CMsftBuilder::SimpleType(VARTYPE vt)
+	{
+		return (int)(0x80000000 | (vt << 16) | vt);
+	}
+
+	//The records of the functions and variables, followed by their member IDs, the
+	//offsets of their names and the offsets of their records
+	std::vector<BYTE> CMsftBuilder::MemberBlock(const CType& type, std::vector<BYTE>& names,
+		std::vector<BYTE>& strings, std::vector<BYTE>& custData)
+	{
+		const std::vector<CFunc>& funcs = type.Funcs;
+		const std::vector<CVar>& vars = type.Vars;
+		std::vector<BYTE> records;
+		std::vector<int> ids;
+		std::vector<int> nameOffsets;
+		std::vector<int> recordOffsets;
+		for (size_t i = 0; i < funcs.size(); i++) {
+			const CFunc& func = funcs[i];
+			ids.push_back(func.MemberId);
+			nameOffsets.push_back(i > 0 && funcs[i - 1].Name == func.Name ? -1 : AddName(names, func.Name));
+			recordOffsets.push_back((int)records.size());
+
+			PutInt(records, 0x20 + (int)func.Params.size() * 12);
+			PutInt(records, func.DataType);
+			PutInt(records, 0);                                 //FUNCFLAGS
+			PutShort(records, func.VtableOffset);
+			PutShort(records, 0);
+			PutInt(records, FUNC_PUREVIRTUAL | (func.InvokeKind << 3) | (CC_STDCALL << 8));
+			PutShort(records, (int16_t)func.Params.size());
+			PutShort(records, 0);                               //optional parameters
+			PutInt(records, 0);                                 //help context
+			PutInt(records, func.DocString.empty() ? -1 : AddString(strings, func.DocString));
+			for (const CParam& param : func.Params) {
+				PutInt(records, param.DataType);
+				PutInt(records, AddName(names, param.Name));
+				PutInt(records, param.Flags);
+			}
+		}
+		for (const CVar& var : vars) {
+			ids.push_back(var.MemberId);
+			nameOffsets.push_back(AddName(names, var.Name));
+			recordOffsets.push_back((int)records.size());
+
+			int offset = (int)var.Value;
+			if (var.Kind == VAR_CONST && (var.Value < 0 || var.Value >= 0x04000000 || var.ValueType == VT_I8 ||
+				var.ValueType == VT_UI8 || var.ValueType == VT_CY)) {
+				offset = (int)custData.size();
+				PutShort(custData, (int16_t)var.ValueType);
+				PutInt(custData, (int32_t)var.Value);
+				if (var.ValueType == VT_I8 || var.ValueType == VT_UI8 || var.ValueType == VT_CY)
+					PutInt(custData, (int32_t)(var.Value >> 32));
+				Pad(custData);
+			}
+			else if (var.Kind == VAR_CONST)
+				offset = (int)(0x80000000 | (var.ValueType << 26) | (DWORD)var.Value);
+
+			PutInt(records, 0x1C);
+			PutInt(records, var.DataType);
+			PutInt(records, 0);                                 //VARFLAGS
+			PutShort(records, (int16_t)var.Kind);
+			PutShort(records, 0);
+			PutInt(records, offset);
+			PutInt(records, 0);                                 //help context
+			PutInt(records, -1);                                //doc string
+		}
+
+		std::vector<BYTE> block;
+		PutInt(block, (int)records.size());
+		block.insert(block.end(), records.begin(), records.end());
+		for (const std::vector<int>* column : { &ids, &nameOffsets, &recordOffsets }) {
+			for (int value : *column)
+				PutInt(block, value);
+		}
+		return block;
+	}
+
+	std::vector<BYTE> CMsftBuilder::Build() const
+	{
+		std::vector<BYTE> guids;
+		std::vector<BYTE> names;
+		std::vector<BYTE> strings;
+		int libGuid = AddGuid(guids, Guid);
+		int libName = AddName(names, Name);
+		int doc = AddString(strings, DocString);
+
+		std::vector<int> typeGuids;
+		std::vector<int> typeNames;
+		for (const CType& type : m_types) {
+			typeGuids.push_back(type.Guid == GUID_NULL ? -1 : AddGuid(guids, type.Guid));
+			typeNames.push_back(AddName(names, type.Name));
+		}
+
+		//the member blocks follow the segments; their offsets are patched in below
+		std::vector<BYTE> custData;
+		std::vector<BYTE> members;
+		std::vector<int> memberOffsets;
+		for (const CType& type : m_types) {
+			memberOffsets.push_back((int)members.size());
+			if (type.Funcs.empty() && type.Vars.empty())
+				continue;
+			std::vector<BYTE> block = MemberBlock(type, names, strings, custData);
+			members.insert(members.end(), block.begin(), block.end());
+		}
+
+		std::vector<BYTE> file;
+		int varFlags = 0x40 | SysKind | (HelpDll ? 0x100 : 0);
+		for (int value : { 0x5446534D, 0x00010002, libGuid, (int)LocaleID, (int)LocaleID, varFlags,
+			MajorVersion | (MinorVersion << 16), 8, (int)m_types.size(), doc, 0, 0, 0, 0, libName,
+			-1, -1, 0x20, 0x80, -1, 0 })
+			PutInt(file, value);
+		if (HelpDll)
+			PutInt(file, -1);
+		for (size_t i = 0; i < m_types.size(); i++)
+			PutInt(file, (int)(i * 100));
+
+		//the segment directory, then the segments in the order of their index
+		std::vector<BYTE> typeInfos(m_types.size() * 100);
+		const std::vector<BYTE>* segments[15] = {};
+		segments[0] = &typeInfos;
+		segments[5] = &guids;
+		segments[7] = &names;
+		segments[8] = &strings;
+		segments[9] = m_typeDescs.empty() ? NULL : &m_typeDescs;
+		segments[11] = custData.empty() ? NULL : &custData;
+		int offset = (int)file.size() + 15 * 16;
+		for (const std::vector<BYTE>* segment : segments) {
+			if (segment)
+				offset += (int)segment->size();
+		}
+		int membersOffset = offset;
+
+		typeInfos.clear();
+		for (size_t i = 0; i < m_types.size(); i++) {
+			const CType& type = m_types[i];
+			bool hasMembers = !type.Funcs.empty() || !type.Vars.empty();
+			PutInt(typeInfos, type.Kind | 0x0200);      //kind and alignment
+			PutInt(typeInfos, hasMembers ? membersOffset + memberOffsets[i] : 0);
+			for (int value : { 0, -1, 3, 0 })
+				PutInt(typeInfos, value);
+			PutInt(typeInfos, (int)type.Funcs.size() | ((int)type.Vars.size() << 16));
+			for (int value : { 0, 0, 0, 0 })
+				PutInt(typeInfos, value);
+			PutInt(typeInfos, typeGuids[i]);
+			PutInt(typeInfos, type.Flags);
+			PutInt(typeInfos, typeNames[i]);
+			PutInt(typeInfos, type.MajorVersion | (type.MinorVersion << 16));
+			for (int value : { -1, 0, 0, -1 })
+				PutInt(typeInfos, value);
+			PutShort(typeInfos, 0);
+			PutShort(typeInfos, 28);
+			PutInt(typeInfos, 4);
+			PutInt(typeInfos, type.DataType1);
+			for (int value : { 0, 0, -1 })
+				PutInt(typeInfos, value);
+		}
+
+		offset = (int)file.size() + 15 * 16;
+		for (const std::vector<BYTE>* segment : segments) {
+			PutInt(file, segment ? offset : -1);
+			PutInt(file, segment ? (int)segment->size() : 0);
+			PutInt(file, -1);
+			PutInt(file, 0x0F);
+			if (segment)
+				offset += (int)segment->size();
+		}
+		for (const std::vector<BYTE>* segment : segments) {
+			if (segment)
+				file.insert(file.end(), segment->begin(), segment->end());
+		}
+		file.insert(file.end(), members.begin(), members.end());
+		return file;
+	}
+
+	GUID CMsftBuilder::TestGuid(uint32_t number)
+	{
+		GUID guid = { 0xA0000000, 0, 0x4000, { 0x80, 0, 0, 0, 0, 0, 0, 0 } };
+		for (int i = 0; i < 4; i++)
+			guid.Data4[7 - i] = (BYTE)(number >> (8 * i));
+		return guid;
+	}
+
+	CMsftBuilder CMsftBuilder::Sample()
+	{
+		CMsftBuilder builder;
+		builder.AddType(TKIND_INTERFACE, TestGuid(1), "IFoo", 0x140);
+		builder.AddType(TKIND_DISPATCH, TestGuid(2), "DFoo", 0x1000);
+		builder.AddType(TKIND_COCLASS, TestGuid(3), "Foo", 2, 1, 2);
+		builder.AddType(TKIND_ENUM, GUID_NULL, "EColor", 0, 0, 0);
+		builder.AddType(TKIND_RECORD, TestGuid(4), "SPoint", 0, 0, 0);
+		builder.AddType(TKIND_ALIAS, GUID_NULL, "Handle", 0, 0, 0);
+		builder.AddType(TKIND_INTERFACE, TestGuid(5), "IBar", 0x40);
+		return builder;
+	}
+}
@@ -0,0 +1,124 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#pragma once
+#include <ole2.h>
+#include <string>
+#include <vector>
+
+namespace w32::test
+{
+	/// <summary>
+	/// Writes a small type library in the MSFT format: the header, the type info offsets,
+	/// the segment directory, the type info, GUID, name, string, type description and
+	/// custom data segments, and after them the member block of every type that has
+	/// functions or variables.
+	/// </summary>
+	class CMsftBuilder
+	{
+		struct CParam
+		{
+			std::string Name;
+			int DataType;
+			WORD Flags;
+		};
+
+		struct CFunc
+		{
+			MEMBERID MemberId;
+			std::string Name;
+			std::string DocString;
+			INVOKEKIND InvokeKind;
+			int DataType;
+			short VtableOffset;
+			std::vector<CParam> Params;
+		};
+
+		struct CVar
+		{
+			MEMBERID MemberId;
+			std::string Name;
+			VARKIND Kind;
+			int DataType;
+			VARTYPE ValueType;
+			LONGLONG Value;             //VAR_CONST, else the offset of the field
+		};
+
+		struct CType
+		{
+			TYPEKIND Kind;
+			GUID Guid;
+			std::string Name;
+			WORD Flags;
+			WORD MajorVersion;
+			WORD MinorVersion;
+			int DataType1;
+			std::vector<CFunc> Funcs;
+			std::vector<CVar> Vars;
+		};
+
+		std::vector<CType> m_types;
+		std::vector<BYTE> m_typeDescs;
+
+		static std::vector<BYTE> MemberBlock(const CType& type, std::vector<BYTE>& names,
+			std::vector<BYTE>& strings, std::vector<BYTE>& custData);
+
+	public:
+		GUID Guid = { 0x12345678, 0x1234, 0x4321, { 0xAB, 0xCD, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB } };
+		std::string Name = "TestLib";
+		std::string DocString = "Test library";
+		WORD MajorVersion = 2;
+		WORD MinorVersion = 5;
+		LCID LocaleID = 0x409;
+		SYSKIND SysKind = SYS_WIN64;
+		bool HelpDll = false;
+
+		//A type without a GUID has GUID_NULL
+		void AddType(TYPEKIND kind, const GUID& guid, const std::string& name, WORD flags,
+			WORD majorVersion = 1, WORD minorVersion = 0);
+
+		//Members of the type added last. A function with the name of the one before it
+		//stores no name of its own, the way the accessors of a property do.
+		void AddFunction(MEMBERID memberId, const std::string& name, INVOKEKIND invokeKind,
+			int returnType, const std::string& docString = "");
+		void AddParam(const std::string& name, int dataType, WORD flags = PARAMFLAG_FIN);
+		void AddField(MEMBERID memberId, const std::string& name, int dataType, LONG offset);
+
+		//Values that fit in 26 bits are stored in the variable record, others in the
+		//custom data
+		void AddConstant(MEMBERID memberId, const std::string& name, VARTYPE vt, LONGLONG value);
+
+		//Aliased type of the type added last
+		void SetAliasType(int dataType);
+
+		//A type description for VT_PTR, VT_SAFEARRAY or VT_USERDEFINED; returns the data
+		//type that refers to it
+		int AddTypeDesc(VARTYPE vt, int value);
+
+		std::vector<BYTE> Build() const;
+
+		//The data type of a simple VARTYPE, the way it is stored in records
+		static int SimpleType(VARTYPE vt);
+
+		//A GUID that differs from the others in its last bytes
+		static GUID TestGuid(uint32_t number);
+
+		//A library with one type of every kind that CTlbInfo lists and a few others:
+		//2 interfaces, a dispinterface, a coclass, an enum, a record and an alias
+		static CMsftBuilder Sample();
+	};
+}
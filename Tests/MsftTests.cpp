@@ -0,0 +1,130 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "MsftBuilder.h"
+#include "MsftTypeLib.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	//Open a library and dump everything the parser offers. The dump is empty if the
+	//file is not an MSFT library; a damaged library throws.
+	std::wstring DumpLibrary(const std::wstring& path)
+	{
+		std::unique_ptr<CMsftTypeLib> lib = CMsftTypeLib::TryOpen(path);
+		if (!lib)
+			return L"";
+		CTlbInfo info;
+		lib->Fill(info);
+		std::wstring dump = GuidText(info.Guid) + L" " + lib->Name() + L" " + lib->DocString() + L" " +
+			std::to_wstring(info.MajorVersion) + L"." + std::to_wstring(info.MinorVersion) + L" " +
+			std::to_wstring(info.LocaleID) + L" " + std::to_wstring(info.SysKind) + L" " +
+			std::to_wstring(info.Flags) + L"\n";
+		size_t kinds[TKIND_MAX] = {};
+		for (size_t i = 0; i < lib->TypeCount(); i++) {
+			CTlbTypeEntry type = lib->Type(i);
+			CHECK(type.Kind >= TKIND_ENUM && type.Kind < TKIND_MAX);
+			kinds[type.Kind]++;
+			dump += std::to_wstring(type.Kind) + L" " + type.Name + L" " + GuidText(type.Guid) + L" " +
+				std::to_wstring(type.Flags) + L" " + std::to_wstring(type.MajorVersion) + L"." +
+				std::to_wstring(type.MinorVersion) + L"\n";
+		}
+		//Fill lists the types that the entries have
+		CHECK(info.CoClasses.size() == kinds[TKIND_COCLASS]);
+		CHECK(info.DispInterfaces.size() == kinds[TKIND_DISPATCH]);
+		CHECK(info.Interfaces.size() == kinds[TKIND_INTERFACE]);
+		return dump;
+	}
+}
+
+TEST(Msft, ReadsLibrary)
+{
+	CTempDir dir;
+	CMsftBuilder builder = CMsftBuilder::Sample();
+	WriteBytes(dir.File(L"a.tlb"), builder.Build());
+
+	std::unique_ptr<CMsftTypeLib> lib = CMsftTypeLib::TryOpen(dir.File(L"a.tlb"));
+	CHECK(lib);
+	CHECK(lib->Guid() == builder.Guid);
+	CHECK(lib->Name() == L"TestLib");
+	CHECK(lib->DocString() == L"Test library");
+	CHECK(lib->MajorVersion() == 2 && lib->MinorVersion() == 5);
+	CHECK(lib->LocaleID() == 0x409);
+	CHECK(lib->SysKind() == SYS_WIN64);
+	CHECK(lib->TypeCount() == 7);
+
+	CTlbTypeEntry coClass = lib->Type(2);
+	CHECK(coClass.Kind == TKIND_COCLASS);
+	CHECK(coClass.Name == L"Foo");
+	CHECK(coClass.Guid == CMsftBuilder::TestGuid(3));
+	CHECK(coClass.Flags == 2);
+	CHECK(coClass.MajorVersion == 1 && coClass.MinorVersion == 2);
+	CHECK(lib->Type(3).Guid == GUID_NULL);
+
+	CTlbInfo info;
+	lib->Fill(info);
+	CHECK(info.Interfaces.size() == 2);
+	CHECK(info.DispInterfaces.size() == 1);
+	CHECK(info.CoClasses.size() == 1 && info.CoClasses[0] == CMsftBuilder::TestGuid(3));
+}
+
+TEST(Msft, ReadsHelpDllAndEmptyLibrary)
+{
+	CTempDir dir;
+	CMsftBuilder builder = CMsftBuilder::Sample();
+	builder.HelpDll = true;
+	builder.SysKind = SYS_WIN32;
+	WriteBytes(dir.File(L"help.tlb"), builder.Build());
+	std::unique_ptr<CMsftTypeLib> lib = CMsftTypeLib::TryOpen(dir.File(L"help.tlb"));
+	CHECK(lib && lib->SysKind() == SYS_WIN32 && lib->TypeCount() == 7);
+	CHECK(lib->Type(6).Name == L"IBar");
+
+	WriteBytes(dir.File(L"empty.tlb"), CMsftBuilder().Build());
+	lib = CMsftTypeLib::TryOpen(dir.File(L"empty.tlb"));
+	CHECK(lib && lib->TypeCount() == 0);
+}
+
+TEST(Msft, OtherFormatsAreNotMsft)
+{
+	CTempDir dir;
+	std::vector<BYTE> sltg = { 'S', 'L', 'T', 'G' };
+	sltg.resize(200);
+	WriteBytes(dir.File(L"sltg.tlb"), sltg);
+	CHECK(!CMsftTypeLib::TryOpen(dir.File(L"sltg.tlb")));
+	CHECK_THROWS(CMsftTypeLib::TryOpen(dir.File(L"missing.tlb")), AppException);
+}
+
+TEST(Msft, DamagedLibrary)
+{
+	CTempDir dir;
+	std::vector<BYTE> bytes = CMsftBuilder::Sample().Build();
+	CDamageCheck check;
+	check.Read = DumpLibrary;
+	check.Mutations = 1000;
+	check.Seed = 17;
+	check.Run(bytes, dir);
+
+	//a library that is cut inside a segment is damaged, not something else
+	std::wstring path = dir.File(L"truncated.tlb");
+	WriteBytes(path, std::vector<BYTE>(bytes.begin(), bytes.begin() + 400));
+	CHECK_THROWS(CMsftTypeLib::TryOpen(path), Win32Exception);
+}
@@ -0,0 +1,113 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "NameIndex.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+
+using namespace w32;
+using namespace w32::test;
+
+TEST(NameIndex, AddAndFind)
+{
+	CNameIndex index;
+	CHECK(index.Count() == 0);
+	CHECK(index.Find(L"a") == CNameIndex::npos);
+
+	size_t clsid = index.Add(L"CLSID");
+	size_t empty = index.Add(L"");
+	CHECK(index.Add(L"clsid") == clsid);
+	CHECK(index.Add(L"") == empty);
+	CHECK(index.Count() == 2);
+	CHECK(index.Find(L"ClsId") == clsid);
+	CHECK(index.Contains(L""));
+	CHECK(!index.Contains(L"CLSI"));
+	CHECK(!index.Contains(L"CLSID2"));
+	CHECK(index.Name(clsid) == L"CLSID");
+
+	index.Clear();
+	CHECK(index.Count() == 0);
+	CHECK(!index.Contains(L"CLSID"));
+	CHECK(index.Add(L"clsid") == 0);
+	CHECK(index.Name(0) == L"clsid");
+}
+
+TEST(NameIndex, ManyNames)
+{
+	CNameIndex index;
+	CNameIndex reserved;
+	reserved.Reserve(20000);
+	CRandom random(3);
+	std::vector<std::wstring> names;
+	for (int i = 0; i < 20000; i++) {
+		GUID guid;
+		guid.Data1 = random.Next(0xFFFFFFFF);
+		guid.Data2 = (unsigned short)i;
+		guid.Data3 = (unsigned short)(i >> 16);
+		for (unsigned char& b : guid.Data4)
+			b = (unsigned char)random.Next(256);
+		names.push_back(GuidText(guid));
+		CHECK(index.Add(names.back()) == (size_t)i);
+		CHECK(reserved.Add(names.back()) == (size_t)i);
+	}
+	CHECK(index.Count() == names.size());
+	for (size_t i = 0; i < names.size(); i++) {
+		std::wstring lower = names[i];
+		std::transform(lower.begin(), lower.end(), lower.begin(), towlower);
+		CHECK(index.Find(lower) == i);
+		CHECK(reserved.Find(names[i]) == i);
+		CHECK(index.Name(i) == names[i]);
+		lower[1] = L'x';
+		CHECK(!index.Contains(lower));
+	}
+}
+
+TEST(NameIndex, KeyIndexes)
+{
+	const REGSAM readWrite = GENERIC_READ | GENERIC_WRITE;
+	CMemRegBackend hive;
+	CHKey key = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Index", readWrite, INVALID_HANDLE_VALUE, &hive);
+	key.CreateSubKey(L"One", readWrite);
+	key.SetValue(L"a", L"1");
+	CHECK(key.SubKeyIndex().Count() == 1 && key.SubKeyIndex().Contains(L"ONE"));
+	CHECK(key.ValueIndex().Count() == 1 && key.ValueIndex().Contains(L"A"));
+
+	//changes through the key are in the index
+	key.CreateSubKey(L"\\Two\\Deeper", readWrite);
+	key.SetValue(L"b", L"2");
+	CHECK(key.SubKeyIndex().Count() == 2 && key.SubKeyIndex().Contains(L"two"));
+	CHECK(!key.SubKeyIndex().Contains(L"Deeper"));
+	CHECK(key.ValueIndex().Contains(L"b"));
+
+	//changes through another key are not, but SubKeyExists sees them
+	CHKey other = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Index", readWrite, INVALID_HANDLE_VALUE, &hive);
+	other.CreateSubKey(L"Three", readWrite);
+	other.DeleteSubKey(L"One");
+	CHECK(key.SubKeyExists(L"Three"));
+	CHECK(!key.SubKeyIndex().Contains(L"Three"));
+	CHECK(!key.SubKeyExists(L"One"));
+	CHECK(key.SubKeyIndex().Contains(L"One"));
+	CHECK(key.SubKeyExists(L"Two\\Deeper"));
+
+	//deleting through the key starts a new index
+	key.DeleteSubKey(L"Two");
+	key.DeleteValue(L"a");
+	CHECK(key.SubKeyIndex().Count() == 1 && key.SubKeyIndex().Contains(L"Three"));
+	CHECK(key.ValueIndex().Count() == 1 && key.ValueIndex().Contains(L"b"));
+}
@@ -0,0 +1,125 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "PathTrie.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include <thread>
+
+using namespace w32;
+using namespace w32::test;
+
+TEST(PathTrie, SegmentsAndStrings)
+{
+	CKeyPath root = CKeyPath::Root(L"HKLM");
+	CKeyPath path = root.Append(L"\\Software\\\\Trie\\Segments\\");
+	CHECK(path.Depth() == 4);
+	CHECK(path.Name() == L"Segments");
+	CHECK(path.ToString() == L"HKLM\\Software\\Trie\\Segments");
+	CHECK(path.ToString(2) == L"Trie\\Segments");
+	CHECK(path.ToString(0).empty());
+	CHECK(path.ToString(10) == path.ToString());
+	CHECK(root.Append(L"").ToString() == L"HKLM");
+
+	CKeyPath empty;
+	CHECK(empty.IsEmpty() && empty.Depth() == 0 && empty.ToString().empty());
+	CHECK(empty.Append(L"a\\b").ToString() == L"a\\b");
+}
+
+TEST(PathTrie, PathsAreSharedAndReleased)
+{
+	size_t before = CKeyPath::NodeCount();
+	{
+		CKeyPath root = CKeyPath::Root(L"SharedRoot");
+		CKeyPath a = root.Append(L"A\\B\\C");
+		CHECK(CKeyPath::NodeCount() == before + 4);
+
+		//the same path again, copies and assignments add no nodes
+		CKeyPath b = root.Append(L"A").Append(L"B\\C");
+		CKeyPath c = a;
+		CKeyPath d;
+		d = b;
+		d = std::move(c);
+		CHECK(CKeyPath::NodeCount() == before + 4);
+
+		//a different spelling is a different node, a sibling shares the parents
+		CKeyPath upper = root.Append(L"A\\B\\c");
+		CKeyPath sibling = root.Append(L"A\\D");
+		CHECK(CKeyPath::NodeCount() == before + 6);
+		CHECK(upper.ToString() == L"SharedRoot\\A\\B\\c");
+
+		//releasing a leaf removes only the leaf
+		upper = CKeyPath();
+		CHECK(CKeyPath::NodeCount() == before + 5);
+
+		//the parents stay as long as a path below them does
+		root = CKeyPath();
+		a = CKeyPath();
+		b = CKeyPath();
+		CHECK(CKeyPath::NodeCount() == before + 5);
+		d = CKeyPath();
+		CHECK(CKeyPath::NodeCount() == before + 3);
+		CHECK(sibling.ToString() == L"SharedRoot\\A\\D");
+	}
+	CHECK(CKeyPath::NodeCount() == before);
+}
+
+TEST(PathTrie, ConcurrentUse)
+{
+	size_t before = CKeyPath::NodeCount();
+	CKeyPath root = CKeyPath::Root(L"ConcurrentRoot");
+	std::atomic<size_t> wrong{ 0 };
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; t < 4; t++) {
+		threads.emplace_back([&, t]() {
+			CRandom random(t + 1);
+			std::vector<CKeyPath> held(16);
+			for (int i = 0; i < 20000; i++) {
+				std::wstring relPath = L"K" + std::to_wstring(random.Next(4)) + L"\\K" + std::to_wstring(random.Next(4));
+				CKeyPath& slot = held[random.Next(16)];
+				if (random.Next(2))
+					slot = root.Append(relPath);
+				else
+					slot = held[random.Next(16)];
+				if (!slot.IsEmpty() && slot.ToString().compare(0, 15, L"ConcurrentRoot\\") != 0)
+					wrong++;
+			}
+		});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	CHECK(wrong == 0);
+	CHECK(CKeyPath::NodeCount() == before + 1);
+	root = CKeyPath();
+	CHECK(CKeyPath::NodeCount() == before);
+}
+
+TEST(PathTrie, KeysReleaseTheirPaths)
+{
+	size_t before = CKeyPath::NodeCount();
+	{
+		CMemRegBackend hive;
+		CHKey key = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Trie", GENERIC_READ | GENERIC_WRITE, INVALID_HANDLE_VALUE, &hive);
+		CHKey subKey = key.CreateSubKey(L"Sub");
+		CHECK(subKey.Path() == L"HKLM\\Software\\Trie\\Sub");
+		CHECK(subKey.RelPath() == L"Sub");
+		CHECK(CKeyPath::NodeCount() > before);
+	}
+	CHECK(CKeyPath::NodeCount() == before);
+}
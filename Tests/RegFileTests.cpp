@@ -0,0 +1,259 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "RegFile.h"
+#include "RegSnapshotFile.h"
+#include "Exception.h"
+#include <string_view>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	std::vector<BYTE> Bytes(std::string_view text)
+	{
+		return std::vector<BYTE>(text.begin(), text.end());
+	}
+
+	//Values of every kind that the exporter writes differently
+	void BuildTree(CMemRegBackend& hive)
+	{
+		CHKey clsid = CHKey::Create(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ | GENERIC_WRITE,
+			INVALID_HANDLE_VALUE, &hive);
+		for (int i = 0; i < 20; i++) {
+			CHKey server = clsid.CreateSubKey(L"{" + std::to_wstring(i) + L"}", GENERIC_READ | GENERIC_WRITE);
+			server.SetValue(L"", L"x \"quoted\" C:\\path\\");
+			server.SetValue(L"App\"ID", (DWORD)i);
+			BYTE binary[100];
+			for (int k = 0; k < 100; k++)
+				binary[k] = (BYTE)(k * i);
+			server.SetValue(L"Binary", REG_BINARY, binary, sizeof(binary));
+			server.SetValue(L"Expand", REG_EXPAND_SZ, reinterpret_cast<const BYTE*>(L"%SystemRoot%"),
+				13 * sizeof(wchar_t));
+			server.SetValue(L"Lines", L"first\r\nsecond\n");
+			server.CreateSubKey(L"InprocServer32", GENERIC_READ | GENERIC_WRITE).SetValue(L"", L"server.dll");
+		}
+	}
+
+	//Number of differences between the CLSID trees of two backends
+	size_t Compare(CMemRegBackend& left, CMemRegBackend& right, const CTempDir& dir)
+	{
+		CMemRegBackend* hives[] = { &left, &right };
+		std::wstring files[] = { dir.File(L"left.snap"), dir.File(L"right.snap") };
+		for (int i = 0; i < 2; i++) {
+			CRegSnapshotWriter writer(files[i]);
+			CHKey clsid = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ, INVALID_HANDLE_VALUE, hives[i]);
+			writer.Add(clsid);
+			writer.Save();
+		}
+
+		struct CIgnore : ISnapshotDiff
+		{
+			void OnKeyAdded(std::wstring_view path) override {}
+			void OnKeyRemoved(std::wstring_view path) override {}
+			void OnValueChanged(std::wstring_view path, const CSnapshotValue* before,
+				const CSnapshotValue* after) override {}
+		} ignore;
+		return DiffSnapshots(CRegSnapshotFile(files[0]), CRegSnapshotFile(files[1]), ignore);
+	}
+
+	//Check that every key and value of part is in whole, the same
+	void CheckPartOf(CHKey& part, CHKey& whole)
+	{
+		std::vector<BYTE> partBuffer;
+		std::vector<BYTE> wholeBuffer;
+		for (const std::wstring& name : part.GetValues()) {
+			CRegValue partValue = part.GetValue(name, partBuffer);
+			CRegValue wholeValue = whole.GetValue(name, wholeBuffer);
+			CHECK(partValue.Type() == wholeValue.Type());
+			CHECK(partBuffer == wholeBuffer);
+		}
+		for (const std::wstring& name : part.GetSubKeys()) {
+			CHKey partKey = part.OpenSubKey(name);
+			CHKey wholeKey = whole.OpenSubKey(name);
+			CheckPartOf(partKey, wholeKey);
+		}
+	}
+
+	//Text of a file that the exporter wrote: UTF-16 with a byte order mark
+	std::wstring ReadExport(const std::wstring& fileName)
+	{
+		std::vector<BYTE> bytes = ReadBytes(fileName);
+		std::wstring text;
+		for (size_t i = 2; i + 1 < bytes.size(); i += 2)
+			text += (wchar_t)(bytes[i] | (bytes[i + 1] << 8));
+		return text;
+	}
+}
+
+TEST(RegFile, ExportImportRoundTrip)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildTree(hive);
+	{
+		CRegFileExporter exporter(dir.File(L"out.reg"));
+		CHKey clsid = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+		exporter.Export(clsid);
+		exporter.Close();
+	}
+
+	CMemRegBackend imported;
+	CRegFileImporter importer(&imported);
+	importer.SetBatchSize(7);
+	importer.Import(dir.File(L"out.reg"));
+	CHECK(importer.KeyCount() == 41);
+	CHECK(importer.ValueCount() == 20 * 6);
+	CHECK(Compare(hive, imported, dir) == 0);
+}
+
+TEST(RegFile, LineBreaksAreExportedAsHex)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	CHKey key = CHKey::Create(HKEY_CLASSES_ROOT, L"Test", GENERIC_READ | GENERIC_WRITE,
+		INVALID_HANDLE_VALUE, &hive);
+	key.SetValue(L"Lines", L"a\r\nb");
+	key.SetValue(L"Plain", L"a b");
+	{
+		CRegFileExporter exporter(dir.File(L"out.reg"));
+		exporter.Export(key);
+	}
+
+	std::wstring text = ReadExport(dir.File(L"out.reg"));
+	CHECK(text.find(L"\"Lines\"=hex(1):61,00") != std::wstring::npos);
+	CHECK(text.find(L"\"Plain\"=\"a b\"") != std::wstring::npos);
+}
+
+TEST(RegFile, Regedit4IsAnsi)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"ansi.reg"), Bytes("REGEDIT4\r\n\r\n[HKEY_CLASSES_ROOT\\X]\r\n\"U\"=\"caf\xE9 \x80\"\r\n"));
+	WriteBytes(dir.File(L"utf8.reg"), Bytes("\xEF\xBB\xBFREGEDIT4\n[HKEY_CLASSES_ROOT\\Y]\n\"U\"=\"caf\xC3\xA9\"\n"));
+
+	CMemRegBackend hive;
+	CRegFileImporter importer(&hive);
+	importer.Import(dir.File(L"ansi.reg"));
+	importer.Import(dir.File(L"utf8.reg"));
+	CHECK(CHKey::Open(HKEY_CLASSES_ROOT, L"X", GENERIC_READ, INVALID_HANDLE_VALUE, &hive).GetWSValue(L"U") ==
+		L"caf\u00E9 \u20AC");
+	CHECK(CHKey::Open(HKEY_CLASSES_ROOT, L"Y", GENERIC_READ, INVALID_HANDLE_VALUE, &hive).GetWSValue(L"U") ==
+		L"caf\u00E9");
+}
+
+TEST(RegFile, HexData)
+{
+	CTempDir dir;
+	//long enough for the 8 byte steps, with a continuation, spaces and upper case
+	WriteBytes(dir.File(L"hex.reg"), Bytes(
+		"REGEDIT4\n[HKCR\\X]\n"
+		"\"Long\"=hex:00,01,02,03,04,05,06,07,08,09,0a,0b,0c,0d,0e,0f,10,11,12,13,\\\n"
+		"  14,15,16,17,18,19,1A,1B,1C,1D,1E,1F,ff\n"
+		"\"Spaced\"=hex: 01 , 02,03 ,04\n"
+		"\"Trailing\"=hex:01,02,\n"
+		"\"Empty\"=hex:\n"
+		"\"Typed\"=hex(b):2a,00,00,00,00,00,00,00\n"));
+
+	CMemRegBackend hive;
+	CRegFileImporter(&hive).Import(dir.File(L"hex.reg"));
+	CHKey key = CHKey::Open(HKEY_CLASSES_ROOT, L"X", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	std::vector<BYTE> buffer;
+	std::span<const BYTE> data = key.GetValue(L"Long", buffer).Binary();
+	CHECK(data.size() == 33);
+	for (size_t i = 0; i < 32; i++)
+		CHECK(data[i] == i);
+	CHECK(data[32] == 0xFF);
+	CHECK(key.GetValue(L"Spaced", buffer).Binary().size() == 4 && buffer[3] == 4);
+	CHECK(key.GetValue(L"Trailing", buffer).Binary().size() == 2);
+	CHECK(key.GetValue(L"Empty", buffer).Binary().size() == 0);
+	CHECK(key.GetValueType(L"Typed") == REG_QWORD && key.GetQWValue(L"Typed") == 42);
+}
+
+TEST(RegFile, SyntaxErrors)
+{
+	CTempDir dir;
+	const char* files[] = {
+		"not a registry file\n",
+		"REGEDIT4\n\"a\"=dword:1\n",
+		"REGEDIT4\n[HKCR\\X]\n\"a\"=dword:123456789\n",
+		"REGEDIT4\n[HKCR\\X]\n\"a\"=hex:0g\n",
+		"REGEDIT4\n[HKCR\\X]\n\"a\"=hex:012\n",
+		"REGEDIT4\n[HKCR\\X]\n\"a\"=hex:01,02,\\\n",
+		"REGEDIT4\n[HKCR\\X]\n\"a\"=\"unterminated\n",
+		"REGEDIT4\n[HKCR\\X\n",
+		"REGEDIT4\n[NOWHERE\\X]\n",
+		"REGEDIT4\n[-HKCR]\n" };
+	CMemRegBackend hive;
+	for (const char* text : files) {
+		WriteBytes(dir.File(L"bad.reg"), Bytes(text));
+		CHECK_THROWS(CRegFileImporter(&hive).Import(dir.File(L"bad.reg")), AppException);
+	}
+
+	//the message has the line
+	WriteBytes(dir.File(L"bad.reg"), Bytes("REGEDIT4\n[HKCR\\X]\n\n\"a\"=bogus\n"));
+	std::string message;
+	try {
+		CRegFileImporter(&hive).Import(dir.File(L"bad.reg"));
+	}
+	catch (const AppException& ex) {
+		message = ex.what();
+	}
+	CHECK(message.find("(4)") != std::string::npos);
+}
+
+TEST(RegFile, TruncatedFile)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildTree(hive);
+	{
+		CRegFileExporter exporter(dir.File(L"out.reg"));
+		CHKey clsid = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+		exporter.Export(clsid);
+	}
+	std::vector<BYTE> bytes = ReadBytes(dir.File(L"out.reg"));
+
+	//A file that is cut after a line imports the values that are complete, or stops
+	//with an error on a value that was continued on the next line; never a part of a value
+	CHKey clsid = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	std::wstring path = dir.File(L"truncated.reg");
+	size_t rejected = 0;
+	for (size_t size = 2; size < bytes.size(); size += 2) {
+		if (bytes[size - 2] != '\n' || bytes[size - 1] != 0)
+			continue;
+		WriteBytes(path, std::vector<BYTE>(bytes.begin(), bytes.begin() + size));
+		CMemRegBackend imported;
+		try {
+			CRegFileImporter(&imported).Import(path);
+		}
+		catch (const AppException&) {
+			CHECK(bytes[size - 6] == '\\');
+			rejected++;
+			continue;
+		}
+		if (CHKey::Exists(HKEY_CLASSES_ROOT, L"CLSID", INVALID_HANDLE_VALUE, &imported)) {
+			CHKey part = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ, INVALID_HANDLE_VALUE, &imported);
+			CheckPartOf(part, clsid);
+		}
+	}
+	CHECK(rejected > 0);
+}
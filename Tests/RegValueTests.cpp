@@ -0,0 +1,185 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "RegValue.h"
+#include "KeySnapshot.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	std::vector<std::wstring> Strings(const CMultiString& value)
+	{
+		std::vector<std::wstring> strings;
+		for (std::wstring_view text : value)
+			strings.push_back(std::wstring(text));
+		return strings;
+	}
+
+	CRegValue MakeValue(DWORD type, const std::vector<wchar_t>& chars)
+	{
+		return CRegValue(type, (const BYTE*)chars.data(), (DWORD)(chars.size() * sizeof(wchar_t)));
+	}
+
+	//Records every call as one line
+	struct CRecordingVisitor : IValueVisitor
+	{
+		std::vector<std::wstring> Calls;
+
+		void OnString(std::wstring_view name, std::wstring_view value, bool expand) override
+		{
+			Calls.push_back(std::wstring(name) + (expand ? L" expand " : L" string ") + std::wstring(value));
+		}
+
+		void OnDWord(std::wstring_view name, DWORD value) override
+		{
+			Calls.push_back(std::wstring(name) + L" dword " + std::to_wstring(value));
+		}
+
+		void OnQWord(std::wstring_view name, ULONGLONG value) override
+		{
+			Calls.push_back(std::wstring(name) + L" qword " + std::to_wstring(value));
+		}
+
+		void OnMultiString(std::wstring_view name, const CMultiString& value) override
+		{
+			Calls.push_back(std::wstring(name) + L" multi " + std::to_wstring(value.Count()));
+		}
+
+		void OnBinary(std::wstring_view name, DWORD type, std::span<const BYTE> value) override
+		{
+			Calls.push_back(std::wstring(name) + L" binary " + std::to_wstring(type) + L" " + std::to_wstring(value.size()));
+		}
+	};
+}
+
+TEST(RegValue, Strings)
+{
+	std::vector<wchar_t> terminated = { L'a', L'b', 0 };
+	std::vector<wchar_t> unterminated = { L'a', L'b' };
+	std::vector<wchar_t> padded = { L'a', L'b', 0, 0, 0 };
+	for (const std::vector<wchar_t>* chars : { &terminated, &unterminated, &padded }) {
+		CHECK(MakeValue(REG_SZ, *chars).String() == L"ab");
+		CHECK(MakeValue(REG_EXPAND_SZ, *chars).String() == L"ab");
+	}
+	CHECK(CRegValue(REG_SZ, NULL, 0).String().empty());
+	CHECK_THROWS(MakeValue(REG_MULTI_SZ, terminated).String(), ExWin32Error);
+	CHECK_THROWS(MakeValue(REG_SZ, terminated).DWord(), ExWin32Error);
+}
+
+TEST(RegValue, Numbers)
+{
+	DWORD dword = 0x12345678;
+	CHECK(CRegValue(REG_DWORD, (const BYTE*)&dword, 4).DWord() == 0x12345678);
+	CHECK(CRegValue(REG_DWORD_BIG_ENDIAN, (const BYTE*)&dword, 4).DWord() == 0x78563412);
+	CHECK_THROWS(CRegValue(REG_DWORD, (const BYTE*)&dword, 2).DWord(), ExWin32Error);
+	CHECK_THROWS(CRegValue(REG_DWORD, (const BYTE*)&dword, 4).QWord(), ExWin32Error);
+
+	ULONGLONG qword = 0x123456789ABCDEF0ull;
+	CHECK(CRegValue(REG_QWORD, (const BYTE*)&qword, 8).QWord() == qword);
+	CHECK_THROWS(CRegValue(REG_QWORD, (const BYTE*)&qword, 4).QWord(), ExWin32Error);
+	CHECK_THROWS(CRegValue(REG_BINARY, (const BYTE*)&qword, 8).QWord(), ExWin32Error);
+	CHECK(CRegValue(REG_BINARY, (const BYTE*)&qword, 8).Binary().size() == 8);
+}
+
+TEST(RegValue, MultiStrings)
+{
+	std::vector<wchar_t> regular = { L'a', 0, L'b', L'c', 0, 0 };
+	std::vector<wchar_t> unterminated = { L'a', 0, L'b', L'c' };
+	std::vector<wchar_t> stopsAtEmpty = { L'a', 0, 0, L'x', 0, 0 };
+	std::vector<wchar_t> empty = { 0 };
+	CHECK(Strings(MakeValue(REG_MULTI_SZ, regular).MultiString()) == std::vector<std::wstring>({ L"a", L"bc" }));
+	CHECK(Strings(MakeValue(REG_MULTI_SZ, unterminated).MultiString()) == std::vector<std::wstring>({ L"a", L"bc" }));
+	CHECK(MakeValue(REG_MULTI_SZ, stopsAtEmpty).MultiString().Count() == 1);
+	CHECK(MakeValue(REG_MULTI_SZ, empty).MultiString().Count() == 0);
+	CHECK(CRegValue(REG_MULTI_SZ, NULL, 0).MultiString().Count() == 0);
+	CHECK_THROWS(MakeValue(REG_SZ, regular).MultiString(), ExWin32Error);
+
+	//the strings point into the data
+	CMultiString strings = MakeValue(REG_MULTI_SZ, regular).MultiString();
+	CHECK((*++strings.begin()).data() == regular.data() + 2);
+}
+
+TEST(RegValue, VisitorGetsTheRightType)
+{
+	DWORD dword = 5;
+	ULONGLONG qword = 6;
+	std::vector<wchar_t> text = { L'x', 0 };
+	std::vector<wchar_t> multi = { L'x', 0, L'y', 0, 0 };
+	CRecordingVisitor visitor;
+	VisitValue(L"s", MakeValue(REG_SZ, text), visitor);
+	VisitValue(L"e", MakeValue(REG_EXPAND_SZ, text), visitor);
+	VisitValue(L"d", CRegValue(REG_DWORD, (const BYTE*)&dword, 4), visitor);
+	VisitValue(L"q", CRegValue(REG_QWORD, (const BYTE*)&qword, 8), visitor);
+	VisitValue(L"m", MakeValue(REG_MULTI_SZ, multi), visitor);
+	VisitValue(L"b", CRegValue(REG_BINARY, (const BYTE*)&qword, 3), visitor);
+	VisitValue(L"short", CRegValue(REG_DWORD, (const BYTE*)&dword, 3), visitor);
+	CHECK(visitor.Calls == std::vector<std::wstring>({
+		L"s string x", L"e expand x", L"d dword 5", L"q qword 6", L"m multi 2",
+		L"b binary 3 3", L"short binary 4 3" }));
+}
+
+TEST(RegValue, KeysAndSnapshots)
+{
+	CMemRegBackend hive;
+	CHKey key = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Values", GENERIC_READ | GENERIC_WRITE, INVALID_HANDLE_VALUE, &hive);
+	std::vector<wchar_t> multi = { L'o', L'n', L'e', 0, L't', L'w', L'o', 0, 0 };
+	ULONGLONG qword = 1ull << 40;
+	key.SetValue(L"", L"default");
+	key.SetValue(L"Number", (DWORD)42);
+	key.SetValue(L"Big", REG_QWORD, (const BYTE*)&qword, 8);
+	key.SetValue(L"List", REG_MULTI_SZ, (const BYTE*)multi.data(), (DWORD)(multi.size() * sizeof(wchar_t)));
+
+	//one buffer for all values, which stops growing once the largest one fits
+	std::vector<BYTE> buffer;
+	CHECK(key.GetValue(L"", buffer).String() == L"default");
+	CHECK(key.GetValue(L"List", buffer).Type() == REG_MULTI_SZ);
+	const BYTE* data = buffer.data();
+	CHECK(key.GetValue(L"number", buffer).DWord() == 42);
+	CHECK(key.GetValue(L"Big", buffer).QWord() == qword);
+	CHECK(Strings(key.GetValue(L"List", buffer).MultiString()) == std::vector<std::wstring>({ L"one", L"two" }));
+	CHECK(buffer.data() == data);
+	CHECK_THROWS(key.GetValue(L"Missing", buffer), ExWin32Error);
+	CHECK(key.GetQWValue(L"Big") == qword);
+	CHECK(key.GetValueType(L"List") == REG_MULTI_SZ);
+
+	CKeySnapshot snapshot = key.Snapshot();
+	CHECK(snapshot.Count() == 4);
+	CHECK(snapshot.Find(L"") == 0 && snapshot.WSValue(0) == L"default");
+	CHECK(snapshot.DWValue(snapshot.Find(L"NUMBER")) == 42);
+	CHECK(snapshot.Value(snapshot.Find(L"big")).QWord() == qword);
+	CHECK(snapshot.Find(L"Missing") == CKeySnapshot::npos);
+	CHECK_THROWS(snapshot.DWValue(0), ExWin32Error);
+	CRecordingVisitor visitor;
+	snapshot.Visit(visitor);
+	CHECK(visitor.Calls == std::vector<std::wstring>({
+		L" string default", L"Number dword 42", L"Big qword 1099511627776", L"List multi 2" }));
+
+	//a recapture replaces what the snapshot held
+	key.DeleteValue(L"List");
+	key.SetValue(L"Number", (DWORD)43);
+	key.Snapshot(snapshot);
+	CHECK(snapshot.Count() == 3);
+	CHECK(snapshot.DWValue(snapshot.Find(L"Number")) == 43);
+	CHECK(snapshot.Find(L"List") == CKeySnapshot::npos);
+}
@@ -0,0 +1,352 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "HKey.h"
+#include "RegfBackend.h"
+#include "Exception.h"
+#include <climits>
+#include <cstring>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	void Put(std::vector<BYTE>& buffer, uint64_t value, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			buffer.push_back((BYTE)(value >> (8 * i)));
+	}
+
+	void PutAt(std::vector<BYTE>& buffer, size_t offset, uint64_t value, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+			buffer[offset + i] = (BYTE)(value >> (8 * i));
+	}
+
+	std::vector<BYTE> Utf16(const std::wstring& text)
+	{
+		std::vector<BYTE> bytes;
+		for (wchar_t c : text)
+			Put(bytes, (uint16_t)c, 2);
+		return bytes;
+	}
+
+	const DWORD NoCell = 0xFFFFFFFF;
+
+	/// <summary>
+	/// Writes a hive file cell by cell, in the layout that CRegfBackend reads.
+	/// Everything goes in a single hive bin.
+	/// </summary>
+	class CHiveBuilder
+	{
+		std::vector<BYTE> m_cells = std::vector<BYTE>(32);
+
+	public:
+		DWORD Cell(const std::vector<BYTE>& data)
+		{
+			DWORD offset = (DWORD)m_cells.size();
+			size_t size = (data.size() + 4 + 7) & ~(size_t)7;
+			Put(m_cells, (uint32_t)-(int32_t)size, 4);
+			m_cells.insert(m_cells.end(), data.begin(), data.end());
+			m_cells.resize(offset + size);
+			return offset;
+		}
+
+		//name is stored as Latin-1 if compressed, otherwise as UTF-16
+		DWORD Key(const std::wstring& name, DWORD subKeys, DWORD subKeyCount,
+			DWORD values, DWORD valueCount, bool compressed = true)
+		{
+			std::vector<BYTE> nameBytes;
+			if (compressed) {
+				for (wchar_t c : name)
+					nameBytes.push_back((BYTE)c);
+			}
+			else
+				nameBytes = Utf16(name);
+
+			std::vector<BYTE> cell = { 'n', 'k' };
+			Put(cell, compressed ? 0x20 : 0, 2);
+			Put(cell, 132000000000000000ULL, 8);
+			Put(cell, 0, 4);                    //access bits
+			Put(cell, 0, 4);                    //parent
+			Put(cell, subKeyCount, 4);
+			Put(cell, 0, 4);
+			Put(cell, subKeys, 4);
+			Put(cell, NoCell, 4);
+			Put(cell, valueCount, 4);
+			Put(cell, values, 4);
+			Put(cell, NoCell, 4);               //security
+			Put(cell, NoCell, 4);               //class name
+			for (int i = 0; i < 5; i++)
+				Put(cell, 0, 4);
+			Put(cell, nameBytes.size(), 2);
+			Put(cell, 0, 2);
+			cell.insert(cell.end(), nameBytes.begin(), nameBytes.end());
+			return Cell(cell);
+		}
+
+		DWORD Value(const std::string& name, DWORD type, const std::vector<BYTE>& data)
+		{
+			std::vector<BYTE> cell = { 'v', 'k' };
+			Put(cell, name.size(), 2);
+			if (data.size() <= 4) {
+				//small data is stored in the offset field
+				Put(cell, data.size() | 0x80000000, 4);
+				std::vector<BYTE> inline_(data);
+				inline_.resize(4);
+				cell.insert(cell.end(), inline_.begin(), inline_.end());
+			}
+			else if (data.size() <= 16344) {
+				Put(cell, data.size(), 4);
+				Put(cell, Cell(data), 4);
+			}
+			else {
+				//big data: a db cell with a list of segments
+				std::vector<BYTE> list;
+				DWORD segments = 0;
+				for (size_t i = 0; i < data.size(); i += 16344, segments++) {
+					size_t end = std::min(data.size(), i + 16344);
+					Put(list, Cell(std::vector<BYTE>(data.begin() + i, data.begin() + end)), 4);
+				}
+				std::vector<BYTE> db = { 'd', 'b' };
+				Put(db, segments, 2);
+				Put(db, Cell(list), 4);
+				Put(cell, data.size(), 4);
+				Put(cell, Cell(db), 4);
+			}
+			Put(cell, type, 4);
+			Put(cell, 1, 2);                    //compressed name
+			Put(cell, 0, 2);
+			cell.insert(cell.end(), name.begin(), name.end());
+			return Cell(cell);
+		}
+
+		DWORD List(const std::vector<DWORD>& cells)
+		{
+			std::vector<BYTE> list;
+			for (DWORD cell : cells)
+				Put(list, cell, 4);
+			return Cell(list);
+		}
+
+		DWORD HashLeaf(const std::vector<DWORD>& keys)
+		{
+			std::vector<BYTE> leaf = { 'l', 'h' };
+			Put(leaf, keys.size(), 2);
+			for (DWORD key : keys) {
+				Put(leaf, key, 4);
+				Put(leaf, 0, 4);
+			}
+			return Cell(leaf);
+		}
+
+		std::vector<BYTE> Hive(DWORD root)
+		{
+			std::vector<BYTE> bins(m_cells);
+			bins.resize((bins.size() + 0xFFF) & ~(size_t)0xFFF);
+			memcpy(bins.data(), "hbin", 4);
+			PutAt(bins, 8, bins.size(), 4);
+
+			std::vector<BYTE> file(0x1000);
+			memcpy(file.data(), "regf", 4);
+			PutAt(file, 4, 1, 4);               //sequence numbers
+			PutAt(file, 8, 1, 4);
+			PutAt(file, 0x14, 1, 4);            //version 1.5
+			PutAt(file, 0x18, 5, 4);
+			PutAt(file, 0x20, 1, 4);
+			PutAt(file, 0x24, root, 4);
+			PutAt(file, 0x28, bins.size(), 4);
+			file.insert(file.end(), bins.begin(), bins.end());
+			return file;
+		}
+	};
+
+	const size_t BinsStart = 0x1000;
+
+	//A hive with three keys below the root: Alpha with a string, a DWORD and a value
+	//that needs a big data cell, zeta, and a key with a UTF-16 name
+	struct CTestHive
+	{
+		std::vector<BYTE> Bytes;
+		DWORD Zeta;             //offsets of cells that the tests damage
+		DWORD Flags;
+
+		CTestHive()
+		{
+			CHiveBuilder builder;
+			std::wstring big(20000, L'x');
+			DWORD name = builder.Value("", REG_SZ, Utf16(std::wstring(L"My Library") + L'\0'));
+			Flags = builder.Value("Flags", REG_DWORD, { 7, 0, 0, 0 });
+			DWORD bigValue = builder.Value("Big", REG_SZ, Utf16(big + L'\0'));
+			DWORD values = builder.List({ name, Flags, bigValue });
+			DWORD alpha = builder.Key(L"Alpha", NoCell, 0, values, 3);
+			Zeta = builder.Key(L"zeta", NoCell, 0, NoCell, 0);
+			DWORD mide = builder.Key(L"Mid\u00E9", NoCell, 0, NoCell, 0, false);
+			DWORD subKeys = builder.HashLeaf({ alpha, mide, Zeta });
+			DWORD root = builder.Key(L"ROOT", subKeys, 3, NoCell, 0);
+			Bytes = builder.Hive(root);
+		}
+	};
+
+	//Read every key and value, the way a scan of a damaged hive would, into a dump
+	void ReadEverything(CHKey& key, std::wstring& dump, int depth = 0)
+	{
+		std::vector<BYTE> buffer;
+		for (const std::wstring& name : key.GetValues()) {
+			CRegValue value = key.GetValue(name, buffer);
+			dump += L"  " + name + L" " + std::to_wstring(value.Type()) + L" " +
+				std::to_wstring(value.Binary().size()) + L":" +
+				std::wstring(value.Binary().begin(), value.Binary().end()) + L"\n";
+		}
+		if (depth < 8) {
+			for (const std::wstring& name : key.GetSubKeys()) {
+				dump += std::to_wstring(depth) + L" " + name + L"\n";
+				CHKey subKey = key.OpenSubKey(name);
+				ReadEverything(subKey, dump, depth + 1);
+			}
+		}
+	}
+
+	//Dump of everything in a hive. Throws if the hive or a part of it is damaged.
+	std::wstring DumpHive(const std::wstring& path)
+	{
+		CRegfBackend hive(path);
+		CHKey root = CHKey::Open(HKEY_LOCAL_MACHINE, L"", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+		std::wstring dump;
+		ReadEverything(root, dump);
+		return dump;
+	}
+
+	//Open a hive and read all of it. Returns the error, or ERROR_SUCCESS.
+	//Anything other than an AppException escapes and fails the test.
+	DWORD ReadHive(const std::wstring& path)
+	{
+		try {
+			DumpHive(path);
+			return ERROR_SUCCESS;
+		}
+		catch (Win32Exception& ex) {
+			return ex.Value();
+		}
+		catch (const AppException&) {
+			return ERROR_BAD_FORMAT;
+		}
+	}
+}
+
+TEST(Regf, ReadsKeysAndValues)
+{
+	CTempDir dir;
+	CTestHive built;
+	WriteBytes(dir.File(L"test.hiv"), built.Bytes);
+
+	CRegfBackend hive(dir.File(L"test.hiv"));
+	CHKey root = CHKey::Open(HKEY_LOCAL_MACHINE, L"", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	std::vector<std::wstring> names = root.GetSubKeys();
+	CHECK(names.size() == 3);
+	CHECK(names[0] == L"Alpha" && names[1] == L"Mid\u00E9" && names[2] == L"zeta");
+
+	CHKey alpha = root.OpenSubKey(L"ALPHA");
+	CHECK(alpha.GetWSValue(L"") == L"My Library");
+	CHECK(alpha.GetDWValue(L"flags") == 7);
+	CHECK(alpha.GetWSValue(L"Big") == std::wstring(20000, L'x'));
+	CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, L"ZETA", INVALID_HANDLE_VALUE, &hive));
+	CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, L"MID\u00E9", INVALID_HANDLE_VALUE, &hive));
+	CHECK(!CHKey::Exists(HKEY_LOCAL_MACHINE, L"nope", INVALID_HANDLE_VALUE, &hive));
+	CHECK(ReadHive(dir.File(L"test.hiv")) == ERROR_SUCCESS);
+}
+
+TEST(Regf, IsReadOnly)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"test.hiv"), CTestHive().Bytes);
+
+	CRegfBackend hive(dir.File(L"test.hiv"));
+	CHKey alpha = CHKey::Open(HKEY_LOCAL_MACHINE, L"Alpha", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	CHECK_THROWS(alpha.SetValue(L"Flags", (DWORD)8), Win32Exception);
+	CHECK(alpha.GetDWValue(L"Flags") == 7);
+}
+
+TEST(Regf, RejectsFilesThatAreNotHives)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"empty.hiv"), {});
+	CHECK_THROWS(CRegfBackend(dir.File(L"empty.hiv")), AppException);
+
+	std::vector<BYTE> bytes = CTestHive().Bytes;
+	bytes[0] = 'X';
+	WriteBytes(dir.File(L"magic.hiv"), bytes);
+	CHECK_THROWS(CRegfBackend(dir.File(L"magic.hiv")), AppException);
+}
+
+TEST(Regf, NameLongerThanCell)
+{
+	CTempDir dir;
+	CTestHive built;
+	PutAt(built.Bytes, BinsStart + built.Zeta + 4 + 0x48, 0xFFFF, 2);
+	WriteBytes(dir.File(L"name.hiv"), built.Bytes);
+
+	CHECK(ReadHive(dir.File(L"name.hiv")) == ERROR_REGISTRY_CORRUPT);
+}
+
+TEST(Regf, InlineDataTooLarge)
+{
+	CTempDir dir;
+	CTestHive built;
+	PutAt(built.Bytes, BinsStart + built.Flags + 4 + 4, 0xFFFFFFFF, 4);
+	WriteBytes(dir.File(L"inline.hiv"), built.Bytes);
+
+	CRegfBackend hive(dir.File(L"inline.hiv"));
+	CHKey alpha = CHKey::Open(HKEY_LOCAL_MACHINE, L"Alpha", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	std::vector<BYTE> buffer;
+	bool corrupt = false;
+	try {
+		alpha.GetValue(L"Flags", buffer);
+	}
+	catch (Win32Exception& ex) {
+		corrupt = ex.Value() == ERROR_REGISTRY_CORRUPT;
+	}
+	CHECK(corrupt);
+}
+
+TEST(Regf, CellSizeMinInt)
+{
+	CTempDir dir;
+	CTestHive built;
+	PutAt(built.Bytes, BinsStart + built.Zeta, (uint32_t)INT_MIN, 4);
+	WriteBytes(dir.File(L"cell.hiv"), built.Bytes);
+
+	CHECK(ReadHive(dir.File(L"cell.hiv")) == ERROR_REGISTRY_CORRUPT);
+}
+
+TEST(Regf, DamagedHive)
+{
+	//the data of a truncated hive is either read as it was or reported as corrupt
+	CTempDir dir;
+	CTestHive built;
+	CDamageCheck check;
+	check.Read = DumpHive;
+	check.TruncateStep = 61;
+	//the small cells at the start and the key cells after the big value
+	check.MutateRanges = { { BinsStart, BinsStart + 0x200 },
+		{ BinsStart + built.Zeta - 0x100, BinsStart + built.Zeta + 0x100 } };
+	check.Seed = 2;
+	check.Run(built.Bytes, dir);
+}
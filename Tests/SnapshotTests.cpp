@@ -0,0 +1,237 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "RegSnapshotFile.h"
+#include "Exception.h"
+#include <cstring>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	//CLSID with a few classes, each with values of several types and two subkeys
+	void BuildTree(CMemRegBackend& hive)
+	{
+		CHKey clsid = CHKey::Create(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ | GENERIC_WRITE,
+			INVALID_HANDLE_VALUE, &hive);
+		for (int i = 0; i < 50; i++) {
+			CHKey server = clsid.CreateSubKey(L"{" + std::to_wstring(i) + L"}", GENERIC_READ | GENERIC_WRITE);
+			server.SetValue(L"", L"Class " + std::to_wstring(i));
+			server.SetValue(L"AppID", L"app");
+			server.SetValue(L"Count", (DWORD)i);
+			BYTE binary[] = { 1, 2, 3, (BYTE)i };
+			server.SetValue(L"Binary", REG_BINARY, binary, sizeof(binary));
+			server.CreateSubKey(L"InprocServer32", GENERIC_READ | GENERIC_WRITE).SetValue(L"", L"server.dll");
+			server.CreateSubKey(L"a b", GENERIC_READ | GENERIC_WRITE);
+		}
+	}
+
+	void Save(CMemRegBackend& hive, const std::wstring& fileName)
+	{
+		CRegSnapshotWriter writer(fileName);
+		CHKey clsid = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+		writer.Add(clsid);
+		writer.Save();
+	}
+
+	const CSnapshotValue* FindValue(const CRegSnapshotFile::CCursor& key, std::wstring_view name)
+	{
+		for (size_t i = 0; i < key.ValueCount(); i++) {
+			if (key.Value(i).Name == name)
+				return &key.Value(i);
+		}
+		return NULL;
+	}
+
+	//Dump every key and value. Throws if the file is damaged.
+	std::wstring DumpSnapshot(const std::wstring& fileName)
+	{
+		CRegSnapshotFile file(fileName);
+		CRegSnapshotFile::CCursor key = file.Keys();
+		std::wstring dump;
+		size_t keys = 0;
+		while (key.Next()) {
+			keys++;
+			dump += std::wstring(key.Path()) + L"\n";
+			for (size_t i = 0; i < key.ValueCount(); i++) {
+				const CSnapshotValue& value = key.Value(i);
+				dump += L"  " + std::wstring(value.Name) + L" " + std::to_wstring(value.Type) + L" " +
+					std::wstring(value.Data, value.Data + value.Size) + L"\n";
+			}
+		}
+		CHECK(keys == file.KeyCount());
+		return dump;
+	}
+
+	struct CCountingDiff : ISnapshotDiff
+	{
+		size_t Added = 0;
+		size_t Removed = 0;
+		size_t Changed = 0;
+
+		void OnKeyAdded(std::wstring_view path) override { Added++; }
+		void OnKeyRemoved(std::wstring_view path) override { Removed++; }
+		void OnValueChanged(std::wstring_view path, const CSnapshotValue* before,
+			const CSnapshotValue* after) override
+		{
+			if (before && after)
+				Changed++;
+		}
+	};
+}
+
+TEST(Snapshot, RoundTrip)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildTree(hive);
+	Save(hive, dir.File(L"a.snap"));
+
+	CRegSnapshotFile file(dir.File(L"a.snap"));
+	CHECK(file.KeyCount() == 1 + 50 * 3);
+
+	CRegSnapshotFile::CCursor key = file.Keys();
+	std::wstring previous;
+	size_t keys = 0;
+	while (key.Next()) {
+		std::wstring path(key.Path());
+		CHECK(keys == 0 || CompareKeyPaths(previous, path) < 0);
+		for (size_t i = 1; i < key.ValueCount(); i++)
+			CHECK(CompareNoCase(key.Value(i - 1).Name, key.Value(i).Name) < 0);
+
+		if (path == L"HKCR\\CLSID\\{7}") {
+			CHECK(key.ValueCount() == 4);
+			const CSnapshotValue* count = FindValue(key, L"Count");
+			CHECK(count && count->Type == REG_DWORD && count->Size == 4);
+			DWORD value;
+			memcpy(&value, count->Data, 4);
+			CHECK(value == 7);
+			const CSnapshotValue* binary = FindValue(key, L"Binary");
+			CHECK(binary && binary->Type == REG_BINARY && binary->Size == 4 && binary->Data[3] == 7);
+		}
+		previous = path;
+		keys++;
+	}
+	CHECK(keys == file.KeyCount());
+}
+
+TEST(Snapshot, LastCopyOfAKeyIsKept)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildTree(hive);
+
+	CRegSnapshotWriter writer(dir.File(L"a.snap"));
+	CHKey clsid = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	writer.Add(clsid);
+	CHKey server = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID\\{7}", GENERIC_READ | GENERIC_WRITE,
+		INVALID_HANDLE_VALUE, &hive);
+	server.SetValue(L"Count", (DWORD)700);
+	writer.Add(server);
+	CHECK(writer.KeyCount() == 151 + 3);
+	writer.Save();
+	CHECK(writer.KeyCount() == 151);
+
+	CRegSnapshotFile file(dir.File(L"a.snap"));
+	CHECK(file.KeyCount() == 151);
+	CRegSnapshotFile::CCursor key = file.Keys();
+	bool found = false;
+	while (key.Next()) {
+		if (key.Path() == L"HKCR\\CLSID\\{7}") {
+			DWORD value;
+			memcpy(&value, FindValue(key, L"Count")->Data, 4);
+			found = value == 700;
+		}
+	}
+	CHECK(found);
+}
+
+TEST(Snapshot, Diff)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildTree(hive);
+	Save(hive, dir.File(L"before.snap"));
+
+	CHKey clsid = CHKey::Open(HKEY_CLASSES_ROOT, L"CLSID", GENERIC_READ | GENERIC_WRITE,
+		INVALID_HANDLE_VALUE, &hive);
+	clsid.OpenSubKey(L"{3}", GENERIC_READ | GENERIC_WRITE).SetValue(L"AppID", L"changed");
+	clsid.CreateSubKey(L"{new}", GENERIC_READ | GENERIC_WRITE);
+	CHKey::DeleteTree(clsid, L"{9}", true, INVALID_HANDLE_VALUE, &hive);
+	Save(hive, dir.File(L"after.snap"));
+
+	CRegSnapshotFile before(dir.File(L"before.snap"));
+	CRegSnapshotFile after(dir.File(L"after.snap"));
+	CCountingDiff diff;
+	DiffSnapshots(before, after, diff);
+	CHECK(diff.Added == 1);
+	CHECK(diff.Removed == 3);
+	CHECK(diff.Changed == 1);
+
+	CCountingDiff none;
+	CHECK(DiffSnapshots(before, before, none) == 0);
+}
+
+TEST(Snapshot, DamagedFile)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildTree(hive);
+	Save(hive, dir.File(L"a.snap"));
+	std::vector<BYTE> bytes = ReadBytes(dir.File(L"a.snap"));
+
+	CDamageCheck check;
+	check.Read = DumpSnapshot;
+	check.TruncateStep = 13;
+	check.MutateRanges = { { 16, bytes.size() } };
+	check.Seed = 5;
+	check.Run(bytes, dir);
+
+	std::wstring path = dir.File(L"truncated.snap");
+	WriteBytes(path, std::vector<BYTE>(bytes.begin(), bytes.begin() + 10));
+	CHECK_THROWS(CRegSnapshotFile{ path }, AppException);
+
+	//a key count that does not match the keys in the file
+	std::vector<BYTE> counted(bytes);
+	counted[8]--;
+	WriteBytes(path, counted);
+	CHECK_THROWS(DumpSnapshot(path), AppException);
+	counted[8] += 2;
+	WriteBytes(path, counted);
+	CHECK_THROWS(DumpSnapshot(path), AppException);
+}
+
+TEST(Snapshot, CharacterCountThatOverflows)
+{
+	CTempDir dir;
+	std::vector<BYTE> bytes = { 'R', 'G', 'S', 'N', 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0 };
+	//shared length 0, then a suffix length of 2^63: doubled, it wraps around to 0
+	bytes.push_back(0);
+	for (int i = 0; i < 9; i++)
+		bytes.push_back(i < 8 ? 0x80 : 0x01);
+	bytes.insert(bytes.end(), { 'a', 0, 0 });
+	WriteBytes(dir.File(L"overflow.snap"), bytes);
+
+	CRegSnapshotFile file(dir.File(L"overflow.snap"));
+	CRegSnapshotFile::CCursor key = file.Keys();
+	CHECK_THROWS(key.Next(), AppException);
+}
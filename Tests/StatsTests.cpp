@@ -0,0 +1,116 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "Stats.h"
+#include "InstrumentedBackend.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+#include <thread>
+
+using namespace w32;
+using namespace w32::test;
+
+TEST(Stats, HistogramBuckets)
+{
+	//every bucket holds the latencies up to its limit, and the limits go up
+	for (size_t i = 1; i < CLatencyHistogram::BucketCount; i++)
+		CHECK(CLatencyHistogram::BucketLimit(i) > CLatencyHistogram::BucketLimit(i - 1));
+	for (ULONGLONG ns : { 0ull, 1ull, 7ull, 8ull, 9ull, 1000ull, 123456789ull, 1ull << 35 }) {
+		size_t index = CLatencyHistogram::BucketIndex(ns);
+		CHECK(ns <= CLatencyHistogram::BucketLimit(index));
+		CHECK(index == 0 || ns > CLatencyHistogram::BucketLimit(index - 1));
+		//within 12.5%
+		CHECK(CLatencyHistogram::BucketLimit(index) - ns <= ns / 8 + 1);
+	}
+	CHECK(CLatencyHistogram::BucketIndex(~0ull) == CLatencyHistogram::BucketCount - 1);
+
+	CLatencyHistogram histogram;
+	CHECK(histogram.Count() == 0 && histogram.Percentile(0.5) == 0);
+	for (ULONGLONG ns = 1; ns <= 1000; ns++)
+		histogram.Add(ns * 1000);
+	histogram.Add(5000000, 10);
+	CHECK(histogram.Count() == 1010);
+	ULONGLONG median = histogram.Percentile(0.5);
+	CHECK(median >= 500000 && median <= 500000 + 500000 / 8);
+	CHECK(histogram.Percentile(1.0) >= 5000000);
+	CHECK(histogram.Percentile(0.0) <= 1000 + 1000 / 8);
+}
+
+TEST(Stats, CountsCallsOfAllThreads)
+{
+	CStatsReport before = CStats::Collect();
+	std::thread worker([]() {
+		for (int i = 0; i < 10; i++)
+			CStats::Record(EStatOp::LoadTypeLib, 1000, i % 2 == 0, 100, 0);
+	});
+	worker.join();
+	{
+		CStatScope scope(EStatOp::LoadTypeLib);
+		scope.Fail();
+		scope.Written(7);
+	}
+	CStatsReport after = CStats::Collect();
+
+	const COpStats& load = after[EStatOp::LoadTypeLib];
+	const COpStats& previous = before[EStatOp::LoadTypeLib];
+	if (CStats::Enabled) {
+		//the thread that ended is still counted
+		CHECK(load.Calls - previous.Calls == 11);
+		CHECK(load.Errors - previous.Errors == 6);
+		CHECK(load.BytesRead - previous.BytesRead == 1000);
+		CHECK(load.BytesWritten - previous.BytesWritten == 7);
+		CHECK(load.Latency.Count() - previous.Latency.Count() == 11);
+		CHECK(load.TotalNanoseconds - previous.TotalNanoseconds >= 10000);
+	}
+	else {
+		CHECK(load.Calls == 0 && load.Latency.Count() == 0);
+	}
+	CHECK(std::wstring(StatOpName(EStatOp::LoadTypeLib)).length() > 0);
+}
+
+TEST(Stats, InstrumentedBackend)
+{
+	CMemRegBackend hive;
+	CInstrumentedBackend counted(&hive);
+	CStatsReport before = CStats::Collect();
+
+	CHKey key = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Stats", GENERIC_READ | GENERIC_WRITE, INVALID_HANDLE_VALUE, &counted);
+	key.SetValue(L"a", L"abc");
+	key.SetValue(L"b", (DWORD)1);
+	CHECK(key.GetWSValue(L"a") == L"abc");
+	CHECK_THROWS(key.GetWSValue(L"missing"), ExWin32Error);
+	CHECK(key.GetSubKeys().empty());
+	CStatsReport after = CStats::Collect();
+
+	auto delta = [&](EStatOp op) { return after[op].Calls - before[op].Calls; };
+	if (CStats::Enabled) {
+		CHECK(delta(EStatOp::CreateKey) >= 1);
+		CHECK(delta(EStatOp::SetValue) == 2);
+		CHECK(after[EStatOp::SetValue].BytesWritten - before[EStatOp::SetValue].BytesWritten == 4 * sizeof(wchar_t) + 4);
+		CHECK(delta(EStatOp::QueryValue) >= 2);
+		CHECK(after[EStatOp::QueryValue].Errors - before[EStatOp::QueryValue].Errors >= 1);
+		//the end of an enumeration is not an error
+		CHECK(delta(EStatOp::EnumKey) >= 1);
+		CHECK(after[EStatOp::EnumKey].Errors == before[EStatOp::EnumKey].Errors);
+	}
+	else {
+		CHECK(delta(EStatOp::SetValue) == 0);
+	}
+}
@@ -0,0 +1,168 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "Task.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+#include <thread>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	CTask<int> Value(int value)
+	{
+		co_return value;
+	}
+
+	CTask<int> Fail(const char* message)
+	{
+		throw AppException(message);
+		co_return 0;
+	}
+
+	//Moves to the pool and returns the thread it ran on
+	CTask<std::thread::id> ThreadOf(CThreadPool* pool)
+	{
+		co_await ResumeOn(pool);
+		co_return std::this_thread::get_id();
+	}
+
+	CTask<int> Square(int value, CThreadPool* pool)
+	{
+		co_await ResumeOn(pool);
+		co_return value * value;
+	}
+
+	//Awaits many tasks that finish without suspending, one after the other
+	CTask<long long> Sum(int count)
+	{
+		long long sum = 0;
+		for (int i = 0; i < count; i++)
+			sum += co_await Value(i);
+		co_return sum;
+	}
+
+	CTask<int> Nested(int depth)
+	{
+		if (depth == 0)
+			co_return 0;
+		co_return 1 + co_await Nested(depth - 1);
+	}
+}
+
+TEST(Task, ResultsAndExceptions)
+{
+	CHECK(SyncWait(Value(7)) == 7);
+	CHECK_THROWS(SyncWait(Fail("failed")), AppException);
+	CHECK(SyncWait(Sum(100000)) == 100000LL * 99999 / 2);
+	CHECK(SyncWait(Nested(1000)) == 1000);
+}
+
+TEST(Task, StartsWhenAwaited)
+{
+	bool started = false;
+	auto work = [&]() -> CTask<void> {
+		started = true;
+		co_return;
+	};
+	CTask<void> task = work();
+	CHECK(!started);
+	SyncWait(std::move(task));
+	CHECK(started);
+}
+
+TEST(Task, ResumeOnMovesToThePool)
+{
+	CThreadPool pool(2);
+	CHECK(SyncWait(ThreadOf(&pool)) != std::this_thread::get_id());
+	CHECK(SyncWait(ThreadOf(NULL)) == std::this_thread::get_id());
+}
+
+TEST(Task, WhenAll)
+{
+	CThreadPool pool(4);
+	std::vector<CTask<int>> tasks;
+	for (int i = 0; i < 200; i++)
+		tasks.push_back(Square(i, &pool));
+	std::vector<int> results = SyncWait(WhenAll(std::move(tasks)));
+	CHECK(results.size() == 200);
+	for (int i = 0; i < 200; i++)
+		CHECK(results[i] == i * i);
+
+	CHECK(SyncWait(WhenAll(std::vector<CTask<int>>())).empty());
+
+	//the first failure in the order of the tasks is thrown
+	std::vector<CTask<int>> failing;
+	failing.push_back(Square(2, &pool));
+	failing.push_back(Fail("first"));
+	failing.push_back(Square(3, &pool));
+	failing.push_back(Fail("second"));
+	std::string message;
+	try {
+		SyncWait(WhenAll(std::move(failing)));
+	}
+	catch (AppException& ex) {
+		message = ex.what();
+	}
+	CHECK(message.find("first") != std::string::npos);
+
+	//tasks without a result
+	std::atomic<int> done{ 0 };
+	auto count = [&](CThreadPool* pool) -> CTask<void> {
+		co_await ResumeOn(pool);
+		done++;
+	};
+	std::vector<CTask<void>> voids;
+	for (int i = 0; i < 50; i++)
+		voids.push_back(count(&pool));
+	SyncWait(WhenAll(std::move(voids)));
+	CHECK(done == 50);
+}
+
+TEST(Task, OpenAndSnapshotAsync)
+{
+	CMemRegBackend hive;
+	for (int i = 0; i < 20; i++) {
+		CHKey key = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Async\\K" + std::to_wstring(i),
+			GENERIC_READ | GENERIC_WRITE, INVALID_HANDLE_VALUE, &hive);
+		key.SetValue(L"Index", (DWORD)i);
+	}
+
+	CThreadPool pool(4);
+	for (CThreadPool* taskPool : { &pool, (CThreadPool*)NULL }) {
+		std::vector<CTask<CHKey>> opens;
+		for (int i = 0; i < 20; i++)
+			opens.push_back(CHKey::OpenAsync(HKEY_LOCAL_MACHINE, L"Software\\Async\\K" + std::to_wstring(i),
+				GENERIC_READ, INVALID_HANDLE_VALUE, &hive, taskPool));
+		std::vector<CHKey> keys = SyncWait(WhenAll(std::move(opens)));
+
+		std::vector<CTask<CKeySnapshot>> snapshots;
+		for (CHKey& key : keys)
+			snapshots.push_back(key.SnapshotAsync(taskPool));
+		std::vector<CKeySnapshot> values = SyncWait(WhenAll(std::move(snapshots)));
+		for (int i = 0; i < 20; i++)
+			CHECK(values[i].DWValue(values[i].Find(L"Index")) == (DWORD)i);
+
+		CHECK_THROWS(SyncWait(CHKey::OpenAsync(HKEY_LOCAL_MACHINE, L"Software\\Async\\Missing",
+			GENERIC_READ, INVALID_HANDLE_VALUE, &hive, taskPool)), ExWin32Error);
+	}
+}
@@ -0,0 +1,140 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#pragma once
+#include <WinBase.h>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace w32::test
+{
+	/// <summary>
+	/// A minimal test runner for the portable build: no framework is needed to build
+	/// the tests. TEST registers a function under a suite and a name, CHECK fails the
+	/// test that is running. The runner (TestMain.cpp) runs the tests of the suites that
+	/// are named on its command line, or all of them, and CTest runs it once per suite.
+	/// </summary>
+	struct CTestCase
+	{
+		const char* Suite;
+		const char* Name;
+		void (*Run)();
+	};
+
+	std::vector<CTestCase>& TestCases();
+
+	struct CRegisterTest
+	{
+		CRegisterTest(const char* suite, const char* name, void (*run)())
+		{
+			TestCases().push_back({ suite, name, run });
+		}
+	};
+
+	//Thrown by CHECK, caught by the runner
+	struct CCheckFailed
+	{
+		std::string Message;
+	};
+
+	[[noreturn]] void Fail(const char* file, int line, const std::string& message);
+
+	/// <summary>
+	/// A directory for the files of one test, removed with everything in it when the
+	/// test is done.
+	/// </summary>
+	class CTempDir
+	{
+		std::filesystem::path m_path;
+
+	public:
+		CTempDir();
+		~CTempDir();
+
+		CTempDir(const CTempDir&) = delete;
+		CTempDir& operator = (const CTempDir&) = delete;
+
+		//Full path of a file in the directory
+		std::wstring File(const std::wstring& name) const;
+	};
+
+	//{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}, for dumps and messages
+	std::wstring GuidText(const GUID& guid);
+
+	std::vector<BYTE> ReadBytes(const std::wstring& path);
+	void WriteBytes(const std::wstring& path, const std::vector<BYTE>& bytes);
+
+	//Deterministic pseudo random numbers, so that a failing corruption test can be rerun
+	class CRandom
+	{
+		uint64_t m_state;
+
+	public:
+		CRandom(uint64_t seed) : m_state(seed) {}
+
+		uint32_t Next(uint32_t limit)
+		{
+			m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+			return (uint32_t)((m_state >> 33) % limit);
+		}
+	};
+
+	/// <summary>
+	/// Feeds damaged copies of a file to a reader of its format: every prefix of the file,
+	/// and copies with a few bytes changed at random.
+	///
+	/// Read reads everything in a file and returns a dump of it, an empty dump for a file
+	/// that it takes as empty or missing, or throws an AppException for a file that it
+	/// rejects. It CHECKs whatever the format guarantees about what it reads.
+	/// A prefix has to be rejected, empty, or read as the whole file (when only padding
+	/// was cut): a dump of part of the file fails the test. A changed copy may read as
+	/// anything that passes the CHECKs of the reader, as a format without checksums
+	/// cannot tell a changed name from the original one.
+	/// </summary>
+	struct CDamageCheck
+	{
+		std::function<std::wstring(const std::wstring& path)> Read;
+		size_t TruncateStep = 1;            //cut the file at every multiple of this size
+		size_t Mutations = 500;             //number of changed copies
+		std::vector<std::pair<size_t, size_t>> MutateRanges;   //[begin, end) of bytes that may be changed; all if empty
+		uint64_t Seed = 1;
+
+		//Check the file and its damaged copies. The copies are written to dir.
+		void Run(const std::vector<BYTE>& bytes, const CTempDir& dir) const;
+	};
+}
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static w32::test::CRegisterTest suite##_##name##_registration(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) w32::test::Fail(__FILE__, __LINE__, #condition); } while (false)
+
+//Check that an expression throws an exception of the given type (or one derived from it)
+#define CHECK_THROWS(expression, type) \
+	do { \
+		bool thrown = false; \
+		try { expression; } \
+		catch (const type&) { thrown = true; } \
+		if (!thrown) w32::test::Fail(__FILE__, __LINE__, #expression " does not throw " #type); \
+	} while (false)
@@ -0,0 +1,171 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "Exception.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace w32::test
+{
+	std::vector<CTestCase>& TestCases()
+	{
+		static std::vector<CTestCase> testCases;
+		return testCases;
+	}
+
+	void Fail(const char* file, int line, const std::string& message)
+	{
+		throw CCheckFailed{ std::string(file) + "(" + std::to_string(line) + "): " + message };
+	}
+
+	CTempDir::CTempDir()
+	{
+		static std::atomic<unsigned> counter = 0;
+		auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+		m_path = std::filesystem::temp_directory_path() /
+			("PlatformToolsTests-" + std::to_string(now) + "-" + std::to_string(counter++));
+		std::filesystem::create_directories(m_path);
+	}
+
+	CTempDir::~CTempDir()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_path, error);
+	}
+
+	std::wstring CTempDir::File(const std::wstring& name) const
+	{
+		return (m_path / name).wstring();
+	}
+
+	std::wstring GuidText(const GUID& guid)
+	{
+		wchar_t text[40];
+		StringFromGUID2(guid, text, 40);
+		return text;
+	}
+
+	std::vector<BYTE> ReadBytes(const std::wstring& path)
+	{
+		std::ifstream file(std::filesystem::path(path), std::ios::binary);
+		return std::vector<BYTE>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void WriteBytes(const std::wstring& path, const std::vector<BYTE>& bytes)
+	{
+		std::ofstream file(std::filesystem::path(path), std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	}
+
+	namespace
+	{
+		//Read a damaged copy. Returns false if it is rejected; a failed CHECK names the copy.
+		bool ReadCopy(const CDamageCheck& check, const std::wstring& path, const std::string& copy,
+			std::wstring& dump)
+		{
+			try {
+				dump = check.Read(path);
+				return true;
+			}
+			catch (const AppException&) {
+				return false;
+			}
+			catch (const CCheckFailed& failed) {
+				throw CCheckFailed{ failed.Message + " (" + copy + ")" };
+			}
+		}
+	}
+
+	void CDamageCheck::Run(const std::vector<BYTE>& bytes, const CTempDir& dir) const
+	{
+		std::wstring path = dir.File(L"damaged.bin");
+		WriteBytes(path, bytes);
+		std::wstring whole;
+		if (!ReadCopy(*this, path, "the whole file", whole) || whole.empty())
+			throw CCheckFailed{ "the undamaged file is not read" };
+
+		std::wstring dump;
+		for (size_t size = 0; size < bytes.size(); size += TruncateStep) {
+			std::string copy = "the first " + std::to_string(size) + " bytes";
+			WriteBytes(path, std::vector<BYTE>(bytes.begin(), bytes.begin() + size));
+			if (ReadCopy(*this, path, copy, dump) && !dump.empty() && dump != whole)
+				throw CCheckFailed{ copy + " are read as part of the file" };
+		}
+
+		std::vector<std::pair<size_t, size_t>> ranges(MutateRanges);
+		if (ranges.empty())
+			ranges.emplace_back(0, bytes.size());
+		CRandom random(Seed);
+		for (size_t i = 0; i < Mutations; i++) {
+			std::vector<BYTE> damaged(bytes);
+			for (int k = 0; k < 4; k++) {
+				const std::pair<size_t, size_t>& range = ranges[random.Next((uint32_t)ranges.size())];
+				damaged[range.first + random.Next((uint32_t)(range.second - range.first))] = (BYTE)random.Next(256);
+			}
+			WriteBytes(path, damaged);
+			ReadCopy(*this, path, "changed copy " + std::to_string(i), dump);
+		}
+	}
+}
+
+using namespace w32::test;
+
+//Run the tests of the suites named on the command line, or all of them
+int main(int argc, char* argv[])
+{
+	size_t run = 0;
+	size_t failed = 0;
+	for (const CTestCase& test : TestCases()) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++)
+			selected |= strcmp(argv[i], test.Suite) == 0;
+		if (!selected)
+			continue;
+
+		std::string error;
+		try {
+			test.Run();
+		}
+		catch (const CCheckFailed& check) {
+			error = check.Message;
+		}
+		catch (const std::exception& ex) {
+			error = std::string("unexpected exception: ") + ex.what();
+		}
+		catch (...) {
+			error = "unexpected exception";
+		}
+
+		run++;
+		if (error.empty())
+			std::cout << "[ OK ] " << test.Suite << "." << test.Name << std::endl;
+		else {
+			failed++;
+			std::cout << "[FAIL] " << test.Suite << "." << test.Name << ": " << error << std::endl;
+		}
+	}
+
+	std::cout << run - failed << " of " << run << " tests passed" << std::endl;
+	return failed == 0 && run > 0 ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+
+using namespace w32;
+using namespace w32::test;
+
+TEST(ThreadPool, RunsEveryTask)
+{
+	std::atomic<size_t> done = 0;
+	{
+		CThreadPool pool(4);
+		CHECK(pool.ThreadCount() == 4);
+		for (int i = 0; i < 1000; i++)
+			pool.Submit([&done] { done++; });
+	}
+	//the destructor finishes the queued work
+	CHECK(done == 1000);
+}
+
+TEST(ThreadPool, TasksSubmitTasks)
+{
+	//a binary tree of tasks, 2^12 leaves, submitted from the workers
+	std::atomic<size_t> leaves = 0;
+	std::atomic<size_t> running = 0;
+	std::mutex lock;
+	std::set<std::thread::id> threads;
+	{
+		CThreadPool pool(4);
+		std::function<void(int)> split = [&](int depth) {
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				threads.insert(std::this_thread::get_id());
+			}
+			if (depth == 12) {
+				leaves++;
+				return;
+			}
+			running += 2;
+			pool.Submit([&, depth] { split(depth + 1); running--; });
+			pool.Submit([&, depth] { split(depth + 1); running--; });
+		};
+		running++;
+		pool.Submit([&] { split(0); running--; });
+		while (running > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(leaves == 4096);
+	CHECK(threads.size() <= 4);
+}
+
+TEST(ThreadPool, DefaultPool)
+{
+	CThreadPool& pool = CThreadPool::Default();
+	CHECK(&pool == &CThreadPool::Default());
+	CHECK(pool.ThreadCount() >= 1);
+
+	std::atomic<size_t> done = 0;
+	for (int i = 0; i < 100; i++)
+		pool.Submit([&done] { done++; });
+	while (done < 100)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	CHECK(CThreadPool(0).ThreadCount() == std::max(1u, std::thread::hardware_concurrency()));
+}
@@ -0,0 +1,151 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "MsftBuilder.h"
+#include "TlbCache.h"
+#include "Exception.h"
+#include <chrono>
+#include <filesystem>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	//A cache with the sample library and a second library, saved to cache.bin
+	void WriteCache(const CTempDir& dir)
+	{
+		WriteBytes(dir.File(L"a.tlb"), CMsftBuilder::Sample().Build());
+		CMsftBuilder other;
+		other.Name = "OtherLib";
+		other.SysKind = SYS_WIN32;
+		other.AddType(TKIND_INTERFACE, CMsftBuilder::TestGuid(100), "IOther", 0);
+		WriteBytes(dir.File(L"b.tlb"), other.Build());
+
+		CTlbCache cache(dir.File(L"cache.bin"));
+		CHECK(cache.Count() == 0);
+		CHECK(cache.Get(dir.File(L"a.tlb")).Name == L"TestLib");
+		CHECK(cache.Get(dir.File(L"b.tlb")).Name == L"OtherLib");
+		CHECK(cache.Modified());
+		CHECK(cache.Save());
+		CHECK(!cache.Modified());
+	}
+
+	//Dump what a cache file has for the two libraries. Empty if the cache is empty.
+	std::wstring DumpCache(const std::wstring& fileName, const CTempDir& dir)
+	{
+		CTlbCache cache(fileName);
+		if (cache.Count() == 0)
+			return L"";
+		std::wstring dump = std::to_wstring(cache.Count()) + L"\n";
+		for (const wchar_t* name : { L"a.tlb", L"b.tlb" }) {
+			CTlbMetadata metadata;
+			if (!cache.TryGet(dir.File(name), metadata))
+				continue;
+			dump += GuidText(metadata.Guid) + L" " + metadata.Name + L" " + metadata.DocString + L" " +
+				metadata.Version + L" " + std::to_wstring(metadata.SysKind) + L"\n";
+			for (const CTlbTypeEntry& type : metadata.Types) {
+				CHECK(type.Kind >= TKIND_ENUM && type.Kind < TKIND_MAX);
+				dump += L"  " + std::to_wstring(type.Kind) + L" " + type.Name + L" " + GuidText(type.Guid) + L"\n";
+			}
+		}
+		CTlbCache::CVerifyResult result = cache.Verify();
+		CHECK(result.Current + result.Changed + result.Missing == cache.Count());
+		return dump;
+	}
+}
+
+TEST(TlbCache, RoundTrip)
+{
+	CTempDir dir;
+	WriteCache(dir);
+
+	CTlbCache cache(dir.File(L"cache.bin"));
+	CHECK(cache.Count() == 2);
+	CTlbMetadata metadata;
+	CHECK(cache.TryGet(dir.File(L"a.tlb"), metadata));
+	CHECK(metadata.Name == L"TestLib");
+	CHECK(metadata.DocString == L"Test library");
+	CHECK(metadata.Types.size() == 7);
+	CHECK(cache.TryGet(dir.File(L"b.tlb"), metadata));
+	CHECK(metadata.Name == L"OtherLib" && metadata.Types.size() == 1);
+	CHECK(!cache.TryGet(dir.File(L"c.tlb"), metadata));
+	CHECK(!cache.Modified());
+}
+
+TEST(TlbCache, Verify)
+{
+	CTempDir dir;
+	WriteCache(dir);
+
+	//same contents with another time: current, and the new time is kept
+	std::filesystem::path a(dir.File(L"a.tlb"));
+	std::filesystem::last_write_time(a, std::filesystem::last_write_time(a) + std::chrono::hours(1));
+	{
+		CTlbCache cache(dir.File(L"cache.bin"));
+		CTlbMetadata metadata;
+		CHECK(cache.TryGet(a.wstring(), metadata));
+		CHECK(cache.Modified());
+		CHECK(cache.Save());
+	}
+
+	CMsftBuilder changed = CMsftBuilder::Sample();
+	changed.DocString = "Changed library";
+	WriteBytes(a.wstring(), changed.Build());
+	std::filesystem::remove(dir.File(L"b.tlb"));
+	CTlbCache cache(dir.File(L"cache.bin"));
+	std::vector<std::wstring> stale;
+	CTlbCache::CVerifyResult result = cache.Verify(&stale);
+	CHECK(result.Current == 0 && result.Changed == 1 && result.Missing == 1);
+	CHECK(stale.size() == 2);
+
+	CTlbMetadata metadata;
+	CHECK(!cache.TryGet(a.wstring(), metadata));
+	CHECK(cache.Get(a.wstring()).DocString == L"Changed library");
+	CHECK(cache.Rebuild() == 1);
+	CHECK(cache.Save());
+	CHECK(cache.Count() == 1);
+	CHECK(CTlbCache(dir.File(L"cache.bin")).Verify().Current == 1);
+}
+
+TEST(TlbCache, DamagedFile)
+{
+	CTempDir dir;
+	WriteCache(dir);
+	std::vector<BYTE> bytes = ReadBytes(dir.File(L"cache.bin"));
+
+	std::vector<BYTE> cut(bytes.begin(), bytes.end() - 20);
+	WriteBytes(dir.File(L"cache.bin"), cut);
+	CTlbCache cache(dir.File(L"cache.bin"));
+	CTlbMetadata metadata;
+	CHECK_THROWS(cache.TryGet(dir.File(L"b.tlb"), metadata), AppException);
+
+	CDamageCheck check;
+	check.Read = [&](const std::wstring& path) { return DumpCache(path, dir); };
+	check.Seed = 22;
+	check.Run(bytes, dir);
+}
+
+TEST(TlbCache, OtherFilesAreEmpty)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"junk.bin"), { 'j', 'u', 'n', 'k' });
+	CHECK(CTlbCache(dir.File(L"junk.bin")).Count() == 0);
+	CHECK(CTlbCache(dir.File(L"missing.bin")).Count() == 0);
+}
@@ -0,0 +1,184 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "MsftBuilder.h"
+#include "TlbChecker.h"
+#include "TlbRegistrar.h"
+#include "MemRegBackend.h"
+#include "StringHelper.h"
+#include <algorithm>
+#include <cwctype>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const REGSAM ReadWrite = GENERIC_READ | GENERIC_WRITE;
+
+	CTlbMetadata Library(uint32_t number, WORD majorVersion)
+	{
+		CTlbMetadata library;
+		library.Guid = CMsftBuilder::TestGuid(number);
+		library.MajorVersion = majorVersion;
+		library.MinorVersion = 0;
+		library.Flags = 0;
+		library.LocaleID = 0;
+		library.SysKind = SYS_WIN32;
+		library.Path = L"C:/Libs/Lib" + std::to_wstring(number) + L".tlb";
+		library.Name = L"Lib" + std::to_wstring(number);
+		return library;
+	}
+
+	//Lib1 1.0 has an oleautomation interface, a custom interface, a dispinterface and a
+	//coclass; Lib2 2.0 has an oleautomation interface
+	std::vector<CTlbMetadata> Libraries()
+	{
+		std::vector<CTlbMetadata> libraries = { Library(1, 1), Library(2, 2) };
+		libraries[0].Types.push_back({ TKIND_INTERFACE, CMsftBuilder::TestGuid(11), L"IAuto", TYPEFLAG_FOLEAUTOMATION, 1, 0 });
+		libraries[0].Types.push_back({ TKIND_INTERFACE, CMsftBuilder::TestGuid(12), L"ICustom", 0, 1, 0 });
+		libraries[0].Types.push_back({ TKIND_DISPATCH, CMsftBuilder::TestGuid(13), L"DEvents", 0, 1, 0 });
+		libraries[0].Types.push_back({ TKIND_COCLASS, CMsftBuilder::TestGuid(14), L"Lib1", TYPEFLAG_FCANCREATE, 1, 0 });
+		libraries[0].Types.push_back({ TKIND_ENUM, GUID_NULL, L"EColor", 0, 0, 0 });
+		libraries[1].Types.push_back({ TKIND_INTERFACE, CMsftBuilder::TestGuid(21), L"IOther", TYPEFLAG_FOLEAUTOMATION, 1, 0 });
+		return libraries;
+	}
+
+	void SetTypeLib(CMemRegBackend& hive, HKEY root, const std::wstring& key, const std::wstring& libId,
+		const std::wstring& version)
+	{
+		CHKey typeLib = CHKey::Create(root, CTlbRegistrar::ClassesPath + key + L"\\TypeLib", ReadWrite,
+			INVALID_HANDLE_VALUE, &hive);
+		typeLib.SetValue(L"", libId);
+		if (!version.empty())
+			typeLib.SetValue(L"Version", version);
+	}
+
+	//A hive where both libraries are registered, with the class key of the coclass
+	void BuildRegistry(CMemRegBackend& hive)
+	{
+		CTlbRegistrar registrar(false, &hive);
+		for (const CTlbMetadata& library : Libraries())
+			registrar.Add(library);
+		registrar.Apply();
+		SetTypeLib(hive, HKEY_LOCAL_MACHINE, L"CLSID\\" + WStringFromGUID(CMsftBuilder::TestGuid(14)),
+			WStringFromGUID(CMsftBuilder::TestGuid(1)), L"");
+	}
+
+	void Check(CTlbChecker& checker)
+	{
+		for (const CTlbMetadata& library : Libraries())
+			checker.Add(library);
+		checker.Check();
+	}
+
+	const CTlbCheckIssue* FindIssue(const CTlbChecker& checker, const std::wstring& key, bool perUser)
+	{
+		for (const CTlbCheckIssue& issue : checker.Issues()) {
+			if (CompareNoCase(issue.Key, key) == 0 && issue.PerUser == perUser)
+				return &issue;
+		}
+		return NULL;
+	}
+
+	std::wstring Upper(const GUID& guid)
+	{
+		return ToWUpperName(WStringFromGUID(guid));
+	}
+}
+
+TEST(TlbChecker, RegisteredLibrariesHaveNoIssues)
+{
+	CMemRegBackend hive;
+	BuildRegistry(hive);
+	CTlbChecker checker(&hive);
+	Check(checker);
+	CHECK(checker.LibraryCount() == 2);
+	CHECK(checker.GuidCount() == 5);
+	CHECK(checker.Issues().empty());
+
+	//checking again starts over
+	checker.Check();
+	CHECK(checker.Issues().empty());
+}
+
+TEST(TlbChecker, EmptyHive)
+{
+	CMemRegBackend hive;
+	CTlbChecker checker(&hive);
+	Check(checker);
+
+	//only the interfaces that registration writes are missing
+	CHECK(checker.Issues().size() == 3);
+	for (uint32_t number : { 11, 13, 21 }) {
+		const CTlbCheckIssue* issue = FindIssue(checker, L"Interface\\" + Upper(CMsftBuilder::TestGuid(number)) + L"\\TypeLib", false);
+		CHECK(issue && issue->Issue == ETlbCheckIssue::MISSING && issue->Found.empty());
+		CHECK(issue && issue->Expected == Upper(CMsftBuilder::TestGuid(number / 10)) + (number == 21 ? L" 2.0" : L" 1.0"));
+	}
+}
+
+TEST(TlbChecker, Issues)
+{
+	CMemRegBackend hive;
+	BuildRegistry(hive);
+	std::wstring lib1 = WStringFromGUID(CMsftBuilder::TestGuid(1));
+	std::wstring lib3 = WStringFromGUID(CMsftBuilder::TestGuid(3));
+	auto interfaceKey = [](uint32_t number) { return L"Interface\\" + WStringFromGUID(CMsftBuilder::TestGuid(number)); };
+	auto classKey = [](uint32_t number) { return L"CLSID\\" + WStringFromGUID(CMsftBuilder::TestGuid(number)); };
+
+	//per machine: IOther is gone, IAuto points at another version, DEvents at another
+	//library, and a class that Lib1 does not have points at Lib1
+	CHKey::DeleteTree(HKEY_LOCAL_MACHINE, (CTlbRegistrar::ClassesPath + interfaceKey(21)).c_str(), true,
+		INVALID_HANDLE_VALUE, &hive);
+	SetTypeLib(hive, HKEY_LOCAL_MACHINE, interfaceKey(11), lib1, L"0.9");
+	SetTypeLib(hive, HKEY_LOCAL_MACHINE, interfaceKey(13), lib3, L"1.0");
+	SetTypeLib(hive, HKEY_LOCAL_MACHINE, classKey(15), lib1, L"");
+	SetTypeLib(hive, HKEY_LOCAL_MACHINE, classKey(16), lib3, L"");
+
+	//per user: the custom interface is registered correctly, in lower case, and the class
+	//points at another library
+	std::wstring lowerCustom = interfaceKey(12);
+	std::transform(lowerCustom.begin(), lowerCustom.end(), lowerCustom.begin(), towlower);
+	std::wstring lowerLib1 = lib1;
+	std::transform(lowerLib1.begin(), lowerLib1.end(), lowerLib1.begin(), towlower);
+	SetTypeLib(hive, HKEY_CURRENT_USER, lowerCustom, lowerLib1, L"1.0");
+	SetTypeLib(hive, HKEY_CURRENT_USER, classKey(14), lib3, L"");
+
+	CTlbChecker checker(&hive);
+	Check(checker);
+	CHECK(checker.Issues().size() == 5);
+
+	const CTlbCheckIssue* issue = FindIssue(checker, interfaceKey(21) + L"\\TypeLib", false);
+	CHECK(issue && issue->Issue == ETlbCheckIssue::MISSING && issue->Expected == Upper(CMsftBuilder::TestGuid(2)) + L" 2.0");
+	issue = FindIssue(checker, interfaceKey(11) + L"\\TypeLib", false);
+	CHECK(issue && issue->Issue == ETlbCheckIssue::STALE);
+	CHECK(issue && issue->Found == lib1 + L" 0.9" && issue->Expected == Upper(CMsftBuilder::TestGuid(1)) + L" 1.0");
+	issue = FindIssue(checker, interfaceKey(13) + L"\\TypeLib", false);
+	CHECK(issue && issue->Issue == ETlbCheckIssue::CONFLICT);
+	CHECK(issue && issue->Found == lib3 + L" 1.0" && issue->Expected == Upper(CMsftBuilder::TestGuid(1)) + L" 1.0");
+	issue = FindIssue(checker, classKey(15) + L"\\TypeLib", false);
+	CHECK(issue && issue->Issue == ETlbCheckIssue::STALE && issue->Found == lib1 && issue->Expected.empty());
+	issue = FindIssue(checker, classKey(14) + L"\\TypeLib", true);
+	CHECK(issue && issue->Issue == ETlbCheckIssue::CONFLICT && issue->Found == lib3);
+	CHECK(issue && issue->Expected == Upper(CMsftBuilder::TestGuid(1)) + L" 1.0");
+
+	//a key of an unknown class that points at an unknown library is not an issue
+	CHECK(!FindIssue(checker, classKey(16) + L"\\TypeLib", false));
+	CHECK(!FindIssue(checker, lowerCustom + L"\\TypeLib", true));
+}
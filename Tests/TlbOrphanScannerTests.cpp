@@ -0,0 +1,177 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "TlbOrphanScanner.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+#include <algorithm>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const REGSAM ReadWrite = GENERIC_READ | GENERIC_WRITE;
+
+	//A hive that refuses to delete keys whose path contains a given text
+	class CRefusingBackend : public CMemRegBackend
+	{
+	public:
+		std::wstring FailOn;
+
+		LSTATUS DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction) override
+		{
+			if (!FailOn.empty() && subKey && std::wstring(subKey).find(FailOn) != std::wstring::npos)
+				return ERROR_ACCESS_DENIED;
+			return CMemRegBackend::DeleteKey(parent, subKey, transaction);
+		}
+	};
+
+	void Register(CMemRegBackend& hive, HKEY root, const std::wstring& key, const std::wstring& path)
+	{
+		CHKey::Create(root, L"Software\\Classes\\TypeLib\\" + key, ReadWrite, INVALID_HANDLE_VALUE, &hive)
+			.SetValue(L"", path);
+	}
+
+	bool Registered(CMemRegBackend& hive, HKEY root, const std::wstring& key)
+	{
+		return CHKey::Exists(root, L"Software\\Classes\\TypeLib\\" + key, INVALID_HANDLE_VALUE, &hive);
+	}
+
+	//Libraries A to D per machine and B per user:
+	//  A  a file on one platform, none on the other
+	//  B  no file for any version
+	//  C  a file for one locale, none for the other
+	//  D  a path that is not checked, and keys that are not registrations
+	void BuildRegistry(CMemRegBackend& hive, const CTempDir& dir)
+	{
+		std::wstring present = dir.File(L"present.tlb");
+		WriteBytes(present, { 'M', 'S', 'F', 'T' });
+		std::wstring missing = dir.File(L"missing.tlb");
+
+		Register(hive, HKEY_LOCAL_MACHINE, L"A\\1.0\\0\\win32", present);
+		Register(hive, HKEY_LOCAL_MACHINE, L"A\\1.0\\0\\win64", missing);
+		Register(hive, HKEY_LOCAL_MACHINE, L"A\\1.0\\FLAGS", L"0");
+		Register(hive, HKEY_LOCAL_MACHINE, L"B\\1.0\\0\\win32", missing);
+		Register(hive, HKEY_LOCAL_MACHINE, L"B\\2.0\\0\\win32", L"\"" + missing + L"\"");
+		Register(hive, HKEY_LOCAL_MACHINE, L"C\\1.0\\409\\win32", present + L"\\2");
+		Register(hive, HKEY_LOCAL_MACHINE, L"C\\1.0\\0\\win32", missing + L"\\3");
+		Register(hive, HKEY_LOCAL_MACHINE, L"D\\1.0\\0\\win32", L"relative.tlb");
+		Register(hive, HKEY_LOCAL_MACHINE, L"D\\1.0\\0\\other", missing);
+		Register(hive, HKEY_LOCAL_MACHINE, L"D\\1.0\\HELPDIR", missing);
+		Register(hive, HKEY_CURRENT_USER, L"B\\1.0\\0\\win32", missing);
+	}
+
+	size_t CountState(const CTlbOrphanScanner& scanner, ETlbFileState state)
+	{
+		return std::count(scanner.States().begin(), scanner.States().end(), state);
+	}
+}
+
+TEST(TlbOrphanScanner, FindsOrphans)
+{
+	CTempDir dir;
+	CMemRegBackend hive;
+	BuildRegistry(hive, dir);
+	CThreadPool pool(4);
+	CTlbOrphanScanner scanner(&hive, pool);
+	scanner.SetIoThreads(3);
+	scanner.Scan();
+
+	const std::vector<CTlbRegistration>& registrations = scanner.Registrations();
+	CHECK(registrations.size() == 8);
+	CHECK(scanner.States().size() == registrations.size());
+	CHECK(scanner.FileCount() == 3);
+	CHECK(CountState(scanner, ETlbFileState::PRESENT) == 2);
+	CHECK(CountState(scanner, ETlbFileState::MISSING) == 5);
+	CHECK(CountState(scanner, ETlbFileState::UNCHECKED) == 1);
+	CHECK(scanner.Orphans().size() == 5);
+	for (size_t i = 0; i < registrations.size(); i++) {
+		const CTlbRegistration& registration = registrations[i];
+		CHECK(registration.Key == L"TypeLib\\" + registration.LibId + L"\\" + registration.Version + L"\\" +
+			registration.Locale + L"\\" + registration.Platform);
+		if (registration.Key == L"TypeLib\\C\\1.0\\409\\win32")
+			CHECK(!registration.PerUser && scanner.States()[i] == ETlbFileState::PRESENT);
+		if (registration.LibId == L"D")
+			CHECK(registration.Path == L"relative.tlb" && scanner.States()[i] == ETlbFileState::UNCHECKED);
+		if (registration.PerUser)
+			CHECK(registration.Key == L"TypeLib\\B\\1.0\\0\\win32" && scanner.States()[i] == ETlbFileState::MISSING);
+	}
+
+	std::vector<std::wstring> keys = scanner.OrphanKeys(false);
+	std::sort(keys.begin(), keys.end());
+	CHECK((keys == std::vector<std::wstring>{ L"TypeLib\\A\\1.0\\0\\win64", L"TypeLib\\B", L"TypeLib\\C\\1.0\\0" }));
+	CHECK((scanner.OrphanKeys(true) == std::vector<std::wstring>{ L"TypeLib\\B" }));
+}
+
+TEST(TlbOrphanScanner, Fix)
+{
+	for (size_t batchSize : { 1, 2, 100 }) {
+		CTempDir dir;
+		CMemRegBackend hive;
+		BuildRegistry(hive, dir);
+		CTlbOrphanScanner scanner(&hive);
+		scanner.SetBatchSize(batchSize);
+		scanner.Scan();
+		CHECK(scanner.Fix() == 4);
+
+		CHECK(Registered(hive, HKEY_LOCAL_MACHINE, L"A\\1.0\\0\\win32"));
+		CHECK(Registered(hive, HKEY_LOCAL_MACHINE, L"A\\1.0\\FLAGS"));
+		CHECK(!Registered(hive, HKEY_LOCAL_MACHINE, L"A\\1.0\\0\\win64"));
+		CHECK(!Registered(hive, HKEY_LOCAL_MACHINE, L"B"));
+		CHECK(Registered(hive, HKEY_LOCAL_MACHINE, L"C\\1.0\\409\\win32"));
+		CHECK(!Registered(hive, HKEY_LOCAL_MACHINE, L"C\\1.0\\0"));
+		CHECK(Registered(hive, HKEY_LOCAL_MACHINE, L"D\\1.0\\0\\other"));
+		CHECK(!Registered(hive, HKEY_CURRENT_USER, L"B"));
+		CHECK(CHKey::Exists(HKEY_CURRENT_USER, L"Software\\Classes\\TypeLib", INVALID_HANDLE_VALUE, &hive));
+
+		//what is left has a file, or is not checked
+		CHECK(scanner.Registrations().size() == 3 && scanner.Orphans().empty());
+		CTlbOrphanScanner again(&hive);
+		again.Scan();
+		CHECK(again.Registrations().size() == 3 && again.Orphans().empty());
+	}
+}
+
+TEST(TlbOrphanScanner, FailedBatch)
+{
+	CTempDir dir;
+	CRefusingBackend hive;
+	BuildRegistry(hive, dir);
+	hive.FailOn = L"TypeLib\\C";
+	CTlbOrphanScanner scanner(&hive);
+	scanner.SetBatchSize(1);
+	scanner.Scan();
+	CHECK_THROWS(scanner.Fix(), Win32Exception);
+
+	//the batches before the one that failed stay deleted, the one that failed is rolled back
+	CHECK(!Registered(hive, HKEY_LOCAL_MACHINE, L"A\\1.0\\0\\win64"));
+	CHECK(!Registered(hive, HKEY_LOCAL_MACHINE, L"B"));
+	CHECK(Registered(hive, HKEY_LOCAL_MACHINE, L"C\\1.0\\0\\win32"));
+
+	//scanning and fixing again finishes the job
+	hive.FailOn.clear();
+	CTlbOrphanScanner again(&hive);
+	again.Scan();
+	CHECK(again.Orphans().size() == 2);
+	CHECK(again.Fix() == 2);
+	CHECK(!Registered(hive, HKEY_LOCAL_MACHINE, L"C\\1.0\\0"));
+	CHECK(!Registered(hive, HKEY_CURRENT_USER, L"B"));
+}
@@ -0,0 +1,185 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "MsftBuilder.h"
+#include "TlbRegPlan.h"
+#include "MemRegBackend.h"
+#include "StringHelper.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const REGSAM ReadWrite = GENERIC_READ | GENERIC_WRITE;
+
+	//An oleautomation interface, a custom interface and a dispinterface
+	CTlbMetadata Library()
+	{
+		CTlbMetadata library;
+		library.Guid = CMsftBuilder::TestGuid(1);
+		library.MajorVersion = 1;
+		library.MinorVersion = 0;
+		library.Flags = 0;
+		library.LocaleID = 0;
+		library.SysKind = SYS_WIN32;
+		library.Path = L"C:/Libs/Lib.tlb";
+		library.Name = L"Lib";
+		library.Types.push_back({ TKIND_INTERFACE, CMsftBuilder::TestGuid(11), L"IAuto", TYPEFLAG_FOLEAUTOMATION, 1, 0 });
+		library.Types.push_back({ TKIND_INTERFACE, CMsftBuilder::TestGuid(12), L"ICustom", 0, 1, 0 });
+		library.Types.push_back({ TKIND_DISPATCH, CMsftBuilder::TestGuid(13), L"DEvents", 0, 1, 0 });
+		return library;
+	}
+
+	CHKey Classes(CMemRegBackend& hive, const std::wstring& key)
+	{
+		return CHKey::Create(HKEY_LOCAL_MACHINE, CTlbRegistrar::ClassesPath + key, ReadWrite,
+			INVALID_HANDLE_VALUE, &hive);
+	}
+
+	//Every value below the Classes key that registration writes into
+	std::wstring Dump(CMemRegBackend& hive)
+	{
+		std::wstring dump;
+		std::vector<std::wstring> roots = { L"TypeLib", L"Interface" };
+		for (const std::wstring& root : roots) {
+			if (!CHKey::Exists(HKEY_LOCAL_MACHINE, CTlbRegistrar::ClassesPath + root, INVALID_HANDLE_VALUE, &hive))
+				continue;
+			std::vector<std::wstring> pending = { root };
+			while (!pending.empty()) {
+				std::wstring path = pending.back();
+				pending.pop_back();
+				CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, CTlbRegistrar::ClassesPath + path, GENERIC_READ,
+					INVALID_HANDLE_VALUE, &hive);
+				dump += path + L"\n";
+				for (const std::wstring& name : key.GetValues())
+					dump += L" " + name + L"=" + key.GetWSValue(name) + L"\n";
+				for (const std::wstring& subKey : key.GetSubKeys())
+					pending.push_back(path + L"\\" + subKey);
+			}
+		}
+		return dump;
+	}
+}
+
+TEST(TlbRegPlan, EmptyHive)
+{
+	CMemRegBackend hive;
+	CTlbRegPlan plan(false, &hive);
+	CHECK(plan.Root() == HKEY_LOCAL_MACHINE);
+	plan.Add(Library());
+
+	std::vector<CTlbRegValue> values;
+	CTlbRegistrar::GetValues(Library(), values);
+	CHECK(plan.Changes().size() == values.size() && plan.UnchangedCount() == 0);
+	for (size_t i = 0; i < values.size(); i++) {
+		const CTlbRegChange& change = plan.Changes()[i];
+		CHECK(change.Change == ETlbRegChange::CREATE);
+		CHECK(change.Key == values[i].Key && change.Name == values[i].Name && change.NewData == values[i].Data);
+	}
+
+	//the plan does not write, Apply writes the same as the registrar
+	size_t keys = hive.KeyCount();
+	CHECK(Dump(hive).empty());
+	plan.Apply();
+	CHECK(hive.KeyCount() > keys);
+
+	CMemRegBackend expected;
+	CTlbRegistrar registrar(false, &expected);
+	registrar.Add(Library());
+	registrar.Apply();
+	CHECK(Dump(hive) == Dump(expected));
+}
+
+TEST(TlbRegPlan, RegisteredLibraryWritesNothing)
+{
+	CMemRegBackend hive;
+	CTlbRegistrar registrar(false, &hive);
+	registrar.Add(Library());
+	registrar.Apply();
+
+	CTlbRegPlan plan(false, &hive);
+	plan.Add(Library());
+	CHECK(plan.Changes().empty());
+	CHECK(plan.UnchangedCount() == registrar.Values().size());
+	plan.Apply();
+
+	//registered per machine is not registered per user
+	CTlbRegPlan perUser(true, &hive);
+	perUser.Add(Library());
+	CHECK(perUser.Changes().size() == registrar.Values().size() && perUser.UnchangedCount() == 0);
+}
+
+TEST(TlbRegPlan, ChangedValues)
+{
+	CMemRegBackend hive;
+	CTlbRegistrar registrar(false, &hive);
+	registrar.Add(Library());
+	registrar.Apply();
+	std::wstring registered = Dump(hive);
+
+	std::wstring version = L"TypeLib\\" + WStringFromGUID(CMsftBuilder::TestGuid(1)) + L"\\1.0";
+	Classes(hive, version + L"\\0\\win32").SetValue(L"", L"D:/Old/Lib.tlb");
+	Classes(hive, version + L"\\FLAGS").SetValue(L"", (DWORD)0);
+	CHKey::DeleteTree(HKEY_LOCAL_MACHINE, (CTlbRegistrar::ClassesPath + version + L"\\HELPDIR").c_str(), true,
+		INVALID_HANDLE_VALUE, &hive);
+
+	CTlbRegPlan plan(false, &hive);
+	plan.Add(Library());
+	const std::vector<CTlbRegChange>& changes = plan.Changes();
+	CHECK(changes.size() == 3 && plan.UnchangedCount() == registrar.Values().size() - 3);
+	CHECK(changes[0].Change == ETlbRegChange::UPDATE && changes[0].Key == version + L"\\0\\win32");
+	CHECK(changes[0].OldData == L"D:/Old/Lib.tlb" && changes[0].NewData == L"C:/Libs/Lib.tlb");
+	CHECK(changes[1].Change == ETlbRegChange::UPDATE && changes[1].OldData == L"<type 4>" && changes[1].NewData == L"0");
+	CHECK(changes[2].Change == ETlbRegChange::CREATE && changes[2].Key == version + L"\\HELPDIR");
+
+	plan.Apply();
+	CHECK(Dump(hive) == registered);
+}
+
+TEST(TlbRegPlan, StaleInterfaces)
+{
+	CMemRegBackend hive;
+	CTlbRegistrar registrar(false, &hive);
+	registrar.Add(Library());
+	registrar.Apply();
+
+	//the custom interface points at another library; IAuto loses [oleautomation]
+	std::wstring custom = L"Interface\\" + WStringFromGUID(CMsftBuilder::TestGuid(12));
+	CHKey typeLib = Classes(hive, custom + L"\\TypeLib");
+	typeLib.SetValue(L"", WStringFromGUID(CMsftBuilder::TestGuid(2)));
+	typeLib.SetValue(L"Version", L"1.0");
+	CTlbMetadata library = Library();
+	library.Types[0].Flags = 0;
+
+	CTlbRegPlan plan(false, &hive);
+	plan.Add(library);
+	CHECK(plan.Changes().size() == 1);
+	std::wstring automation = L"Interface\\" + WStringFromGUID(CMsftBuilder::TestGuid(11));
+	CHECK(plan.Changes()[0].Change == ETlbRegChange::DELETE_KEY && plan.Changes()[0].Key == automation);
+
+	plan.Apply();
+	CHECK(!CHKey::Exists(HKEY_LOCAL_MACHINE, CTlbRegistrar::ClassesPath + automation, INVALID_HANDLE_VALUE, &hive));
+	CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, CTlbRegistrar::ClassesPath + custom, INVALID_HANDLE_VALUE, &hive));
+
+	CTlbRegPlan again(false, &hive);
+	again.Add(library);
+	CHECK(again.Changes().empty());
+}
@@ -0,0 +1,161 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "MsftBuilder.h"
+#include "TlbRegistrar.h"
+#include "MemRegBackend.h"
+#include "StringHelper.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	//A hive that refuses to write values with a given name
+	class CRefusingBackend : public CMemRegBackend
+	{
+	public:
+		std::wstring FailOn;
+
+		LSTATUS SetValue(HKEY key, LPCWSTR valueName, DWORD type, const BYTE* data, DWORD size) override
+		{
+			if (!FailOn.empty() && valueName && FailOn == valueName)
+				return ERROR_ACCESS_DENIED;
+			return CMemRegBackend::SetValue(key, valueName, type, data, size);
+		}
+	};
+
+	//A library with an interface of every kind that registration treats differently
+	CTlbMetadata Library(uint32_t number)
+	{
+		CTlbMetadata library;
+		library.Guid = CMsftBuilder::TestGuid(number);
+		library.MajorVersion = 2;
+		library.MinorVersion = 10;
+		library.Flags = LIBFLAG_FCONTROL | LIBFLAG_FHIDDEN;
+		library.LocaleID = 0x409;
+		library.SysKind = SYS_WIN64;
+		library.Path = L"C:/Libs/Lib" + std::to_wstring(number) + L".tlb";
+		library.Name = L"Lib" + std::to_wstring(number);
+		library.Types.push_back({ TKIND_INTERFACE, CMsftBuilder::TestGuid(number * 10 + 1), L"IAuto", TYPEFLAG_FOLEAUTOMATION, 1, 0 });
+		library.Types.push_back({ TKIND_INTERFACE, CMsftBuilder::TestGuid(number * 10 + 2), L"ICustom", 0, 1, 0 });
+		library.Types.push_back({ TKIND_DISPATCH, CMsftBuilder::TestGuid(number * 10 + 3), L"DDual", TYPEFLAG_FDUAL, 1, 0 });
+		library.Types.push_back({ TKIND_DISPATCH, CMsftBuilder::TestGuid(number * 10 + 4), L"DEvents", 0, 1, 0 });
+		library.Types.push_back({ TKIND_COCLASS, CMsftBuilder::TestGuid(number * 10 + 5), L"Lib", TYPEFLAG_FCANCREATE, 1, 0 });
+		return library;
+	}
+
+	std::wstring ReadValue(HKEY root, const CTlbRegValue& value, IRegBackend* backend)
+	{
+		CHKey key = CHKey::Open(root, CTlbRegistrar::ClassesPath + value.Key, GENERIC_READ,
+			INVALID_HANDLE_VALUE, backend);
+		return key.GetWSValue(value.Name);
+	}
+}
+
+TEST(TlbRegistrar, Values)
+{
+	CTlbMetadata library = Library(1);
+	std::vector<CTlbRegValue> values;
+	CTlbRegistrar::GetValues(library, values);
+	CHECK(values.size() == 4 + 3 * 5);
+
+	std::wstring version = L"TypeLib\\" + WStringFromGUID(library.Guid) + L"\\2.a";
+	CHECK(values[0].Key == version && values[0].Name.empty() && values[0].Data == L"Lib1");
+	CHECK(values[1].Key == version + L"\\409\\win64" && values[1].Data == library.Path);
+	CHECK(values[2].Key == version + L"\\FLAGS" && values[2].Data == L"6");
+	CHECK(values[3].Key == version + L"\\HELPDIR" && values[3].Data == L"C:/Libs");
+
+	//the oleautomation interface and both dispinterfaces, not the custom interface or the coclass
+	const wchar_t* typeLibProxy = L"{00020424-0000-0000-C000-000000000046}";
+	const wchar_t* dispatchProxy = L"{00020420-0000-0000-C000-000000000046}";
+	const CTlbTypeEntry* registered[] = { &library.Types[0], &library.Types[2], &library.Types[3] };
+	const wchar_t* proxies[] = { typeLibProxy, typeLibProxy, dispatchProxy };
+	for (size_t i = 0; i < 3; i++) {
+		const CTlbRegValue* value = &values[4 + i * 5];
+		std::wstring key = L"Interface\\" + WStringFromGUID(registered[i]->Guid);
+		CHECK(value[0].Key == key && value[0].Data == registered[i]->Name);
+		CHECK(value[1].Key == key + L"\\ProxyStubClsid" && value[1].Data == proxies[i]);
+		CHECK(value[2].Key == key + L"\\ProxyStubClsid32" && value[2].Data == proxies[i]);
+		CHECK(value[3].Key == key + L"\\TypeLib" && value[3].Name.empty() && value[3].Data == WStringFromGUID(library.Guid));
+		CHECK(value[4].Key == key + L"\\TypeLib" && value[4].Name == L"Version" && value[4].Data == L"2.a");
+	}
+	CHECK(!CTlbRegistrar::RegistersInterface(library.Types[1]));
+	CHECK(!CTlbRegistrar::RegistersInterface(library.Types[4]));
+
+	//the description wins over the name
+	library.DocString = L"Library one";
+	values.clear();
+	CTlbRegistrar::GetValues(library, values);
+	CHECK(values[0].Data == L"Library one");
+
+	library.SysKind = SYS_MAC;
+	CHECK_THROWS(CTlbRegistrar::GetValues(library, values), Win32Exception);
+}
+
+TEST(TlbRegistrar, Apply)
+{
+	for (bool perUser : { false, true }) {
+		CMemRegBackend hive;
+		CTlbRegistrar registrar(perUser, &hive);
+		CHECK(registrar.Root() == (perUser ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE));
+		for (uint32_t i = 1; i <= 3; i++)
+			registrar.Add(Library(i));
+		CHECK(registrar.Values().size() == 3 * 19);
+		registrar.Apply();
+
+		for (const CTlbRegValue& value : registrar.Values())
+			CHECK(ReadValue(registrar.Root(), value, &hive) == value.Data);
+		CHECK(!CHKey::Exists(perUser ? HKEY_LOCAL_MACHINE : HKEY_CURRENT_USER,
+			L"Software\\Classes\\TypeLib", INVALID_HANDLE_VALUE, &hive));
+
+		//registering again writes the same keys
+		size_t keys = hive.KeyCount();
+		registrar.Apply();
+		CHECK(hive.KeyCount() == keys);
+	}
+}
+
+TEST(TlbRegistrar, FailureChangesNothing)
+{
+	CRefusingBackend hive;
+	hive.FailOn = L"Version";
+	CTlbRegistrar registrar(false, &hive);
+	registrar.Add(Library(1));
+	size_t keys = hive.KeyCount();
+	try {
+		registrar.Apply();
+		CHECK(false);
+	}
+	catch (Win32Exception& ex) {
+		CHECK(ex.Value() == ERROR_ACCESS_DENIED);
+	}
+	CHECK(hive.KeyCount() == keys);
+	CHECK(!CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\Classes\\TypeLib", INVALID_HANDLE_VALUE, &hive));
+
+	//in a transaction of the caller, which is not committed
+	hive.FailOn.clear();
+	HANDLE transaction;
+	CHECK(hive.CreateTransaction(&transaction) == ERROR_SUCCESS);
+	registrar.Apply(transaction);
+	CHECK(hive.RollbackTransaction(transaction) == ERROR_SUCCESS);
+	CHECK(hive.CloseTransaction(transaction) == ERROR_SUCCESS);
+	CHECK(hive.KeyCount() == keys);
+}
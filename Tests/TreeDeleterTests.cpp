@@ -0,0 +1,203 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "TreeDeleter.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+#include <filesystem>
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const REGSAM ReadWrite = GENERIC_READ | GENERIC_WRITE;
+
+	//A hive that counts enumerations and deletions, and can refuse to delete a key
+	class CCountingBackend : public CMemRegBackend
+	{
+	public:
+		std::wstring FailOn;
+		std::atomic<size_t> Enumerations{ 0 };
+		std::atomic<size_t> Deletions{ 0 };
+
+		LSTATUS EnumKey(HKEY key, DWORD index, LPWSTR name, DWORD* nameLength) override
+		{
+			Enumerations++;
+			return CMemRegBackend::EnumKey(key, index, name, nameLength);
+		}
+
+		LSTATUS DeleteKey(HKEY parent, LPCWSTR subKey, HANDLE transaction) override
+		{
+			if (subKey && FailOn == subKey)
+				return ERROR_ACCESS_DENIED;
+			Deletions++;
+			return CMemRegBackend::DeleteKey(parent, subKey, transaction);
+		}
+	};
+
+	struct CProgress : IDeleteProgress
+	{
+		std::vector<size_t> Deleted;
+		size_t Total = 0;
+
+		void OnProgress(size_t deleted, size_t total) override
+		{
+			Deleted.push_back(deleted);
+			Total = total;
+		}
+	};
+
+	//A tree of width^1 + ... + width^depth keys below Software\Tree, with values everywhere
+	void BuildTree(CHKey& key, size_t width, size_t depth)
+	{
+		key.SetValue(L"v", key.Name());
+		key.SetValue(L"w", (DWORD)depth);
+		if (depth == 0)
+			return;
+		for (size_t i = 0; i < width; i++) {
+			CHKey subKey = key.CreateSubKey(L"K" + std::to_wstring(i), ReadWrite);
+			BuildTree(subKey, width, depth - 1);
+		}
+	}
+
+	CHKey BuildHive(CMemRegBackend& hive, size_t width, size_t depth)
+	{
+		CHKey key = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Tree", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+		BuildTree(key, width, depth);
+		CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\TreeSibling", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+		return key;
+	}
+}
+
+TEST(TreeDeleter, SameResultAsDeleteTree)
+{
+	for (bool deleteSubKey : { true, false }) {
+		CMemRegBackend expected;
+		BuildHive(expected, 3, 3);
+		CHKey::DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Tree", deleteSubKey, INVALID_HANDLE_VALUE, &expected);
+		size_t expectedKeys = expected.KeyCount();
+
+		for (size_t threads : { 1, 4 }) {
+			for (size_t batchSize : { 1, 2, 7, 1000 }) {
+				CMemRegBackend hive;
+				BuildHive(hive, 3, 3);
+				CThreadPool pool(threads);
+				CTreeDeleter deleter(&hive, pool);
+				deleter.SetBatchSize(batchSize);
+				CProgress progress;
+				deleter.SetProgress(&progress);
+				deleter.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Tree", deleteSubKey);
+
+				CHECK(deleter.DeletedCount() == 3 + 9 + 27);
+				CHECK(hive.KeyCount() == expectedKeys);
+				CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\Tree", INVALID_HANDLE_VALUE, &hive) == !deleteSubKey);
+				CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\TreeSibling", INVALID_HANDLE_VALUE, &hive));
+				if (!deleteSubKey) {
+					CHKey root = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Tree", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+					CHECK(root.GetValues().empty());
+					CHECK(root.GetSubKeys().empty());
+				}
+
+				CHECK(!progress.Deleted.empty());
+				CHECK(progress.Total == 3 + 9 + 27);
+				CHECK(progress.Deleted.back() == progress.Total);
+				CHECK(std::is_sorted(progress.Deleted.begin(), progress.Deleted.end()));
+			}
+		}
+	}
+}
+
+TEST(TreeDeleter, ResumesFromTheCheckpoint)
+{
+	CTempDir dir;
+	std::wstring checkpoint = dir.File(L"delete.ckp");
+	CCountingBackend hive;
+	BuildHive(hive, 4, 3);
+	size_t before = hive.KeyCount();
+	CThreadPool pool(4);
+
+	//the first run stops at a key on the middle level
+	hive.FailOn = L"K2\\K1";
+	CTreeDeleter deleter(&hive, pool);
+	deleter.SetBatchSize(3);
+	deleter.SetCheckpointFile(checkpoint);
+	CHECK_THROWS(deleter.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Tree", true), Win32Exception);
+	CHECK(std::filesystem::exists(std::filesystem::path(checkpoint)));
+	size_t firstRun = deleter.DeletedCount();
+	CHECK(firstRun >= 64);      //the deepest level is gone
+	CHECK(firstRun < 64 + 16);
+	CHECK(hive.KeyCount() == before - firstRun);
+
+	//the second run does not enumerate again and skips the batches that were committed
+	hive.FailOn.clear();
+	hive.Enumerations = 0;
+	hive.Deletions = 0;
+	CProgress progress;
+	CTreeDeleter resumed(&hive, pool);
+	resumed.SetBatchSize(3);
+	resumed.SetCheckpointFile(checkpoint);
+	resumed.SetProgress(&progress);
+	resumed.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Tree", true);
+	CHECK(hive.Enumerations == 0);
+	CHECK(resumed.DeletedCount() == 4 + 16 + 64);
+	CHECK(progress.Deleted.front() > firstRun);
+	CHECK(hive.Deletions == 4 + 16 + 64 - firstRun + 1);
+	CHECK(!CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\Tree", INVALID_HANDLE_VALUE, &hive));
+	CHECK(hive.KeyCount() == before - 4 - 16 - 64 - 1);
+	CHECK(!std::filesystem::exists(std::filesystem::path(checkpoint)));
+}
+
+TEST(TreeDeleter, UnusableCheckpointsAreIgnored)
+{
+	CTempDir dir;
+	std::wstring checkpoint = dir.File(L"delete.ckp");
+	CThreadPool pool(2);
+
+	//a checkpoint of another tree, of other batches, and garbage
+	CCountingBackend other;
+	BuildHive(other, 2, 2);
+	CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Other", ReadWrite, INVALID_HANDLE_VALUE, &other).CreateSubKey(L"A", ReadWrite);
+	other.FailOn = L"A";
+	CTreeDeleter failing(&other, pool);
+	failing.SetCheckpointFile(checkpoint);
+	CHECK_THROWS(failing.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Other", true), Win32Exception);
+	std::vector<BYTE> otherTree = ReadBytes(checkpoint);
+
+	other.FailOn = L"K1";
+	failing.SetBatchSize(1);
+	CHECK_THROWS(failing.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Tree", true), Win32Exception);
+	std::vector<BYTE> otherBatches = ReadBytes(checkpoint);
+
+	std::vector<BYTE> garbage = otherBatches;
+	for (size_t i = 8; i < garbage.size(); i++)
+		garbage[i] = (BYTE)(i * 7);
+
+	for (const std::vector<BYTE>* file : { &otherTree, &otherBatches, &garbage }) {
+		CCountingBackend hive;
+		BuildHive(hive, 2, 2);
+		WriteBytes(checkpoint, *file);
+		CTreeDeleter deleter(&hive, pool);
+		deleter.SetCheckpointFile(checkpoint);
+		deleter.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\Tree", true);
+		CHECK(hive.Enumerations > 0);
+		CHECK(deleter.DeletedCount() == 2 + 4);
+		CHECK(!CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\Tree", INVALID_HANDLE_VALUE, &hive));
+	}
+}
@@ -0,0 +1,220 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "HKey.h"
+#include "MemRegBackend.h"
+#include "RegSnapshotFile.h"
+#include "TreeWalker.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const REGSAM ReadWrite = GENERIC_READ | GENERIC_WRITE;
+
+	//A hive that refuses to open keys with a given name
+	class CFailingBackend : public CMemRegBackend
+	{
+	public:
+		std::wstring FailOn;
+
+		LSTATUS OpenKey(HKEY parent, LPCWSTR subKey, REGSAM samDesired, HANDLE transaction,
+			HKEY* result) override
+		{
+			if (subKey && FailOn == subKey)
+				return ERROR_ACCESS_DENIED;
+			return CMemRegBackend::OpenKey(parent, subKey, samDesired, transaction, result);
+		}
+	};
+
+	//Keys 0..width-1 on every level, down to depth, each with a value that names it
+	void BuildTree(CHKey& key, size_t width, size_t depth)
+	{
+		key.SetValue(L"Name", key.Name());
+		if (depth == 0)
+			return;
+		for (size_t i = 0; i < width; i++) {
+			CHKey subKey = key.CreateSubKey(L"K" + std::to_wstring(i), ReadWrite);
+			BuildTree(subKey, width, depth - 1);
+		}
+	}
+
+	//The keys in the order of a recursive walk on one thread
+	void WalkRecursively(CHKey& key, size_t depth, size_t maxDepth, std::vector<std::wstring>& keys)
+	{
+		keys.push_back(std::to_wstring(depth) + L" " + key.Path());
+		if (depth == maxDepth)
+			return;
+		for (const std::wstring& name : key.GetSubKeys()) {
+			CHKey subKey = key.OpenSubKey(name);
+			WalkRecursively(subKey, depth + 1, maxDepth, keys);
+		}
+	}
+
+	struct CRecorder : IKeyVisitor
+	{
+		std::vector<std::wstring> Keys;
+		size_t WrongValues = 0;
+
+		void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+		{
+			Keys.push_back(std::to_wstring(depth) + L" " + key.Path());
+			size_t index = values.Find(L"Name");
+			if (index == CKeySnapshot::npos || values.WSValue(index) != key.Name())
+				WrongValues++;
+		}
+	};
+
+	CHKey Root(CMemRegBackend& hive)
+	{
+		return CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\Tree", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	}
+
+	void BuildHive(CMemRegBackend& hive, size_t width, size_t depth)
+	{
+		CHKey root = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Tree", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+		BuildTree(root, width, depth);
+	}
+}
+
+TEST(TreeWalker, SameOrderAsARecursiveWalk)
+{
+	CMemRegBackend hive;
+	BuildHive(hive, 6, 4);
+	CHKey root = Root(hive);
+	std::vector<std::wstring> expected;
+	WalkRecursively(root, 0, SIZE_MAX, expected);
+	CHECK(expected.size() == 1 + 6 + 36 + 216 + 1296);
+
+	for (size_t threads : { 1, 4 }) {
+		CThreadPool pool(threads);
+		for (size_t window : { (size_t)1, (size_t)5, CTreeWalker::DefaultWindow, CTreeWalker::Unlimited }) {
+			CTreeWalker walker(pool);
+			walker.SetWindow(window);
+			CRecorder recorder;
+			walker.Walk(root, recorder);
+			CHECK(recorder.Keys == expected);
+			CHECK(recorder.WrongValues == 0);
+		}
+	}
+}
+
+TEST(TreeWalker, MaxDepthAndStructureOnly)
+{
+	CMemRegBackend hive;
+	BuildHive(hive, 3, 4);
+	CHKey root = Root(hive);
+	std::vector<std::wstring> expected;
+	WalkRecursively(root, 0, 2, expected);
+
+	CThreadPool pool(4);
+	CTreeWalker walker(pool);
+	walker.SetMaxDepth(2);
+	CRecorder recorder;
+	walker.Walk(root, recorder);
+	CHECK(recorder.Keys == expected);
+
+	//without values, every snapshot is empty
+	CTreeWalker structure(pool, false);
+	CRecorder empty;
+	structure.Walk(root, empty);
+	CHECK(empty.Keys.size() == 1 + 3 + 9 + 27 + 81);
+	CHECK(empty.WrongValues == empty.Keys.size());
+}
+
+TEST(TreeWalker, SortedOrder)
+{
+	CMemRegBackend hive;
+	CHKey root = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\Tree", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+	for (const wchar_t* name : { L"b", L"a b", L"a", L"a_b", L"Aé" })
+		root.CreateSubKey(name, ReadWrite).SetValue(L"Name", name);
+
+	CThreadPool pool(2);
+	CTreeWalker walker(pool);
+	walker.SetOrder(CompareKeyPaths);
+	CRecorder recorder;
+	walker.Walk(root, recorder);
+	CHECK(recorder.Keys.size() == 6);
+	for (size_t i = 2; i < recorder.Keys.size(); i++)
+		CHECK(CompareKeyPaths(recorder.Keys[i - 1].substr(2), recorder.Keys[i].substr(2)) < 0);
+}
+
+TEST(TreeWalker, ErrorWhereARecursiveWalkStops)
+{
+	CFailingBackend hive;
+	BuildHive(hive, 4, 3);
+	hive.FailOn = L"K2";
+	CHKey root = Root(hive);
+
+	//a recursive walk visits everything before the first K2, which is Tree\K0\K0\K2
+	std::vector<std::wstring> expected;
+	hive.FailOn.clear();
+	WalkRecursively(root, 0, SIZE_MAX, expected);
+	hive.FailOn = L"K2";
+	auto first = std::find_if(expected.begin(), expected.end(), [](const std::wstring& key) {
+		return key.size() > 3 && key.compare(key.size() - 3, 3, L"\\K2") == 0;
+	});
+	expected.erase(first, expected.end());
+
+	for (size_t window : { (size_t)1, (size_t)7, CTreeWalker::Unlimited }) {
+		CThreadPool pool(4);
+		CTreeWalker walker(pool);
+		walker.SetWindow(window);
+		CRecorder recorder;
+		bool denied = false;
+		try {
+			walker.Walk(root, recorder);
+		}
+		catch (Win32Exception& ex) {
+			denied = ex.Value() == ERROR_ACCESS_DENIED;
+		}
+		CHECK(denied);
+		CHECK(recorder.Keys == expected);
+	}
+}
+
+TEST(TreeWalker, VisitorExceptionStopsTheWalk)
+{
+	struct CThrower : IKeyVisitor
+	{
+		size_t Visited = 0;
+
+		void Visit(CHKey& key, const CKeySnapshot& values, size_t depth) override
+		{
+			if (++Visited == 50)
+				throw AppException("stop");
+		}
+	};
+
+	CMemRegBackend hive;
+	BuildHive(hive, 5, 4);
+	CHKey root = Root(hive);
+	CThreadPool pool(4);
+	CTreeWalker walker(pool);
+	CThrower thrower;
+	CHECK_THROWS(walker.Walk(root, thrower), AppException);
+	CHECK(thrower.Visited == 50);
+
+	//the walker can be used again
+	CRecorder recorder;
+	walker.Walk(root, recorder);
+	CHECK(recorder.Keys.size() == 1 + 5 + 25 + 125 + 625);
+}
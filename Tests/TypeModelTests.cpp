@@ -0,0 +1,197 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "MsftBuilder.h"
+#include "TypeModel.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	//The types of the sample library with members: functions with parameters on IFoo, including a
+	//property whose accessors share a name, constants on EColor, fields on SPoint and
+	//an alias of a pointer
+	CMsftBuilder MemberSample()
+	{
+		CMsftBuilder members;
+		int intPtr = members.AddTypeDesc(VT_PTR, CMsftBuilder::SimpleType(VT_I4));
+		int bstrPtr = members.AddTypeDesc(VT_PTR, CMsftBuilder::SimpleType(VT_BSTR));
+		members.AddType(TKIND_INTERFACE, CMsftBuilder::TestGuid(1), "IFoo", 0x140);
+		members.AddFunction(0x60010000, "Open", INVOKE_FUNC, CMsftBuilder::SimpleType(VT_HRESULT), "Opens it");
+		members.AddParam("path", CMsftBuilder::SimpleType(VT_BSTR));
+		members.AddParam("flags", intPtr, PARAMFLAG_FIN | PARAMFLAG_FOUT);
+		members.AddFunction(2, "Name", INVOKE_PROPERTYGET, CMsftBuilder::SimpleType(VT_HRESULT));
+		members.AddParam("value", bstrPtr, PARAMFLAG_FOUT | PARAMFLAG_FRETVAL);
+		members.AddFunction(2, "Name", INVOKE_PROPERTYPUT, CMsftBuilder::SimpleType(VT_HRESULT));
+		members.AddParam("value", CMsftBuilder::SimpleType(VT_BSTR));
+		members.AddType(TKIND_DISPATCH, CMsftBuilder::TestGuid(2), "DFoo", 0x1000);
+		members.AddType(TKIND_COCLASS, CMsftBuilder::TestGuid(3), "Foo", 2, 1, 2);
+		members.AddType(TKIND_ENUM, GUID_NULL, "EColor", 0, 0, 0);
+		members.AddConstant(0x40000000, "Red", VT_I4, 0);
+		members.AddConstant(0x40000001, "Green", VT_I4, 0x03FFFFFF);
+		members.AddConstant(0x40000002, "Blue", VT_I4, -5);
+		members.AddConstant(0x40000003, "Huge", VT_I8, 0x123456789ABLL);
+		members.AddType(TKIND_RECORD, CMsftBuilder::TestGuid(4), "SPoint", 0, 0, 0);
+		members.AddField(0x40000000, "x", CMsftBuilder::SimpleType(VT_I4), 0);
+		members.AddField(0x40000001, "y", CMsftBuilder::SimpleType(VT_I4), 4);
+		members.AddType(TKIND_ALIAS, GUID_NULL, "Handle", 0, 0, 0);
+		members.SetAliasType(intPtr);
+		members.AddType(TKIND_INTERFACE, CMsftBuilder::TestGuid(5), "IBar", 0x40);
+		return members;
+	}
+
+	//Everything in the model, one line per row
+	std::wstring DumpModel(const std::wstring& path)
+	{
+		CTypeModel model = CTypeModel::Load(path);
+		const CTypeModel::CTypeTable& types = model.Types();
+		const CTypeModel::CFuncTable& funcs = model.Funcs();
+		const CTypeModel::CParamTable& params = model.Params();
+		const CTypeModel::CVarTable& vars = model.Vars();
+		std::wstring dump;
+		for (size_t i = 0; i < types.Count; i++) {
+			CHECK(types.FirstFunc[i] + types.FuncCount[i] <= funcs.Count);
+			CHECK(types.FirstVar[i] + types.VarCount[i] <= vars.Count);
+			dump += std::wstring(model.String(types.Name[i])) + L" " + std::to_wstring(types.Kind[i]) + L"\n";
+			for (size_t f = types.FirstFunc[i]; f < types.FirstFunc[i] + types.FuncCount[i]; f++) {
+				CHECK(funcs.FirstParam[f] + funcs.ParamCount[f] <= params.Count);
+				dump += L" " + std::wstring(model.String(funcs.Name[f])) + L" " + std::to_wstring(funcs.MemberId[f]) +
+					L" " + std::to_wstring(funcs.ReturnType[f]) + L"\n";
+				for (size_t p = funcs.FirstParam[f]; p < funcs.FirstParam[f] + funcs.ParamCount[f]; p++)
+					dump += L"  " + std::wstring(model.String(params.Name[p])) + L" " + std::to_wstring(params.Type[p]) + L"\n";
+			}
+			for (size_t v = types.FirstVar[i]; v < types.FirstVar[i] + types.VarCount[i]; v++)
+				dump += L" " + std::wstring(model.String(vars.Name[v])) + L" " + std::to_wstring(vars.Value[v]) + L"\n";
+		}
+		return dump;
+	}
+}
+
+TEST(TypeModel, ReadsTypes)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"sample.tlb"), CMsftBuilder::Sample().Build());
+	CTypeModel model = CTypeModel::Load(dir.File(L"sample.tlb"));
+
+	const CTypeModel::CTypeTable& types = model.Types();
+	CHECK(types.Count == 7);
+	CHECK(model.Funcs().Count == 0 && model.Params().Count == 0 && model.Vars().Count == 0);
+	CHECK(model.String(types.Name[0]) == L"IFoo" && types.Kind[0] == TKIND_INTERFACE);
+	CHECK(types.Guid[0] == CMsftBuilder::TestGuid(1) && types.Flags[0] == 0x140);
+	CHECK(model.String(types.Name[2]) == L"Foo" && types.MajorVersion[2] == 1 && types.MinorVersion[2] == 2);
+	CHECK(types.Guid[3] == GUID_NULL);
+	CHECK(types.BaseType[0] == CTypeModel::NoIndex && types.BaseType[2] == CTypeModel::NoIndex);
+	CHECK(model.String(types.DocString[0]).empty());
+	CHECK(model.MemorySize() > 0);
+}
+
+TEST(TypeModel, ReadsMembers)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"members.tlb"), MemberSample().Build());
+	CTypeModel model = CTypeModel::Load(dir.File(L"members.tlb"));
+
+	const CTypeModel::CTypeTable& types = model.Types();
+	const CTypeModel::CFuncTable& funcs = model.Funcs();
+	const CTypeModel::CParamTable& params = model.Params();
+	const CTypeModel::CVarTable& vars = model.Vars();
+	const CTypeModel::CTypeDescTable& typeDescs = model.TypeDescs();
+	CHECK(types.Count == 7 && funcs.Count == 3 && params.Count == 4 && vars.Count == 6);
+	CHECK(typeDescs.Count == 2 && model.Bounds().Count == 0);
+
+	//IFoo has the functions, the types after it none
+	CHECK(types.FirstFunc[0] == 0 && types.FuncCount[0] == 3 && types.VarCount[0] == 0);
+	CHECK(types.FirstFunc[1] == 3 && types.FuncCount[1] == 0);
+	CHECK(model.String(funcs.Name[0]) == L"Open" && model.String(funcs.DocString[0]) == L"Opens it");
+	CHECK(funcs.MemberId[0] == 0x60010000 && funcs.InvokeKind[0] == INVOKE_FUNC);
+	CHECK(funcs.FuncKind[0] == FUNC_PUREVIRTUAL && funcs.CallConv[0] == CC_STDCALL);
+	CHECK(funcs.VtableOffset[0] == 24 && funcs.VtableOffset[1] == 32);
+	CHECK(CTypeModel::IsSimple(funcs.ReturnType[0]) && CTypeModel::SimpleVarType(funcs.ReturnType[0]) == VT_HRESULT);
+	CHECK(funcs.FirstParam[0] == 0 && funcs.ParamCount[0] == 2 && funcs.OptionalParamCount[0] == 0);
+	CHECK(model.String(params.Name[0]) == L"path" && CTypeModel::SimpleVarType(params.Type[0]) == VT_BSTR);
+	CHECK(model.String(params.Name[1]) == L"flags" && params.Type[1] == 0);
+	CHECK(params.Flags[1] == (PARAMFLAG_FIN | PARAMFLAG_FOUT));
+
+	//the put accessor has no name of its own in the file
+	CHECK(model.String(funcs.Name[1]) == L"Name" && funcs.InvokeKind[1] == INVOKE_PROPERTYGET);
+	CHECK(model.String(funcs.Name[2]) == L"Name" && funcs.InvokeKind[2] == INVOKE_PROPERTYPUT);
+	CHECK(funcs.MemberId[1] == 2 && funcs.MemberId[2] == 2);
+	CHECK(model.String(funcs.DocString[1]).empty());
+	CHECK(funcs.FirstParam[1] == 2 && params.Type[2] == 1 && params.Flags[2] == (PARAMFLAG_FOUT | PARAMFLAG_FRETVAL));
+	CHECK(funcs.FirstParam[2] == 3 && CTypeModel::SimpleVarType(params.Type[3]) == VT_BSTR);
+
+	//the type descriptions are pointers to simple types
+	CHECK(typeDescs.VarType[0] == VT_PTR && CTypeModel::SimpleVarType(typeDescs.Inner[0]) == VT_I4);
+	CHECK(typeDescs.VarType[1] == VT_PTR && CTypeModel::SimpleVarType(typeDescs.Inner[1]) == VT_BSTR);
+	CHECK(typeDescs.RefType[0] == CTypeModel::NoIndex && typeDescs.DimCount[0] == 0);
+
+	//constants, in the record and in the custom data
+	CHECK(types.FirstVar[3] == 0 && types.VarCount[3] == 4 && types.FuncCount[3] == 0);
+	const wchar_t* names[] = { L"Red", L"Green", L"Blue", L"Huge" };
+	VARTYPE valueTypes[] = { VT_I4, VT_I4, VT_I4, VT_I8 };
+	LONGLONG values[] = { 0, 0x03FFFFFF, -5, 0x123456789ABLL };
+	for (size_t i = 0; i < 4; i++) {
+		CHECK(model.String(vars.Name[i]) == names[i]);
+		CHECK(vars.MemberId[i] == (MEMBERID)(0x40000000 + i));
+		CHECK(vars.VarKind[i] == VAR_CONST && vars.Offset[i] == 0);
+		CHECK(vars.ValueType[i] == valueTypes[i] && vars.Value[i] == values[i]);
+	}
+
+	//fields
+	CHECK(types.FirstVar[4] == 4 && types.VarCount[4] == 2);
+	CHECK(model.String(vars.Name[5]) == L"y" && vars.VarKind[5] == VAR_PERINSTANCE && vars.Offset[5] == 4);
+	CHECK(vars.ValueType[5] == VT_EMPTY && CTypeModel::SimpleVarType(vars.Type[5]) == VT_I4);
+
+	CHECK(types.AliasType[5] == 0 && types.AliasType[0] == CTypeModel::NoIndex);
+	CHECK(types.FirstFunc[6] == 3 && types.FirstVar[6] == 6 && types.FuncCount[6] == 0);
+}
+
+TEST(TypeModel, LocalType)
+{
+	CTempDir dir;
+	WriteBytes(dir.File(L"sample.tlb"), CMsftBuilder::Sample().Build());
+	CTypeModel model = CTypeModel::Load(dir.File(L"sample.tlb"));
+	CHECK(model.LocalType(0) == 0);
+	CHECK(model.LocalType(6 * 0x64) == 6);
+	CHECK(model.LocalType(7 * 0x64) == CTypeModel::NoIndex);
+	CHECK(model.LocalType(0x64 + 1) == CTypeModel::NoIndex);
+	CHECK(model.LocalType(CTypeModel::NoIndex) == CTypeModel::NoIndex);
+}
+
+TEST(TypeModel, NotMsft)
+{
+	CTempDir dir;
+	std::vector<BYTE> sltg = { 'S', 'L', 'T', 'G' };
+	sltg.resize(200);
+	WriteBytes(dir.File(L"sltg.tlb"), sltg);
+	CHECK_THROWS(CTypeModel::Load(dir.File(L"sltg.tlb")), Win32Exception);
+}
+
+TEST(TypeModel, DamagedLibrary)
+{
+	CTempDir dir;
+	std::vector<BYTE> bytes = MemberSample().Build();
+	CDamageCheck check;
+	check.Read = DumpModel;
+	check.Mutations = 1000;
+	check.Seed = 23;
+	check.Run(bytes, dir);
+}
@@ -0,0 +1,231 @@
+//RegTlb.exe a program to manage Type Library registration
+//Copyright(C) 2024 Bruno van Dooren
+//
+//This program is free software : you can redistribute it and /or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+//
+//This program is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+//GNU General Public License for more details.
+//
+//You should have received a copy of the GNU General Public License
+//along with this program.If not, see < https://www.gnu.org/licenses/>
+
+
+#include "pch.h"
+#include "Test.h"
+#include "WriteBatch.h"
+#include "MemRegBackend.h"
+#include "Exception.h"
+
+using namespace w32;
+using namespace w32::test;
+
+namespace
+{
+	const REGSAM ReadWrite = GENERIC_READ | GENERIC_WRITE;
+
+	//Every key from HKLM\Software down with its values, sorted, one line per key
+	void Dump(CHKey& key, std::vector<std::wstring>& lines)
+	{
+		std::vector<std::wstring> values;
+		for (const std::wstring& name : key.GetValues()) {
+			std::wstring data;
+			try {
+				data = std::to_wstring(key.GetDWValue(name));
+			}
+			catch (AppException&) {
+				data = L"\"" + key.GetWSValue(name) + L"\"";
+			}
+			values.push_back(ToWUpperName(name) + L"=" + data);
+		}
+		std::sort(values.begin(), values.end());
+		std::wstring line = ToWUpperName(key.Path());
+		for (const std::wstring& value : values)
+			line += L" " + value;
+		lines.push_back(line);
+		for (const std::wstring& name : key.GetSubKeys()) {
+			CHKey subKey = key.OpenSubKey(name);
+			Dump(subKey, lines);
+		}
+	}
+
+	std::vector<std::wstring> Dump(CMemRegBackend& hive)
+	{
+		std::vector<std::wstring> lines;
+		CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+		Dump(key, lines);
+		return lines;
+	}
+
+	void CreateKeys(CMemRegBackend& hive)
+	{
+		CHKey a = CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\A", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+		a.SetValue(L"v", L"a");
+		a.CreateSubKey(L"B", ReadWrite).SetValue(L"w", (DWORD)1);
+		CHKey::Create(HKEY_LOCAL_MACHINE, L"Software\\C", ReadWrite, INVALID_HANDLE_VALUE, &hive);
+	}
+
+	//One random operation, added to a batch and performed directly on another hive
+	void RandomOperation(CRandom& random, CWriteBatch& batch, CMemRegBackend& direct)
+	{
+		static const wchar_t* const Keys[] = { L"Software\\A", L"software\\a\\b\\", L"Software\\C", L"Software\\A\\D" };
+		static const wchar_t* const Values[] = { L"v", L"V", L"w" };
+		const wchar_t* path = Keys[random.Next(4)];
+		const wchar_t* name = Values[random.Next(3)];
+		try {
+			switch (random.Next(4)) {
+			case 0:
+				batch.CreateKey(HKEY_LOCAL_MACHINE, path);
+				CHKey::Create(HKEY_LOCAL_MACHINE, path, ReadWrite, INVALID_HANDLE_VALUE, &direct);
+				break;
+			case 1: {
+				DWORD data = random.Next(100);
+				batch.SetValue(HKEY_LOCAL_MACHINE, path, name, data);
+				CHKey::Create(HKEY_LOCAL_MACHINE, path, ReadWrite, INVALID_HANDLE_VALUE, &direct).SetValue(name, data);
+				break;
+			}
+			case 2:
+				batch.DeleteValue(HKEY_LOCAL_MACHINE, path, name);
+				CHKey::Open(HKEY_LOCAL_MACHINE, path, ReadWrite, INVALID_HANDLE_VALUE, &direct).DeleteValue(name);
+				break;
+			default:
+				batch.DeleteTree(HKEY_LOCAL_MACHINE, path);
+				CHKey::DeleteTree(HKEY_LOCAL_MACHINE, path, true, INVALID_HANDLE_VALUE, &direct);
+				break;
+			}
+		}
+		catch (Win32Exception&) {
+			//the batch reports this in its status
+		}
+	}
+}
+
+TEST(WriteBatch, CoalescesOperations)
+{
+	CMemRegBackend hive;
+	CWriteBatch batch(&hive);
+	size_t create1 = batch.CreateKey(HKEY_LOCAL_MACHINE, L"Software\\A");
+	size_t set1 = batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\A", L"v", L"one");
+	size_t create2 = batch.CreateKey(HKEY_LOCAL_MACHINE, L"\\software\\a\\");
+	size_t set2 = batch.SetValue(HKEY_LOCAL_MACHINE, L"SOFTWARE\\A", L"V", L"two");
+	size_t other = batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\A", L"w", (DWORD)3);
+	CHECK(batch.Count() == 5);
+	CHECK(batch.EffectiveCount() == 3);
+
+	CHECK(batch.Apply());
+	for (size_t i : { create1, set1, create2, set2, other })
+		CHECK(batch.Status(i) == ERROR_SUCCESS);
+	CHKey key = CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\A", GENERIC_READ, INVALID_HANDLE_VALUE, &hive);
+	CHECK(key.GetWSValue(L"v") == L"two");
+	CHECK(key.GetDWValue(L"w") == 3);
+
+	//a tree deletion drops everything before it inside the tree
+	batch.Clear();
+	batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\A\\B", L"x", L"gone");
+	batch.CreateKey(HKEY_LOCAL_MACHINE, L"Software\\A\\C");
+	batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\AB", L"x", L"kept");
+	size_t deleted = batch.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\A");
+	size_t recreated = batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\A", L"v", L"three");
+	CHECK(batch.EffectiveCount() == 3);
+	CHECK(batch.Apply());
+	CHECK(batch.Status(deleted) == ERROR_SUCCESS && batch.Status(recreated) == ERROR_SUCCESS);
+	CHECK(Dump(hive) == std::vector<std::wstring>({
+		L"HKLM\\SOFTWARE",
+		L"HKLM\\SOFTWARE\\A V=\"three\"",
+		L"HKLM\\SOFTWARE\\AB X=\"kept\"",
+		L"HKLM\\SOFTWARE\\CLASSES" }));
+}
+
+TEST(WriteBatch, FailureRollsBackEverything)
+{
+	CMemRegBackend hive;
+	CreateKeys(hive);
+	std::vector<std::wstring> before = Dump(hive);
+
+	CWriteBatch batch(&hive);
+	size_t set = batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\A", L"v", L"changed");
+	size_t deleted = batch.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\C");
+	size_t missingValue = batch.DeleteValue(HKEY_LOCAL_MACHINE, L"Software\\A", L"none");
+	size_t missingKey = batch.DeleteValue(HKEY_LOCAL_MACHINE, L"Software\\None", L"v");
+	CHECK(!batch.Apply());
+	CHECK(batch.Status(set) == ERROR_SUCCESS);
+	CHECK(batch.Status(deleted) == ERROR_SUCCESS);
+	CHECK(batch.Status(missingValue) == ERROR_FILE_NOT_FOUND);
+	CHECK(batch.Status(missingKey) == ERROR_FILE_NOT_FOUND);
+	CHECK(Dump(hive) == before);
+
+	//deleting what the batch itself created is not a failure
+	batch.Clear();
+	size_t create = batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\E", L"v", L"new");
+	size_t deleteValue = batch.DeleteValue(HKEY_LOCAL_MACHINE, L"Software\\E", L"v");
+	size_t deleteAgain = batch.DeleteValue(HKEY_LOCAL_MACHINE, L"Software\\E", L"v");
+	size_t deleteTree = batch.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\E");
+	CHECK(batch.Apply());
+	for (size_t i : { create, deleteValue, deleteAgain, deleteTree })
+		CHECK(batch.Status(i) == ERROR_SUCCESS);
+	CHECK(Dump(hive) == before);
+
+	//but the parent of a deleted tree stays, as it does when the keys are created one by one
+	batch.Clear();
+	batch.CreateKey(HKEY_LOCAL_MACHINE, L"Software\\F\\G\\H");
+	batch.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\F\\G\\H");
+	batch.DeleteTree(HKEY_LOCAL_MACHINE, L"Software\\F\\G");
+	CHECK(batch.EffectiveCount() == 1);
+	CHECK(batch.Apply());
+	CHECK(CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\F", INVALID_HANDLE_VALUE, &hive));
+	CHECK(!CHKey::Exists(HKEY_LOCAL_MACHINE, L"Software\\F\\G", INVALID_HANDLE_VALUE, &hive));
+}
+
+TEST(WriteBatch, CallerTransaction)
+{
+	CMemRegBackend hive;
+	CreateKeys(hive);
+	std::vector<std::wstring> before = Dump(hive);
+
+	HANDLE transaction = INVALID_HANDLE_VALUE;
+	CHECK(hive.CreateTransaction(&transaction) == ERROR_SUCCESS);
+	CWriteBatch batch(&hive);
+	batch.SetValue(HKEY_LOCAL_MACHINE, L"Software\\A", L"v", L"changed");
+	size_t missing = batch.DeleteValue(HKEY_LOCAL_MACHINE, L"Software\\A", L"none");
+	CHECK(!batch.Apply(transaction));
+	CHECK(batch.Status(missing) == ERROR_FILE_NOT_FOUND);
+
+	//the caller decides: the successful part is there until the rollback
+	CHECK(CHKey::Open(HKEY_LOCAL_MACHINE, L"Software\\A", GENERIC_READ, INVALID_HANDLE_VALUE, &hive).GetWSValue(L"v") == L"changed");
+	CHECK(hive.RollbackTransaction(transaction) == ERROR_SUCCESS);
+	CHECK(hive.CloseTransaction(transaction) == ERROR_SUCCESS);
+	CHECK(Dump(hive) == before);
+}
+
+TEST(WriteBatch, SameAsOneByOne)
+{
+	CRandom random(7);
+	size_t applied = 0;
+	for (int trial = 0; trial < 500; trial++) {
+		CMemRegBackend batched;
+		CMemRegBackend direct;
+		CreateKeys(batched);
+		CreateKeys(direct);
+		std::vector<std::wstring> before = Dump(batched);
+
+		CWriteBatch batch(&batched);
+		size_t count = 1 + random.Next(8);
+		for (size_t i = 0; i < count; i++)
+			RandomOperation(random, batch, direct);
+		CHECK(batch.Count() == count);
+		CHECK(batch.EffectiveCount() <= count);
+
+		if (batch.Apply()) {
+			CHECK(Dump(batched) == Dump(direct));
+			applied++;
+		}
+		else {
+			CHECK(Dump(batched) == before);
+		}
+	}
+	CHECK(applied > 100);
+}